@@ -30,7 +30,7 @@
 #ifndef _GZIP_ENCODING_H_
 #define _GZIP_ENCODING_H_
 #include "net/http_client_base.h"
-#include "zlib/zlib.h"
+#include <zlib.h>
 //#include "http.h"
 
 
@@ -181,7 +181,7 @@ namespace net_utils
 		*
 		*/
 		inline 
-		virtual void stop(std::string& OUT collect_remains)
+		virtual void stop(std::string& collect_remains)
 		{
 		}
 	protected:
@@ -61,6 +61,9 @@
 #define MONERO_DEFAULT_LOG_CATEGORY "net"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_QUE_MAX_BYTES (64 * 1024 * 1024)
+#define ABSTRACT_SERVER_WRITE_MAX_BUFFERS 64 // queued entries gathered into one write
+#define ABSTRACT_SERVER_WRITE_MAX_BYTES (64 * 1024) // stop gathering once a write is this big
 
 namespace epee
 {
@@ -138,11 +141,13 @@ namespace net_utils
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
+    virtual bool request_callback_on_sent();
     virtual boost::asio::io_service& get_io_service();
     virtual bool add_ref();
     virtual bool release();
     //------------------------------------------------------
     bool do_send_chunk(byte_slice chunk); ///< will send (or queue) a part of data. internal use only
+    void start_write(); ///< writes the head of the send queue as one gathered write. m_send_que_lock must be held
 
     boost::shared_ptr<connection<t_protocol_handler> > safe_shared_from_this();
     bool shutdown();
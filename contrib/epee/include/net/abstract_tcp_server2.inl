@@ -253,6 +253,23 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::request_callback_on_sent()
+  {
+    TRY_ENTRY();
+    {
+      CRITICAL_REGION_LOCAL(m_send_que_lock);
+      if (!m_send_que.empty())
+      {
+        // handle_write calls back once the queue drains
+        m_callback_on_sent = true;
+        return true;
+      }
+    }
+    return request_callback();
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::request_callback_on_sent()", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   boost::asio::io_service& connection<t_protocol_handler>::get_io_service()
   {
     return GET_IO_SERVICE(socket());
@@ -626,7 +643,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     long int retry=0;
     const long int retry_limit = 5*4;
-    while (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    while (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT || m_send_que_bytes > ABSTRACT_SERVER_SEND_QUE_MAX_BYTES)
     {
         retry++;
 
@@ -653,18 +670,19 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         _dbg1("sleep for queue: " << ms);
 
         if (retry > retry_limit) {
-            MWARNING("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
+            MWARNING("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << ") or ABSTRACT_SERVER_SEND_QUE_MAX_BYTES(" << ABSTRACT_SERVER_SEND_QUE_MAX_BYTES << "), shutting down connection");
             shutdown();
             return false;
         }
     }
 
+    m_send_que_bytes += chunk.size();
     m_send_que.push_back(std::move(chunk));
 
-    if(m_send_que.size() > 1)
+    if(m_send_que_writing)
     { // active operation should be in progress, nothing to do, just wait last operation callback
         auto size_now = m_send_que.back().size();
-        MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
+        MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size() << ", queued bytes=" << m_send_que_bytes);
         //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
       
       LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
@@ -683,16 +701,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         if (speed_limit_is_enabled())
 			do_send_handler_write( m_send_que.back().data(), m_send_que.back().size() ); // (((H)))
 
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
-        reset_timer(get_default_timeout(), false);
-            async_write(boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 strand_.wrap(
-                                 std::bind(&connection<t_protocol_handler>::handle_write, self, std::placeholders::_1, std::placeholders::_2)
-                                 )
-                                 );
-        //_dbg3("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //_info("[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+        start_write();
     }
     
     //do_send_handler_stop( ptr , cb ); // empty function
@@ -703,6 +712,34 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   } // do_send_chunk
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write()
+  {
+    // gather the small frames queued behind the head (levin headers, fluffed
+    // txes, chunks of a split message) into a single scatter-gather write.
+    // The queue keeps the slices alive until handle_write pops them.
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t size_now = 0;
+    for (const byte_slice& entry : m_send_que)
+    {
+      if (buffers.size() == ABSTRACT_SERVER_WRITE_MAX_BUFFERS)
+        break;
+      if (!buffers.empty() && size_now + entry.size() > ABSTRACT_SERVER_WRITE_MAX_BYTES)
+        break;
+      buffers.emplace_back(entry.data(), entry.size());
+      size_now += entry.size();
+    }
+    m_send_que_writing = buffers.size();
+    MDEBUG("start_write() NOW SENDS: " << size_now << " B in " << buffers.size() << " buffers, from queue size=" << m_send_que.size());
+
+    reset_timer(get_default_timeout(), false);
+    async_write(buffers,
+      strand_.wrap(
+        std::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), std::placeholders::_1, std::placeholders::_2)
+      )
+    );
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   boost::posix_time::milliseconds connection<t_protocol_handler>::get_default_timeout()
   {
     unsigned count;
@@ -866,6 +903,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		}
 
     bool do_shutdown = false;
+    bool do_callback = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
     if(m_send_que.empty())
     {
@@ -873,31 +911,45 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    // the write that just completed covered the first m_send_que_writing entries
+    for (; m_send_que_writing && !m_send_que.empty(); --m_send_que_writing)
+    {
+      m_send_que_bytes -= m_send_que.front().size();
+      m_send_que.pop_front();
+    }
+    m_send_que_writing = 0;
     if(m_send_que.empty())
     {
-      if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
+      // the protocol handler has more to send, so the connection is not done yet
+      if(m_callback_on_sent)
+      {
+        m_callback_on_sent = false;
+        do_callback = true;
+      }
+      else if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
       {
         do_shutdown = true;
       }
     }else
     {
       //have more data to send
-		reset_timer(get_default_timeout(), false);
-		auto size_now = m_send_que.front().size();
-		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
 		if (speed_limit_is_enabled())
 			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-		  async_write(boost::asio::buffer(m_send_que.front().data(), size_now) , 
-           strand_.wrap(
-            std::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), std::placeholders::_1, std::placeholders::_2)
-			  )
-          );
-      //_dbg3("(normal)" << size_now);
+		start_write();
     }
     CRITICAL_REGION_END();
 
+    if(do_callback)
+    {
+      // already running in the strand, and the queue lock is released so the handler can send
+      m_protocol_handler.handle_qued_callback();
+      bool drained = false;
+      CRITICAL_REGION_BEGIN(m_send_que_lock);
+      drained = m_send_que.empty() && !m_callback_on_sent;
+      CRITICAL_REGION_END();
+      do_shutdown = drained && boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection);
+    }
+
     if(do_shutdown)
     {
       shutdown();
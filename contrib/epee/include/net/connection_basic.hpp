@@ -110,6 +110,9 @@ class connection_basic { // not-templated base class for rapid developmet of som
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
     std::deque<byte_slice> m_send_que;
+    size_t m_send_que_bytes; // bytes held in m_send_que, including the write in progress
+    size_t m_send_que_writing; // number of m_send_que entries handed to the write in progress
+    bool m_callback_on_sent; // handle_qued_callback is due once m_send_que drains
     volatile bool m_is_multithreaded;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
@@ -30,6 +30,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -118,6 +119,7 @@ namespace net_utils
 			std::string m_cookie;			//"Cookie:"
 			std::string m_user_agent;	//"User-Agent:"
 			std::string m_origin;           //"Origin:"
+			std::string m_accept_encoding;  //"Accept-Encoding:"
 			fields_list m_etc_fields;
 
 			void clear()
@@ -132,6 +134,7 @@ namespace net_utils
 				m_cookie.clear();
 				m_user_agent.clear();
 				m_origin.clear();
+				m_accept_encoding.clear();
 				m_etc_fields.clear();
 			}
 		};
@@ -185,6 +188,24 @@ namespace net_utils
 		};
 
 
+		/*! Produces a response body piece by piece. Each call appends the next
+		    piece to `chunk`; appending nothing ends the body. Returning false
+		    aborts the response and drops the connection. Pieces are generated
+		    on the connection's io thread, each once the previous one was written. */
+		typedef std::function<bool(std::string& chunk)> body_generator;
+
+		struct http_response_info;
+
+		/*! Hands a deferred response back to its connection, from any thread.
+		    Only the first call counts. */
+		typedef std::function<void(http_response_info&& response)> response_sink;
+
+		/*! Starts work whose response is not ready when the handler returns, such
+		    as a long poll, keeping `done` to call once it is. It must be called in
+		    the end. Meanwhile the connection holds no server thread, and answers
+		    no other request. */
+		typedef std::function<void(const response_sink& done)> response_deferrer;
+
 		struct http_response_info 
 		{
 			int					m_response_code;
@@ -195,6 +216,8 @@ namespace net_utils
 			http_header_info    m_header_info;
 			int                 m_http_ver_hi;// OUT paramter only
 			int                 m_http_ver_lo;// OUT paramter only
+			body_generator      m_body_generator;// sent chunked instead of m_body when set
+			response_deferrer   m_deferred;// the response comes later, through the sink it is started with, when set
 
 			void clear()
 			{
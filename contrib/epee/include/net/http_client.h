@@ -41,6 +41,10 @@
 #include "net_helper.h"
 #include "http_client_base.h"
 
+// builds with zlib ask for, and decode, gzip responses
+#if defined(HAVE_ZLIB) && !defined(HTTP_ENABLE_GZIP)
+#define HTTP_ENABLE_GZIP
+#endif
 #ifdef HTTP_ENABLE_GZIP
 #include "gzip_encoding.h"
 #endif 
@@ -256,6 +260,13 @@ namespace net_utils
 				req_buff.append(method.data(), method.size()).append(" ").append(uri.data(), uri.size()).append(" HTTP/1.1\r\n");
 				add_field(req_buff, "Host", m_host_buff);
 				add_field(req_buff, "Content-Length", std::to_string(body.size()));
+#ifdef HTTP_ENABLE_GZIP
+				const bool accept_encoding_set = std::any_of(additional_params.begin(), additional_params.end(), [](const std::pair<std::string, std::string>& field) {
+					return !string_tools::compare_no_case(field.first, "Accept-Encoding");
+				});
+				if (!accept_encoding_set)
+					add_field(req_buff, "Accept-Encoding", "gzip");
+#endif
 
 				//handle "additional_params"
 				for(const auto& field : additional_params)
@@ -0,0 +1,87 @@
+// Copyright (c) 2014-2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace epee
+{
+namespace net_utils
+{
+  namespace http
+  {
+    //! Response body codings, from RFC 7231 and RFC 8878.
+    enum class content_coding : std::uint8_t
+    {
+      identity = 0,
+      gzip,
+      zstd
+    };
+
+    //! \return True if this build can produce `coding`.
+    bool is_supported(content_coding coding) noexcept;
+
+    //! \return Token for the Content-Encoding field, empty for identity.
+    const char* get_name(content_coding coding) noexcept;
+
+    /*! \return The supported coding with the highest weight in an
+        Accept-Encoding value, zstd first on a tie. identity when nothing
+        else is acceptable, or the field is empty. */
+    content_coding negotiate_content_coding(boost::string_ref accept_encoding);
+
+    //! Compresses one response body, piece by piece.
+    class body_compressor
+    {
+    public:
+      //! `coding` must be supported and not identity.
+      explicit body_compressor(content_coding coding);
+      body_compressor(body_compressor&&) = delete;
+      body_compressor(const body_compressor&) = delete;
+      ~body_compressor();
+      body_compressor& operator=(body_compressor&&) = delete;
+      body_compressor& operator=(const body_compressor&) = delete;
+
+      /*! Appends `in`, compressed, to `out`. Output is flushed at the end of
+          each call so it can be sent as is; `finish` also ends the stream.
+          \return False on a compressor error. */
+      bool compress(boost::string_ref in, std::string& out, bool finish);
+
+      //! Compresses a whole body in one go.
+      static bool compress(content_coding coding, boost::string_ref in, std::string& out);
+
+      struct impl;
+    private:
+      std::unique_ptr<impl> m_impl;
+    };
+  }
+}
+}
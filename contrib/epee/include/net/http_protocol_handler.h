@@ -31,11 +31,13 @@
 #define _HTTP_SERVER_H_
 
 #include <boost/optional/optional.hpp>
+#include <memory>
 #include <string>
 #include "net_utils_base.h"
 #include "to_nonconst_iterator.h"
 #include "http_auth.h"
 #include "http_base.h"
+#include "http_compression.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "net.http"
@@ -57,6 +59,7 @@ namespace net_utils
 			std::vector<std::string> m_access_control_origins;
 			boost::optional<login> m_user;
 			critical_section m_lock;
+			bool m_compress = false; //!< Compress bodies for clients that accept it
 		};
 
 		/************************************************************************/
@@ -92,6 +95,8 @@ namespace net_utils
 			}
 			virtual bool handle_recv(const void* ptr, size_t cb);
 			virtual bool handle_request(const http::http_request_info& query_info, http_response_info& response);
+			//! Sends the next chunk of a streamed body once the previous one was written, or a deferred response once it is ready
+			void handle_qued_callback();
 
 		private:
 			enum machine_state{
@@ -128,6 +133,12 @@ namespace net_utils
 
 			//major function 
 			inline bool handle_request_and_send_response(const http::http_request_info& query_info);
+			bool send_response(const http::http_request_info& query_info, http_response_info& response);
+			bool defer_response(const http::http_request_info& query_info, const response_deferrer& deferrer);
+			bool send_deferred_response();
+			bool send_chunked_body(const http::http_request_info& query_info, const body_generator& generator);
+			bool send_next_chunk();
+			void compress_response(const http::http_request_info& query_info, http_response_info& response);
 
 
 			std::string get_not_found_response_body(const std::string& URI);
@@ -142,6 +153,18 @@ namespace net_utils
 			config_type& m_config;
 			bool m_want_close;
 			size_t m_newlines;
+			body_generator m_chunked_body; //!< Set while a streamed body is being sent
+			std::string m_chunked_uri;
+
+			//! Filled in by the sink of a deferred response, from any thread
+			struct deferred_response
+			{
+				critical_section lock;
+				bool completed = false;
+				http_response_info response{};
+			};
+			std::shared_ptr<deferred_response> m_deferred; //!< Set while a response is deferred
+			http::http_request_info m_deferred_query;
 		protected:
 			i_service_endpoint* m_psnd_hndlr; 
 			t_connection_context& m_conn_context;
@@ -209,8 +232,6 @@ namespace net_utils
 			{
 				return m_config.m_phandler->deinit_server_thread();
 			}
-			void handle_qued_callback()
-			{}
 			bool after_init_connection()
 			{
 				return true;
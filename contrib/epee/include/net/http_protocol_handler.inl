@@ -40,6 +40,7 @@
 #define HTTP_MAX_URI_LEN		 9000 
 #define HTTP_MAX_HEADER_LEN		 100000
 #define HTTP_MAX_STARTING_NEWLINES       8
+#define HTTP_COMPRESS_MIN_SIZE           1024
 
 namespace epee
 {
@@ -206,6 +207,10 @@ namespace net_utils
 		m_config(config),
 		m_want_close(false),
 		m_newlines(0),
+		m_chunked_body(),
+		m_chunked_uri(),
+		m_deferred(),
+		m_deferred_query(),
 		m_psnd_hndlr(psnd_hndlr),
 		m_conn_context(conn_context)
 	{
@@ -251,6 +256,13 @@ namespace net_utils
 		m_is_stop_handling = false;
 		while(!m_is_stop_handling)
 		{
+			// requests pipelined after one that closes the connection are not answered
+			if(m_want_close)
+				break;
+			// requests pipelined behind a streamed or deferred response wait until it is sent
+			if(m_chunked_body || m_deferred)
+				break;
+
 			switch(m_state)
 			{
 			case http_state_retriving_comand_line:
@@ -308,7 +320,10 @@ namespace net_utils
 					break;
 				}
 			case http_state_retriving_body:
-				return handle_retriving_query_body();
+				// the rest of the buffer may hold the next pipelined request
+				if(!handle_retriving_query_body())
+					return false;
+				break;
 			case http_state_connection_close:
 				return false;
 			default:
@@ -360,7 +375,7 @@ namespace net_utils
 		boost::smatch result;	
 		if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
 		{
-			if (!analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi))
+			if (!analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_lo))
 			{
 				m_state = http_state_error;
 				MERROR("Failed to analyze method");
@@ -396,6 +411,11 @@ namespace net_utils
 	{
 
     //Here we returning head size, including terminating sequence (\r\n\r\n or \n\n)
+		//A request without any header field ends right after its request line
+		if(!buf.compare(0, 2, "\r\n"))
+			return 2;
+		if(!buf.compare(0, 1, "\n"))
+			return 1;
 		std::string::size_type res = buf.find("\r\n\r\n");
 		if(std::string::npos != res)
 			return res+4;
@@ -502,10 +522,10 @@ namespace net_utils
 	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos)
 	{ 
 		STATIC_REGEXP_EXPR_1(rexp_mach_field, 
-			"\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)|(User-Agent)|(Origin)"
-			//  12            3         4                5              6                   7                  8      9        10           11
+			"\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)|(User-Agent)|(Origin)|(Accept-Encoding)"
+			//  12            3         4                5              6                   7                  8      9        10           11       12
 			"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-			//11             1213   14 
+			//13             1415   16 
 			boost::regex::icase | boost::regex::normal);
 
 		boost::smatch		result;
@@ -517,8 +537,8 @@ namespace net_utils
 		//lookup all fields and fill well-known fields
 		while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched) 
 		{
-			const size_t field_val = 14;
-			const size_t field_etc_name = 12;
+			const size_t field_val = 15;
+			const size_t field_etc_name = 13;
 
 			int i = 2; //start position = 2
 			if(result[i++].matched)//"Connection"
@@ -541,6 +561,8 @@ namespace net_utils
 				body_info.m_user_agent = result[field_val];
 			else if(result[i++].matched)//"Origin"
 				body_info.m_origin = result[field_val];
+			else if(result[i++].matched)//"Accept-Encoding"
+				body_info.m_accept_encoding = result[field_val];
 			else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
 				body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
 			else
@@ -588,19 +610,243 @@ namespace net_utils
 			response.m_response_comment = "OK";
 		}
 
+		if (response.m_deferred)
+			return defer_response(query_info, response.m_deferred) && res;
+		return send_response(query_info, response) && res;
+	}
+	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::send_response(const http::http_request_info& query_info, http_response_info& response)
+	{
+		// HTTP/1.0 clients can't take a chunked body, and HEAD needs the real length
+		const bool http11 = query_info.m_http_ver_hi > 1 || (query_info.m_http_ver_hi == 1 && query_info.m_http_ver_lo >= 1);
+		if (response.m_body_generator && (!http11 || query_info.m_http_method == http::http_method_head))
+		{
+			const body_generator generator = std::move(response.m_body_generator);
+			response.m_body_generator = nullptr;
+			for (size_t size = 0; ; size = response.m_body.size())
+			{
+				if (!generator(response.m_body))
+				{
+					MERROR("Failed to generate response body for " << query_info.m_URI);
+					response.m_body.clear();
+					response.m_response_code = 500;
+					response.m_response_comment = "Internal Server Error";
+					m_want_close = true;
+					break;
+				}
+				if (response.m_body.size() == size)
+					break;
+			}
+		}
+
+		if (m_config.m_compress)
+			compress_response(query_info, response);
+
 		std::string response_data = get_response_header(response);
 		//LOG_PRINT_L0("HTTP_SEND: << \r\n" << response_data + response.m_body);
 
 		LOG_PRINT_L3("HTTP_RESPONSE_HEAD: << \r\n" << response_data);
 
+		if (response.m_body_generator)
+		{
+			m_psnd_hndlr->do_send(byte_slice{std::move(response_data)});
+			return send_chunked_body(query_info, response.m_body_generator);
+		}
+
 		if ((response.m_body.size() && (query_info.m_http_method != http::http_method_head)) || (query_info.m_http_method == http::http_method_options))
 			response_data += response.m_body;
 
 		m_psnd_hndlr->do_send(byte_slice{std::move(response_data)});
 		m_psnd_hndlr->send_done();
+		return true;
+	}
+	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::defer_response(const http::http_request_info& query_info, const response_deferrer& deferrer)
+	{
+		// The connection is kept alive until the sink is called, and it only
+		// posts the response back to the connection's strand to be sent.
+		if (!m_psnd_hndlr->add_ref())
+			return false;
+		m_deferred = std::make_shared<deferred_response>();
+		m_deferred_query = query_info;
+		const std::shared_ptr<deferred_response> deferred = m_deferred;
+		i_service_endpoint* const endpoint = m_psnd_hndlr;
+		const response_sink done = [deferred, endpoint](http_response_info&& response) {
+			{
+				CRITICAL_REGION_LOCAL(deferred->lock);
+				if (deferred->completed)
+					return;
+				deferred->completed = true;
+				deferred->response = std::move(response);
+			}
+			endpoint->request_callback();
+			endpoint->release();
+		};
+		try
+		{
+			deferrer(done);
+		}
+		catch (const std::exception& e)
+		{
+			MERROR("Failed to defer response for " << query_info.m_URI << ": " << e.what());
+			http_response_info response{};
+			response.m_response_code = 500;
+			response.m_response_comment = "Internal Server Error";
+			done(std::move(response));
+		}
+		return true;
+	}
+	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::send_deferred_response()
+	{
+		http_response_info response{};
+		{
+			CRITICAL_REGION_LOCAL(m_deferred->lock);
+			if (!m_deferred->completed)
+				return true;
+			response = std::move(m_deferred->response);
+		}
+		m_deferred.reset();
+		if (response.m_response_code == 500)
+			m_want_close = true;
+
+		// the response header is made from the request being answered
+		m_query_info = std::move(m_deferred_query);
+		m_deferred_query.clear();
+		const bool res = send_response(m_query_info, response);
+		set_ready_state();
 		return res;
 	}
 	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::send_chunked_body(const http::http_request_info& query_info, const body_generator& generator)
+	{
+		m_chunked_body = generator;
+		m_chunked_uri = query_info.m_URI;
+		return send_next_chunk();
+	}
+	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::send_next_chunk()
+	{
+		// Each chunk is generated straight after a fixed width size line, which is
+		// patched once the chunk is known. The next chunk is only generated once
+		// this one was written, so generation never runs ahead of the socket and
+		// never waits on it either.
+		static constexpr const size_t size_digits = 8;
+		static constexpr const char hex[] = "0123456789abcdef";
+		std::string chunk(size_digits, '0');
+		chunk += "\r\n";
+		if (!m_chunked_body(chunk))
+		{
+			MERROR("Failed to generate response body for " << m_chunked_uri << ", dropping connection");
+			m_chunked_body = nullptr;
+			m_want_close = true;
+			m_psnd_hndlr->close();
+			return false;
+		}
+		size_t size = chunk.size() - size_digits - 2;
+		if (size >= (size_t(1) << (4 * size_digits)))
+		{
+			MERROR("Response chunk too large: " << size << ", dropping connection");
+			m_chunked_body = nullptr;
+			m_want_close = true;
+			m_psnd_hndlr->close();
+			return false;
+		}
+		const bool last = size == 0;
+		for (size_t i = size_digits; i-- > 0; size >>= 4)
+			chunk[i] = hex[size & 0xf];
+		chunk += "\r\n";
+		if (!m_psnd_hndlr->do_send(byte_slice{std::move(chunk)}))
+		{
+			m_chunked_body = nullptr;
+			return false;
+		}
+		if (!last)
+			return m_psnd_hndlr->request_callback_on_sent();
+
+		m_chunked_body = nullptr;
+		m_chunked_uri.clear();
+		m_psnd_hndlr->send_done();
+		return true;
+	}
+	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
+	void simple_http_connection_handler<t_connection_context>::handle_qued_callback()
+	{
+		if (m_deferred)
+		{
+			if (!send_deferred_response() || m_deferred || m_chunked_body)
+				return;
+		}
+		else if (!m_chunked_body || !send_next_chunk() || m_chunked_body)
+			return;
+
+		// answer the requests that were pipelined behind the response
+		std::string buf;
+		const bool res = handle_buff_in(buf);
+		if (!res || m_want_close)
+			m_psnd_hndlr->close();
+	}
+	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
+	void simple_http_connection_handler<t_connection_context>::compress_response(const http::http_request_info& query_info, http_response_info& response)
+	{
+		// no body to compress, or not worth it
+		if (query_info.m_http_method == http::http_method_head || query_info.m_http_method == http::http_method_options)
+			return;
+		if (response.m_response_code != 200 || (!response.m_body_generator && response.m_body.size() < HTTP_COMPRESS_MIN_SIZE))
+			return;
+		for (const auto& field: response.m_additional_fields)
+			if (!string_tools::compare_no_case(field.first, "Content-Encoding"))
+				return;
+
+		response.m_additional_fields.emplace_back("Vary", "Accept-Encoding");
+		const content_coding coding = negotiate_content_coding(query_info.m_header_info.m_accept_encoding);
+		if (coding == content_coding::identity)
+			return;
+
+		if (response.m_body_generator)
+		{
+			// Each piece is compressed and flushed as it is generated, so a chunk
+			// goes out as soon as it would have uncompressed. The end of the body
+			// flushes the trailer, which is sent ahead of the final empty chunk.
+			struct stream
+			{
+				stream(content_coding coding, body_generator generator)
+					: compressor(coding), generator(std::move(generator)), piece(), done(false)
+				{}
+
+				body_compressor compressor;
+				const body_generator generator;
+				std::string piece;
+				bool done;
+			};
+			const std::shared_ptr<stream> state = std::make_shared<stream>(coding, std::move(response.m_body_generator));
+			response.m_body_generator = [state](std::string& chunk) {
+				if (state->done)
+					return true;
+				state->piece.clear();
+				if (!state->generator(state->piece))
+					return false;
+				state->done = state->piece.empty();
+				return state->compressor.compress(state->piece, chunk, state->done);
+			};
+		}
+		else
+		{
+			std::string compressed;
+			if (!body_compressor::compress(coding, response.m_body, compressed) || compressed.size() >= response.m_body.size())
+				return;
+			response.m_body = std::move(compressed);
+		}
+		response.m_additional_fields.emplace_back("Content-Encoding", get_name(coding));
+	}
+	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_request(const http::http_request_info& query_info, http_response_info& response)
 	{
@@ -636,9 +882,11 @@ namespace net_utils
 	{
 		std::string buf = "HTTP/1.1 ";
 		buf += boost::lexical_cast<std::string>(response.m_response_code) + " " + response.m_response_comment + "\r\n" +
-			"Server: Epee-based\r\n"
-			"Content-Length: ";
-		buf += boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
+			"Server: Epee-based\r\n";
+		if (response.m_body_generator)
+			buf += "Transfer-Encoding: chunked\r\n";
+		else
+			buf += "Content-Length: " + boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
 
 		if(!response.m_mime_tipe.empty())
 		{
@@ -654,16 +902,18 @@ namespace net_utils
 		//Wed, 01 Dec 2010 03:27:41 GMT"
 
 		string_tools::trim(m_query_info.m_header_info.m_connection);
-		if(m_query_info.m_header_info.m_connection.size())
+		// HTTP/1.0 connections are only persistent when asked for
+		const bool http10 = m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo == 0;
+		const bool keep_alive = !string_tools::compare_no_case("keep-alive", m_query_info.m_header_info.m_connection);
+		if(!string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection) || (http10 && !keep_alive))
 		{
-			if(!string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection))
-			{
-        //closing connection after sending
-				buf += "Connection: close\r\n";
-				m_state = http_state_connection_close;
-				m_want_close = true;
-			}
+			//closing connection after sending
+			buf += "Connection: close\r\n";
+			m_state = http_state_connection_close;
+			m_want_close = true;
 		}
+		else if(http10)
+			buf += "Connection: keep-alive\r\n";
 
 		// Cross-origin resource sharing
 		if(m_query_info.m_header_info.m_origin.size())
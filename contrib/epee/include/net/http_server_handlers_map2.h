@@ -30,10 +30,25 @@
 #include "jsonrpc_structs.h"
 #include "storages/portable_storage.h"
 #include "storages/portable_storage_template_helper.h"
+#include "storages/json_storage_reader.h"
+#include "storages/json_storage_writer.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "net.http"
 
+namespace epee
+{
+namespace net_utils
+{
+namespace http
+{
+  //! Parks a call mapped with MAP_URI_AUTO_JON2_DEFERRED, started with a function to call once with the response
+  template<typename t_response>
+  using json_deferrer = std::function<void(const std::function<void(const t_response&)>& done)>;
+}
+}
+}
+
 
 #define CHAIN_HTTP_TO_MAP2(context_type) bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, \
               epee::net_utils::http::http_response_info& response, \
@@ -65,6 +80,8 @@
 
 #define MAP_URI2(pattern, callback)  else if(std::string::npos != query_info.m_URI.find(pattern)) return callback(query_info, response_info, &m_conn_context);
 
+#define MAP_URI2_IF(s_pattern, callback, cond)  else if((query_info.m_URI == s_pattern) && (cond)) return callback(query_info, response_info, &m_conn_context);
+
 #define MAP_URI_AUTO_XML2(s_pattern, callback_f, command_type) //TODO: don't think i ever again will use xml - ambiguous and "overtagged" format
 
 #define MAP_URI_AUTO_JON2_IF(s_pattern, callback_f, command_type, cond) \
@@ -73,7 +90,7 @@
       handled = true; \
       uint64_t ticks = misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
-      bool parse_res = epee::serialization::load_t_from_json(static_cast<command_type::request&>(req), query_info.m_body); \
+      bool parse_res = epee::serialization::load_t_from_json_direct(static_cast<command_type::request&>(req), query_info.m_body); \
       CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse json: \r\n" << query_info.m_body); \
       uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::response> resp;\
@@ -88,7 +105,7 @@
         return true; \
       } \
       uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
-      epee::serialization::store_t_to_json(static_cast<command_type::response&>(resp), response_info.m_body); \
+      epee::serialization::store_t_to_json_direct(static_cast<command_type::response&>(resp), response_info.m_body); \
       uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
       response_info.m_mime_tipe = "application/json"; \
       response_info.m_header_info.m_content_type = " application/json"; \
@@ -97,6 +114,45 @@
 
 #define MAP_URI_AUTO_JON2(s_pattern, callback_f, command_type) MAP_URI_AUTO_JON2_IF(s_pattern, callback_f, command_type, true)
 
+// `cache` yields an object testing false when the response must not be cached, with
+// `find(request_body, response_body)` and `store(request_body, response_body)`. Only
+// successful calls are stored.
+#define MAP_URI_AUTO_JON2_CACHED(s_pattern, callback_f, command_type, cache) \
+    else if(query_info.m_URI == s_pattern) \
+    { \
+      handled = true; \
+      const auto cache_ = cache; \
+      response_info.m_mime_tipe = "application/json"; \
+      response_info.m_header_info.m_content_type = " application/json"; \
+      if (cache_ && cache_.find(query_info.m_body, response_info.m_body)) \
+      { \
+        MDEBUG( s_pattern << " served from cache"); \
+        return true; \
+      } \
+      uint64_t ticks = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::request> req; \
+      bool parse_res = epee::serialization::load_t_from_json_direct(static_cast<command_type::request&>(req), query_info.m_body); \
+      CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse json: \r\n" << query_info.m_body); \
+      uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::response> resp;\
+      MINFO(m_conn_context << "calling " << s_pattern); \
+      bool res = false; \
+      try { res = callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp), &m_conn_context); } \
+      catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "(): " << e.what()); } \
+      if (!res) \
+      { \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
+      epee::serialization::store_t_to_json_direct(static_cast<command_type::response&>(resp), response_info.m_body); \
+      uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+      if (cache_) \
+        cache_.store(query_info.m_body, response_info.m_body); \
+      MDEBUG( s_pattern << " processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
+    }
+
 #define MAP_URI_AUTO_BIN2(s_pattern, callback_f, command_type) \
     else if(query_info.m_URI == s_pattern) \
     { \
@@ -125,23 +181,114 @@
       MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
     }
 
+// The callback takes an extra `body_generator*`; when it sets the generator the
+// response body is streamed from it and `resp` is not serialized.
+#define MAP_URI_AUTO_BIN2_STREAMED(s_pattern, callback_f, command_type) \
+    else if(query_info.m_URI == s_pattern) \
+    { \
+      handled = true; \
+      uint64_t ticks = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::request> req; \
+      bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), epee::strspan<uint8_t>(query_info.m_body)); \
+      CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse bin body data, body size=" << query_info.m_body.size()); \
+      uint64_t ticks1 = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::response> resp;\
+      MINFO(m_conn_context << "calling " << s_pattern); \
+      bool res = false; \
+      try { res = callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp), &m_conn_context, &response_info.m_body_generator); } \
+      catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "()"); } \
+      if (!res) \
+      { \
+        response_info.m_body_generator = nullptr; \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      uint64_t ticks2 = misc_utils::get_tick_count(); \
+      if (!response_info.m_body_generator) \
+        epee::serialization::store_t_to_binary(static_cast<command_type::response&>(resp), response_info.m_body); \
+      uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+      response_info.m_mime_tipe = " application/octet-stream"; \
+      response_info.m_header_info.m_content_type = " application/octet-stream"; \
+      MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms" << (response_info.m_body_generator ? ", streaming" : "")); \
+    }
+
+// The callback takes an extra `json_deferrer<command_type::response>*`; when it
+// sets the deferrer the call is parked there, and the response it hands back
+// later, from any thread, is sent instead of `resp`.
+#define MAP_URI_AUTO_JON2_DEFERRED(s_pattern, callback_f, command_type) \
+    else if(query_info.m_URI == s_pattern) \
+    { \
+      handled = true; \
+      uint64_t ticks = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::request> req; \
+      bool parse_res = epee::serialization::load_t_from_json_direct(static_cast<command_type::request&>(req), query_info.m_body); \
+      CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse json: \r\n" << query_info.m_body); \
+      uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::response> resp;\
+      epee::net_utils::http::json_deferrer<command_type::response> defer; \
+      MINFO(m_conn_context << "calling " << s_pattern); \
+      bool res = false; \
+      try { res = callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp), &m_conn_context, &defer); } \
+      catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "(): " << e.what()); } \
+      if (!res) \
+      { \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
+      if (defer) \
+      { \
+        response_info.m_deferred = [defer](const epee::net_utils::http::response_sink& done) { \
+          defer([done](const command_type::response& resp) { \
+            epee::net_utils::http::http_response_info response{}; \
+            response.m_response_code = 200; \
+            response.m_response_comment = "Ok"; \
+            epee::serialization::store_t_to_json_direct(resp, response.m_body); \
+            response.m_mime_tipe = "application/json"; \
+            response.m_header_info.m_content_type = " application/json"; \
+            done(std::move(response)); \
+          }); \
+        }; \
+      } \
+      else \
+        epee::serialization::store_t_to_json_direct(static_cast<command_type::response&>(resp), response_info.m_body); \
+      uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+      response_info.m_mime_tipe = "application/json"; \
+      response_info.m_header_info.m_content_type = " application/json"; \
+      MDEBUG( s_pattern << " processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms" << (defer ? ", deferred" : "")); \
+    }
+
 #define CHAIN_URI_MAP2(callback) else {callback(query_info, response_info, m_conn_context);handled = true;}
 
 #define END_URI_MAP2() return handled;}
 
 
+#ifndef JSON_RPC_MAX_BATCH_SIZE
+#define JSON_RPC_MAX_BATCH_SIZE 256
+#endif
+
+// A body holding an array is a JSON-RPC 2.0 batch: each element runs through the
+// map as a request of its own, via the server's run_json_rpc_batch, and the
+// responses are sent back as an array. run_json_rpc_batch may run an element
+// again, when the first run was deferred, and the last run gives its response.
 #define BEGIN_JSON_RPC_MAP(uri)    else if(query_info.m_URI == uri) \
     { \
+    auto json_rpc_call_ = [&](const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info) -> bool \
+    { \
+    bool handled = false; \
+    (void)handled; \
     uint64_t ticks = epee::misc_utils::get_tick_count(); \
     response_info.m_mime_tipe = "application/json"; \
-    epee::serialization::portable_storage ps; \
+    epee::serialization::json_storage_reader ps; \
     if(!ps.load_from_json(query_info.m_body)) \
     { \
        boost::value_initialized<epee::json_rpc::error_response> rsp; \
        static_cast<epee::json_rpc::error_response&>(rsp).jsonrpc = "2.0"; \
        static_cast<epee::json_rpc::error_response&>(rsp).error.code = -32700; \
        static_cast<epee::json_rpc::error_response&>(rsp).error.message = "Parse error"; \
-       epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+       epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
        return true; \
     } \
     epee::serialization::storage_entry id_; \
@@ -154,7 +301,7 @@
       rsp.jsonrpc = "2.0"; \
       rsp.error.code = -32600; \
       rsp.error.message = "Invalid Request"; \
-      epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+      epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
       return true; \
     } \
     if(false) return true; //just a stub to have "else if"
@@ -172,7 +319,7 @@
     fail_resp.id = req.id; \
     fail_resp.error.code = -32602; \
     fail_resp.error.message = "Invalid params"; \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
     return true; \
   } \
   uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
@@ -183,7 +330,7 @@
 
 #define FINALIZE_OBJECTS_TO_JSON(method_name) \
   uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
-  epee::serialization::store_t_to_json(resp, response_info.m_body); \
+  epee::serialization::store_t_to_json_direct(resp, response_info.m_body); \
   uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
   response_info.m_mime_tipe = "application/json"; \
   response_info.m_header_info.m_content_type = " application/json"; \
@@ -202,7 +349,7 @@
   catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "(): " << e.what()); } \
   if (!res) \
   { \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
     return true; \
   } \
   FINALIZE_OBJECTS_TO_JSON(method_name) \
@@ -211,6 +358,38 @@
 
 #define MAP_JON_RPC_WE(method_name, callback_f, command_type) MAP_JON_RPC_WE_IF(method_name, callback_f, command_type, true)
 
+// see MAP_URI_AUTO_JON2_CACHED; the whole request body, id included, is the key
+#define MAP_JON_RPC_WE_CACHED(method_name, callback_f, command_type, cache) \
+    else if(callback_name == method_name) \
+{ \
+  const auto cache_ = cache; \
+  if (cache_ && cache_.find(query_info.m_body, response_info.m_body)) \
+  { \
+    handled = true; \
+    response_info.m_mime_tipe = "application/json"; \
+    response_info.m_header_info.m_content_type = " application/json"; \
+    MDEBUG( query_info.m_URI << "[" << method_name << "] served from cache"); \
+    return true; \
+  } \
+  PREPARE_OBJECTS_FROM_JSON(command_type) \
+  epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
+  fail_resp.jsonrpc = "2.0"; \
+  fail_resp.id = req.id; \
+  MINFO(m_conn_context << "Calling RPC method " << method_name); \
+  bool res = false; \
+  try { res = callback_f(req.params, resp.result, fail_resp.error, &m_conn_context); } \
+  catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "(): " << e.what()); } \
+  if (!res) \
+  { \
+    epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    return true; \
+  } \
+  FINALIZE_OBJECTS_TO_JSON(method_name) \
+  if (cache_) \
+    cache_.store(query_info.m_body, response_info.m_body); \
+  return true;\
+}
+
 #define MAP_JON_RPC_WERI(method_name, callback_f, command_type) \
     else if(callback_name == method_name) \
 { \
@@ -224,7 +403,7 @@
   catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "(): " << e.what()); } \
   if (!res) \
   { \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
     return true; \
   } \
   FINALIZE_OBJECTS_TO_JSON(method_name) \
@@ -246,10 +425,44 @@
     fail_resp.id = req.id; \
     fail_resp.error.code = -32603; \
     fail_resp.error.message = "Internal error"; \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    return true; \
+  } \
+  FINALIZE_OBJECTS_TO_JSON(method_name) \
+  return true;\
+}
+
+// see MAP_JON_RPC_WE_CACHED
+#define MAP_JON_RPC_CACHED(method_name, callback_f, command_type, cache) \
+    else if(callback_name == method_name) \
+{ \
+  const auto cache_ = cache; \
+  if (cache_ && cache_.find(query_info.m_body, response_info.m_body)) \
+  { \
+    handled = true; \
+    response_info.m_mime_tipe = "application/json"; \
+    response_info.m_header_info.m_content_type = " application/json"; \
+    MDEBUG( query_info.m_URI << "[" << method_name << "] served from cache"); \
+    return true; \
+  } \
+  PREPARE_OBJECTS_FROM_JSON(command_type) \
+  MINFO(m_conn_context << "calling RPC method " << method_name); \
+  bool res = false; \
+  try { res = callback_f(req.params, resp.result, &m_conn_context); } \
+  catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "(): " << e.what()); } \
+  if (!res) \
+  { \
+    epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
+    fail_resp.jsonrpc = "2.0"; \
+    fail_resp.id = req.id; \
+    fail_resp.error.code = -32603; \
+    fail_resp.error.message = "Internal error"; \
+    epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
     return true; \
   } \
   FINALIZE_OBJECTS_TO_JSON(method_name) \
+  if (cache_) \
+    cache_.store(query_info.m_body, response_info.m_body); \
   return true;\
 }
 
@@ -259,7 +472,60 @@
   rsp.jsonrpc = "2.0"; \
   rsp.error.code = -32601; \
   rsp.error.message = "Method not found"; \
-  epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+  epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+  return true; \
+  }; \
+  handled = true; \
+  const size_t json_rpc_start_ = query_info.m_body.find_first_not_of(" \t\r\n"); \
+  if (json_rpc_start_ == std::string::npos || query_info.m_body[json_rpc_start_] != '[') \
+    return json_rpc_call_(query_info, response_info); \
+  response_info.m_mime_tipe = "application/json"; \
+  response_info.m_header_info.m_content_type = " application/json"; \
+  std::vector<std::string> json_rpc_batch_; \
+  const bool json_rpc_parsed_ = epee::serialization::split_json_array(query_info.m_body, json_rpc_batch_); \
+  if (!json_rpc_parsed_ || json_rpc_batch_.empty() || json_rpc_batch_.size() > JSON_RPC_MAX_BATCH_SIZE) \
+  { \
+    epee::json_rpc::error_response rsp; \
+    rsp.jsonrpc = "2.0"; \
+    rsp.error.code = json_rpc_parsed_ ? -32600 : -32700; \
+    rsp.error.message = json_rpc_parsed_ ? "Invalid Request" : "Parse error"; \
+    if (json_rpc_batch_.size() > JSON_RPC_MAX_BATCH_SIZE) \
+      rsp.error.message = "Batch too large, max " + std::to_string(JSON_RPC_MAX_BATCH_SIZE) + " requests"; \
+    epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+    return true; \
+  } \
+  MINFO(m_conn_context << "JSON-RPC batch of " << json_rpc_batch_.size() << " requests"); \
+  epee::net_utils::http::http_request_info json_rpc_request_ = query_info; \
+  json_rpc_request_.m_body.clear(); \
+  std::vector<epee::net_utils::http::http_response_info> json_rpc_responses_(json_rpc_batch_.size()); \
+  run_json_rpc_batch(json_rpc_batch_.size(), [&](size_t i) { \
+    epee::net_utils::http::http_request_info element_query = json_rpc_request_; \
+    element_query.m_body = json_rpc_batch_[i]; \
+    epee::net_utils::http::http_response_info& element_response = json_rpc_responses_[i]; \
+    element_response = epee::net_utils::http::http_response_info{}; \
+    element_response.m_response_code = 200; \
+    if (element_query.m_body.empty() || element_query.m_body[0] != '{') \
+    { \
+      epee::json_rpc::error_response rsp; \
+      rsp.jsonrpc = "2.0"; \
+      rsp.error.code = -32600; \
+      rsp.error.message = "Invalid Request"; \
+      epee::serialization::store_t_to_json_direct(static_cast<epee::json_rpc::error_response&>(rsp), element_response.m_body); \
+      return; \
+    } \
+    try { json_rpc_call_(element_query, element_response); } \
+    catch (const std::exception &e) { MERROR(m_conn_context << "Exception in JSON-RPC batch element: " << e.what()); element_response.m_body.clear(); } \
+  }, m_conn_context); \
+  response_info.m_body = "["; \
+  for (const auto &element_response: json_rpc_responses_) \
+  { \
+    if (element_response.m_body.empty()) \
+      continue; \
+    if (response_info.m_body.size() > 1) \
+      response_info.m_body += ','; \
+    response_info.m_body += element_response.m_body; \
+  } \
+  response_info.m_body += ']'; \
   return true; \
 }
 
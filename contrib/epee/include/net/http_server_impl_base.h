@@ -30,6 +30,7 @@
 #pragma once 
 
 
+#include <functional>
 #include <boost/thread.hpp>
 #include <boost/bind/bind.hpp>
 
@@ -131,6 +132,14 @@ namespace epee
     }
 
   protected: 
+    //! runs the requests of a JSON-RPC batch one after the other; servers whose
+    //! handlers are safe to call concurrently may hide this with a parallel version
+    void run_json_rpc_batch(size_t count, const std::function<void(size_t)>& call, const t_connection_context&)
+    {
+      for (size_t i = 0; i < count; ++i)
+        call(i);
+    }
+
     net_utils::boosted_tcp_server<net_utils::http::http_custom_handler<t_connection_context> > m_net_server;
   };
 }
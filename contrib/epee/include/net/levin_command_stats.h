@@ -0,0 +1,140 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace epee
+{
+namespace levin
+{
+  //! Messages and bytes per levin command, updated without locking from the connection threads
+  class command_stats
+  {
+  public:
+    //! Commands seen after the table filled up are counted under this one
+    static constexpr std::uint32_t other_commands = 0xffffffff;
+
+    struct entry
+    {
+      std::uint32_t command;
+      std::uint64_t messages_in;
+      std::uint64_t bytes_in;
+      std::uint64_t messages_out;
+      std::uint64_t bytes_out;
+    };
+
+    command_stats() noexcept
+    {
+      for (slot& s : m_slots)
+        s.reset();
+      m_other.reset();
+    }
+
+    command_stats(const command_stats&) = delete;
+    command_stats& operator=(const command_stats&) = delete;
+
+    void received(const std::uint32_t command, const std::size_t bytes) noexcept
+    {
+      slot& s = find(command);
+      s.messages_in.fetch_add(1, std::memory_order_relaxed);
+      s.bytes_in.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void sent(const std::uint32_t command, const std::size_t bytes) noexcept
+    {
+      slot& s = find(command);
+      s.messages_out.fetch_add(1, std::memory_order_relaxed);
+      s.bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    std::vector<entry> get() const
+    {
+      std::vector<entry> out;
+      const auto add = [&out](const slot& s, const std::uint32_t command) {
+        out.push_back({command,
+          s.messages_in.load(std::memory_order_relaxed), s.bytes_in.load(std::memory_order_relaxed),
+          s.messages_out.load(std::memory_order_relaxed), s.bytes_out.load(std::memory_order_relaxed)});
+      };
+      for (const slot& s : m_slots)
+      {
+        const std::uint64_t key = s.key.load(std::memory_order_acquire);
+        if (key)
+          add(s, std::uint32_t(key - 1));
+      }
+      if (m_other.messages_in.load(std::memory_order_relaxed) || m_other.messages_out.load(std::memory_order_relaxed))
+        add(m_other, other_commands);
+      return out;
+    }
+
+  private:
+    static constexpr std::size_t capacity = 64;
+
+    struct slot
+    {
+      std::atomic<std::uint64_t> key; //!< Command + 1, 0 when unused
+      std::atomic<std::uint64_t> messages_in;
+      std::atomic<std::uint64_t> bytes_in;
+      std::atomic<std::uint64_t> messages_out;
+      std::atomic<std::uint64_t> bytes_out;
+
+      void reset() noexcept
+      {
+        key.store(0, std::memory_order_relaxed);
+        messages_in.store(0, std::memory_order_relaxed);
+        bytes_in.store(0, std::memory_order_relaxed);
+        messages_out.store(0, std::memory_order_relaxed);
+        bytes_out.store(0, std::memory_order_relaxed);
+      }
+    };
+
+    // open addressing, slots are claimed once and never released
+    slot& find(const std::uint32_t command) noexcept
+    {
+      const std::uint64_t key = std::uint64_t(command) + 1;
+      for (std::size_t i = 0; i < capacity; ++i)
+      {
+        slot& s = m_slots[(command + i) % capacity];
+        std::uint64_t current = s.key.load(std::memory_order_acquire);
+        if (current == 0 && s.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+          return s;
+        if (current == key)
+          return s;
+      }
+      return m_other;
+    }
+
+    std::array<slot, capacity> m_slots;
+    slot m_other;
+  };
+}
+}
@@ -35,6 +35,7 @@
 #include <deque>
 
 #include "levin_base.h"
+#include "levin_command_stats.h"
 #include "buffer.h"
 #include "misc_language.h"
 #include "syncobj.h"
@@ -86,6 +87,7 @@ public:
   typedef t_connection_context connection_context;
   uint64_t m_max_packet_size; 
   uint64_t m_invoke_timeout;
+  command_stats m_command_stats;
 
   int invoke(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, boost::uuids::uuid connection_id);
   template<class callback_t>
@@ -121,11 +123,27 @@ class async_protocol_handler
 {
   std::string m_fragment_buffer;
 
+  //! Command of a message from `make_notify` or `make_fragmented_notify`
+  static uint32_t get_command(const byte_slice& message) noexcept
+  {
+    bucket_head2 head;
+    if (message.size() < sizeof(head))
+      return 0;
+    std::memcpy(std::addressof(head), message.data(), sizeof(head));
+
+    // the first fragment starts with the header of the whole message
+    const uint32_t flags = SWAP32LE(head.m_flags);
+    if (!(flags & (LEVIN_PACKET_REQUEST | LEVIN_PACKET_RESPONSE)) && (flags & LEVIN_PACKET_BEGIN) && !(flags & LEVIN_PACKET_END) && message.size() >= 2 * sizeof(head))
+      std::memcpy(std::addressof(head), message.data() + sizeof(head), sizeof(head));
+    return SWAP32LE(head.m_command);
+  }
+
   bool send_message(uint32_t command, epee::span<const uint8_t> in_buff, uint32_t flags, bool expect_response)
   {
     const bucket_head2 head = make_header(command, in_buff.size(), flags, expect_response);
     if(!m_pservice_endpoint->do_send(byte_slice{as_byte_span(head), in_buff}))
       return false;
+    m_config.m_command_stats.sent(command, sizeof(head) + in_buff.size());
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
         << ", flags" << head.m_flags
@@ -468,6 +486,7 @@ public:
             buff_to_invoke = {reinterpret_cast<const uint8_t*>(temp.data()) + sizeof(bucket_head2), temp.size() - sizeof(bucket_head2)};
           }
 
+          m_config.m_command_stats.received(m_current_head.m_command, sizeof(bucket_head2) + buff_to_invoke.size());
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
           MDEBUG(m_connection_context << "LEVIN_PACKET_RECEIVED. [len=" << m_current_head.m_cb
@@ -523,8 +542,10 @@ public:
               head.m_return_code = SWAP32LE(return_code);
               return_buff.insert(0, reinterpret_cast<const char*>(&head), sizeof(head));
 
+              const std::size_t return_size = return_buff.size();
               if(!m_pservice_endpoint->do_send(byte_slice{std::move(return_buff)}))
                 return false;
+              m_config.m_command_stats.sent(m_current_head.m_command, return_size);
 
               MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
                 << ", flags" << head.m_flags
@@ -750,11 +771,13 @@ public:
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
     const std::size_t length = message.size();
+    const uint32_t command = get_command(message);
     if (!m_pservice_endpoint->do_send(std::move(message)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to send message, dropping it");
       return -1;
     }
+    m_config.m_command_stats.sent(command, length);
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << (length - sizeof(bucket_head2)) << ", r?=0]");
     return 1;
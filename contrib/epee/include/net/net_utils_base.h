@@ -355,6 +355,9 @@ namespace net_utils
 	inline bool operator>=(const network_address& lhs, const network_address& rhs)
 	{ return !lhs.less(rhs); }
 
+	//! Consistent with `network_address::equal`; found by `boost::hash` via ADL.
+	std::size_t hash_value(const network_address& address);
+
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
@@ -440,6 +443,8 @@ namespace net_utils
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
     virtual bool request_callback()=0;
+    //! Like request_callback, but only once everything queued so far was written
+    virtual bool request_callback_on_sent() { return request_callback(); }
     virtual boost::asio::io_service& get_io_service()=0;
     //protect from deletion connection object(with protocol instance) during external call "invoke"
     virtual bool add_ref()=0;
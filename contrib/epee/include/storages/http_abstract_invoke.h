@@ -30,6 +30,8 @@
 #include <chrono>
 #include <string>
 #include "portable_storage_template_helper.h"
+#include "json_storage_reader.h"
+#include "json_storage_writer.h"
 #include "net/http_base.h"
 #include "net/http_server_handlers_map2.h"
 
@@ -41,7 +43,7 @@ namespace epee
     bool invoke_http_json(const boost::string_ref uri, const t_request& out_struct, t_response& result_struct, t_transport& transport, std::chrono::milliseconds timeout = std::chrono::seconds(15), const boost::string_ref method = "POST")
     {
       std::string req_param;
-      if(!serialization::store_t_to_json(out_struct, req_param))
+      if(!serialization::store_t_to_json_direct(out_struct, req_param))
         return false;
 
       http::fields_list additional_params;
@@ -66,7 +68,7 @@ namespace epee
         return false;
       }
 
-      return serialization::load_t_from_json(result_struct, pri->m_body);
+      return serialization::load_t_from_json_direct(result_struct, pri->m_body);
     }
 
 
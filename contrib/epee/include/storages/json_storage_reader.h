@@ -0,0 +1,337 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_from_json.h"
+#include "portable_storage_val_converters.h"
+
+#include <boost/mpl/contains.hpp>
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Read-only storage over a parsed rapidjson document.                  */
+    /* A KV_SERIALIZE map reads its fields from the document in place, so   */
+    /* no section tree is built and each string is copied once, into the    */
+    /* target field. Numbers, strings and nulls convert the same way they   */
+    /* do through portable_storage::load_from_json.                         */
+    /************************************************************************/
+    class json_storage_reader
+    {
+    public:
+      typedef const rapidjson::Value* hsection;
+      struct array_ref
+      {
+        const rapidjson::Value* array;
+        rapidjson::SizeType next;
+      };
+      typedef array_ref* harray;
+      typedef storage_entry meta_entry;
+
+      json_storage_reader() {}
+
+      bool       load_from_json(const std::string& source);
+
+      hsection   open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       get_value(const std::string& value_name, t_value& val, hsection hparent_section);
+      bool       get_value(const std::string& value_name, storage_entry& val, hsection hparent_section);
+
+      //serial access for arrays of values --------------------------------------
+      template<class t_value>
+      harray     get_first_value(const std::string& value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool       get_next_value(harray hval_array, t_value& target);
+      harray     get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section);
+      bool       get_next_section(harray hsec_array, hsection& h_child_section);
+
+    private:
+      const rapidjson::Value* find_entry(const std::string& name, hsection hparent_section) const;
+      harray add_array(const rapidjson::Value* array);
+      template<class t_value>
+      static void read_value(const rapidjson::Value& v, t_value& val);
+      static storage_entry read_entry(const rapidjson::Value& v, unsigned int recursion);
+      static array_entry read_array(const rapidjson::Value& v, unsigned int recursion);
+
+      rapidjson::Document m_document;
+      std::deque<array_ref> m_arrays;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool json_storage_reader::load_from_json(const std::string& source)
+    {
+      m_arrays.clear();
+      // the iterative parser keeps deeply nested input off the stack
+      m_document.Parse<rapidjson::kParseIterativeFlag>(source.data(), source.size());
+      if (m_document.HasParseError() || !m_document.IsObject())
+      {
+        m_document.SetObject();
+        return false;
+      }
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const rapidjson::Value* json_storage_reader::find_entry(const std::string& name, hsection hparent_section) const
+    {
+      const rapidjson::Value& parent = hparent_section ? *hparent_section : m_document;
+      if (!parent.IsObject())
+        return nullptr;
+      // the first of duplicate names wins, objects are small enough for a linear search
+      for (auto it = parent.MemberBegin(); it != parent.MemberEnd(); ++it)
+      {
+        if (it->name.GetStringLength() == name.size() && !memcmp(it->name.GetString(), name.data(), name.size()))
+          return it->value.IsNull() ? nullptr : &it->value;
+      }
+      return nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    json_storage_reader::harray json_storage_reader::add_array(const rapidjson::Value* array)
+    {
+      m_arrays.push_back(array_ref{array, 1});
+      return &m_arrays.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void read_json_string(const rapidjson::Value& v, t_value& val)
+    {
+      convert_t(std::string(v.GetString(), v.GetStringLength()), val);
+    }
+    inline void read_json_string(const rapidjson::Value& v, std::string& val)
+    {
+      val.assign(v.GetString(), v.GetStringLength());
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void json_storage_reader::read_value(const rapidjson::Value& v, t_value& val)
+    {
+      if (v.IsString())
+        read_json_string(v, val);
+      else if (v.IsBool())
+        convert_t(v.GetBool(), val);
+      else if (v.IsUint64())
+        convert_t(v.GetUint64(), val);
+      else if (v.IsInt64())
+        convert_t(v.GetInt64(), val);
+      else if (v.IsNumber())
+        convert_t(v.GetDouble(), val);
+      else
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from json type " << v.GetType() << " to type " << typeid(t_value).name());
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    storage_entry json_storage_reader::read_entry(const rapidjson::Value& v, unsigned int recursion)
+    {
+      CHECK_AND_ASSERT_THROW_MES(recursion < EPEE_JSON_RECURSION_LIMIT_INTERNAL, "Wrong JSON data: recursion limitation (" << EPEE_JSON_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      if (v.IsString())
+        return storage_entry(std::string(v.GetString(), v.GetStringLength()));
+      if (v.IsBool())
+        return storage_entry(v.GetBool());
+      if (v.IsUint64())
+        return storage_entry(v.GetUint64());
+      if (v.IsInt64())
+        return storage_entry(v.GetInt64());
+      if (v.IsNumber())
+        return storage_entry(v.GetDouble());
+      if (v.IsArray())
+        return storage_entry(read_array(v, recursion + 1));
+      CHECK_AND_ASSERT_THROW_MES(v.IsObject(), "Unexpected null in json array");
+      section sec;
+      for (auto it = v.MemberBegin(); it != v.MemberEnd(); ++it)
+      {
+        if (!it->value.IsNull())
+          sec.m_entries.emplace(std::string(it->name.GetString(), it->name.GetStringLength()), read_entry(it->value, recursion + 1));
+      }
+      return storage_entry(std::move(sec));
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    array_entry json_storage_reader::read_array(const rapidjson::Value& v, unsigned int recursion)
+    {
+      // arrays are homogeneous, typed by their first element as the epee parser does
+      if (!v.Size())
+        return array_entry();
+      array_entry ae;
+      bool first = true;
+      for (auto it = v.Begin(); it != v.End(); ++it)
+      {
+        storage_entry e = read_entry(*it, recursion);
+        CHECK_AND_ASSERT_THROW_MES(e.type() != typeid(array_entry), "array of array not supported");
+        if (first)
+        {
+          ae = boost::apply_visitor([](const auto& t) -> array_entry {
+            return array_entry(array_entry_t<typename std::decay<decltype(t)>::type>());
+          }, e);
+          first = false;
+        }
+        boost::apply_visitor([&ae](auto& t) {
+          auto* a = boost::get<array_entry_t<typename std::decay<decltype(t)>::type>>(&ae);
+          CHECK_AND_ASSERT_THROW_MES(a, "mixed types in json array");
+          a->insert_next_value(std::move(t));
+        }, e);
+      }
+      return ae;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    json_storage_reader::hsection json_storage_reader::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      const rapidjson::Value* pentry = find_entry(section_name, hparent_section);
+      if (!pentry || !pentry->IsObject())
+        return nullptr;
+      return pentry;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool json_storage_reader::get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const rapidjson::Value* pentry = find_entry(value_name, hparent_section);
+      if (!pentry)
+        return false;
+      read_value(*pentry, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool json_storage_reader::get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+    {
+      const rapidjson::Value* pentry = find_entry(value_name, hparent_section);
+      if (!pentry)
+        return false;
+      val = read_entry(*pentry, 0);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    json_storage_reader::harray json_storage_reader::get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const rapidjson::Value* pentry = find_entry(value_name, hparent_section);
+      if (!pentry || !pentry->IsArray() || !pentry->Size())
+        return nullptr;
+      read_value((*pentry)[0], target);
+      return add_array(pentry);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool json_storage_reader::get_next_value(harray hval_array, t_value& target)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      CHECK_AND_ASSERT(hval_array, false);
+      if (hval_array->next >= hval_array->array->Size())
+        return false;
+      read_value((*hval_array->array)[hval_array->next++], target);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    json_storage_reader::harray json_storage_reader::get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section)
+    {
+      const rapidjson::Value* pentry = find_entry(section_name, hparent_section);
+      if (!pentry || !pentry->IsArray() || !pentry->Size() || !(*pentry)[0].IsObject())
+        return nullptr;
+      h_child_section = &(*pentry)[0];
+      return add_array(pentry);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool json_storage_reader::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      CHECK_AND_ASSERT(hsec_array, false);
+      if (hsec_array->next >= hsec_array->array->Size())
+        return false;
+      const rapidjson::Value& v = (*hsec_array->array)[hsec_array->next++];
+      CHECK_AND_ASSERT_THROW_MES(v.IsObject(), "mixed types in json array");
+      h_child_section = &v;
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool load_t_from_json_direct(t_struct& out, const std::string& json_buff)
+    {
+      json_storage_reader reader;
+      if (!reader.load_from_json(json_buff))
+        return false;
+      return out.load(reader);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline bool json_depth_within(const rapidjson::Value& v, unsigned int limit)
+    {
+      if (!limit)
+        return false;
+      if (v.IsArray())
+      {
+        for (auto it = v.Begin(); it != v.End(); ++it)
+          if (!json_depth_within(*it, limit - 1))
+            return false;
+      }
+      else if (v.IsObject())
+      {
+        for (auto it = v.MemberBegin(); it != v.MemberEnd(); ++it)
+          if (!json_depth_within(it->value, limit - 1))
+            return false;
+      }
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    //! splits a JSON array into the text of each of its elements; false if `json_buff` is not an array
+    inline bool split_json_array(const std::string& json_buff, std::vector<std::string>& elements)
+    {
+      rapidjson::Document doc;
+      doc.Parse<rapidjson::kParseIterativeFlag>(json_buff.data(), json_buff.size());
+      if (doc.HasParseError() || !doc.IsArray() || !json_depth_within(doc, EPEE_JSON_RECURSION_LIMIT_INTERNAL))
+        return false;
+      elements.clear();
+      elements.reserve(doc.Size());
+      rapidjson::StringBuffer buffer;
+      for (auto it = doc.Begin(); it != doc.End(); ++it)
+      {
+        buffer.Clear();
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        it->Accept(writer);
+        elements.emplace_back(buffer.GetString(), buffer.GetSize());
+      }
+      return true;
+    }
+  }
+}
@@ -0,0 +1,261 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/static_visitor.hpp>
+#include <rapidjson/writer.h>
+
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Write-only storage that turns a KV_SERIALIZE map straight into JSON. */
+    /* Values go to a rapidjson::Writer as the map names them, so no        */
+    /* section tree is built and nothing is copied into one. Members come   */
+    /* out in declaration order rather than sorted, and without whitespace. */
+    /* Calls must be nested the way a map's store() makes them: writing to  */
+    /* a section closes whatever was opened below it since.                 */
+    /************************************************************************/
+    class json_storage_writer
+    {
+      struct frame
+      {
+        size_t depth;
+        bool array;
+      };
+    public:
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      explicit json_storage_writer(std::string& out);
+
+      //! closes every open object and array; nothing may be written afterwards
+      void       finish();
+
+      hsection   open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       set_value(const std::string& value_name, t_value&& target, hsection hparent_section);
+
+      //serial access for arrays of values --------------------------------------
+      template<class t_value>
+      harray     insert_first_value(const std::string& value_name, t_value&& target, hsection hparent_section);
+      template<class t_value>
+      bool       insert_next_value(harray hval_array, t_value&& target);
+      harray     insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section);
+      bool       insert_next_section(harray hsec_array, hsection& hinserted_childsection);
+
+    private:
+      struct sink
+      {
+        typedef char Ch;
+        std::string* m_buf;
+        void Put(char c) { m_buf->push_back(c); }
+        void Flush() {}
+      };
+      typedef rapidjson::Writer<sink, rapidjson::UTF8<>, rapidjson::UTF8<>, rapidjson::CrtAllocator, rapidjson::kWriteNanAndInfFlag> writer;
+
+      struct entry_visitor: public boost::static_visitor<void>
+      {
+        json_storage_writer& m_self;
+        explicit entry_visitor(json_storage_writer& self): m_self(self) {}
+        template<class t_value>
+        void operator()(const t_value& v) const { m_self.write(v); }
+        template<class t_value>
+        void operator()(const array_entry_t<t_value>& a) const
+        {
+          m_self.m_writer.StartArray();
+          for (const auto& v: a.m_array)
+            m_self.write(v);
+          m_self.m_writer.EndArray();
+        }
+      };
+
+      void close_to(hsection hsec);
+      hsection push(bool array);
+      void key(const std::string& name);
+
+      void write(uint64_t v) { m_writer.Uint64(v); }
+      void write(uint32_t v) { m_writer.Uint(v); }
+      void write(uint16_t v) { m_writer.Uint(v); }
+      void write(uint8_t v) { m_writer.Uint(v); }
+      void write(int64_t v) { m_writer.Int64(v); }
+      void write(int32_t v) { m_writer.Int(v); }
+      void write(int16_t v) { m_writer.Int(v); }
+      void write(int8_t v) { m_writer.Int(v); }
+      void write(double v) { m_writer.Double(v); }
+      void write(bool v) { m_writer.Bool(v); }
+      void write(const std::string& v) { m_writer.String(v.data(), rapidjson::SizeType(v.size())); }
+      void write(const section& sec);
+      void write(const array_entry& ae) { boost::apply_visitor(entry_visitor(*this), ae); }
+      void write(const storage_entry& se) { boost::apply_visitor(entry_visitor(*this), se); }
+
+      sink m_out;
+      writer m_writer;
+      std::deque<frame> m_frames;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    json_storage_writer::json_storage_writer(std::string& out): m_out{&out}, m_writer(m_out)
+    {
+      m_writer.StartObject();
+      m_frames.push_back(frame{0, false});
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void json_storage_writer::finish()
+    {
+      if (m_frames.empty())
+        return;
+      close_to(&m_frames.front());
+      m_writer.EndObject();
+      m_frames.clear();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void json_storage_writer::close_to(hsection hsec)
+    {
+      CHECK_AND_ASSERT_THROW_MES(!m_frames.empty(), "json_storage_writer: write after finish");
+      if (!hsec)
+        hsec = &m_frames.front();
+      while (m_frames.size() > hsec->depth + 1)
+      {
+        if (m_frames.back().array)
+          m_writer.EndArray();
+        else
+          m_writer.EndObject();
+        m_frames.pop_back();
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    json_storage_writer::hsection json_storage_writer::push(bool array)
+    {
+      if (array)
+        m_writer.StartArray();
+      else
+        m_writer.StartObject();
+      m_frames.push_back(frame{m_frames.size(), array});
+      return &m_frames.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void json_storage_writer::key(const std::string& name)
+    {
+      m_writer.Key(name.data(), rapidjson::SizeType(name.size()));
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void json_storage_writer::write(const section& sec)
+    {
+      m_writer.StartObject();
+      for (const auto& e: sec.m_entries)
+      {
+        key(e.first);
+        write(e.second);
+      }
+      m_writer.EndObject();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    json_storage_writer::hsection json_storage_writer::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      close_to(hparent_section);
+      key(section_name);
+      return push(false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool json_storage_writer::set_value(const std::string& value_name, t_value&& target, hsection hparent_section)
+    {
+      close_to(hparent_section);
+      key(value_name);
+      write(target);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    json_storage_writer::harray json_storage_writer::insert_first_value(const std::string& value_name, t_value&& target, hsection hparent_section)
+    {
+      close_to(hparent_section);
+      key(value_name);
+      harray hval_array = push(true);
+      write(target);
+      return hval_array;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool json_storage_writer::insert_next_value(harray hval_array, t_value&& target)
+    {
+      CHECK_AND_ASSERT(hval_array && hval_array->array, false);
+      close_to(hval_array);
+      write(target);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    json_storage_writer::harray json_storage_writer::insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      close_to(hparent_section);
+      key(section_name);
+      harray hsec_array = push(true);
+      hinserted_childsection = push(false);
+      return hsec_array;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool json_storage_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      CHECK_AND_ASSERT(hsec_array && hsec_array->array, false);
+      close_to(hsec_array);
+      hinserted_childsection = push(false);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool store_t_to_json_direct(const t_struct& str_in, std::string& json_buff)
+    {
+      TRY_ENTRY();
+      json_buff.clear();
+      json_storage_writer writer(json_buff);
+      str_in.store(writer);
+      writer.finish();
+      return true;
+      CATCH_ENTRY("store_t_to_json_direct", false);
+    }
+  }
+}
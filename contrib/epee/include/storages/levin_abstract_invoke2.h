@@ -120,7 +120,7 @@ namespace epee
         LOG_PRINT_L1("Failed to invoke command " << command << " return code " << res);
         return false;
       }
-      typename serialization::portable_storage stg_ret;
+      serialization::portable_storage_reader stg_ret;
       if(!stg_ret.load_from_binary(buff_to_recv))
       {
         on_levin_traffic(context, true, false, true, buff_to_recv.size(), command);
@@ -151,7 +151,7 @@ namespace epee
           cb(code, result_struct, context);
           return false;
         }
-        serialization::portable_storage stg_ret;
+        serialization::portable_storage_reader stg_ret;
         if(!stg_ret.load_from_binary(buff))
         {
           on_levin_traffic(context, true, false, true, buff.size(), command);
@@ -201,7 +201,7 @@ namespace epee
     template<class t_owner, class t_in_type, class t_out_type, class t_context, class callback_t>
     int buff_to_t_adapter(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, callback_t cb, t_context& context )
     {
-      serialization::portable_storage strg;
+      serialization::portable_storage_reader strg;
       if(!strg.load_from_binary(in_buff))
       {
         on_levin_traffic(context, false, false, true, in_buff.size(), command);
@@ -235,7 +235,7 @@ namespace epee
     template<class t_owner, class t_in_type, class t_context, class callback_t>
     int buff_to_t_adapter(t_owner* powner, int command, const epee::span<const uint8_t> in_buff, callback_t cb, t_context& context)
     {
-      serialization::portable_storage strg;
+      serialization::portable_storage_reader strg;
       if(!strg.load_from_binary(in_buff))
       {
         on_levin_traffic(context, false, false, true, in_buff.size(), command);
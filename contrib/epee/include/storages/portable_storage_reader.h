@@ -0,0 +1,500 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "misc_log_ex.h"
+#include "span.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+
+#include <boost/mpl/contains.hpp>
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Read-only view of a binary portable_storage blob.                    */
+    /* load_from_binary makes a single pass over the blob and records where */
+    /* each entry lives, without materializing any value: values are only  */
+    /* decoded (and strings copied once) when a KV_SERIALIZE map asks for   */
+    /* them. The blob must outlive the reader.                              */
+    /************************************************************************/
+    class portable_storage_reader
+    {
+    public:
+      struct entry_ref
+      {
+        const uint8_t* name;
+        uint8_t name_size;
+        uint8_t type;              // element type for arrays, SERIALIZE_FLAG_ARRAY set
+        const uint8_t* start;      // type byte of this entry
+        const uint8_t* value;      // first value (or first array element)
+        size_t count;              // number of array elements
+        size_t section;            // first child section for objects and arrays of objects
+        const uint8_t* cursor;     // array iteration state
+        size_t next;
+      };
+      struct section_ref
+      {
+        size_t first_entry;
+        size_t entry_count;
+      };
+      typedef const section_ref* hsection;
+      typedef entry_ref* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_reader(): m_ptr(nullptr), m_end(nullptr), m_recursion_count(0) {}
+
+      bool       load_from_binary(const epee::span<const uint8_t> source);
+      bool       load_from_binary(const std::string& source) { return load_from_binary(epee::strspan<uint8_t>(source)); }
+
+      hsection   open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       get_value(const std::string& value_name, t_value& val, hsection hparent_section);
+      bool       get_value(const std::string& value_name, storage_entry& val, hsection hparent_section);
+
+      //serial access for arrays of values --------------------------------------
+      template<class t_value>
+      harray     get_first_value(const std::string& value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool       get_next_value(harray hval_array, t_value& target);
+      harray     get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section);
+      bool       get_next_section(harray hsec_array, hsection& h_child_section);
+
+    private:
+      struct recursion_guard
+      {
+        size_t& m_counter_ref;
+        recursion_guard(size_t& counter):m_counter_ref(counter)
+        {
+          ++m_counter_ref;
+          CHECK_AND_ASSERT_THROW_MES(m_counter_ref < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+        }
+        ~recursion_guard() { --m_counter_ref; }
+      };
+
+      size_t remaining() const { return m_end - m_ptr; }
+      void skip(size_t count);
+      uint8_t read_byte();
+      size_t read_varint();
+      static size_t read_varint(const uint8_t*& ptr, const uint8_t* end);
+      static size_t pod_size(uint8_t type);
+
+      bool index_root();
+      section_ref index_section();
+      void index_entry(entry_ref& entry, uint8_t type);
+      void index_array(entry_ref& entry, uint8_t type);
+
+      const entry_ref* find_entry(const std::string& name, hsection hparent_section) const;
+      template<class t_value>
+      void read_value(uint8_t type, const uint8_t*& ptr, t_value& val) const;
+
+      std::vector<section_ref> m_sections;
+      std::vector<entry_ref> m_entries;
+      const uint8_t* m_ptr;
+      const uint8_t* m_end;
+      size_t m_recursion_count;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::load_from_binary(const epee::span<const uint8_t> source)
+    {
+      m_sections.clear();
+      m_entries.clear();
+      m_recursion_count = 0;
+      const size_t header_size = sizeof(uint32_t) * 2 + 1;
+      if(source.size() < header_size)
+      {
+        LOG_ERROR("portable_storage_reader: wrong binary format, packet size = " << source.size() << " less than expected header size " << header_size);
+        return false;
+      }
+      uint32_t signature_a, signature_b;
+      memcpy(&signature_a, source.data(), sizeof(signature_a));
+      memcpy(&signature_b, source.data() + sizeof(signature_a), sizeof(signature_b));
+      if(signature_a != SWAP32LE(PORTABLE_STORAGE_SIGNATUREA) ||
+        signature_b != SWAP32LE(PORTABLE_STORAGE_SIGNATUREB)
+        )
+      {
+        LOG_ERROR("portable_storage_reader: wrong binary format - signature mismatch");
+        return false;
+      }
+      const uint8_t ver = source.data()[header_size - 1];
+      if(ver != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage_reader: wrong binary format - unknown format ver = " << (unsigned)ver);
+        return false;
+      }
+      m_ptr = source.data() + header_size;
+      m_end = source.data() + source.size();
+      if (!index_root())
+      {
+        m_sections.clear();
+        m_entries.clear();
+        return false;
+      }
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::index_root()
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_THROW_MES(m_ptr != m_end, "empty storage");
+      // children are indexed before their parents, so the root section goes last
+      const section_ref root = index_section();
+      m_sections.push_back(root);
+      return true;
+      CATCH_ENTRY("portable_storage_reader::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::skip(size_t count)
+    {
+      CHECK_AND_ASSERT_THROW_MES(remaining() >= count, " attempt to read " << count << " bytes from buffer with " << remaining() << " bytes remained");
+      m_ptr += count;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    uint8_t portable_storage_reader::read_byte()
+    {
+      CHECK_AND_ASSERT_THROW_MES(remaining() >= 1, " attempt to read 1 byte from empty buffer");
+      return *m_ptr++;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_reader::read_varint()
+    {
+      return read_varint(m_ptr, m_end);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_reader::read_varint(const uint8_t*& ptr, const uint8_t* end)
+    {
+      CHECK_AND_ASSERT_THROW_MES(ptr != end, "empty buff, expected place for varint");
+      size_t bytes = 0;
+      switch (*ptr & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE: bytes = 1; break;
+      case PORTABLE_RAW_SIZE_MARK_WORD: bytes = 2; break;
+      case PORTABLE_RAW_SIZE_MARK_DWORD: bytes = 4; break;
+      default: bytes = 8; break;
+      }
+      CHECK_AND_ASSERT_THROW_MES(size_t(end - ptr) >= bytes, "varint goes out of remain storage len");
+      uint64_t v = 0;
+      for (size_t i = 0; i < bytes; ++i)
+        v |= uint64_t(ptr[i]) << (8 * i);
+      ptr += bytes;
+      return v >> 2;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_reader::pod_size(uint8_t type)
+    {
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  return sizeof(int64_t);
+      case SERIALIZE_TYPE_INT32:  return sizeof(int32_t);
+      case SERIALIZE_TYPE_INT16:  return sizeof(int16_t);
+      case SERIALIZE_TYPE_INT8:   return sizeof(int8_t);
+      case SERIALIZE_TYPE_UINT64: return sizeof(uint64_t);
+      case SERIALIZE_TYPE_UINT32: return sizeof(uint32_t);
+      case SERIALIZE_TYPE_UINT16: return sizeof(uint16_t);
+      case SERIALIZE_TYPE_UINT8:  return sizeof(uint8_t);
+      case SERIALIZE_TYPE_DUOBLE: return sizeof(double);
+      case SERIALIZE_TYPE_BOOL:   return sizeof(bool);
+      default: return 0;
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_reader::section_ref portable_storage_reader::index_section()
+    {
+      recursion_guard rg(m_recursion_count);
+      const size_t count = read_varint();
+      // every entry takes at least a name length, a type and one byte of value
+      CHECK_AND_ASSERT_THROW_MES(count <= remaining() / 3, "Size sanity check failed");
+      // child sections append their own entries while this one is read, so
+      // gather ours apart and append them once complete to keep them adjacent
+      std::vector<entry_ref> entries;
+      entries.reserve(std::min<size_t>(count, 64));
+      for (size_t i = 0; i < count; ++i)
+      {
+        entry_ref entry{};
+        entry.name_size = read_byte();
+        entry.name = m_ptr;
+        skip(entry.name_size);
+        entry.start = m_ptr;
+        index_entry(entry, read_byte());
+        entries.push_back(entry);
+      }
+      // the DOM keeps the first of duplicate names, so keep the sort stable
+      std::stable_sort(entries.begin(), entries.end(), [](const entry_ref& a, const entry_ref& b) {
+        const int r = memcmp(a.name, b.name, std::min(a.name_size, b.name_size));
+        return r < 0 || (r == 0 && a.name_size < b.name_size);
+      });
+      const section_ref section{m_entries.size(), count};
+      m_entries.insert(m_entries.end(), entries.begin(), entries.end());
+      return section;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::index_entry(entry_ref& entry, uint8_t type)
+    {
+      if (type & SERIALIZE_FLAG_ARRAY)
+        return index_array(entry, type);
+
+      entry.type = type;
+      entry.value = m_ptr;
+      switch(type)
+      {
+      case SERIALIZE_TYPE_STRING:
+      {
+        const size_t len = read_varint();
+        CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+        skip(len);
+        break;
+      }
+      case SERIALIZE_TYPE_OBJECT:
+      {
+        const section_ref section = index_section();
+        entry.section = m_sections.size();
+        m_sections.push_back(section);
+        break;
+      }
+      case SERIALIZE_TYPE_ARRAY:
+      {
+        const uint8_t array_type = read_byte();
+        CHECK_AND_ASSERT_THROW_MES(array_type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+        index_array(entry, array_type);
+        break;
+      }
+      default:
+      {
+        const size_t size = pod_size(type);
+        CHECK_AND_ASSERT_THROW_MES(size, "unknown entry_type code = " << (unsigned)type);
+        skip(size);
+        break;
+      }
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::index_array(entry_ref& entry, uint8_t type)
+    {
+      recursion_guard rg(m_recursion_count);
+      entry.type = type;
+      entry.count = read_varint();
+      entry.value = m_ptr;
+      CHECK_AND_ASSERT_THROW_MES(entry.count <= remaining(), "Size sanity check failed");
+      switch(type & ~SERIALIZE_FLAG_ARRAY)
+      {
+      case SERIALIZE_TYPE_STRING:
+        for (size_t i = 0; i < entry.count; ++i)
+        {
+          const size_t len = read_varint();
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          skip(len);
+        }
+        break;
+      case SERIALIZE_TYPE_OBJECT:
+      {
+        std::vector<section_ref> sections;
+        sections.reserve(std::min<size_t>(entry.count, 64));
+        for (size_t i = 0; i < entry.count; ++i)
+          sections.push_back(index_section());
+        entry.section = m_sections.size();
+        m_sections.insert(m_sections.end(), sections.begin(), sections.end());
+        break;
+      }
+      case SERIALIZE_TYPE_ARRAY:
+        CHECK_AND_ASSERT_THROW_MES(entry.count == 0, "Reading array entry is not supported");
+        break;
+      default:
+      {
+        const size_t size = pod_size(type & ~SERIALIZE_FLAG_ARRAY);
+        CHECK_AND_ASSERT_THROW_MES(size, "unknown entry_type code = " << (unsigned)type);
+        CHECK_AND_ASSERT_THROW_MES(entry.count <= remaining() / size, "Size sanity check failed");
+        skip(entry.count * size);
+        break;
+      }
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const portable_storage_reader::entry_ref* portable_storage_reader::find_entry(const std::string& name, hsection hparent_section) const
+    {
+      if (m_sections.empty())
+        return nullptr;
+      if (!hparent_section)
+        hparent_section = &m_sections.back();
+      const auto begin = m_entries.begin() + hparent_section->first_entry;
+      const auto end = begin + hparent_section->entry_count;
+      const auto it = std::lower_bound(begin, end, name, [](const entry_ref& e, const std::string& n) {
+        const int r = memcmp(e.name, n.data(), std::min<size_t>(e.name_size, n.size()));
+        return r < 0 || (r == 0 && e.name_size < n.size());
+      });
+      if (it == end || it->name_size != name.size() || memcmp(it->name, name.data(), name.size()))
+        return nullptr;
+      return &*it;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_pod_type>
+    t_pod_type read_reader_pod(const uint8_t*& ptr)
+    {
+      t_pod_type v;
+      memcpy(&v, ptr, sizeof(v));
+      ptr += sizeof(v);
+      return CONVERT_POD(v);
+    }
+    template<class t_value>
+    void read_reader_string(const uint8_t* ptr, size_t len, t_value& val)
+    {
+      convert_t(std::string((const char*)ptr, len), val);
+    }
+    inline void read_reader_string(const uint8_t* ptr, size_t len, std::string& val)
+    {
+      val.assign((const char*)ptr, len);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_reader::read_value(uint8_t type, const uint8_t*& ptr, t_value& val) const
+    {
+      // bounds were checked when indexing
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  convert_t(read_reader_pod<int64_t>(ptr), val); break;
+      case SERIALIZE_TYPE_INT32:  convert_t(read_reader_pod<int32_t>(ptr), val); break;
+      case SERIALIZE_TYPE_INT16:  convert_t(read_reader_pod<int16_t>(ptr), val); break;
+      case SERIALIZE_TYPE_INT8:   convert_t(read_reader_pod<int8_t>(ptr), val); break;
+      case SERIALIZE_TYPE_UINT64: convert_t(read_reader_pod<uint64_t>(ptr), val); break;
+      case SERIALIZE_TYPE_UINT32: convert_t(read_reader_pod<uint32_t>(ptr), val); break;
+      case SERIALIZE_TYPE_UINT16: convert_t(read_reader_pod<uint16_t>(ptr), val); break;
+      case SERIALIZE_TYPE_UINT8:  convert_t(read_reader_pod<uint8_t>(ptr), val); break;
+      case SERIALIZE_TYPE_DUOBLE: convert_t(read_reader_pod<double>(ptr), val); break;
+      case SERIALIZE_TYPE_BOOL:   convert_t(read_reader_pod<bool>(ptr), val); break;
+      case SERIALIZE_TYPE_STRING:
+      {
+        const size_t len = read_varint(ptr, m_end);
+        read_reader_string(ptr, len, val);
+        ptr += len;
+        break;
+      }
+      default:
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from entry type " << (unsigned)type << " to type " << typeid(t_value).name());
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_reader::hsection portable_storage_reader::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      const entry_ref* pentry = find_entry(section_name, hparent_section);
+      if (!pentry || pentry->type != SERIALIZE_TYPE_OBJECT)
+        return nullptr;
+      return &m_sections[pentry->section];
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const entry_ref* pentry = find_entry(value_name, hparent_section);
+      if (!pentry)
+        return false;
+      const uint8_t* ptr = pentry->value;
+      read_value(pentry->type, ptr, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+    {
+      const entry_ref* pentry = find_entry(value_name, hparent_section);
+      if (!pentry)
+        return false;
+      throwable_buffer_reader buf_reader(pentry->start, m_end - pentry->start);
+      val = buf_reader.load_storage_entry();
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_reader::harray portable_storage_reader::get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      entry_ref* pentry = const_cast<entry_ref*>(find_entry(value_name, hparent_section));
+      if (!pentry || !(pentry->type & SERIALIZE_FLAG_ARRAY) || !pentry->count)
+        return nullptr;
+      pentry->cursor = pentry->value;
+      pentry->next = 1;
+      read_value(pentry->type & ~SERIALIZE_FLAG_ARRAY, pentry->cursor, target);
+      return pentry;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_next_value(harray hval_array, t_value& target)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      CHECK_AND_ASSERT(hval_array, false);
+      if (hval_array->next >= hval_array->count)
+        return false;
+      ++hval_array->next;
+      read_value(hval_array->type & ~SERIALIZE_FLAG_ARRAY, hval_array->cursor, target);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_reader::harray portable_storage_reader::get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section)
+    {
+      entry_ref* pentry = const_cast<entry_ref*>(find_entry(section_name, hparent_section));
+      if (!pentry || pentry->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || !pentry->count)
+        return nullptr;
+      pentry->next = 1;
+      h_child_section = &m_sections[pentry->section];
+      return pentry;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      CHECK_AND_ASSERT(hsec_array, false);
+      if (hsec_array->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || hsec_array->next >= hsec_array->count)
+        return false;
+      h_child_section = &m_sections[hsec_array->section + hsec_array->next++];
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+  }
+}
@@ -30,6 +30,7 @@
 
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "portable_storage_reader.h"
 #include "file_io_utils.h"
 
 namespace epee
@@ -86,7 +87,7 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const epee::span<const uint8_t> binary_buff)
     {
-      portable_storage ps;
+      portable_storage_reader ps;
       bool rs = ps.load_from_binary(binary_buff);
       if(!rs)
         return false;
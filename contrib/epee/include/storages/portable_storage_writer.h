@@ -0,0 +1,111 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "misc_log_ex.h"
+#include "span.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_to_bin.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Append-only encoder for the binary portable_storage format.          */
+    /* Lets a large response be emitted piece by piece into any number of   */
+    /* buffers instead of being built as a section tree first. The caller   */
+    /* is responsible for the layout: entry counts must be known up front,  */
+    /* and entries must be written in name order (as store_to_binary does)  */
+    /* for the output to be byte identical to it.                           */
+    /************************************************************************/
+    class portable_storage_writer
+    {
+    public:
+      explicit portable_storage_writer(std::string& out): m_out{&out} {}
+
+      void set_buffer(std::string& out) { m_out.m_buf = &out; }
+
+      void storage_header()
+      {
+        write_pod(uint32_t(PORTABLE_STORAGE_SIGNATUREA));
+        write_pod(uint32_t(PORTABLE_STORAGE_SIGNATUREB));
+        write_pod(uint8_t(PORTABLE_STORAGE_FORMAT_VER));
+      }
+
+      //! starts a section (the root, or an element of an array of objects)
+      void section(size_t entry_count) { pack_varint(m_out, entry_count); }
+      //! starts a section stored as the value of the entry just named
+      void object(size_t entry_count) { write_pod(uint8_t(SERIALIZE_TYPE_OBJECT)); section(entry_count); }
+
+      void name(const char* name)
+      {
+        const size_t len = std::char_traits<char>::length(name);
+        CHECK_AND_ASSERT_THROW_MES(len < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << len);
+        write_pod(uint8_t(len));
+        m_out.write(name, len);
+      }
+
+      void string(const epee::span<const uint8_t> value) { write_pod(uint8_t(SERIALIZE_TYPE_STRING)); array_string(value); }
+      void string(const std::string& value) { string(epee::strspan<uint8_t>(value)); }
+      void uint64(uint64_t value) { write_pod(uint8_t(SERIALIZE_TYPE_UINT64)); write_pod(value); }
+      void boolean(bool value) { write_pod(uint8_t(SERIALIZE_TYPE_BOOL)); write_pod(uint8_t(value ? 1 : 0)); }
+
+      //! starts an array of `count` values of `type`, each written with the array_* calls
+      void array(uint8_t type, size_t count) { write_pod(uint8_t(type | SERIALIZE_FLAG_ARRAY)); pack_varint(m_out, count); }
+      void array_string(const epee::span<const uint8_t> value)
+      {
+        pack_varint(m_out, value.size());
+        m_out.write(reinterpret_cast<const char*>(value.data()), value.size());
+      }
+      void array_uint64(uint64_t value) { write_pod(value); }
+
+    private:
+      struct sink
+      {
+        std::string* m_buf;
+        void write(const char* data, size_t size) { m_buf->append(data, size); }
+      };
+
+      template<class t_pod>
+      void write_pod(t_pod value)
+      {
+        value = CONVERT_POD(value);
+        m_out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+      }
+
+      sink m_out;
+    };
+  }
+}
@@ -136,6 +136,9 @@ connection_basic::connection_basic(boost::asio::ip::tcp::socket&& sock, std::sha
 	socket_(GET_IO_SERVICE(sock), get_context(m_state.get())),
 	m_want_close_connection(false),
 	m_was_shutdown(false),
+	m_send_que_bytes(0),
+	m_send_que_writing(0),
+	m_callback_on_sent(false),
 	m_is_multithreaded(false),
 	m_ssl_support(ssl_support)
 {
@@ -161,6 +164,9 @@ connection_basic::connection_basic(boost::asio::io_service &io_service, std::sha
 	socket_(io_service, get_context(m_state.get())),
 	m_want_close_connection(false),
 	m_was_shutdown(false),
+	m_send_que_bytes(0),
+	m_send_que_writing(0),
+	m_callback_on_sent(false),
 	m_is_multithreaded(false),
 	m_ssl_support(ssl_support)
 {
@@ -0,0 +1,325 @@
+// Copyright (c) 2014-2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "net/http_compression.h"
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <limits>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "misc_log_ex.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "net.http"
+
+namespace
+{
+  // Both are tuned for speed, the server compresses every response it is asked to
+  constexpr const int gzip_level = 1;
+  constexpr const int zstd_level = 1;
+
+  //! Output buffer growth step, for when the output of one call does not fit
+  constexpr const std::size_t min_out_step = 16 * 1024;
+
+  boost::string_ref trim(boost::string_ref s)
+  {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+      s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+      s.remove_suffix(1);
+    return s;
+  }
+
+  //! \return Weight of an RFC 7231 qvalue in thousandths, 0 if malformed.
+  int parse_qvalue(boost::string_ref q)
+  {
+    if (q.empty() || (q[0] != '0' && q[0] != '1'))
+      return 0;
+    int weight = (q[0] - '0') * 1000;
+    q.remove_prefix(1);
+    if (q.empty())
+      return weight;
+    if (q[0] != '.' || q.size() > 4)
+      return 0;
+    q.remove_prefix(1);
+    int scale = 100;
+    for (const char c : q)
+    {
+      if (c < '0' || c > '9')
+        return 0;
+      weight += (c - '0') * scale;
+      scale /= 10;
+    }
+    return std::min(weight, 1000);
+  }
+
+  std::size_t out_step(const std::size_t in_size) noexcept
+  {
+    return std::max(in_size / 2 + 64, min_out_step);
+  }
+}
+
+namespace epee
+{
+namespace net_utils
+{
+  namespace http
+  {
+    struct body_compressor::impl
+    {
+      virtual ~impl() {}
+      virtual bool compress(boost::string_ref in, std::string& out, bool finish) = 0;
+    };
+
+    namespace
+    {
+#ifdef HAVE_ZLIB
+      class gzip_compressor final : public body_compressor::impl
+      {
+      public:
+        gzip_compressor()
+          : m_stream(), m_ready(false)
+        {
+          // 16 + window bits selects the gzip wrapper
+          m_ready = deflateInit2(&m_stream, gzip_level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+          if (!m_ready)
+            MERROR("Failed to initialize gzip compression");
+        }
+
+        ~gzip_compressor() override
+        {
+          if (m_ready)
+            deflateEnd(&m_stream);
+        }
+
+        bool compress(boost::string_ref in, std::string& out, const bool finish) override
+        {
+          if (!m_ready)
+            return false;
+          CHECK_AND_ASSERT_MES(in.size() <= std::numeric_limits<uInt>::max(), false, "Response piece too large to compress");
+          m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+          m_stream.avail_in = in.size();
+          for (;;)
+          {
+            const std::size_t used = out.size();
+            out.resize(used + out_step(m_stream.avail_in));
+            m_stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+            m_stream.avail_out = out.size() - used;
+            const int status = deflate(&m_stream, finish ? Z_FINISH : Z_SYNC_FLUSH);
+            out.resize(out.size() - m_stream.avail_out);
+            if (status == Z_STREAM_END)
+            {
+              m_ready = false;
+              deflateEnd(&m_stream);
+              return true;
+            }
+            if (status != Z_OK && status != Z_BUF_ERROR)
+            {
+              MERROR("gzip compression failed: " << status);
+              return false;
+            }
+            // with room left over, the input is consumed and flushed
+            if (!finish && m_stream.avail_out != 0)
+              return true;
+          }
+        }
+
+      private:
+        z_stream m_stream;
+        bool m_ready;
+      };
+#endif
+
+#ifdef HAVE_ZSTD
+      class zstd_compressor final : public body_compressor::impl
+      {
+      public:
+        zstd_compressor()
+          : m_ctx(ZSTD_createCCtx())
+        {
+          if (!m_ctx || ZSTD_isError(ZSTD_CCtx_setParameter(m_ctx, ZSTD_c_compressionLevel, zstd_level)))
+            MERROR("Failed to initialize zstd compression");
+        }
+
+        ~zstd_compressor() override
+        {
+          ZSTD_freeCCtx(m_ctx);
+        }
+
+        bool compress(boost::string_ref in, std::string& out, const bool finish) override
+        {
+          if (!m_ctx)
+            return false;
+          ZSTD_inBuffer input{in.data(), in.size(), 0};
+          for (;;)
+          {
+            const std::size_t used = out.size();
+            out.resize(used + out_step(input.size - input.pos));
+            ZSTD_outBuffer output{&out[used], out.size() - used, 0};
+            const std::size_t remaining = ZSTD_compressStream2(m_ctx, &output, &input, finish ? ZSTD_e_end : ZSTD_e_flush);
+            out.resize(used + output.pos);
+            if (ZSTD_isError(remaining))
+            {
+              MERROR("zstd compression failed: " << ZSTD_getErrorName(remaining));
+              return false;
+            }
+            if (remaining == 0)
+              return true;
+          }
+        }
+
+      private:
+        ZSTD_CCtx* m_ctx;
+      };
+#endif
+    }
+
+    bool is_supported(const content_coding coding) noexcept
+    {
+      switch (coding)
+      {
+        case content_coding::identity:
+          return true;
+#ifdef HAVE_ZLIB
+        case content_coding::gzip:
+          return true;
+#endif
+#ifdef HAVE_ZSTD
+        case content_coding::zstd:
+          return true;
+#endif
+        default:
+          return false;
+      }
+    }
+
+    const char* get_name(const content_coding coding) noexcept
+    {
+      switch (coding)
+      {
+        case content_coding::gzip:
+          return "gzip";
+        case content_coding::zstd:
+          return "zstd";
+        default:
+          return "";
+      }
+    }
+
+    content_coding negotiate_content_coding(boost::string_ref accept_encoding)
+    {
+      // weights in thousandths, -1 while not listed
+      int gzip = -1;
+      int zstd = -1;
+      int any = -1;
+      while (!accept_encoding.empty())
+      {
+        const std::size_t comma = accept_encoding.find(',');
+        boost::string_ref item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == boost::string_ref::npos ? boost::string_ref{} : accept_encoding.substr(comma + 1);
+
+        std::size_t semicolon = item.find(';');
+        const boost::string_ref name = trim(item.substr(0, semicolon));
+        int weight = 1000;
+        while (semicolon != boost::string_ref::npos)
+        {
+          // only the q parameter is defined for codings
+          item.remove_prefix(semicolon + 1);
+          semicolon = item.find(';');
+          const boost::string_ref param = trim(item.substr(0, semicolon));
+          if (param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+            weight = parse_qvalue(param.substr(2));
+        }
+
+        if (boost::iequals(name, "gzip") || boost::iequals(name, "x-gzip"))
+          gzip = std::max(gzip, weight);
+        else if (boost::iequals(name, "zstd"))
+          zstd = std::max(zstd, weight);
+        else if (name == "*")
+          any = std::max(any, weight);
+      }
+
+      if (gzip < 0)
+        gzip = any;
+      if (zstd < 0)
+        zstd = any;
+      if (!is_supported(content_coding::gzip))
+        gzip = -1;
+      if (!is_supported(content_coding::zstd))
+        zstd = -1;
+
+      if (zstd > 0 && zstd >= gzip)
+        return content_coding::zstd;
+      if (gzip > 0)
+        return content_coding::gzip;
+      return content_coding::identity;
+    }
+
+    body_compressor::body_compressor(const content_coding coding)
+      : m_impl()
+    {
+      switch (coding)
+      {
+#ifdef HAVE_ZLIB
+        case content_coding::gzip:
+          m_impl.reset(new gzip_compressor{});
+          break;
+#endif
+#ifdef HAVE_ZSTD
+        case content_coding::zstd:
+          m_impl.reset(new zstd_compressor{});
+          break;
+#endif
+        default:
+          break;
+      }
+    }
+
+    body_compressor::~body_compressor()
+    {}
+
+    bool body_compressor::compress(const boost::string_ref in, std::string& out, const bool finish)
+    {
+      return m_impl && m_impl->compress(in, out, finish);
+    }
+
+    bool body_compressor::compress(const content_coding coding, const boost::string_ref in, std::string& out)
+    {
+      body_compressor compressor{coding};
+      return compressor.compress(in, out, true);
+    }
+  }
+}
+}
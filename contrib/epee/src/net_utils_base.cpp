@@ -1,6 +1,7 @@
 
 #include "net/net_utils_base.h"
 
+#include <boost/functional/hash.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
 #include "string_tools.h"
@@ -87,6 +88,35 @@ namespace epee { namespace net_utils
 		return self_->is_same_host(*other_self);
 	}
 
+	std::size_t hash_value(const network_address& address)
+	{
+		std::size_t seed = std::size_t(address.get_type_id());
+		switch (address.get_type_id())
+		{
+			case address_type::ipv4:
+			{
+				const ipv4_network_address &ipv4 = address.as<ipv4_network_address>();
+				boost::hash_combine(seed, ipv4.ip());
+				boost::hash_combine(seed, ipv4.port());
+				break;
+			}
+			case address_type::ipv6:
+			{
+				const ipv6_network_address &ipv6 = address.as<ipv6_network_address>();
+				const boost::asio::ip::address_v6::bytes_type bytes = ipv6.ip().to_bytes();
+				boost::hash_range(seed, bytes.begin(), bytes.end());
+				boost::hash_combine(seed, ipv6.port());
+				break;
+			}
+			case address_type::invalid:
+				break;
+			default:
+				boost::hash_combine(seed, address.str());
+				break;
+		}
+		return seed;
+	}
+
   std::string print_connection_context(const connection_context_base& ctx)
   {
     std::stringstream ss;
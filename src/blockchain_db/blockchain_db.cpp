@@ -35,6 +35,7 @@
 #include "ringct/rctOps.h"
 
 #include "lmdb/db_lmdb.h"
+#include "memory/db_memory.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db"
@@ -119,16 +120,40 @@ const command_line::arg_descriptor<bool> arg_db_salvage  = {
 , "Try to salvage a blockchain database if it seems corrupted"
 , false
 };
+const command_line::arg_descriptor<bool> arg_db_compress_txs  = {
+  "db-compress-txs"
+, "Store transaction blobs compressed with a dictionary trained on the chain (requires zstd support, converts an existing database)"
+, false
+};
+
+const command_line::arg_descriptor<std::string> arg_db_type = {
+  "db-type"
+, "Specify database type, available: lmdb, memory (nothing is saved to disk)"
+, DEFAULT_DB_TYPE
+};
 
-BlockchainDB *new_db()
+const command_line::arg_descriptor<bool> arg_db_stats  = {
+  "db-stats"
+, "Keep per table operation counts and latency histograms of the blockchain database, see print_db_stats"
+, false
+};
+
+BlockchainDB *new_db(const std::string& db_type)
 {
-  return new BlockchainLMDB();
+  if (db_type == "lmdb")
+    return new BlockchainLMDB();
+  if (db_type == "memory")
+    return new BlockchainMemory();
+  return NULL;
 }
 
 void BlockchainDB::init_options(boost::program_options::options_description& desc)
 {
+  command_line::add_arg(desc, arg_db_type);
   command_line::add_arg(desc, arg_db_sync_mode);
   command_line::add_arg(desc, arg_db_salvage);
+  command_line::add_arg(desc, arg_db_compress_txs);
+  command_line::add_arg(desc, arg_db_stats);
 }
 
 void BlockchainDB::pop_block()
@@ -357,6 +382,28 @@ bool BlockchainDB::get_pruned_tx(const crypto::hash& h, cryptonote::transaction
   return true;
 }
 
+bool BlockchainDB::for_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, bool pruned, const std::function<bool(uint64_t, const epee::span<const uint8_t>, const cryptonote::block&, std::vector<cryptonote::blobdata>&)> &f) const
+{
+  std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>> blocks;
+  if (!get_blocks_from(start_height, min_count, max_count, max_size, blocks, pruned, true, false))
+    throw DB_ERROR("Failed to get blocks from the db");
+
+  std::vector<cryptonote::blobdata> txs;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    block b;
+    if (!parse_and_validate_block_from_blob(blocks[i].first.first, b))
+      throw DB_ERROR("Failed to parse block from blob retrieved from the db");
+    txs.clear();
+    txs.reserve(blocks[i].second.size());
+    for (auto &tx: blocks[i].second)
+      txs.push_back(std::move(tx.second));
+    if (!f(start_height + i, epee::strspan<uint8_t>(blocks[i].first.first), b, txs))
+      return false;
+  }
+  return true;
+}
+
 transaction BlockchainDB::get_tx(const crypto::hash& h) const
 {
   transaction tx;
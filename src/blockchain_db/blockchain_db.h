@@ -35,6 +35,7 @@
 #include <boost/program_options.hpp>
 #include "common/command_line.h"
 #include "crypto/hash.h"
+#include "span.h"
 #include "cryptonote_basic/blobdatatype.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/difficulty.h"
@@ -103,8 +104,11 @@ namespace cryptonote
 /** a pair of <transaction hash, output index>, typedef for convenience */
 typedef std::pair<crypto::hash, uint64_t> tx_out_index;
 
+extern const command_line::arg_descriptor<std::string> arg_db_type;
 extern const command_line::arg_descriptor<std::string> arg_db_sync_mode;
 extern const command_line::arg_descriptor<bool, false> arg_db_salvage;
+extern const command_line::arg_descriptor<bool, false> arg_db_compress_txs;
+extern const command_line::arg_descriptor<bool, false> arg_db_stats;
 
 enum class relay_category : uint8_t
 {
@@ -188,6 +192,62 @@ struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+#define DBF_COMPRESS_TXS 0x20
+#define DBF_STATS   0x40
+
+// bucket 0 counts operations under 1 us, bucket i those taking [2^(i-1), 2^i) us,
+// and the last bucket anything slower
+#define DB_STATS_LATENCY_BUCKETS 20
+
+/**
+ * @brief a latency histogram of database operations
+ */
+struct db_latency_histogram_t
+{
+  uint64_t count;
+  uint64_t total_ns;
+  std::vector<uint64_t> buckets;  //!< DB_STATS_LATENCY_BUCKETS power of two buckets
+};
+
+/**
+ * @brief size and usage statistics for a database table
+ */
+struct db_table_stats_t
+{
+  std::string name;
+  uint64_t entries;
+  uint64_t depth;
+  uint64_t branch_pages;
+  uint64_t leaf_pages;
+  uint64_t overflow_pages;
+  uint64_t reads;             //!< lookups and cursor moves
+  uint64_t writes;
+  uint64_t deletes;
+  uint64_t cursor_opens;      //!< cursors opened or renewed
+  db_latency_histogram_t latency;  //!< of reads, writes and deletes
+};
+
+/**
+ * @brief database wide statistics, see BlockchainDB::get_db_stats
+ *
+ * The operation counters and histograms are only kept when the database
+ * was opened with DBF_STATS, the rest is sampled when requested.
+ */
+struct db_stats_t
+{
+  bool enabled;
+  uint64_t page_size;
+  uint64_t map_size;
+  uint64_t used_size;
+  uint64_t max_readers;
+  uint64_t num_readers;
+  uint64_t map_resizes;
+  uint64_t read_txns;
+  db_latency_histogram_t commits;
+  uint64_t major_page_faults; //!< for the whole process, mostly caused by the memory map
+  uint64_t minor_page_faults;
+  std::vector<db_table_stats_t> tables;
+};
 
 /***********************************
  * Exception Definitions
@@ -1309,6 +1369,28 @@ public:
    */
   virtual bool get_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>>& blocks, bool pruned, bool skip_coinbase, bool get_miner_tx_hash) const = 0;
 
+  /**
+   * @brief visits the blocks and transactions stored from the one with the given height
+   *
+   * Walks the same blocks get_blocks_from would return, with coinbase
+   * transactions skipped, but hands each one to the visitor instead of
+   * collecting them. The block blob may point straight into the database
+   * and is only valid during the call. The tx blobs are scratch space reused
+   * from one block to the next, and may be moved from.
+   *
+   * The default implementation goes through get_blocks_from.
+   *
+   * @param start_height the height of the first block
+   * @param min_count the minimum number of blocks to visit, if they exist
+   * @param max_count the maximum number of blocks to visit
+   * @param max_size the maximum size of block/transaction data to visit (will be exceeded by one blocks's worth at most, if min_count is met)
+   * @param pruned whether to visit full or pruned tx data
+   * @param f the visitor, called with the height, block blob, parsed block and tx blobs
+   *
+   * @return false if the visitor returned false, true otherwise
+   */
+  virtual bool for_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, bool pruned, const std::function<bool(uint64_t, const epee::span<const uint8_t>, const cryptonote::block&, std::vector<cryptonote::blobdata>&)> &f) const;
+
   /**
    * @brief fetches the prunable transaction blob with the given hash
    *
@@ -1826,6 +1908,15 @@ public:
    */
   virtual uint64_t get_database_size() const = 0;
 
+  /**
+   * @brief get performance statistics of the database
+   *
+   * @param stats return-by-reference the statistics
+   *
+   * @return false if the backend does not keep statistics
+   */
+  virtual bool get_db_stats(db_stats_t &stats) const { return false; }
+
   // TODO: this should perhaps be (or call) a series of functions which
   // progressively update through version updates
   /**
@@ -1894,7 +1985,7 @@ private:
 class db_rtxn_guard: public db_txn_guard { public: db_rtxn_guard(BlockchainDB *db): db_txn_guard(db, true) {} };
 class db_wtxn_guard: public db_txn_guard { public: db_wtxn_guard(BlockchainDB *db): db_txn_guard(db, false) {} };
 
-BlockchainDB *new_db();
+BlockchainDB *new_db(const std::string& db_type = DEFAULT_DB_TYPE);
 
 }  // namespace cryptonote
 
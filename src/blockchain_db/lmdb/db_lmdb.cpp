@@ -29,6 +29,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 #endif
 
@@ -44,6 +45,7 @@
 #include "file_io_utils.h"
 #include "common/util.h"
 #include "common/pruning.h"
+#include "common/threadpool.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
@@ -61,7 +63,7 @@ using epee::string_tools::pod_to_hex;
 using namespace crypto;
 
 // Increase when the DB structure changes
-#define VERSION 5
+#define VERSION 6
 
 namespace
 {
@@ -218,6 +220,10 @@ namespace
  * (DUPFIXED saves 8 bytes per record.)
  *
  * The output_amounts table doesn't use a dummy key, but uses DUPSORT.
+ *
+ * When transaction compression is enabled (see the txs_compression property),
+ * the txs_pruned and txs_prunable records are zstd frames compressed with the
+ * dictionaries stored in the txs_pruned_zdict and txs_prunable_zdict properties.
  */
 const char* const LMDB_BLOCKS = "blocks";
 const char* const LMDB_BLOCK_HEIGHTS = "block_heights";
@@ -245,6 +251,35 @@ const char* const LMDB_HF_VERSIONS = "hf_versions";
 
 const char* const LMDB_PROPERTIES = "properties";
 
+// properties keys for transaction compression
+const char* const LMDB_TXS_COMPRESSION = "txs_compression";
+const char* const LMDB_TXS_PRUNED_ZDICT = "txs_pruned_zdict";
+const char* const LMDB_TXS_PRUNABLE_ZDICT = "txs_prunable_zdict";
+
+// properties key for the "<table> <records moved>" checkpoint of migrate_table
+const char* const LMDB_MIGRATION_PROGRESS = "migration_progress";
+
+// flags stored in the txs_compression property
+enum : uint32_t
+{
+  txs_compression_pruned = 1,
+  txs_compression_prunable = 2,
+  txs_compression_all = txs_compression_pruned | txs_compression_prunable
+};
+
+// size of trained dictionaries, and how much sample data to train them on
+constexpr size_t TXS_ZDICT_SIZE = 112640;
+constexpr size_t TXS_ZDICT_MAX_SAMPLES = 100000;
+constexpr size_t TXS_ZDICT_MAX_SAMPLE_BYTES = 100 * TXS_ZDICT_SIZE;
+constexpr size_t TXS_ZDICT_MIN_SAMPLES = 1000;
+
+// how far get_output_key steps through an amount's outputs with MDB_NEXT_DUP
+// before it is cheaper to search for the next requested index
+constexpr uint64_t OUTPUT_KEY_MAX_DUP_WALK = 16;
+
+// records moved per txn (and per checkpoint) by migrate_table
+constexpr size_t MIGRATE_TABLE_BATCH_SIZE = 1000;
+
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
@@ -260,6 +295,37 @@ inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi
     throw0(cryptonote::DB_OPEN_FAILURE((lmdb_error(error_string + " : ", res) + std::string(" - you may want to start with --db-salvage")).c_str()));
 }
 
+bool lmdb_get_property(MDB_txn *txn, MDB_dbi dbi, const char *key, std::string &value)
+{
+  MDB_val_str(k, key);
+  MDB_val v;
+  int result = mdb_get(txn, dbi, &k, &v);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(cryptonote::DB_ERROR(lmdb_error(std::string("Failed to retrieve property ") + key + ": ", result).c_str()));
+  value.assign(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+  return true;
+}
+
+void lmdb_put_property(MDB_txn *txn, MDB_dbi dbi, const char *key, const std::string &value)
+{
+  MDB_val_str(k, key);
+  MDB_val v = {value.size(), (void *)value.data()};
+  int result = mdb_put(txn, dbi, &k, &v, 0);
+  if (result)
+    throw0(cryptonote::DB_ERROR(lmdb_error(std::string("Failed to write property ") + key + ": ", result).c_str()));
+}
+
+// appends a txs_pruned or txs_prunable record to bd, decompressing if needed
+inline void append_tx_blob(const cryptonote::tx_blob_compressor &compressor, const MDB_val &v, cryptonote::blobdata &bd)
+{
+  if (!compressor.enabled())
+    bd.append(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+  else if (!compressor.decompress_append({reinterpret_cast<const uint8_t*>(v.mv_data), v.mv_size}, bd))
+    throw0(cryptonote::DB_ERROR("Failed to decompress transaction data"));
+}
+
 
 }  // anonymous namespace
 
@@ -268,6 +334,7 @@ inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi
 	  int result = mdb_cursor_open(*m_write_txn, m_ ## name, &m_cur_ ## name); \
 	  if (result) \
         throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str())); \
+	  count_cursor_open(m_ ## name); \
 	}
 
 #define RCURSOR(name) \
@@ -277,11 +344,13 @@ inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi
         throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str())); \
 	  if (m_cursors != &m_wcursors) \
 	    m_tinfo->m_ti_rflags.m_rf_ ## name = true; \
+	  count_cursor_open(m_ ## name); \
 	} else if (m_cursors != &m_wcursors && !m_tinfo->m_ti_rflags.m_rf_ ## name) { \
 	  int result = mdb_cursor_renew(m_txn, m_cur_ ## name); \
       if (result) \
         throw0(DB_ERROR(lmdb_error("Failed to renew cursor: ", result).c_str())); \
 	  m_tinfo->m_ti_rflags.m_rf_ ## name = true; \
+	  count_cursor_open(m_ ## name); \
 	}
 
 namespace cryptonote
@@ -518,6 +587,109 @@ inline void BlockchainLMDB::check_open() const
     throw0(DB_ERROR("DB operation attempted on a not-open DB instance"));
 }
 
+void mdb_latency_counters::add(uint64_t ns)
+{
+  size_t bucket = 0;
+  for (uint64_t us = ns / 1000; us && bucket < DB_STATS_LATENCY_BUCKETS - 1; us >>= 1)
+    ++bucket;
+  count.fetch_add(1, std::memory_order_relaxed);
+  total_ns.fetch_add(ns, std::memory_order_relaxed);
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void mdb_latency_counters::reset()
+{
+  count = 0;
+  total_ns = 0;
+  for (auto &bucket: buckets)
+    bucket = 0;
+}
+
+void mdb_latency_counters::get(db_latency_histogram_t &histogram) const
+{
+  histogram.count = count;
+  histogram.total_ns = total_ns;
+  histogram.buckets.clear();
+  for (const auto &bucket: buckets)
+    histogram.buckets.push_back(bucket);
+}
+
+void mdb_table_counters::reset()
+{
+  reads = 0;
+  writes = 0;
+  deletes = 0;
+  cursor_opens = 0;
+  latency.reset();
+}
+
+void BlockchainLMDB::count_table_op(MDB_dbi dbi, std::atomic<uint64_t> mdb_table_counters::*counter, uint64_t ns) const
+{
+  if (dbi >= sizeof(m_table_counters) / sizeof(m_table_counters[0]))
+    return;
+  mdb_table_counters &counters = m_table_counters[dbi];
+  (counters.*counter).fetch_add(1, std::memory_order_relaxed);
+  counters.latency.add(ns);
+}
+
+void BlockchainLMDB::count_cursor_open(MDB_dbi dbi) const
+{
+  if (m_stats_enabled && dbi < sizeof(m_table_counters) / sizeof(m_table_counters[0]))
+    m_table_counters[dbi].cursor_opens.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BlockchainLMDB::count_read_txn() const
+{
+  if (m_stats_enabled)
+    m_read_txns.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BlockchainLMDB::commit_txn(mdb_txn_safe &txn, const std::string &message) const
+{
+  if (!m_stats_enabled)
+  {
+    txn.commit(message);
+    return;
+  }
+  TIME_MEASURE_NS_START(t);
+  txn.commit(message);
+  TIME_MEASURE_NS_FINISH(t);
+  m_commit_counters.add(t);
+}
+
+inline int BlockchainLMDB::lmdb_cursor_get(MDB_cursor *cursor, MDB_val *key, MDB_val *data, MDB_cursor_op op) const
+{
+  if (!m_stats_enabled)
+    return mdb_cursor_get(cursor, key, data, op);
+  TIME_MEASURE_NS_START(t);
+  const int result = mdb_cursor_get(cursor, key, data, op);
+  TIME_MEASURE_NS_FINISH(t);
+  count_table_op(mdb_cursor_dbi(cursor), &mdb_table_counters::reads, t);
+  return result;
+}
+
+inline int BlockchainLMDB::lmdb_cursor_put(MDB_cursor *cursor, MDB_val *key, MDB_val *data, unsigned int flags) const
+{
+  if (!m_stats_enabled)
+    return mdb_cursor_put(cursor, key, data, flags);
+  TIME_MEASURE_NS_START(t);
+  const int result = mdb_cursor_put(cursor, key, data, flags);
+  TIME_MEASURE_NS_FINISH(t);
+  count_table_op(mdb_cursor_dbi(cursor), &mdb_table_counters::writes, t);
+  return result;
+}
+
+inline int BlockchainLMDB::lmdb_cursor_del(MDB_cursor *cursor, unsigned int flags) const
+{
+  if (!m_stats_enabled)
+    return mdb_cursor_del(cursor, flags);
+  TIME_MEASURE_NS_START(t);
+  const int result = mdb_cursor_del(cursor, flags);
+  TIME_MEASURE_NS_FINISH(t);
+  count_table_op(mdb_cursor_dbi(cursor), &mdb_table_counters::deletes, t);
+  return result;
+}
+
 void BlockchainLMDB::do_resize(uint64_t increase_size)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -582,6 +754,7 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
     throw0(DB_ERROR(lmdb_error("Failed to set new mapsize: ", result).c_str()));
 
   MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
+  ++m_map_resizes;
 
   mdb_txn_safe::allow_new_txns();
 }
@@ -752,13 +925,13 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   CURSOR(block_heights)
   blk_height bh = {blk_hash, m_height};
   MDB_val_set(val_h, bh);
-  if (mdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH) == 0)
+  if (lmdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH) == 0)
     throw1(BLOCK_EXISTS("Attempting to add block that's already in the db"));
 
   if (m_height > 0)
   {
     MDB_val_set(parent_key, blk.prev_id);
-    int result = mdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &parent_key, MDB_GET_BOTH);
+    int result = lmdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &parent_key, MDB_GET_BOTH);
     if (result)
     {
       LOG_PRINT_L3("m_height: " << m_height);
@@ -780,7 +953,7 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   // this call to mdb_cursor_put will change height()
   cryptonote::blobdata block_blob(block_to_blob(blk));
   MDB_val_sized(blob, block_blob);
-  result = mdb_cursor_put(m_cur_blocks, &key, &blob, MDB_APPEND);
+  result = lmdb_cursor_put(m_cur_blocks, &key, &blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block blob to db transaction: ", result).c_str()));
 
@@ -797,7 +970,7 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   {
     uint64_t last_height = m_height-1;
     MDB_val_set(h, last_height);
-    if ((result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
+    if ((result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
         throw1(BLOCK_DNE(lmdb_error("Failed to get block info: ", result).c_str()));
     const mdb_block_info *bi_prev = (const mdb_block_info*)h.mv_data;
     bi.bi_cum_rct += bi_prev->bi_cum_rct;
@@ -805,11 +978,11 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   bi.bi_long_term_block_weight = long_term_block_weight;
 
   MDB_val_set(val, bi);
-  result = mdb_cursor_put(m_cur_block_info, (MDB_val *)&zerokval, &val, MDB_APPENDDUP);
+  result = lmdb_cursor_put(m_cur_block_info, (MDB_val *)&zerokval, &val, MDB_APPENDDUP);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block info to db transaction: ", result).c_str()));
 
-  result = mdb_cursor_put(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, 0);
+  result = lmdb_cursor_put(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
 
@@ -836,7 +1009,7 @@ void BlockchainLMDB::remove_block()
   CURSOR(blocks)
   MDB_val_copy<uint64_t> k(m_height - 1);
   MDB_val h = k;
-  if ((result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
+  if ((result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
       throw1(BLOCK_DNE(lmdb_error("Attempting to remove block that's not in the db: ", result).c_str()));
 
   // must use h now; deleting from m_block_info will invalidate it
@@ -844,15 +1017,15 @@ void BlockchainLMDB::remove_block()
   blk_height bh = {bi->bi_hash, 0};
   h.mv_data = (void *)&bh;
   h.mv_size = sizeof(bh);
-  if ((result = mdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
+  if ((result = lmdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
       throw1(DB_ERROR(lmdb_error("Failed to locate block height by hash for removal: ", result).c_str()));
-  if ((result = mdb_cursor_del(m_cur_block_heights, 0)))
+  if ((result = lmdb_cursor_del(m_cur_block_heights, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block height by hash to db transaction: ", result).c_str()));
 
-  if ((result = mdb_cursor_del(m_cur_blocks, 0)))
+  if ((result = lmdb_cursor_del(m_cur_blocks, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block to db transaction: ", result).c_str()));
 
-  if ((result = mdb_cursor_del(m_cur_block_info, 0)))
+  if ((result = lmdb_cursor_del(m_cur_block_info, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
 }
 
@@ -874,7 +1047,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
 
   MDB_val_set(val_tx_id, tx_id);
   MDB_val_set(val_h, tx_hash);
-  result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH);
+  result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH);
   if (result == 0) {
     txindex *tip = (txindex *)val_h.mv_data;
     throw1(TX_EXISTS(std::string("Attempting to add transaction that's already in the db (tx id ").append(boost::lexical_cast<std::string>(tip->data.tx_id)).append(")").c_str()));
@@ -892,7 +1065,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   val_h.mv_size = sizeof(ti);
   val_h.mv_data = (void *)&ti;
 
-  result = mdb_cursor_put(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, 0);
+  result = lmdb_cursor_put(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add tx data to db transaction: ", result).c_str()));
 
@@ -914,19 +1087,32 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
     throw0(DB_ERROR("pruned tx size is larger than tx size"));
 
   MDB_val pruned_blob = {unprunable_size, (void*)blob.data()};
-  result = mdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
+  std::string compressed;
+  if (m_txs_pruned_compressor.enabled())
+  {
+    if (!m_txs_pruned_compressor.compress({(const uint8_t*)blob.data(), unprunable_size}, compressed))
+      throw0(DB_ERROR("Failed to compress pruned tx blob"));
+    pruned_blob = {compressed.size(), (void*)compressed.data()};
+  }
+  result = lmdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
 
   MDB_val prunable_blob = {blob.size() - unprunable_size, (void*)(blob.data() + unprunable_size)};
-  result = mdb_cursor_put(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
+  if (m_txs_prunable_compressor.enabled())
+  {
+    if (!m_txs_prunable_compressor.compress({(const uint8_t*)blob.data() + unprunable_size, blob.size() - unprunable_size}, compressed))
+      throw0(DB_ERROR("Failed to compress prunable tx blob"));
+    prunable_blob = {compressed.size(), (void*)compressed.data()};
+  }
+  result = lmdb_cursor_put(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add prunable tx blob to db transaction: ", result).c_str()));
 
   if (get_blockchain_pruning_seed())
   {
     MDB_val_set(val_height, m_height);
-    result = mdb_cursor_put(m_cur_txs_prunable_tip, &val_tx_id, &val_height, 0);
+    result = lmdb_cursor_put(m_cur_txs_prunable_tip, &val_tx_id, &val_height, 0);
     if (result)
       throw0(DB_ERROR(lmdb_error("Failed to add prunable tx id to db transaction: ", result).c_str()));
   }
@@ -934,7 +1120,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   if (tx.version > 1)
   {
     MDB_val_set(val_prunable_hash, tx_prunable_hash);
-    result = mdb_cursor_put(m_cur_txs_prunable_hash, &val_tx_id, &val_prunable_hash, MDB_APPEND);
+    result = lmdb_cursor_put(m_cur_txs_prunable_hash, &val_tx_id, &val_prunable_hash, MDB_APPEND);
     if (result)
       throw0(DB_ERROR(lmdb_error("Failed to add prunable tx prunable hash to db transaction: ", result).c_str()));
   }
@@ -961,62 +1147,62 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
 
   MDB_val_set(val_h, tx_hash);
 
-  if (mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH))
+  if (lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH))
       throw1(TX_DNE("Attempting to remove transaction that isn't in the db"));
   txindex *tip = (txindex *)val_h.mv_data;
   MDB_val_set(val_tx_id, tip->data.tx_id);
 
-  if ((result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, NULL, MDB_SET)))
+  if ((result = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, NULL, MDB_SET)))
       throw1(DB_ERROR(lmdb_error("Failed to locate pruned tx for removal: ", result).c_str()));
-  result = mdb_cursor_del(m_cur_txs_pruned, 0);
+  result = lmdb_cursor_del(m_cur_txs_pruned, 0);
   if (result)
       throw1(DB_ERROR(lmdb_error("Failed to add removal of pruned tx to db transaction: ", result).c_str()));
 
-  result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, NULL, MDB_SET);
+  result = lmdb_cursor_get(m_cur_txs_prunable, &val_tx_id, NULL, MDB_SET);
   if (result == 0)
   {
-      result = mdb_cursor_del(m_cur_txs_prunable, 0);
+      result = lmdb_cursor_del(m_cur_txs_prunable, 0);
       if (result)
           throw1(DB_ERROR(lmdb_error("Failed to add removal of prunable tx to db transaction: ", result).c_str()));
   }
   else if (result != MDB_NOTFOUND)
       throw1(DB_ERROR(lmdb_error("Failed to locate prunable tx for removal: ", result).c_str()));
 
-  result = mdb_cursor_get(m_cur_txs_prunable_tip, &val_tx_id, NULL, MDB_SET);
+  result = lmdb_cursor_get(m_cur_txs_prunable_tip, &val_tx_id, NULL, MDB_SET);
   if (result && result != MDB_NOTFOUND)
       throw1(DB_ERROR(lmdb_error("Failed to locate tx id for removal: ", result).c_str()));
   if (result == 0)
   {
-    result = mdb_cursor_del(m_cur_txs_prunable_tip, 0);
+    result = lmdb_cursor_del(m_cur_txs_prunable_tip, 0);
     if (result)
         throw1(DB_ERROR(lmdb_error("Error adding removal of tx id to db transaction", result).c_str()));
   }
 
   if (tx.version > 1)
   {
-    if ((result = mdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, NULL, MDB_SET)))
+    if ((result = lmdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, NULL, MDB_SET)))
         throw1(DB_ERROR(lmdb_error("Failed to locate prunable hash tx for removal: ", result).c_str()));
-    result = mdb_cursor_del(m_cur_txs_prunable_hash, 0);
+    result = lmdb_cursor_del(m_cur_txs_prunable_hash, 0);
     if (result)
         throw1(DB_ERROR(lmdb_error("Failed to add removal of prunable hash tx to db transaction: ", result).c_str()));
   }
 
   remove_tx_outputs(tip->data.tx_id, tx);
 
-  result = mdb_cursor_get(m_cur_tx_outputs, &val_tx_id, NULL, MDB_SET);
+  result = lmdb_cursor_get(m_cur_tx_outputs, &val_tx_id, NULL, MDB_SET);
   if (result == MDB_NOTFOUND)
     LOG_PRINT_L1("tx has no outputs to remove: " << tx_hash);
   else if (result)
     throw1(DB_ERROR(lmdb_error("Failed to locate tx outputs for removal: ", result).c_str()));
   if (!result)
   {
-    result = mdb_cursor_del(m_cur_tx_outputs, 0);
+    result = lmdb_cursor_del(m_cur_tx_outputs, 0);
     if (result)
       throw1(DB_ERROR(lmdb_error("Failed to add removal of tx outputs to db transaction: ", result).c_str()));
   }
 
   // Don't delete the tx_indices entry until the end, after we're done with val_tx_id
-  if (mdb_cursor_del(m_cur_tx_indices, 0))
+  if (lmdb_cursor_del(m_cur_tx_indices, 0))
       throw1(DB_ERROR("Failed to add removal of tx index to db transaction"));
 }
 
@@ -1045,14 +1231,14 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
   outtx ot = {m_num_outputs, tx_hash, local_index};
   MDB_val_set(vot, ot);
 
-  result = mdb_cursor_put(m_cur_output_txs, (MDB_val *)&zerokval, &vot, MDB_APPENDDUP);
+  result = lmdb_cursor_put(m_cur_output_txs, (MDB_val *)&zerokval, &vot, MDB_APPENDDUP);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add output tx hash to db transaction: ", result).c_str()));
 
   outkey ok;
   MDB_val data;
   MDB_val_copy<uint64_t> val_amount(tx_output.amount);
-  result = mdb_cursor_get(m_cur_output_amounts, &val_amount, &data, MDB_SET);
+  result = lmdb_cursor_get(m_cur_output_amounts, &val_amount, &data, MDB_SET);
   if (!result)
     {
       mdb_size_t num_elems = 0;
@@ -1080,7 +1266,7 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
   }
   data.mv_data = &ok;
 
-  if ((result = mdb_cursor_put(m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
+  if ((result = lmdb_cursor_put(m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
       throw0(DB_ERROR(lmdb_error("Failed to add output pubkey to db transaction: ", result).c_str()));
 
   return ok.amount_index;
@@ -1104,7 +1290,7 @@ void BlockchainLMDB::add_tx_amount_output_indices(const uint64_t tx_id,
   v.mv_size = sizeof(uint64_t) * num_outputs;
   // LOG_PRINT_L1("tx_outputs[tx_hash] size: " << v.mv_size);
 
-  result = mdb_cursor_put(m_cur_tx_outputs, &k_tx_id, &v, MDB_APPEND);
+  result = lmdb_cursor_put(m_cur_tx_outputs, &k_tx_id, &v, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(std::string("Failed to add <tx hash, amount output index array> to db transaction: ").append(mdb_strerror(result)).c_str()));
 }
@@ -1143,7 +1329,7 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   MDB_val_set(k, amount);
   MDB_val_set(v, out_index);
 
-  auto result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+  auto result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
   if (result == MDB_NOTFOUND)
     throw1(OUTPUT_DNE("Attempting to get an output index by amount and amount index, but amount not found"));
   else if (result)
@@ -1151,7 +1337,7 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
 
   const pre_rct_outkey *ok = (const pre_rct_outkey *)v.mv_data;
   MDB_val_set(otxk, ok->output_id);
-  result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &otxk, MDB_GET_BOTH);
+  result = lmdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &otxk, MDB_GET_BOTH);
   if (result == MDB_NOTFOUND)
   {
     throw0(DB_ERROR("Unexpected: global output index not found in m_output_txs"));
@@ -1160,12 +1346,12 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   {
     throw1(DB_ERROR(lmdb_error("Error adding removal of output tx to db transaction", result).c_str()));
   }
-  result = mdb_cursor_del(m_cur_output_txs, 0);
+  result = lmdb_cursor_del(m_cur_output_txs, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error(std::string("Error deleting output index ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
 
   // now delete the amount
-  result = mdb_cursor_del(m_cur_output_amounts, 0);
+  result = lmdb_cursor_del(m_cur_output_amounts, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error(std::string("Error deleting amount for output index ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
 }
@@ -1182,7 +1368,7 @@ void BlockchainLMDB::prune_outputs(uint64_t amount)
 
   MDB_val v;
   MDB_val_set(k, amount);
-  int result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
+  int result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
   if (result == MDB_NOTFOUND)
     return;
   if (result)
@@ -1199,7 +1385,7 @@ void BlockchainLMDB::prune_outputs(uint64_t amount)
     const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
     output_ids.push_back(okp->output_id);
     MDEBUG("output id " << okp->output_id);
-    result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_NEXT_DUP);
+    result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_NEXT_DUP);
     if (result == MDB_NOTFOUND)
       break;
     if (result)
@@ -1208,17 +1394,17 @@ void BlockchainLMDB::prune_outputs(uint64_t amount)
   if (output_ids.size() != num_elems)
     throw0(DB_ERROR("Unexpected number of outputs"));
 
-  result = mdb_cursor_del(m_cur_output_amounts, MDB_NODUPDATA);
+  result = lmdb_cursor_del(m_cur_output_amounts, MDB_NODUPDATA);
   if (result)
     throw0(DB_ERROR(lmdb_error("Error deleting outputs: ", result).c_str()));
 
   for (uint64_t output_id: output_ids)
   {
     MDB_val_set(v, output_id);
-    result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+    result = lmdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
     if (result)
       throw0(DB_ERROR(lmdb_error("Error looking up output: ", result).c_str()));
-    result = mdb_cursor_del(m_cur_output_txs, 0);
+    result = lmdb_cursor_del(m_cur_output_txs, 0);
     if (result)
       throw0(DB_ERROR(lmdb_error("Error deleting output: ", result).c_str()));
   }
@@ -1233,7 +1419,7 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
   CURSOR(spent_keys)
 
   MDB_val k = {sizeof(k_image), (void *)&k_image};
-  if (auto result = mdb_cursor_put(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_NODUPDATA)) {
+  if (auto result = lmdb_cursor_put(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_NODUPDATA)) {
     if (result == MDB_KEYEXIST)
       throw1(KEY_IMAGE_EXISTS("Attempting to add spent key image that's already in the db"));
     else
@@ -1250,12 +1436,12 @@ void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
   CURSOR(spent_keys)
 
   MDB_val k = {sizeof(k_image), (void *)&k_image};
-  auto result = mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH);
+  auto result = lmdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH);
   if (result != 0 && result != MDB_NOTFOUND)
       throw1(DB_ERROR(lmdb_error("Error finding spent key to remove", result).c_str()));
   if (!result)
   {
-    result = mdb_cursor_del(m_cur_spent_keys, 0);
+    result = lmdb_cursor_del(m_cur_spent_keys, 0);
     if (result)
         throw1(DB_ERROR(lmdb_error("Error adding removal of key image to db transaction", result).c_str()));
   }
@@ -1288,6 +1474,10 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_batch_active = false;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_compress_txs = false;
+  m_stats_enabled = false;
+  m_read_txns = 0;
+  m_map_resizes = 0;
 
   // reset may also need changing when initialize things here
 
@@ -1324,6 +1514,9 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   if (m_open)
     throw0(DB_OPEN_FAILURE("Attempted to open db, but it's already open"));
 
+  m_compress_txs = db_flags & DBF_COMPRESS_TXS;
+  m_stats_enabled = db_flags & DBF_STATS;
+
   boost::filesystem::path direc(filename);
   if (boost::filesystem::exists(direc))
   {
@@ -1556,10 +1749,31 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     }
   }
 
+  bool compression_pending = false;
+  if (!load_tx_compression(txn, compression_pending))
+  {
+    txn.abort();
+    mdb_env_close(m_env);
+    m_open = false;
+    MFATAL("Existing lmdb database has compressed transactions, but this build has no zstd support.");
+    return;
+  }
+  if (compression_pending && (mdb_flags & MDB_RDONLY))
+  {
+    txn.abort();
+    mdb_env_close(m_env);
+    m_open = false;
+    MFATAL("Existing lmdb database has an unfinished transaction compression, which cannot be resumed on a read-only database.");
+    return;
+  }
+
   // commit the transaction
   txn.commit();
 
   m_open = true;
+
+  if (compression_pending || (m_compress_txs && !(mdb_flags & MDB_RDONLY) && !m_txs_pruned_compressor.enabled()))
+    compress_tx_tables();
   // from here, init should be finished
 }
 
@@ -1649,6 +1863,11 @@ void BlockchainLMDB::reset()
   txn.commit();
   m_cum_size = 0;
   m_cum_count = 0;
+
+  // the dictionaries went with the properties, they'll be retrained
+  // on a later start with --db-compress-txs once there is data again
+  m_txs_pruned_compressor.reset();
+  m_txs_prunable_compressor.reset();
 }
 
 std::vector<std::string> BlockchainLMDB::get_filenames() const
@@ -1727,7 +1946,7 @@ void BlockchainLMDB::unlock()
 #define TXN_POSTFIX_SUCCESS() \
   do { \
     if (! m_batch_active) \
-      auto_txn.commit(); \
+      commit_txn(auto_txn); \
   } while(0)
 
 
@@ -1753,7 +1972,7 @@ void BlockchainLMDB::unlock()
 #define TXN_BLOCK_POSTFIX_SUCCESS() \
   do { \
     if (! m_batch_active && ! m_write_txn) \
-      auto_txn.commit(); \
+      commit_txn(auto_txn); \
   } while(0)
 
 void BlockchainLMDB::add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
@@ -1767,14 +1986,14 @@ void BlockchainLMDB::add_txpool_tx(const crypto::hash &txid, const cryptonote::b
 
   MDB_val k = {sizeof(txid), (void *)&txid};
   MDB_val v = {sizeof(meta), (void *)&meta};
-  if (auto result = mdb_cursor_put(m_cur_txpool_meta, &k, &v, MDB_NODUPDATA)) {
+  if (auto result = lmdb_cursor_put(m_cur_txpool_meta, &k, &v, MDB_NODUPDATA)) {
     if (result == MDB_KEYEXIST)
       throw1(DB_ERROR("Attempting to add txpool tx metadata that's already in the db"));
     else
       throw1(DB_ERROR(lmdb_error("Error adding txpool tx metadata to db transaction: ", result).c_str()));
   }
   MDB_val_sized(blob_val, blob);
-  if (auto result = mdb_cursor_put(m_cur_txpool_blob, &k, &blob_val, MDB_NODUPDATA)) {
+  if (auto result = lmdb_cursor_put(m_cur_txpool_blob, &k, &blob_val, MDB_NODUPDATA)) {
     if (result == MDB_KEYEXIST)
       throw1(DB_ERROR("Attempting to add txpool tx blob that's already in the db"));
     else
@@ -1793,14 +2012,14 @@ void BlockchainLMDB::update_txpool_tx(const crypto::hash &txid, const txpool_tx_
 
   MDB_val k = {sizeof(txid), (void *)&txid};
   MDB_val v;
-  auto result = mdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
+  auto result = lmdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
   if (result != 0)
     throw1(DB_ERROR(lmdb_error("Error finding txpool tx meta to update: ", result).c_str()));
-  result = mdb_cursor_del(m_cur_txpool_meta, 0);
+  result = lmdb_cursor_del(m_cur_txpool_meta, 0);
   if (result)
     throw1(DB_ERROR(lmdb_error("Error adding removal of txpool tx metadata to db transaction: ", result).c_str()));
   v = MDB_val({sizeof(meta), (void *)&meta});
-  if ((result = mdb_cursor_put(m_cur_txpool_meta, &k, &v, MDB_NODUPDATA)) != 0) {
+  if ((result = lmdb_cursor_put(m_cur_txpool_meta, &k, &v, MDB_NODUPDATA)) != 0) {
     if (result == MDB_KEYEXIST)
       throw1(DB_ERROR("Attempting to add txpool tx metadata that's already in the db"));
     else
@@ -1837,7 +2056,7 @@ uint64_t BlockchainLMDB::get_txpool_tx_count(relay_category category) const
     MDB_cursor_op op = MDB_FIRST;
     while (1)
     {
-      result = mdb_cursor_get(m_cur_txpool_meta, &k, &v, op);
+      result = lmdb_cursor_get(m_cur_txpool_meta, &k, &v, op);
       op = MDB_NEXT;
       if (result == MDB_NOTFOUND)
         break;
@@ -1863,7 +2082,7 @@ bool BlockchainLMDB::txpool_has_tx(const crypto::hash& txid, relay_category tx_c
 
   MDB_val k = {sizeof(txid), (void *)&txid};
   MDB_val v;
-  auto result = mdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
+  auto result = lmdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
   if (result != 0 && result != MDB_NOTFOUND)
     throw1(DB_ERROR(lmdb_error("Error finding txpool tx meta: ", result).c_str()));
   if (result == MDB_NOTFOUND)
@@ -1889,21 +2108,21 @@ void BlockchainLMDB::remove_txpool_tx(const crypto::hash& txid)
   CURSOR(txpool_blob)
 
   MDB_val k = {sizeof(txid), (void *)&txid};
-  auto result = mdb_cursor_get(m_cur_txpool_meta, &k, NULL, MDB_SET);
+  auto result = lmdb_cursor_get(m_cur_txpool_meta, &k, NULL, MDB_SET);
   if (result != 0 && result != MDB_NOTFOUND)
     throw1(DB_ERROR(lmdb_error("Error finding txpool tx meta to remove: ", result).c_str()));
   if (!result)
   {
-    result = mdb_cursor_del(m_cur_txpool_meta, 0);
+    result = lmdb_cursor_del(m_cur_txpool_meta, 0);
     if (result)
       throw1(DB_ERROR(lmdb_error("Error adding removal of txpool tx metadata to db transaction: ", result).c_str()));
   }
-  result = mdb_cursor_get(m_cur_txpool_blob, &k, NULL, MDB_SET);
+  result = lmdb_cursor_get(m_cur_txpool_blob, &k, NULL, MDB_SET);
   if (result != 0 && result != MDB_NOTFOUND)
     throw1(DB_ERROR(lmdb_error("Error finding txpool tx blob to remove: ", result).c_str()));
   if (!result)
   {
-    result = mdb_cursor_del(m_cur_txpool_blob, 0);
+    result = lmdb_cursor_del(m_cur_txpool_blob, 0);
     if (result)
       throw1(DB_ERROR(lmdb_error("Error adding removal of txpool tx blob to db transaction: ", result).c_str()));
   }
@@ -1919,7 +2138,7 @@ bool BlockchainLMDB::get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta
 
   MDB_val k = {sizeof(txid), (void *)&txid};
   MDB_val v;
-  auto result = mdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
+  auto result = lmdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
   if (result == MDB_NOTFOUND)
       return false;
   if (result != 0)
@@ -1945,7 +2164,7 @@ bool BlockchainLMDB::get_txpool_tx_blob(const crypto::hash& txid, cryptonote::bl
   if (tx_category != relay_category::all)
   {
     RCURSOR(txpool_meta)
-    auto result = mdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
+    auto result = lmdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
     if (result == MDB_NOTFOUND)
       return false;
     if (result != 0)
@@ -1956,7 +2175,7 @@ bool BlockchainLMDB::get_txpool_tx_blob(const crypto::hash& txid, cryptonote::bl
       return false;
   }
 
-  auto result = mdb_cursor_get(m_cur_txpool_blob, &k, &v, MDB_SET);
+  auto result = lmdb_cursor_get(m_cur_txpool_blob, &k, &v, MDB_SET);
   if (result == MDB_NOTFOUND)
     return false;
   if (result != 0)
@@ -1984,7 +2203,7 @@ uint32_t BlockchainLMDB::get_blockchain_pruning_seed() const
   RCURSOR(properties)
   MDB_val_str(k, "pruning_seed");
   MDB_val v;
-  int result = mdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
+  int result = lmdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
   if (result == MDB_NOTFOUND)
     return 0;
   if (result)
@@ -1997,7 +2216,7 @@ uint32_t BlockchainLMDB::get_blockchain_pruning_seed() const
   return pruning_seed;
 }
 
-static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
+static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id, const tx_blob_compressor &compressor)
 {
   MDB_val v;
   int ret = mdb_cursor_get(c_txs_pruned, tx_id, &v, MDB_SET);
@@ -2005,6 +2224,12 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
     throw0(DB_ERROR(lmdb_error("Failed to find transaction pruned data: ", ret).c_str()));
   if (v.mv_size == 0)
     throw0(DB_ERROR("Invalid transaction pruned data"));
+  if (compressor.enabled())
+  {
+    cryptonote::blobdata bd;
+    append_tx_blob(compressor, v, bd);
+    return cryptonote::is_v1_tx(bd);
+  }
   return cryptonote::is_v1_tx(cryptonote::blobdata_ref{(const char*)v.mv_data, v.mv_size});
 }
 
@@ -2102,7 +2327,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     MDB_cursor_op op = MDB_FIRST;
     while (1)
     {
-      int ret = mdb_cursor_get(c_txs_prunable_tip, &k, &v, op);
+      int ret = lmdb_cursor_get(c_txs_prunable_tip, &k, &v, op);
       op = MDB_NEXT;
       if (ret == MDB_NOTFOUND)
         break;
@@ -2114,10 +2339,10 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS < blockchain_height)
       {
         ++n_total_records;
-        if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &k))
+        if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &k, m_txs_pruned_compressor))
         {
           ++n_prunable_records;
-          result = mdb_cursor_get(c_txs_prunable, &k, &v, MDB_SET);
+          result = lmdb_cursor_get(c_txs_prunable, &k, &v, MDB_SET);
           if (result == MDB_NOTFOUND)
             MDEBUG("Already pruned at height " << block_height << "/" << blockchain_height);
           else if (result)
@@ -2128,12 +2353,12 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
             ++n_pruned_records;
             ++commit_counter;
             n_bytes += k.mv_size + v.mv_size;
-            result = mdb_cursor_del(c_txs_prunable, 0);
+            result = lmdb_cursor_del(c_txs_prunable, 0);
             if (result)
               throw0(DB_ERROR(lmdb_error("Failed to delete transaction prunable data: ", result).c_str()));
           }
         }
-        result = mdb_cursor_del(c_txs_prunable_tip, 0);
+        result = lmdb_cursor_del(c_txs_prunable_tip, 0);
         if (result)
           throw0(DB_ERROR(lmdb_error("Failed to delete transaction tip data: ", result).c_str()));
 
@@ -2167,7 +2392,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     MDB_cursor_op op = MDB_FIRST;
     while (1)
     {
-      int ret = mdb_cursor_get(c_tx_indices, &k, &v, op);
+      int ret = lmdb_cursor_get(c_tx_indices, &k, &v, op);
       op = MDB_NEXT;
       if (ret == MDB_NOTFOUND)
         break;
@@ -2185,7 +2410,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
         MDB_val_set(vp, block_height);
         if (mode == prune_mode_check)
         {
-          result = mdb_cursor_get(c_txs_prunable_tip, &kp, &vp, MDB_SET);
+          result = lmdb_cursor_get(c_txs_prunable_tip, &kp, &vp, MDB_SET);
           if (result && result != MDB_NOTFOUND)
             throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
           if (result == MDB_NOTFOUND)
@@ -2194,15 +2419,15 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
         }
         else
         {
-          result = mdb_cursor_put(c_txs_prunable_tip, &kp, &vp, 0);
+          result = lmdb_cursor_put(c_txs_prunable_tip, &kp, &vp, 0);
           if (result && result != MDB_NOTFOUND)
             throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
         }
       }
       MDB_val_set(kp, ti.data.tx_id);
-      if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp))
+      if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp, m_txs_pruned_compressor))
       {
-        result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
+        result = lmdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
         if (result && result != MDB_NOTFOUND)
           throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
         if (mode == prune_mode_check)
@@ -2221,7 +2446,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
             MDEBUG("Pruning at height " << block_height << "/" << blockchain_height);
             ++n_pruned_records;
             n_bytes += kp.mv_size + v.mv_size;
-            result = mdb_cursor_del(c_txs_prunable, 0);
+            result = lmdb_cursor_del(c_txs_prunable, 0);
             if (result)
               throw0(DB_ERROR(lmdb_error("Failed to delete transaction prunable data: ", result).c_str()));
             ++commit_counter;
@@ -2233,7 +2458,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
         if (mode == prune_mode_check)
         {
           MDB_val_set(kp, ti.data.tx_id);
-          result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
+          result = lmdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
           if (result && result != MDB_NOTFOUND)
             throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
           if (result == MDB_NOTFOUND)
@@ -2264,7 +2489,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
         MDB_val val;
         val.mv_size = sizeof(ti);
         val.mv_data = (void *)&ti;
-        result = mdb_cursor_get(c_tx_indices, (MDB_val*)&zerokval, &val, MDB_GET_BOTH);
+        result = lmdb_cursor_get(c_tx_indices, (MDB_val*)&zerokval, &val, MDB_GET_BOTH);
         if (result)
           throw0(DB_ERROR(lmdb_error("Failed to restore cursor for tx_indices: ", result).c_str()));
         commit_counter = 0;
@@ -2324,7 +2549,7 @@ bool BlockchainLMDB::for_all_txpool_txes(std::function<bool(const crypto::hash&,
   MDB_cursor_op op = MDB_FIRST;
   while (1)
   {
-    int result = mdb_cursor_get(m_cur_txpool_meta, &k, &v, op);
+    int result = lmdb_cursor_get(m_cur_txpool_meta, &k, &v, op);
     op = MDB_NEXT;
     if (result == MDB_NOTFOUND)
       break;
@@ -2339,7 +2564,7 @@ bool BlockchainLMDB::for_all_txpool_txes(std::function<bool(const crypto::hash&,
     if (include_blob)
     {
       MDB_val b;
-      result = mdb_cursor_get(m_cur_txpool_blob, &k, &b, MDB_SET);
+      result = lmdb_cursor_get(m_cur_txpool_blob, &k, &b, MDB_SET);
       if (result == MDB_NOTFOUND)
         throw0(DB_ERROR("Failed to find txpool tx blob to match metadata"));
       if (result)
@@ -2374,7 +2599,7 @@ bool BlockchainLMDB::for_all_alt_blocks(std::function<bool(const crypto::hash&,
   MDB_cursor_op op = MDB_FIRST;
   while (1)
   {
-    int result = mdb_cursor_get(m_cur_alt_blocks, &k, &v, op);
+    int result = lmdb_cursor_get(m_cur_alt_blocks, &k, &v, op);
     op = MDB_NEXT;
     if (result == MDB_NOTFOUND)
       break;
@@ -2413,7 +2638,7 @@ bool BlockchainLMDB::block_exists(const crypto::hash& h, uint64_t *height) const
 
   bool ret = false;
   MDB_val_set(key, h);
-  auto get_result = mdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     LOG_PRINT_L3("Block with hash " << epee::string_tools::pod_to_hex(h) << " not found in db");
@@ -2451,7 +2676,7 @@ uint64_t BlockchainLMDB::get_block_height(const crypto::hash& h) const
   RCURSOR(block_heights);
 
   MDB_val_set(key, h);
-  auto get_result = mdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_heights, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
     throw1(BLOCK_DNE("Attempted to retrieve non-existent block height"));
   else if (get_result)
@@ -2482,7 +2707,7 @@ cryptonote::blobdata BlockchainLMDB::get_block_blob_from_height(const uint64_t&
 
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
-  auto get_result = mdb_cursor_get(m_cur_blocks, &key, &result, MDB_SET);
+  auto get_result = lmdb_cursor_get(m_cur_blocks, &key, &result, MDB_SET);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get block from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block not in db").c_str()));
@@ -2507,7 +2732,7 @@ uint64_t BlockchainLMDB::get_block_timestamp(const uint64_t& height) const
   RCURSOR(block_info);
 
   MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get timestamp from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- timestamp not in db").c_str()));
@@ -2557,7 +2782,7 @@ std::vector<uint64_t> BlockchainLMDB::get_block_cumulative_rct_outputs(const std
       if (height == prev_height + 1)
       {
         MDB_val k2;
-        result = mdb_cursor_get(m_cur_block_info, &k2, &v, MDB_NEXT_MULTIPLE);
+        result = lmdb_cursor_get(m_cur_block_info, &k2, &v, MDB_NEXT_MULTIPLE);
         range_begin = ((const mdb_block_info*)v.mv_data)->bi_height;
         range_end = range_begin + v.mv_size / sizeof(mdb_block_info); // whole records please
         if (height < range_begin || height >= range_end)
@@ -2567,7 +2792,7 @@ std::vector<uint64_t> BlockchainLMDB::get_block_cumulative_rct_outputs(const std
       {
         v.mv_size = sizeof(uint64_t);
         v.mv_data = (void*)&height;
-        result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+        result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
         range_begin = height;
         range_end = range_begin + 1;
       }
@@ -2607,7 +2832,7 @@ size_t BlockchainLMDB::get_block_weight(const uint64_t& height) const
   RCURSOR(block_info);
 
   MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get block size from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block size not in db").c_str()));
@@ -2650,7 +2875,7 @@ std::vector<uint64_t> BlockchainLMDB::get_block_info_64bit_fields(uint64_t start
       if (range_end > 0)
       {
         MDB_val k2;
-        result = mdb_cursor_get(m_cur_block_info, &k2, &v, MDB_NEXT_MULTIPLE);
+        result = lmdb_cursor_get(m_cur_block_info, &k2, &v, MDB_NEXT_MULTIPLE);
         range_begin = ((const mdb_block_info*)v.mv_data)->bi_height;
         range_end = range_begin + v.mv_size / sizeof(mdb_block_info); // whole records please
         if (height < range_begin || height >= range_end)
@@ -2660,7 +2885,7 @@ std::vector<uint64_t> BlockchainLMDB::get_block_info_64bit_fields(uint64_t start
       {
         v.mv_size = sizeof(uint64_t);
         v.mv_data = (void*)&height;
-        result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+        result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
         range_begin = height;
         range_end = range_begin + 1;
       }
@@ -2684,7 +2909,7 @@ uint64_t BlockchainLMDB::get_max_block_size()
   RCURSOR(properties)
   MDB_val_str(k, "max_block_size");
   MDB_val v;
-  int result = mdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
+  int result = lmdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
   if (result == MDB_NOTFOUND)
     return std::numeric_limits<uint64_t>::max();
   if (result)
@@ -2707,7 +2932,7 @@ void BlockchainLMDB::add_max_block_size(uint64_t sz)
 
   MDB_val_str(k, "max_block_size");
   MDB_val v;
-  int result = mdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
+  int result = lmdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
   if (result && result != MDB_NOTFOUND)
     throw0(DB_ERROR(lmdb_error("Failed to retrieve max block size: ", result).c_str()));
   uint64_t max_block_size = 0;
@@ -2721,7 +2946,7 @@ void BlockchainLMDB::add_max_block_size(uint64_t sz)
     max_block_size = sz;
   v.mv_data = (void*)&max_block_size;
   v.mv_size = sizeof(max_block_size);
-  result = mdb_cursor_put(m_cur_properties, &k, &v, 0);
+  result = lmdb_cursor_put(m_cur_properties, &k, &v, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to set max_block_size: ", result).c_str()));
 }
@@ -2746,7 +2971,7 @@ difficulty_type BlockchainLMDB::get_block_cumulative_difficulty(const uint64_t&
   RCURSOR(block_info);
 
   MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get cumulative difficulty from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- difficulty not in db").c_str()));
@@ -2788,7 +3013,7 @@ uint64_t BlockchainLMDB::get_block_already_generated_coins(const uint64_t& heigh
   RCURSOR(block_info);
 
   MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get generated coins from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block size not in db").c_str()));
@@ -2811,7 +3036,7 @@ uint64_t BlockchainLMDB::get_block_long_term_weight(const uint64_t& height) cons
   RCURSOR(block_info);
 
   MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get block long term weight from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block info not in db").c_str()));
@@ -2834,7 +3059,7 @@ crypto::hash BlockchainLMDB::get_block_hash_from_height(const uint64_t& height)
   RCURSOR(block_info);
 
   MDB_val_set(result, height);
-  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get hash from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- hash not in db").c_str()));
@@ -2931,7 +3156,7 @@ uint64_t BlockchainLMDB::num_outputs() const
 
   uint64_t num = 0;
   MDB_val k, v;
-  result = mdb_cursor_get(m_cur_output_txs, &k, &v, MDB_LAST);
+  result = lmdb_cursor_get(m_cur_output_txs, &k, &v, MDB_LAST);
   if (result == MDB_NOTFOUND)
     num = 0;
   else if (result == 0)
@@ -2954,7 +3179,7 @@ bool BlockchainLMDB::tx_exists(const crypto::hash& h) const
   bool tx_found = false;
 
   TIME_MEASURE_START(time1);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
   if (get_result == 0)
     tx_found = true;
   else if (get_result != MDB_NOTFOUND)
@@ -2985,7 +3210,7 @@ bool BlockchainLMDB::tx_exists(const crypto::hash& h, uint64_t& tx_id) const
   MDB_val_set(v, h);
 
   TIME_MEASURE_START(time1);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   TIME_MEASURE_FINISH(time1);
   time_tx_exists += time1;
   if (!get_result) {
@@ -3017,7 +3242,7 @@ uint64_t BlockchainLMDB::get_tx_unlock_time(const crypto::hash& h) const
   RCURSOR(tx_indices);
 
   MDB_val_set(v, h);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
     throw1(TX_DNE(lmdb_error(std::string("tx data with hash ") + epee::string_tools::pod_to_hex(h) + " not found in db: ", get_result).c_str()));
   else if (get_result)
@@ -3041,15 +3266,15 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
 
   MDB_val_set(v, h);
   MDB_val result0, result1;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     txindex *tip = (txindex *)v.mv_data;
     MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result0, MDB_SET);
+    get_result = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result0, MDB_SET);
     if (get_result == 0)
     {
-      get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result1, MDB_SET);
+      get_result = lmdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result1, MDB_SET);
     }
   }
   if (get_result == MDB_NOTFOUND)
@@ -3057,8 +3282,9 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result0.mv_data), result0.mv_size);
-  bd.append(reinterpret_cast<char*>(result1.mv_data), result1.mv_size);
+  bd.clear();
+  append_tx_blob(m_txs_pruned_compressor, result0, bd);
+  append_tx_blob(m_txs_prunable_compressor, result1, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3076,19 +3302,20 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
 
   MDB_val_set(v, h);
   MDB_val result;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     txindex *tip = (txindex *)v.mv_data;
     MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, MDB_SET);
+    get_result = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, MDB_SET);
   }
   if (get_result == MDB_NOTFOUND)
     return false;
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  bd.clear();
+  append_tx_blob(m_txs_pruned_compressor, result, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3111,7 +3338,7 @@ bool BlockchainLMDB::get_pruned_tx_blobs_from(const crypto::hash& h, size_t coun
 
   MDB_val_set(v, h);
   MDB_val result;
-  int res = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  int res = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (res == MDB_NOTFOUND)
     return false;
   if (res)
@@ -3123,13 +3350,14 @@ bool BlockchainLMDB::get_pruned_tx_blobs_from(const crypto::hash& h, size_t coun
   MDB_cursor_op op = MDB_SET;
   while (count--)
   {
-    res = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, op);
+    res = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, op);
     op = MDB_NEXT;
     if (res == MDB_NOTFOUND)
       return false;
     if (res)
       throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx blob", res).c_str()));
-    bd.emplace_back(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+    bd.emplace_back();
+    append_tx_blob(m_txs_pruned_compressor, result, bd.back());
   }
 
   TXN_POSTFIX_RDONLY();
@@ -3161,7 +3389,7 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_count, si
   for (uint64_t h = start_height; h < blockchain_height && blocks.size() < max_count && (size < max_size || blocks.size() < min_count); ++h)
   {
     MDB_cursor_op op = h == start_height ? MDB_SET : MDB_NEXT;
-    int result = mdb_cursor_get(m_cur_blocks, &key, &v, op);
+    int result = lmdb_cursor_get(m_cur_blocks, &key, &v, op);
     if (result == MDB_NOTFOUND)
       throw0(BLOCK_DNE(std::string("Attempt to get block from height ").append(boost::lexical_cast<std::string>(h)).append(" failed -- block not in db").c_str()));
     else if (result)
@@ -3183,7 +3411,7 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_count, si
     {
       crypto::hash hash = cryptonote::get_transaction_hash(b.miner_tx);
       MDB_val_set(v, hash);
-      result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+      result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
       if (result)
         throw0(DB_ERROR(lmdb_error("Error attempting to retrieve block coinbase transaction from the db: ", result).c_str()));
 
@@ -3195,12 +3423,12 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_count, si
 
     if (skip_coinbase)
     {
-      result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &v, op);
+      result = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &v, op);
       if (result)
         throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
       if (!pruned)
       {
-        result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
+        result = lmdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
         if (result)
           throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
       }
@@ -3213,17 +3441,17 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_count, si
     {
       // get pruned data
       cryptonote::blobdata tx_blob;
-      result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &v, op);
+      result = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &v, op);
       if (result)
         throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
-      tx_blob.assign((const char*)v.mv_data, v.mv_size);
+      append_tx_blob(m_txs_pruned_compressor, v, tx_blob);
 
       if (!pruned)
       {
-        result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
+        result = lmdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
         if (result)
           throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
-        tx_blob.append(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+        append_tx_blob(m_txs_prunable_compressor, v, tx_blob);
       }
       current_block.second.push_back(std::make_pair(tx_hash, std::move(tx_blob)));
       size += current_block.second.back().second.size();
@@ -3235,6 +3463,105 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_count, si
   return true;
 }
 
+bool BlockchainLMDB::for_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, bool pruned, const std::function<bool(uint64_t, const epee::span<const uint8_t>, const cryptonote::block&, std::vector<cryptonote::blobdata>&)> &f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(blocks);
+  RCURSOR(tx_indices);
+  RCURSOR(txs_pruned);
+  if (!pruned)
+  {
+    RCURSOR(txs_prunable);
+  }
+
+  const uint64_t blockchain_height = height();
+  uint64_t size = 0;
+  size_t count = 0;
+  MDB_val_copy<uint64_t> key(start_height);
+  MDB_val v, val_tx_id;
+  uint64_t tx_id = ~0;
+  std::vector<cryptonote::blobdata> txs;
+  cryptonote::blobdata parse_blob;
+  cryptonote::block b;
+  for (uint64_t h = start_height; h < blockchain_height && count < max_count && (size < max_size || count < min_count); ++h, ++count)
+  {
+    const MDB_cursor_op op = h == start_height ? MDB_SET : MDB_NEXT;
+    int result = lmdb_cursor_get(m_cur_blocks, &key, &v, op);
+    if (result == MDB_NOTFOUND)
+      throw0(BLOCK_DNE(std::string("Attempt to get block from height ").append(boost::lexical_cast<std::string>(h)).append(" failed -- block not in db").c_str()));
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a block from the db", result).c_str()));
+
+    // the block blob is handed out in place, it stays valid while the txn is open
+    const epee::span<const uint8_t> block_blob{static_cast<const uint8_t*>(v.mv_data), v.mv_size};
+    size += v.mv_size;
+
+    parse_blob.assign(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+    b = cryptonote::block{};
+    if (!parse_and_validate_block_from_blob(parse_blob, b))
+      throw0(DB_ERROR("Invalid block"));
+
+    // get the tx_id for the first tx (the first block's coinbase tx)
+    if (h == start_height)
+    {
+      crypto::hash hash = cryptonote::get_transaction_hash(b.miner_tx);
+      MDB_val_set(v, hash);
+      result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve block coinbase transaction from the db: ", result).c_str()));
+
+      const txindex *tip = (const txindex *)v.mv_data;
+      tx_id = tip->data.tx_id;
+      val_tx_id.mv_data = &tx_id;
+      val_tx_id.mv_size = sizeof(tx_id);
+    }
+
+    // skip the coinbase
+    result = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &v, op);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
+    if (!pruned)
+    {
+      result = lmdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
+    }
+
+    // the strings are kept across blocks so their buffers get reused
+    if (txs.size() < b.tx_hashes.size())
+      txs.resize(b.tx_hashes.size());
+    for (size_t n = 0; n < b.tx_hashes.size(); ++n)
+    {
+      cryptonote::blobdata &tx_blob = txs[n];
+      tx_blob.clear();
+      result = lmdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &v, MDB_NEXT);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
+      append_tx_blob(m_txs_pruned_compressor, v, tx_blob);
+
+      if (!pruned)
+      {
+        result = lmdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, MDB_NEXT);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
+        append_tx_blob(m_txs_prunable_compressor, v, tx_blob);
+      }
+      size += tx_blob.size();
+    }
+    txs.resize(b.tx_hashes.size());
+
+    if (!f(h, block_blob, b, txs))
+      return false;
+  }
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
 bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3246,19 +3573,20 @@ bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blo
 
   MDB_val_set(v, h);
   MDB_val result;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     const txindex *tip = (const txindex *)v.mv_data;
     MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
+    get_result = lmdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
   }
   if (get_result == MDB_NOTFOUND)
     return false;
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  bd.clear();
+  append_tx_blob(m_txs_prunable_compressor, result, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3276,12 +3604,12 @@ bool BlockchainLMDB::get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::h
 
   MDB_val_set(v, tx_hash);
   MDB_val result, val_tx_prunable_hash;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     txindex *tip = (txindex *)v.mv_data;
     MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, &result, MDB_SET);
+    get_result = lmdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, &result, MDB_SET);
   }
   if (get_result == MDB_NOTFOUND)
     return false;
@@ -3335,7 +3663,7 @@ uint64_t BlockchainLMDB::get_tx_block_height(const crypto::hash& h) const
   RCURSOR(tx_indices);
 
   MDB_val_set(v, h);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
   {
     throw1(TX_DNE(std::string("tx_data_t with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
@@ -3360,7 +3688,7 @@ uint64_t BlockchainLMDB::get_num_outputs(const uint64_t& amount) const
   MDB_val_copy<uint64_t> k(amount);
   MDB_val v;
   mdb_size_t num_elems = 0;
-  auto result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
+  auto result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
   if (result == MDB_SUCCESS)
   {
     mdb_cursor_count(m_cur_output_amounts, &num_elems);
@@ -3383,7 +3711,7 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
 
   MDB_val_set(k, amount);
   MDB_val_set(v, index);
-  auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
     throw1(OUTPUT_DNE(std::string("Attempting to get output pubkey by index, but key does not exist: amount " +
         std::to_string(amount) + ", index " + std::to_string(index)).c_str()));
@@ -3417,7 +3745,7 @@ tx_out_index BlockchainLMDB::get_output_tx_and_index_from_global(const uint64_t&
 
   MDB_val_set(v, output_id);
 
-  auto get_result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = lmdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
     throw1(OUTPUT_DNE("output with given index not in db"));
   else if (get_result)
@@ -3460,7 +3788,7 @@ std::vector<std::vector<uint64_t>> BlockchainLMDB::get_tx_amount_output_indices(
   MDB_cursor_op op = MDB_SET;
   while (n_txes-- > 0)
   {
-    int result = mdb_cursor_get(m_cur_tx_outputs, &k_tx_id, &v, op);
+    int result = lmdb_cursor_get(m_cur_tx_outputs, &k_tx_id, &v, op);
     if (result == MDB_NOTFOUND)
       LOG_PRINT_L0("WARNING: Unexpected: tx has no amount indices stored in "
           "tx_outputs, but it should have an empty entry even if it's a tx without "
@@ -3497,7 +3825,7 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   RCURSOR(spent_keys);
 
   MDB_val k = {sizeof(img), (void *)&img};
-  ret = (mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
+  ret = (lmdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
 
   TXN_POSTFIX_RDONLY();
   return ret;
@@ -3518,7 +3846,7 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
   MDB_cursor_op op = MDB_FIRST;
   while (1)
   {
-    int ret = mdb_cursor_get(m_cur_spent_keys, &k, &v, op);
+    int ret = lmdb_cursor_get(m_cur_spent_keys, &k, &v, op);
     op = MDB_NEXT;
     if (ret == MDB_NOTFOUND)
       break;
@@ -3559,7 +3887,7 @@ bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, st
   }
   while (1)
   {
-    int ret = mdb_cursor_get(m_cur_blocks, &k, &v, op);
+    int ret = lmdb_cursor_get(m_cur_blocks, &k, &v, op);
     op = MDB_NEXT;
     if (ret == MDB_NOTFOUND)
       break;
@@ -3604,7 +3932,7 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
   MDB_cursor_op op = MDB_FIRST;
   while (1)
   {
-    int ret = mdb_cursor_get(m_cur_tx_indices, &k, &v, op);
+    int ret = lmdb_cursor_get(m_cur_tx_indices, &k, &v, op);
     op = MDB_NEXT;
     if (ret == MDB_NOTFOUND)
       break;
@@ -3616,14 +3944,14 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
     k.mv_data = (void *)&ti->data.tx_id;
     k.mv_size = sizeof(ti->data.tx_id);
 
-    ret = mdb_cursor_get(m_cur_txs_pruned, &k, &v, MDB_SET);
+    ret = lmdb_cursor_get(m_cur_txs_pruned, &k, &v, MDB_SET);
     if (ret == MDB_NOTFOUND)
       break;
     if (ret)
       throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
     transaction tx;
     blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    append_tx_blob(m_txs_pruned_compressor, v, bd);
     if (pruned)
     {
       if (!parse_and_validate_tx_base_from_blob(bd, tx))
@@ -3631,10 +3959,10 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
     }
     else
     {
-      ret = mdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
+      ret = lmdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
       if (ret)
         throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", ret).c_str()));
-      bd.append(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+      append_tx_blob(m_txs_prunable_compressor, v, bd);
       if (!parse_and_validate_tx_from_blob(bd, tx))
         throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
     }
@@ -3664,7 +3992,7 @@ bool BlockchainLMDB::for_all_outputs(std::function<bool(uint64_t amount, const c
   MDB_cursor_op op = MDB_FIRST;
   while (1)
   {
-    int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, op);
+    int ret = lmdb_cursor_get(m_cur_output_amounts, &k, &v, op);
     op = MDB_NEXT;
     if (ret == MDB_NOTFOUND)
       break;
@@ -3699,7 +4027,7 @@ bool BlockchainLMDB::for_all_outputs(uint64_t amount, const std::function<bool(u
   MDB_cursor_op op = MDB_SET;
   while (1)
   {
-    int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, op);
+    int ret = lmdb_cursor_get(m_cur_output_amounts, &k, &v, op);
     op = MDB_NEXT_DUP;
     if (ret == MDB_NOTFOUND)
       break;
@@ -3784,7 +4112,7 @@ void BlockchainLMDB::batch_commit()
 
   LOG_PRINT_L3("batch transaction: committing...");
   TIME_MEASURE_START(time1);
-  m_write_txn->commit();
+  commit_txn(*m_write_txn);
   TIME_MEASURE_FINISH(time1);
   time_commit1 += time1;
   LOG_PRINT_L3("batch transaction: committed");
@@ -3821,7 +4149,7 @@ void BlockchainLMDB::batch_stop()
   TIME_MEASURE_START(time1);
   try
   {
-    m_write_txn->commit();
+    commit_txn(*m_write_txn);
     TIME_MEASURE_FINISH(time1);
     time_commit1 += time1;
     cleanup_batch();
@@ -3897,7 +4225,10 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
     ret = true;
   }
   if (ret)
+  {
     tinfo->m_ti_rflags.m_rf_txn = true;
+    count_read_txn();
+  }
   *mtxn = tinfo->m_ti_rtxn;
   *mcur = &tinfo->m_ti_rcursors;
 
@@ -3964,7 +4295,7 @@ void BlockchainLMDB::block_wtxn_stop()
     if (! m_batch_active)
 	{
       TIME_MEASURE_START(time1);
-      m_write_txn->commit();
+      commit_txn(*m_write_txn);
       TIME_MEASURE_FINISH(time1);
       time_commit1 += time1;
 
@@ -4061,7 +4392,7 @@ void BlockchainLMDB::get_output_tx_and_index_from_global(const std::vector<uint6
   {
     MDB_val_set(v, output_id);
 
-    auto get_result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+    auto get_result = lmdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
     if (get_result == MDB_NOTFOUND)
       throw1(OUTPUT_DNE("output with given index not in db"));
     else if (get_result)
@@ -4083,46 +4414,101 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
   TIME_MEASURE_START(db3);
   check_open();
   outputs.clear();
-  outputs.reserve(offsets.size());
+
+  const auto amount_at = [&amounts](size_t i) { return amounts.size() == 1 ? amounts[0] : amounts[i]; };
+
+  // Ring members are requested in random order, so look them up in table
+  // order instead: the cursor then only moves forward, nearby outputs share
+  // pages, and runs of close indices are reached with MDB_NEXT_DUP rather
+  // than a new search from the root. Results are scattered back into
+  // request order, and duplicates are only looked up once.
+  std::vector<size_t> order(offsets.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    const uint64_t amount_a = amount_at(a), amount_b = amount_at(b);
+    return amount_a < amount_b || (amount_a == amount_b && offsets[a] < offsets[b]);
+  });
+
+  outputs.resize(offsets.size());
+  std::vector<uint8_t> found(offsets.size(), 0);
 
   TXN_PREFIX_RDONLY();
 
   RCURSOR(output_amounts);
 
-  for (size_t i = 0; i < offsets.size(); ++i)
+  bool positioned = false;
+  uint64_t cursor_amount = 0, cursor_index = 0;
+  for (size_t n = 0; n < order.size(); ++n)
   {
-    const uint64_t amount = amounts.size() == 1 ? amounts[0] : amounts[i];
-    MDB_val_set(k, amount);
-    MDB_val_set(v, offsets[i]);
+    const size_t i = order[n];
+    const uint64_t amount = amount_at(i);
+    const uint64_t index = offsets[i];
 
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
-    if (get_result == MDB_NOTFOUND)
+    if (n > 0 && amount == amount_at(order[n - 1]) && index == offsets[order[n - 1]])
+    {
+      found[i] = found[order[n - 1]];
+      outputs[i] = outputs[order[n - 1]];
+      continue;
+    }
+
+    MDB_val k, v;
+    int get_result = MDB_NOTFOUND;
+    if (positioned && amount == cursor_amount && index > cursor_index && index - cursor_index <= OUTPUT_KEY_MAX_DUP_WALK)
     {
-      if (allow_partial)
+      while (cursor_index < index)
       {
-        MDEBUG("Partial result: " << outputs.size() << "/" << offsets.size());
-        break;
+        get_result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_NEXT_DUP);
+        if (get_result)
+          break;
+        cursor_index = ((const outkey *)v.mv_data)->amount_index;
       }
-      throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + boost::lexical_cast<std::string>(amount) + ", index " + boost::lexical_cast<std::string>(offsets[i]) + ", count " + boost::lexical_cast<std::string>(get_num_outputs(amount)) + "), but key does not exist (current height " + boost::lexical_cast<std::string>(height()) + ")").c_str()));
+      if (get_result == 0 && cursor_index != index)
+        get_result = MDB_NOTFOUND;
     }
+    if (get_result)
+    {
+      k = MDB_val{sizeof(amount), (void *)&amount};
+      v = MDB_val{sizeof(index), (void *)&index};
+      get_result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+      positioned = get_result == 0;
+      cursor_amount = amount;
+      cursor_index = index;
+    }
+    if (get_result == MDB_NOTFOUND)
+      continue;
     else if (get_result)
       throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
 
+    found[i] = 1;
     if (amount == 0)
     {
       const outkey *okp = (const outkey *)v.mv_data;
-      outputs.push_back(okp->data);
+      outputs[i] = okp->data;
     }
     else
     {
       const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
-      outputs.resize(outputs.size() + 1);
-      output_data_t &data = outputs.back();
+      output_data_t &data = outputs[i];
       memcpy(&data, &okp->data, sizeof(pre_rct_output_data_t));
       data.commitment = rct::zeroCommit(amount);
     }
   }
 
+  for (size_t i = 0; i < offsets.size(); ++i)
+  {
+    if (found[i])
+      continue;
+    if (allow_partial)
+    {
+      MDEBUG("Partial result: " << i << "/" << offsets.size());
+      outputs.resize(i);
+      break;
+    }
+    const uint64_t amount = amount_at(i);
+    throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + boost::lexical_cast<std::string>(amount) + ", index " + boost::lexical_cast<std::string>(offsets[i]) + ", count " + boost::lexical_cast<std::string>(get_num_outputs(amount)) + "), but key does not exist (current height " + boost::lexical_cast<std::string>(height()) + ")").c_str()));
+  }
+
   TXN_POSTFIX_RDONLY();
 
   TIME_MEASURE_FINISH(db3);
@@ -4146,7 +4532,7 @@ void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::
   {
     MDB_val_set(v, index);
 
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+    auto get_result = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
     if (get_result == MDB_NOTFOUND)
       throw1(OUTPUT_DNE("Attempting to get output by index, but key does not exist"));
     else if (get_result)
@@ -4182,7 +4568,7 @@ std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get
     MDB_cursor_op op = MDB_FIRST;
     while (1)
     {
-      int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, op);
+      int ret = lmdb_cursor_get(m_cur_output_amounts, &k, &v, op);
       op = MDB_NEXT_NODUP;
       if (ret == MDB_NOTFOUND)
         break;
@@ -4200,7 +4586,7 @@ std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get
     for (const auto &amount: amounts)
     {
       MDB_val_copy<uint64_t> k(amount);
-      int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
+      int ret = lmdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET);
       if (ret == MDB_NOTFOUND)
       {
         if (0 >= min_count)
@@ -4279,7 +4665,7 @@ bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_heig
   base = 0;
   while (1)
   {
-    int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, op);
+    int ret = lmdb_cursor_get(m_cur_output_amounts, &k, &v, op);
     op = MDB_NEXT_DUP;
     if (ret == MDB_NOTFOUND)
       break;
@@ -4355,7 +4741,7 @@ uint8_t BlockchainLMDB::get_hard_fork_version(uint64_t height) const
 
   MDB_val_copy<uint64_t> val_key(height);
   MDB_val val_ret;
-  auto result = mdb_cursor_get(m_cur_hf_versions, &val_key, &val_ret, MDB_SET);
+  auto result = lmdb_cursor_get(m_cur_hf_versions, &val_key, &val_ret, MDB_SET);
   if (result == MDB_NOTFOUND || result)
     throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a hard fork version at height " + boost::lexical_cast<std::string>(height) + " from the db: ", result).c_str()));
 
@@ -4378,7 +4764,7 @@ void BlockchainLMDB::add_alt_block(const crypto::hash &blkid, const cryptonote::
   memcpy(val.get(), &data, sizeof(alt_block_data_t));
   memcpy(val.get() + sizeof(alt_block_data_t), blob.data(), blob.size());
   MDB_val v = {val_size, (void *)val.get()};
-  if (auto result = mdb_cursor_put(m_cur_alt_blocks, &k, &v, MDB_NODUPDATA)) {
+  if (auto result = lmdb_cursor_put(m_cur_alt_blocks, &k, &v, MDB_NODUPDATA)) {
     if (result == MDB_KEYEXIST)
       throw1(DB_ERROR("Attempting to add alternate block that's already in the db"));
     else
@@ -4396,7 +4782,7 @@ bool BlockchainLMDB::get_alt_block(const crypto::hash &blkid, alt_block_data_t *
 
   MDB_val_set(k, blkid);
   MDB_val v;
-  int result = mdb_cursor_get(m_cur_alt_blocks, &k, &v, MDB_SET);
+  int result = lmdb_cursor_get(m_cur_alt_blocks, &k, &v, MDB_SET);
   if (result == MDB_NOTFOUND)
     return false;
 
@@ -4425,10 +4811,10 @@ void BlockchainLMDB::remove_alt_block(const crypto::hash &blkid)
 
   MDB_val k = {sizeof(blkid), (void *)&blkid};
   MDB_val v;
-  int result = mdb_cursor_get(m_cur_alt_blocks, &k, &v, MDB_SET);
+  int result = lmdb_cursor_get(m_cur_alt_blocks, &k, &v, MDB_SET);
   if (result)
     throw0(DB_ERROR(lmdb_error("Error locating alternate block " + epee::string_tools::pod_to_hex(blkid) + " in the db: ", result).c_str()));
-  result = mdb_cursor_del(m_cur_alt_blocks, 0);
+  result = lmdb_cursor_del(m_cur_alt_blocks, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Error deleting alternate block " + epee::string_tools::pod_to_hex(blkid) + " from the db: ", result).c_str()));
 }
@@ -4491,6 +4877,90 @@ uint64_t BlockchainLMDB::get_database_size() const
   return size;
 }
 
+bool BlockchainLMDB::get_db_stats(db_stats_t &stats) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  MDB_envinfo mei;
+  mdb_env_info(m_env, &mei);
+  MDB_stat mst;
+  mdb_env_stat(m_env, &mst);
+
+  stats.enabled = m_stats_enabled;
+  stats.page_size = mst.ms_psize;
+  stats.map_size = mei.me_mapsize;
+  stats.used_size = (mei.me_last_pgno + 1) * (uint64_t)mst.ms_psize;
+  stats.max_readers = mei.me_maxreaders;
+  stats.num_readers = mei.me_numreaders;
+  stats.map_resizes = m_map_resizes;
+  stats.read_txns = m_read_txns;
+  m_commit_counters.get(stats.commits);
+
+  stats.major_page_faults = 0;
+  stats.minor_page_faults = 0;
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+  {
+    stats.major_page_faults = usage.ru_majflt;
+    stats.minor_page_faults = usage.ru_minflt;
+  }
+#endif
+
+  const std::pair<const char*, MDB_dbi> tables[] = {
+    {LMDB_BLOCKS, m_blocks},
+    {LMDB_BLOCK_HEIGHTS, m_block_heights},
+    {LMDB_BLOCK_INFO, m_block_info},
+    {LMDB_TXS_PRUNED, m_txs_pruned},
+    {LMDB_TXS_PRUNABLE, m_txs_prunable},
+    {LMDB_TXS_PRUNABLE_HASH, m_txs_prunable_hash},
+    {LMDB_TXS_PRUNABLE_TIP, m_txs_prunable_tip},
+    {LMDB_TX_INDICES, m_tx_indices},
+    {LMDB_TX_OUTPUTS, m_tx_outputs},
+    {LMDB_OUTPUT_TXS, m_output_txs},
+    {LMDB_OUTPUT_AMOUNTS, m_output_amounts},
+    {LMDB_SPENT_KEYS, m_spent_keys},
+    {LMDB_TXPOOL_META, m_txpool_meta},
+    {LMDB_TXPOOL_BLOB, m_txpool_blob},
+    {LMDB_ALT_BLOCKS, m_alt_blocks},
+    {LMDB_HF_VERSIONS, m_hf_versions},
+    {LMDB_PROPERTIES, m_properties},
+  };
+
+  TXN_PREFIX_RDONLY();
+
+  stats.tables.clear();
+  for (const auto &table: tables)
+  {
+    // tables not opened in read only mode have no stats
+    if (mdb_stat(m_txn, table.second, &mst))
+      continue;
+    stats.tables.push_back({});
+    db_table_stats_t &ts = stats.tables.back();
+    ts.name = table.first;
+    ts.entries = mst.ms_entries;
+    ts.depth = mst.ms_depth;
+    ts.branch_pages = mst.ms_branch_pages;
+    ts.leaf_pages = mst.ms_leaf_pages;
+    ts.overflow_pages = mst.ms_overflow_pages;
+    ts.reads = ts.writes = ts.deletes = ts.cursor_opens = 0;
+    if (table.second < sizeof(m_table_counters) / sizeof(m_table_counters[0]))
+    {
+      const mdb_table_counters &counters = m_table_counters[table.second];
+      ts.reads = counters.reads;
+      ts.writes = counters.writes;
+      ts.deletes = counters.deletes;
+      ts.cursor_opens = counters.cursor_opens;
+      counters.latency.get(ts.latency);
+    }
+  }
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
 void BlockchainLMDB::fixup()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -4514,7 +4984,7 @@ void BlockchainLMDB::fixup()
     result = mdb_cursor_open(txn, 1, &c_cur); \
     if (result) \
       throw0(DB_ERROR(lmdb_error("Failed to open a cursor for " name ": ", result).c_str())); \
-    result = mdb_cursor_get(c_cur, &k, NULL, MDB_SET_KEY); \
+    result = lmdb_cursor_get(c_cur, &k, NULL, MDB_SET_KEY); \
     if (result) \
       throw0(DB_ERROR(lmdb_error("Failed to get DB record for " name ": ", result).c_str())); \
     ptr = (char *)k.mv_data; \
@@ -4603,7 +5073,7 @@ void BlockchainLMDB::migrate_0_1()
           i = ms.ms_entries;
         }
       }
-      result = mdb_cursor_get(c_old, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_old, &k, &v, MDB_NEXT);
       if (result == MDB_NOTFOUND) {
         txn.commit();
         break;
@@ -4612,14 +5082,14 @@ void BlockchainLMDB::migrate_0_1()
         throw0(DB_ERROR(lmdb_error("Failed to get a record from block_heights: ", result).c_str()));
       bh.bh_hash = *(crypto::hash *)k.mv_data;
       bh.bh_height = *(uint64_t *)v.mv_data;
-      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
+      result = lmdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to put a record into block_heightr: ", result).c_str()));
       /* we delete the old records immediately, so the overall DB and mapsize should not grow.
        * This is a little slower than just letting mdb_drop() delete it all at the end, but
        * it saves a significant amount of disk space.
        */
-      result = mdb_cursor_del(c_old, 0);
+      result = lmdb_cursor_del(c_old, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_heights: ", result).c_str()));
       i++;
@@ -4708,48 +5178,48 @@ void BlockchainLMDB::migrate_0_1()
           i = ms.ms_entries;
         }
       }
-      result = mdb_cursor_get(c_coins, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_coins, &k, &v, MDB_NEXT);
       if (result == MDB_NOTFOUND) {
         break;
       } else if (result)
         throw0(DB_ERROR(lmdb_error("Failed to get a record from block_coins: ", result).c_str()));
       bi.bi_height = *(uint64_t *)k.mv_data;
       bi.bi_coins = *(uint64_t *)v.mv_data;
-      result = mdb_cursor_get(c_diffs, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_diffs, &k, &v, MDB_NEXT);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to get a record from block_diffs: ", result).c_str()));
       bi.bi_diff = *(uint64_t *)v.mv_data;
-      result = mdb_cursor_get(c_hashes, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_hashes, &k, &v, MDB_NEXT);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to get a record from block_hashes: ", result).c_str()));
       bi.bi_hash = *(crypto::hash *)v.mv_data;
-      result = mdb_cursor_get(c_sizes, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_sizes, &k, &v, MDB_NEXT);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to get a record from block_sizes: ", result).c_str()));
       if (v.mv_size == sizeof(uint32_t))
         bi.bi_weight = *(uint32_t *)v.mv_data;
       else
         bi.bi_weight = *(uint64_t *)v.mv_data;  // this is a 32/64 compat bug in version 0
-      result = mdb_cursor_get(c_timestamps, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_timestamps, &k, &v, MDB_NEXT);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to get a record from block_timestamps: ", result).c_str()));
       bi.bi_timestamp = *(uint64_t *)v.mv_data;
-      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
+      result = lmdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to put a record into block_info: ", result).c_str()));
-      result = mdb_cursor_del(c_coins, 0);
+      result = lmdb_cursor_del(c_coins, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_coins: ", result).c_str()));
-      result = mdb_cursor_del(c_diffs, 0);
+      result = lmdb_cursor_del(c_diffs, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_diffs: ", result).c_str()));
-      result = mdb_cursor_del(c_hashes, 0);
+      result = lmdb_cursor_del(c_hashes, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_hashes: ", result).c_str()));
-      result = mdb_cursor_del(c_sizes, 0);
+      result = lmdb_cursor_del(c_sizes, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_sizes: ", result).c_str()));
-      result = mdb_cursor_del(c_timestamps, 0);
+      result = lmdb_cursor_del(c_timestamps, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_timestamps: ", result).c_str()));
       i++;
@@ -4830,17 +5300,17 @@ void BlockchainLMDB::migrate_0_1()
           i = ms.ms_entries;
         }
       }
-      result = mdb_cursor_get(c_old, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_old, &k, &v, MDB_NEXT);
       if (result == MDB_NOTFOUND) {
         txn.commit();
         break;
       }
       else if (result)
         throw0(DB_ERROR(lmdb_error("Failed to get a record from hf_versions: ", result).c_str()));
-      result = mdb_cursor_put(c_cur, &k, &v, MDB_APPEND);
+      result = lmdb_cursor_put(c_cur, &k, &v, MDB_APPEND);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to put a record into hf_versionr: ", result).c_str()));
-      result = mdb_cursor_del(c_old, 0);
+      result = lmdb_cursor_del(c_old, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from hf_versions: ", result).c_str()));
       i++;
@@ -4959,7 +5429,7 @@ void BlockchainLMDB::migrate_0_1()
           }
           MDB_val_set(pk, "txblk");
           MDB_val_set(pv, m_height);
-          result = mdb_cursor_put(c_props, &pk, &pv, 0);
+          result = lmdb_cursor_put(c_props, &pk, &pv, 0);
           if (result)
             throw0(DB_ERROR(lmdb_error("Failed to update txblk property: ", result).c_str()));
           txn.commit();
@@ -4987,25 +5457,25 @@ void BlockchainLMDB::migrate_0_1()
           i = ms.ms_entries;
           if (i) {
             MDB_val_set(pk, "txblk");
-            result = mdb_cursor_get(c_props, &pk, &k, MDB_SET);
+            result = lmdb_cursor_get(c_props, &pk, &k, MDB_SET);
             if (result)
               throw0(DB_ERROR(lmdb_error("Failed to get a record from properties: ", result).c_str()));
             m_height = *(uint64_t *)k.mv_data;
           }
         }
         if (i) {
-          result = mdb_cursor_get(c_blocks, &k, &v, MDB_SET);
+          result = lmdb_cursor_get(c_blocks, &k, &v, MDB_SET);
           if (result)
             throw0(DB_ERROR(lmdb_error("Failed to get a record from blocks: ", result).c_str()));
         }
       }
-      result = mdb_cursor_get(c_blocks, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_blocks, &k, &v, MDB_NEXT);
       if (result == MDB_NOTFOUND) {
         MDB_val_set(pk, "txblk");
-        result = mdb_cursor_get(c_props, &pk, &v, MDB_SET);
+        result = lmdb_cursor_get(c_props, &pk, &v, MDB_SET);
         if (result)
           throw0(DB_ERROR(lmdb_error("Failed to get a record from props: ", result).c_str()));
-        result = mdb_cursor_del(c_props, 0);
+        result = lmdb_cursor_del(c_props, 0);
         if (result)
           throw0(DB_ERROR(lmdb_error("Failed to delete a record from props: ", result).c_str()));
         batch_stop();
@@ -5021,14 +5491,14 @@ void BlockchainLMDB::migrate_0_1()
       for (unsigned int j = 0; j<b.tx_hashes.size(); j++) {
         transaction tx;
         hk.mv_data = &b.tx_hashes[j];
-        result = mdb_cursor_get(c_txs, &hk, &v, MDB_SET);
+        result = lmdb_cursor_get(c_txs, &hk, &v, MDB_SET);
         if (result)
           throw0(DB_ERROR(lmdb_error("Failed to get record from txs: ", result).c_str()));
         bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
         if (!parse_and_validate_tx_from_blob(bd, tx))
           throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
         add_transaction(null_hash, std::make_pair(std::move(tx), bd), &b.tx_hashes[j]);
-        result = mdb_cursor_del(c_txs, 0);
+        result = lmdb_cursor_del(c_txs, 0);
         if (result)
           throw0(DB_ERROR(lmdb_error("Failed to get record from txs: ", result).c_str()));
       }
@@ -5067,11 +5537,9 @@ void BlockchainLMDB::migrate_0_1()
 void BlockchainLMDB::migrate_1_2()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  uint64_t i, z;
   int result;
   mdb_txn_safe txn(false);
-  MDB_val k, v;
-  char *ptr;
+  MDB_val v;
 
   MGINFO_YELLOW("Migrating blockchain from DB version 1 to 2 - this may take a while:");
   MINFO("updating txs_pruned and txs_prunable tables...");
@@ -5102,52 +5570,12 @@ void BlockchainLMDB::migrate_1_2()
       break;
     }
 
-    MINFO("updating txs tables:");
-
-    MDB_cursor *c_old, *c_cur0, *c_cur1, *c_cur2;
-    i = 0;
-
-    while(1) {
-      if (!(i % 1000)) {
-        if (i) {
-          result = mdb_stat(txn, m_txs, &db_stats_txs);
-          if (result)
-            throw0(DB_ERROR(lmdb_error("Failed to query m_txs: ", result).c_str()));
-          LOGIF(el::Level::Info) {
-            std::cout << i << " / " << (i + db_stats_txs.ms_entries) << "  \r" << std::flush;
-          }
-          txn.commit();
-          result = mdb_txn_begin(m_env, NULL, 0, txn);
-          if (result)
-            throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
-        }
-        result = mdb_cursor_open(txn, m_txs_pruned, &c_cur0);
-        if (result)
-          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
-        result = mdb_cursor_open(txn, m_txs_prunable, &c_cur1);
-        if (result)
-          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
-        result = mdb_cursor_open(txn, m_txs_prunable_hash, &c_cur2);
-        if (result)
-          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable_hash: ", result).c_str()));
-        result = mdb_cursor_open(txn, m_txs, &c_old);
-        if (result)
-          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs: ", result).c_str()));
-        if (!i) {
-          i = db_stats_txs_pruned.ms_entries;
-        }
-      }
-      MDB_val_set(k, i);
-      result = mdb_cursor_get(c_old, &k, &v, MDB_SET);
-      if (result == MDB_NOTFOUND) {
-        txn.commit();
-        break;
-      }
-      else if (result)
-        throw0(DB_ERROR(lmdb_error("Failed to get a record from txs: ", result).c_str()));
+    txn.commit();
 
-      cryptonote::blobdata bd;
-      bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    // parsing and reserializing every tx is the bulk of the work, and runs on the threadpool
+    MINFO("updating txs tables:");
+    migrate_table(m_txs, {m_txs_pruned, m_txs_prunable, m_txs_prunable_hash}, MDB_APPEND, "txs", [](const epee::span<const uint8_t> blob, std::vector<boost::optional<std::string>> &converted) {
+      cryptonote::blobdata bd(reinterpret_cast<const char*>(blob.data()), blob.size());
       transaction tx;
       if (!parse_and_validate_tx_from_blob(bd, tx))
         throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
@@ -5163,34 +5591,15 @@ void BlockchainLMDB::migrate_1_2()
       if (memcmp(pruned.data(), bd.data(), pruned.size()))
         throw0(DB_ERROR("Pruned tx is not a prefix of the raw tx"));
 
-      MDB_val nv;
-      nv.mv_data = (void*)pruned.data();
-      nv.mv_size = pruned.size();
-      result = mdb_cursor_put(c_cur0, (MDB_val *)&k, &nv, 0);
-      if (result)
-        throw0(DB_ERROR(lmdb_error("Failed to put a record into txs_pruned: ", result).c_str()));
-
-      nv.mv_data = (void*)(bd.data() + pruned.size());
-      nv.mv_size = bd.size() - pruned.size();
-      result = mdb_cursor_put(c_cur1, (MDB_val *)&k, &nv, 0);
-      if (result)
-        throw0(DB_ERROR(lmdb_error("Failed to put a record into txs_prunable: ", result).c_str()));
-
+      converted[1] = bd.substr(pruned.size());
+      converted[0] = std::move(pruned);
       if (tx.version > 1)
       {
-        crypto::hash prunable_hash = get_transaction_prunable_hash(tx);
-        MDB_val_set(val_prunable_hash, prunable_hash);
-        result = mdb_cursor_put(c_cur2, (MDB_val *)&k, &val_prunable_hash, 0);
-        if (result)
-          throw0(DB_ERROR(lmdb_error("Failed to put a record into txs_prunable_hash: ", result).c_str()));
+        const crypto::hash prunable_hash = get_transaction_prunable_hash(tx);
+        converted[2] = std::string(reinterpret_cast<const char*>(&prunable_hash), sizeof(prunable_hash));
       }
-
-      result = mdb_cursor_del(c_old, 0);
-      if (result)
-        throw0(DB_ERROR(lmdb_error("Failed to delete a record from txs: ", result).c_str()));
-
-      i++;
-    }
+      return true;
+    }, true);
   } while(0);
 
   uint32_t version = 2;
@@ -5280,7 +5689,7 @@ void BlockchainLMDB::migrate_2_3()
           i = db_stats.ms_entries;
         }
       }
-      result = mdb_cursor_get(c_old, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_old, &k, &v, MDB_NEXT);
       if (result == MDB_NOTFOUND) {
         txn.commit();
         break;
@@ -5299,14 +5708,14 @@ void BlockchainLMDB::migrate_2_3()
         throw0(DB_ERROR("Bad height in block_info record"));
       bi.bi_cum_rct = distribution[bi_old->bi_height];
       MDB_val_set(nv, bi);
-      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
+      result = lmdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to put a record into block_infn: ", result).c_str()));
       /* we delete the old records immediately, so the overall DB and mapsize should not grow.
        * This is a little slower than just letting mdb_drop() delete it all at the end, but
        * it saves a significant amount of disk space.
        */
-      result = mdb_cursor_del(c_old, 0);
+      result = lmdb_cursor_del(c_old, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_info: ", result).c_str()));
       i++;
@@ -5410,9 +5819,18 @@ void BlockchainLMDB::migrate_3_4()
           if (result)
             throw0(DB_ERROR(lmdb_error("Failed to query m_block_info: ", result).c_str()));
           i = db_stats.ms_entries;
+          // when resuming, reload the long term weight window from the records already moved
+          for (MDB_cursor_op op = MDB_LAST; i && long_term_block_weights.size() < long_term_block_weights.capacity(); op = MDB_PREV) {
+            result = lmdb_cursor_get(c_cur, &k, &v, op);
+            if (result == MDB_NOTFOUND)
+              break;
+            if (result)
+              throw0(DB_ERROR(lmdb_error("Failed to get a record from block_infn: ", result).c_str()));
+            long_term_block_weights.push_front(((const mdb_block_info_3*)v.mv_data)->bi_long_term_block_weight);
+          }
         }
       }
-      result = mdb_cursor_get(c_old, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_old, &k, &v, MDB_NEXT);
       if (result == MDB_NOTFOUND) {
         txn.commit();
         break;
@@ -5434,7 +5852,7 @@ void BlockchainLMDB::migrate_3_4()
       {
         MDB_val_copy<uint64_t> kb(bi.bi_height);
         MDB_val vb;
-        result = mdb_cursor_get(c_blocks, &kb, &vb, MDB_SET);
+        result = lmdb_cursor_get(c_blocks, &kb, &vb, MDB_SET);
         if (result)
           throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
         if (vb.mv_size == 0)
@@ -5459,14 +5877,14 @@ void BlockchainLMDB::migrate_3_4()
       bi.bi_long_term_block_weight = long_term_block_weight;
 
       MDB_val_set(nv, bi);
-      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
+      result = lmdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to put a record into block_infn: ", result).c_str()));
       /* we delete the old records immediately, so the overall DB and mapsize should not grow.
        * This is a little slower than just letting mdb_drop() delete it all at the end, but
        * it saves a significant amount of disk space.
        */
-      result = mdb_cursor_del(c_old, 0);
+      result = lmdb_cursor_del(c_old, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_info: ", result).c_str()));
       i++;
@@ -5566,7 +5984,7 @@ void BlockchainLMDB::migrate_4_5()
           i = db_stats.ms_entries;
         }
       }
-      result = mdb_cursor_get(c_old, &k, &v, MDB_NEXT);
+      result = lmdb_cursor_get(c_old, &k, &v, MDB_NEXT);
       if (result == MDB_NOTFOUND) {
         txn.commit();
         break;
@@ -5586,14 +6004,14 @@ void BlockchainLMDB::migrate_4_5()
       bi.bi_long_term_block_weight = bi_old->bi_long_term_block_weight;
 
       MDB_val_set(nv, bi);
-      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
+      result = lmdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to put a record into block_infn: ", result).c_str()));
       /* we delete the old records immediately, so the overall DB and mapsize should not grow.
        * This is a little slower than just letting mdb_drop() delete it all at the end, but
        * it saves a significant amount of disk space.
        */
-      result = mdb_cursor_del(c_old, 0);
+      result = lmdb_cursor_del(c_old, 0);
       if (result)
         throw0(DB_ERROR(lmdb_error("Failed to delete a record from block_info: ", result).c_str()));
       i++;
@@ -5629,6 +6047,405 @@ void BlockchainLMDB::migrate_4_5()
   txn.commit();
 }
 
+void BlockchainLMDB::migrate_5_6()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val v;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 5 to 6:");
+
+  // version 6 allows txs_pruned and txs_prunable records to be compressed,
+  // but only converts them if asked to
+  if (m_compress_txs)
+    compress_tx_tables();
+
+  uint32_t version = 6;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_str(vk, "version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
+bool BlockchainLMDB::load_tx_compression(MDB_txn *txn, bool &pending)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  pending = false;
+  m_txs_pruned_compressor.reset();
+  m_txs_prunable_compressor.reset();
+
+  std::string pruned_dict, prunable_dict, flags_data;
+  lmdb_get_property(txn, m_properties, LMDB_TXS_PRUNED_ZDICT, pruned_dict);
+  lmdb_get_property(txn, m_properties, LMDB_TXS_PRUNABLE_ZDICT, prunable_dict);
+  if (pruned_dict.empty() && prunable_dict.empty())
+    return true;
+  if (!tx_blob_compressor::is_supported())
+    return false;
+
+  uint32_t flags = 0;
+  if (lmdb_get_property(txn, m_properties, LMDB_TXS_COMPRESSION, flags_data))
+  {
+    if (flags_data.size() != sizeof(flags))
+      throw0(DB_ERROR("Unexpected txs_compression property size"));
+    memcpy(&flags, flags_data.data(), sizeof(flags));
+  }
+
+  // dictionaries are written before the tables are converted, so a partial
+  // conversion must be finished before the tables can be used
+  if (pruned_dict.empty() || prunable_dict.empty() || (flags & txs_compression_all) != txs_compression_all)
+  {
+    pending = true;
+    return true;
+  }
+
+  if (!m_txs_pruned_compressor.set_dictionary(pruned_dict) || !m_txs_prunable_compressor.set_dictionary(prunable_dict))
+    throw0(DB_ERROR("Failed to load transaction compression dictionaries"));
+  MINFO("Transaction compression enabled, dictionary sizes " << pruned_dict.size() << "/" << prunable_dict.size());
+  return true;
+}
+
+bool BlockchainLMDB::train_tx_dictionary(MDB_dbi dbi, std::string &dictionary)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_cursor *c_cur;
+  MDB_val k, v;
+
+  result = mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_cursor_open(txn, dbi, &c_cur);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor: ", result).c_str()));
+
+  // tx ids are contiguous, but txs_prunable may have holes when pruned, so
+  // spread the samples over the whole id range rather than the entry count
+  result = lmdb_cursor_get(c_cur, &k, &v, MDB_LAST);
+  if (result == MDB_NOTFOUND)
+  {
+    txn.abort();
+    return false;
+  }
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get last record: ", result).c_str()));
+  uint64_t last_id;
+  memcpy(&last_id, k.mv_data, sizeof(last_id));
+  const uint64_t step = std::max<uint64_t>(1, (last_id + 1) / TXS_ZDICT_MAX_SAMPLES);
+
+  std::vector<std::string> samples;
+  size_t bytes = 0;
+  for (uint64_t id = 0; id <= last_id && samples.size() < TXS_ZDICT_MAX_SAMPLES && bytes < TXS_ZDICT_MAX_SAMPLE_BYTES; id += step)
+  {
+    MDB_val_set(key, id);
+    result = lmdb_cursor_get(c_cur, &key, &v, MDB_SET_RANGE);
+    if (result == MDB_NOTFOUND)
+      break;
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to get a record: ", result).c_str()));
+    if (v.mv_size == 0)
+      continue;
+    samples.emplace_back(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+    bytes += v.mv_size;
+  }
+  mdb_cursor_close(c_cur);
+  txn.abort();
+
+  if (samples.size() < TXS_ZDICT_MIN_SAMPLES)
+  {
+    MDEBUG("Only " << samples.size() << " samples, not enough to train a dictionary");
+    return false;
+  }
+  return tx_blob_compressor::train(samples, TXS_ZDICT_SIZE, dictionary);
+}
+
+void BlockchainLMDB::migrate_table(MDB_dbi o_dbi, const std::vector<MDB_dbi> &n_dbis, unsigned int put_flags, const char *name, const migrate_record_t &convert, bool parallel)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_cursor *c_old;
+  std::vector<MDB_cursor*> c_new(n_dbis.size());
+  MDB_val k, v;
+  MDB_stat db_stats;
+
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t threads = parallel ? std::max(1u, tpool.get_max_concurrency()) : 1;
+
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  // records are moved and the checkpoint updated in the same txn, so after an
+  // interruption the first new table holds exactly the records the checkpoint
+  // counts. When they disagree, something else wrote to the tables, and going
+  // on would mix records of both
+  if ((result = mdb_stat(txn, n_dbis[0], &db_stats)))
+    throw0(DB_ERROR(lmdb_error(std::string("Failed to query new ") + name + ": ", result).c_str()));
+  uint64_t done = db_stats.ms_entries;
+  if ((result = mdb_stat(txn, o_dbi, &db_stats)))
+    throw0(DB_ERROR(lmdb_error(std::string("Failed to query ") + name + ": ", result).c_str()));
+  const uint64_t total = done + db_stats.ms_entries;
+
+  std::string checkpoint;
+  const std::string prefix = std::string(name) + " ";
+  if (lmdb_get_property(txn, m_properties, LMDB_MIGRATION_PROGRESS, checkpoint) && checkpoint.compare(0, prefix.size(), prefix) == 0)
+  {
+    if (checkpoint.substr(prefix.size()) != std::to_string(done))
+      throw0(DB_ERROR(("Migration checkpoint for " + std::string(name) + " (" + checkpoint.substr(prefix.size()) + ") does not match the " + std::to_string(done) + " records already moved").c_str()));
+    MGINFO("Resuming migration of " << name << " at " << done << " / " << total);
+  }
+  else if (done)
+  {
+    // interrupted before checkpoints existed
+    MGINFO("Resuming migration of " << name << " at " << done << " / " << total);
+  }
+
+  std::vector<std::string> keys, values;
+  std::vector<std::vector<boost::optional<std::string>>> converted;
+  while (1)
+  {
+    for (size_t t = 0; t < n_dbis.size(); ++t)
+    {
+      result = mdb_cursor_open(txn, n_dbis[t], &c_new[t]);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to open a cursor for new table: ", result).c_str()));
+    }
+    result = mdb_cursor_open(txn, o_dbi, &c_old);
+    if (result)
+      throw0(DB_ERROR(lmdb_error(std::string("Failed to open a cursor for ") + name + ": ", result).c_str()));
+
+    // copy a batch out, pointers into the map do not survive the writes below
+    keys.clear();
+    values.clear();
+    MDB_cursor_op op = MDB_FIRST;
+    while (keys.size() < MIGRATE_TABLE_BATCH_SIZE)
+    {
+      result = lmdb_cursor_get(c_old, &k, &v, op);
+      if (result == MDB_NOTFOUND)
+        break;
+      if (result)
+        throw0(DB_ERROR(lmdb_error(std::string("Failed to get a record from ") + name + ": ", result).c_str()));
+      keys.emplace_back(reinterpret_cast<const char*>(k.mv_data), k.mv_size);
+      values.emplace_back(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+      op = MDB_NEXT;
+    }
+    if (keys.empty())
+      break;
+
+    const size_t n_records = keys.size();
+    converted.resize(n_records);
+    for (std::vector<boost::optional<std::string>> &record: converted)
+      record.assign(n_dbis.size(), boost::none);
+    std::atomic<bool> failed(false);
+    const auto convert_range = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end && !failed; ++i)
+      {
+        try
+        {
+          if (!convert({reinterpret_cast<const uint8_t*>(values[i].data()), values[i].size()}, converted[i]))
+            failed = true;
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to convert a record from " << name << ": " << e.what());
+          failed = true;
+        }
+      }
+    };
+    if (threads > 1)
+    {
+      tools::threadpool::waiter waiter;
+      const size_t chunk = (n_records + threads - 1) / threads;
+      for (size_t begin = 0; begin < n_records; begin += chunk)
+        tpool.submit(&waiter, [&convert_range, begin, chunk, n_records]() { convert_range(begin, std::min(begin + chunk, n_records)); }, true);
+      waiter.wait(&tpool);
+    }
+    else
+    {
+      convert_range(0, n_records);
+    }
+    if (failed)
+      throw0(DB_ERROR(std::string("Failed to convert a record from ").append(name).c_str()));
+
+    // write back in the original order, deleting the old records as we go
+    // so the DB does not need to hold two copies
+    for (size_t i = 0; i < n_records; ++i)
+    {
+      result = lmdb_cursor_get(c_old, &k, &v, MDB_FIRST);
+      if (result)
+        throw0(DB_ERROR(lmdb_error(std::string("Failed to get a record from ") + name + ": ", result).c_str()));
+      if (!converted[i][0])
+        throw0(DB_ERROR(std::string("No record for the first new table converting ").append(name).c_str()));
+      MDB_val nk = {keys[i].size(), (void *)keys[i].data()};
+      for (size_t t = 0; t < n_dbis.size(); ++t)
+      {
+        if (!converted[i][t])
+          continue;
+        MDB_val nv = {converted[i][t]->size(), (void *)converted[i][t]->data()};
+        result = lmdb_cursor_put(c_new[t], &nk, &nv, put_flags);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to put a record into new table: ", result).c_str()));
+      }
+      result = lmdb_cursor_del(c_old, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error(std::string("Failed to delete a record from ") + name + ": ", result).c_str()));
+    }
+    done += n_records;
+    lmdb_put_property(txn, m_properties, LMDB_MIGRATION_PROGRESS, std::string(name) + " " + std::to_string(done));
+
+    LOGIF(el::Level::Info) {
+      std::cout << done << " / " << total << "  \r" << std::flush;
+    }
+    txn.commit();
+    if (need_resize())
+      do_resize();
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  }
+
+  MDB_val_str(pk, LMDB_MIGRATION_PROGRESS);
+  result = mdb_del(txn, m_properties, &pk, NULL);
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to remove migration checkpoint: ", result).c_str()));
+  txn.commit();
+}
+
+void BlockchainLMDB::compress_tx_table(MDB_dbi o_dbi, MDB_dbi n_dbi, const tx_blob_compressor &compressor, const char *name)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  std::atomic<uint64_t> n_bytes_in(0), n_bytes_out(0);
+
+  migrate_table(o_dbi, {n_dbi}, MDB_APPEND, name, [&](const epee::span<const uint8_t> blob, std::vector<boost::optional<std::string>> &converted) {
+    converted[0] = std::string();
+    if (!compressor.compress(blob, *converted[0]))
+      return false;
+    n_bytes_in += blob.size();
+    n_bytes_out += converted[0]->size();
+    return true;
+  }, true);
+
+  MINFO("Compressed " << name << " from " << n_bytes_in << " to " << n_bytes_out << " bytes in this run");
+}
+
+void BlockchainLMDB::compress_tx_tables()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (!tx_blob_compressor::is_supported())
+  {
+    MWARNING("Transaction compression requested, but this build has no zstd support");
+    return;
+  }
+
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k;
+  MDB_cursor *c_cur;
+  char *ptr;
+
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  std::string pruned_dict, prunable_dict, flags_data;
+  lmdb_get_property(txn, m_properties, LMDB_TXS_PRUNED_ZDICT, pruned_dict);
+  lmdb_get_property(txn, m_properties, LMDB_TXS_PRUNABLE_ZDICT, prunable_dict);
+  uint32_t flags = 0;
+  if (lmdb_get_property(txn, m_properties, LMDB_TXS_COMPRESSION, flags_data) && flags_data.size() == sizeof(flags))
+    memcpy(&flags, flags_data.data(), sizeof(flags));
+  txn.abort();
+
+  if (pruned_dict.empty() || prunable_dict.empty())
+  {
+    MGINFO_YELLOW("Training transaction compression dictionaries...");
+    if (!train_tx_dictionary(m_txs_pruned, pruned_dict) || !train_tx_dictionary(m_txs_prunable, prunable_dict))
+    {
+      MWARNING("Not enough transactions to train compression dictionaries yet, transactions will be stored uncompressed for now");
+      return;
+    }
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    lmdb_put_property(txn, m_properties, LMDB_TXS_PRUNED_ZDICT, pruned_dict);
+    lmdb_put_property(txn, m_properties, LMDB_TXS_PRUNABLE_ZDICT, prunable_dict);
+    txn.commit();
+  }
+
+  tx_blob_compressor pruned_compressor, prunable_compressor;
+  if (!pruned_compressor.set_dictionary(pruned_dict) || !prunable_compressor.set_dictionary(prunable_dict))
+    throw0(DB_ERROR("Failed to load transaction compression dictionaries"));
+
+  if (!(flags & txs_compression_pruned))
+  {
+    MGINFO_YELLOW("Compressing pruned transaction data - this may take a while:");
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    /* The new table's name is the same as the old one's but for the last
+     * character, so it can be renamed in place when done (see RENAME_DB).
+     */
+    MDB_dbi o_txs_pruned = m_txs_pruned;
+    lmdb_db_open(txn, "txs_prunec", MDB_INTEGERKEY | MDB_CREATE, m_txs_pruned, "Failed to open db handle for txs_prunec");
+    txn.commit();
+
+    compress_tx_table(o_txs_pruned, m_txs_pruned, pruned_compressor, LMDB_TXS_PRUNED);
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    result = mdb_drop(txn, o_txs_pruned, 1);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to delete old txs_pruned table: ", result).c_str()));
+    RENAME_DB("txs_prunec");
+    mdb_dbi_close(m_env, m_txs_pruned);
+    lmdb_db_open(txn, LMDB_TXS_PRUNED, MDB_INTEGERKEY | MDB_CREATE, m_txs_pruned, "Failed to open db handle for m_txs_pruned");
+
+    flags |= txs_compression_pruned;
+    lmdb_put_property(txn, m_properties, LMDB_TXS_COMPRESSION, std::string((const char*)&flags, sizeof(flags)));
+    txn.commit();
+  }
+
+  if (!(flags & txs_compression_prunable))
+  {
+    MGINFO_YELLOW("Compressing prunable transaction data - this may take a while:");
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    MDB_dbi o_txs_prunable = m_txs_prunable;
+    lmdb_db_open(txn, "txs_prunabld", MDB_INTEGERKEY | MDB_CREATE, m_txs_prunable, "Failed to open db handle for txs_prunabld");
+    mdb_set_compare(txn, m_txs_prunable, compare_uint64);
+    txn.commit();
+
+    compress_tx_table(o_txs_prunable, m_txs_prunable, prunable_compressor, LMDB_TXS_PRUNABLE);
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    result = mdb_drop(txn, o_txs_prunable, 1);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to delete old txs_prunable table: ", result).c_str()));
+    RENAME_DB("txs_prunabld");
+    mdb_dbi_close(m_env, m_txs_prunable);
+    lmdb_db_open(txn, LMDB_TXS_PRUNABLE, MDB_INTEGERKEY | MDB_CREATE, m_txs_prunable, "Failed to open db handle for m_txs_prunable");
+    mdb_set_compare(txn, m_txs_prunable, compare_uint64);
+
+    flags |= txs_compression_prunable;
+    lmdb_put_property(txn, m_properties, LMDB_TXS_COMPRESSION, std::string((const char*)&flags, sizeof(flags)));
+    txn.commit();
+  }
+
+  if (!m_txs_pruned_compressor.set_dictionary(pruned_dict) || !m_txs_prunable_compressor.set_dictionary(prunable_dict))
+    throw0(DB_ERROR("Failed to load transaction compression dictionaries"));
+  MGINFO_GREEN("Transaction data compressed");
+}
+
 void BlockchainLMDB::migrate(const uint32_t oldversion)
 {
   if (oldversion < 1)
@@ -5641,6 +6458,8 @@ void BlockchainLMDB::migrate(const uint32_t oldversion)
     migrate_3_4();
   if (oldversion < 5)
     migrate_4_5();
+  if (oldversion < 6)
+    migrate_5_6();
 }
 
 }  // namespace cryptonote
@@ -29,8 +29,10 @@
 #include <atomic>
 
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/tx_compression.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
+#include <boost/optional/optional.hpp>
 #include <boost/thread/tss.hpp>
 
 #include <lmdb.h>
@@ -165,6 +167,32 @@ struct mdb_txn_safe
   static std::atomic_flag creation_gate;
 };
 
+// latency counters behind db_latency_histogram_t, updated concurrently by readers
+struct mdb_latency_counters
+{
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> total_ns;
+  std::atomic<uint64_t> buckets[DB_STATS_LATENCY_BUCKETS];
+
+  mdb_latency_counters() { reset(); }
+  void add(uint64_t ns);
+  void reset();
+  void get(db_latency_histogram_t &histogram) const;
+};
+
+// operation counters behind db_table_stats_t
+struct mdb_table_counters
+{
+  std::atomic<uint64_t> reads;
+  std::atomic<uint64_t> writes;
+  std::atomic<uint64_t> deletes;
+  std::atomic<uint64_t> cursor_opens;
+  mdb_latency_counters latency;
+
+  mdb_table_counters() { reset(); }
+  void reset();
+};
+
 
 // If m_batch_active is set, a batch transaction exists beyond this class, such
 // as a batch import with verification enabled, or possibly (later) a batch
@@ -256,6 +284,7 @@ public:
   virtual bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
   virtual bool get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const;
   virtual bool get_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>>& blocks, bool pruned, bool skip_coinbase, bool get_miner_tx_hash) const;
+  virtual bool for_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, bool pruned, const std::function<bool(uint64_t, const epee::span<const uint8_t>, const cryptonote::block&, std::vector<cryptonote::blobdata>&)> &f) const;
   virtual bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
   virtual bool get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const;
 
@@ -348,6 +377,8 @@ public:
    */
   std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff, uint64_t min_count) const;
 
+  virtual bool get_db_stats(db_stats_t &stats) const;
+
   bool get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const;
 
   // helper functions
@@ -409,6 +440,15 @@ private:
 
   inline void check_open() const;
 
+  // cursor operations, counted and timed per table when DBF_STATS is set
+  inline int lmdb_cursor_get(MDB_cursor *cursor, MDB_val *key, MDB_val *data, MDB_cursor_op op) const;
+  inline int lmdb_cursor_put(MDB_cursor *cursor, MDB_val *key, MDB_val *data, unsigned int flags) const;
+  inline int lmdb_cursor_del(MDB_cursor *cursor, unsigned int flags) const;
+  void count_table_op(MDB_dbi dbi, std::atomic<uint64_t> mdb_table_counters::*counter, uint64_t ns) const;
+  void count_cursor_open(MDB_dbi dbi) const;
+  void count_read_txn() const;
+  void commit_txn(mdb_txn_safe &txn, const std::string &message = "") const;
+
   bool prune_worker(int mode, uint32_t pruning_seed);
 
   virtual bool is_read_only() const;
@@ -441,6 +481,27 @@ private:
   // migrate from DB version 4 to 5
   void migrate_4_5();
 
+  // migrate from DB version 5 to 6
+  void migrate_5_6();
+
+  // load the tx blob compression dictionaries, if any
+  bool load_tx_compression(MDB_txn *txn, bool &pending);
+
+  // convert txs_pruned and txs_prunable to dictionary compressed records
+  void compress_tx_tables();
+
+  // move all records of o_dbi to n_dbis in order, converting their values:
+  // convert sets the value of the record with the same key in each of the
+  // new tables, leaving it unset to write none there. The first new table
+  // must get a record for every old one. Old records are deleted as they
+  // are moved and progress is checkpointed in the properties table, so an
+  // interrupted migration resumes where it stopped. Conversion runs on the
+  // threadpool when parallel is set.
+  typedef std::function<bool(const epee::span<const uint8_t> value, std::vector<boost::optional<std::string>> &converted)> migrate_record_t;
+  void migrate_table(MDB_dbi o_dbi, const std::vector<MDB_dbi> &n_dbis, unsigned int put_flags, const char *name, const migrate_record_t &convert, bool parallel);
+  void compress_tx_table(MDB_dbi o_dbi, MDB_dbi n_dbi, const tx_blob_compressor &compressor, const char *name);
+  bool train_tx_dictionary(MDB_dbi dbi, std::string &dictionary);
+
   void cleanup_batch();
 
 private:
@@ -486,6 +547,17 @@ private:
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
 
+  bool m_compress_txs; // convert tx blobs to compressed records if not done yet
+
+  bool m_stats_enabled; // keep the counters below (DBF_STATS)
+  // indexed by MDB_dbi: the 32 named databases follow LMDB's two core ones
+  mutable mdb_table_counters m_table_counters[34];
+  mutable mdb_latency_counters m_commit_counters;
+  mutable std::atomic<uint64_t> m_read_txns;
+  std::atomic<uint64_t> m_map_resizes;
+  tx_blob_compressor m_txs_pruned_compressor;
+  tx_blob_compressor m_txs_prunable_compressor;
+
 #if defined(__arm__)
   // force a value so it can compile with 32-bit ARM
   constexpr static uint64_t DEFAULT_MAPSIZE = 1LL << 31;
@@ -42,7 +42,7 @@ namespace cryptonote
         m_batch = m_db.batch_start();
         m_active = true;
       }
-      void commit() { try { if (m_batch && m_active) { m_db.batch_stop(); m_active = false; } } catch (const std::exception &e) { MWARNING("LockedTXN::commit filtering exception: " << e.what()); } }
+      bool commit() { try { if (m_batch && m_active) { m_db.batch_stop(); m_active = false; } return true; } catch (const std::exception &e) { MWARNING("LockedTXN::commit filtering exception: " << e.what()); return false; } }
       void abort() { try { if (m_batch && m_active) { m_db.batch_abort(); m_active = false; } } catch (const std::exception &e) { MWARNING("LockedTXN::abort filtering exception: " << e.what()); } }
       ~LockedTXN() { abort(); }
     private:
@@ -0,0 +1,1908 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "db_memory.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cstring>  // memcpy
+
+#include "string_tools.h"
+#include "common/pruning.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "profile_tools.h"
+#include "ringct/rctOps.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db.memory"
+
+using epee::string_tools::pod_to_hex;
+
+namespace
+{
+
+template <typename T>
+inline void throw0(const T &e)
+{
+  LOG_PRINT_L0(e.what());
+  throw e;
+}
+
+template <typename T>
+inline void throw1(const T &e)
+{
+  LOG_PRINT_L1(e.what());
+  throw e;
+}
+
+enum { prune_mode_prune, prune_mode_update, prune_mode_check };
+
+}
+
+namespace cryptonote
+{
+
+BlockchainMemory::BlockchainMemory(bool batch_transactions): BlockchainDB()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  m_folder = "thishsouldnotexistbecauseitisgibberish";
+  m_db_flags = 0;
+  m_write_txn = false;
+  m_batch_transactions = batch_transactions;
+  m_batch_active = false;
+  clear();
+
+  m_hardfork = nullptr;
+}
+
+BlockchainMemory::~BlockchainMemory()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+
+  // batch transaction shouldn't be active at this point. If it is, consider it aborted.
+  if (m_batch_active)
+  {
+    try { batch_abort(); }
+    catch (...) { /* ignore */ }
+  }
+  if (m_open)
+    close();
+}
+
+inline void BlockchainMemory::check_open() const
+{
+  if (!m_open)
+    throw0(DB_ERROR("DB operation attempted on a not-open DB instance"));
+}
+
+void BlockchainMemory::check_writable() const
+{
+  check_open();
+  if (m_db_flags & DBF_RDONLY)
+    throw0(DB_ERROR("Attempted to write to a read-only database"));
+}
+
+void BlockchainMemory::push_undo(std::function<void()> undo)
+{
+  if (m_write_txn && m_writer == boost::this_thread::get_id())
+    m_undo.push_back(std::move(undo));
+}
+
+void BlockchainMemory::rollback()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__ << ": " << m_undo.size() << " changes");
+  while (!m_undo.empty())
+  {
+    m_undo.back()();
+    m_undo.pop_back();
+  }
+}
+
+void BlockchainMemory::clear()
+{
+  m_blocks.clear();
+  m_block_heights.clear();
+  m_txs.clear();
+  m_tx_indices.clear();
+  m_output_txs.clear();
+  m_output_amounts.clear();
+  m_spent_keys.clear();
+  m_txpool.clear();
+  m_alt_blocks.clear();
+  m_hf_versions.clear();
+  m_max_block_size = std::numeric_limits<uint64_t>::max();
+  m_pruning_seed = 0;
+  m_data_size = 0;
+  m_undo.clear();
+}
+
+void BlockchainMemory::open(const std::string& filename, const int db_flags)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+
+  if (m_open)
+    throw0(DB_OPEN_FAILURE("Attempted to open db, but it's already open"));
+
+  if (db_flags & DBF_COMPRESS_TXS)
+    MWARNING("Transaction compression is not supported by the memory database, ignored");
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  m_folder = filename;
+  m_db_flags = db_flags;
+  clear();
+  m_open = true;
+  MGINFO("Using an in-memory database, nothing will be saved to disk");
+}
+
+void BlockchainMemory::close()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  if (m_batch_active)
+  {
+    LOG_PRINT_L3("close() first calling batch_abort() due to active batch transaction");
+    batch_abort();
+  }
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  clear();
+  m_open = false;
+}
+
+void BlockchainMemory::sync()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+}
+
+void BlockchainMemory::safesyncmode(const bool onoff)
+{
+  MINFO("switching safe mode " << (onoff ? "on" : "off") << " (no effect on the memory database)");
+}
+
+void BlockchainMemory::reset()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  clear();
+}
+
+std::vector<std::string> BlockchainMemory::get_filenames() const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  return std::vector<std::string>();
+}
+
+bool BlockchainMemory::remove_data_file(const std::string& folder) const
+{
+  return true;
+}
+
+std::string BlockchainMemory::get_db_name() const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+
+  return std::string("memory");
+}
+
+bool BlockchainMemory::lock()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+  return false;
+}
+
+void BlockchainMemory::unlock()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+}
+
+const BlockchainMemory::block_record &BlockchainMemory::get_block_record(uint64_t height, const char *what) const
+{
+  if (height >= m_blocks.size())
+    throw0(BLOCK_DNE(std::string("Attempt to get ").append(what).append(" from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block not in db").c_str()));
+  return m_blocks[height];
+}
+
+const BlockchainMemory::tx_record *BlockchainMemory::find_tx(const crypto::hash& h) const
+{
+  const auto i = m_tx_indices.find(h);
+  if (i == m_tx_indices.end())
+    return nullptr;
+  return &m_txs[i->second];
+}
+
+const BlockchainMemory::amount_output &BlockchainMemory::get_amount_output(uint64_t amount, uint64_t index) const
+{
+  const auto i = m_output_amounts.find(amount);
+  if (i == m_output_amounts.end() || index >= i->second.size())
+    throw1(OUTPUT_DNE(std::string("Attempting to get output pubkey by index, but key does not exist: amount " +
+        std::to_string(amount) + ", index " + std::to_string(index)).c_str()));
+  return i->second[index];
+}
+
+uint64_t BlockchainMemory::num_outputs() const
+{
+  return m_output_txs.size();
+}
+
+void BlockchainMemory::add_block(const block& blk, size_t block_weight, uint64_t long_term_block_weight, const difficulty_type& cumulative_difficulty, const uint64_t& coins_generated,
+    uint64_t num_rct_outs, const crypto::hash& blk_hash)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const uint64_t m_height = m_blocks.size();
+
+  if (m_block_heights.find(blk_hash) != m_block_heights.end())
+    throw1(BLOCK_EXISTS("Attempting to add block that's already in the db"));
+
+  if (m_height > 0)
+  {
+    const auto parent = m_block_heights.find(blk.prev_id);
+    if (parent == m_block_heights.end())
+    {
+      LOG_PRINT_L3("m_height: " << m_height);
+      LOG_PRINT_L3("parent_key: " << blk.prev_id);
+      throw0(DB_ERROR("Failed to get top block hash to check for new block's parent"));
+    }
+    if (parent->second != m_height - 1)
+      throw0(BLOCK_PARENT_DNE("Top block is not new block's parent"));
+  }
+
+  block_record br;
+  br.blob = block_to_blob(blk);
+  br.hash = blk_hash;
+  br.timestamp = blk.timestamp;
+  br.coins = coins_generated;
+  br.weight = block_weight;
+  br.long_term_weight = long_term_block_weight;
+  br.cum_rct = num_rct_outs + (m_height > 0 ? m_blocks.back().cum_rct : 0);
+  br.cumulative_difficulty = cumulative_difficulty;
+
+  m_data_size += br.blob.size();
+  m_blocks.push_back(std::move(br));
+  m_block_heights.emplace(blk_hash, m_height);
+
+  push_undo([this, blk_hash]() {
+    m_data_size -= m_blocks.back().blob.size();
+    m_blocks.pop_back();
+    m_block_heights.erase(blk_hash);
+  });
+}
+
+void BlockchainMemory::remove_block()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (m_blocks.empty())
+    throw0(BLOCK_DNE ("Attempting to remove block from an empty blockchain"));
+
+  block_record br = std::move(m_blocks.back());
+  m_blocks.pop_back();
+  m_block_heights.erase(br.hash);
+  m_data_size -= br.blob.size();
+
+  push_undo([this, br]() {
+    m_data_size += br.blob.size();
+    m_block_heights.emplace(br.hash, m_blocks.size());
+    m_blocks.push_back(br);
+  });
+}
+
+uint64_t BlockchainMemory::add_transaction_data(const crypto::hash& blk_hash, const std::pair<transaction, blobdata>& txp, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const uint64_t tx_id = m_txs.size();
+
+  const auto i = m_tx_indices.find(tx_hash);
+  if (i != m_tx_indices.end())
+    throw1(TX_EXISTS(std::string("Attempting to add transaction that's already in the db (tx id ").append(boost::lexical_cast<std::string>(i->second)).append(")").c_str()));
+
+  const cryptonote::transaction &tx = txp.first;
+  const cryptonote::blobdata &blob = txp.second;
+
+  unsigned int unprunable_size = tx.unprunable_size;
+  if (unprunable_size == 0)
+  {
+    std::stringstream ss;
+    binary_archive<true> ba(ss);
+    bool r = const_cast<cryptonote::transaction&>(tx).serialize_base(ba);
+    if (!r)
+      throw0(DB_ERROR("Failed to serialize pruned tx"));
+    unprunable_size = ss.str().size();
+  }
+
+  if (unprunable_size > blob.size())
+    throw0(DB_ERROR("pruned tx size is larger than tx size"));
+
+  tx_record tr;
+  tr.hash = tx_hash;
+  tr.data.tx_id = tx_id;
+  tr.data.unlock_time = tx.unlock_time;
+  tr.data.block_id = m_blocks.size();  // we don't need blk_hash since we know the height
+  tr.pruned.assign(blob.data(), unprunable_size);
+  tr.prunable.assign(blob.data() + unprunable_size, blob.size() - unprunable_size);
+  tr.has_prunable = true;
+  tr.has_prunable_hash = tx.version > 1;
+  tr.prunable_hash = tr.has_prunable_hash ? tx_prunable_hash : crypto::null_hash;
+
+  m_data_size += blob.size();
+  m_txs.push_back(std::move(tr));
+  m_tx_indices.emplace(tx_hash, tx_id);
+
+  push_undo([this, tx_hash]() {
+    const tx_record &tr = m_txs.back();
+    m_data_size -= tr.pruned.size() + tr.prunable.size();
+    m_tx_indices.erase(tx_hash);
+    m_txs.pop_back();
+  });
+
+  return tx_id;
+}
+
+void BlockchainMemory::remove_transaction_data(const crypto::hash& tx_hash, const transaction& tx)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_tx_indices.find(tx_hash);
+  if (i == m_tx_indices.end())
+    throw1(TX_DNE("Attempting to remove transaction that isn't in the db"));
+  const uint64_t tx_id = i->second;
+  if (tx_id + 1 != m_txs.size())
+    throw0(DB_ERROR("Attempting to remove a transaction which is not the most recent one"));
+
+  const std::vector<uint64_t> &amount_output_indices = m_txs[tx_id].amount_output_indices;
+  if (amount_output_indices.empty())
+  {
+    if (tx.vout.empty())
+      LOG_PRINT_L2("tx has no outputs, so no output indices");
+    else
+      throw0(DB_ERROR("tx has outputs, but no output indices found"));
+  }
+  else if (amount_output_indices.size() != tx.vout.size())
+    throw0(DB_ERROR("tx has a different number of outputs and output indices"));
+
+  bool is_pseudo_rct = tx.version >= 2 && tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
+  for (size_t i = tx.vout.size(); i-- > 0;)
+  {
+    uint64_t amount = is_pseudo_rct ? 0 : tx.vout[i].amount;
+    remove_output(amount, amount_output_indices[i]);
+  }
+
+  tx_record tr = std::move(m_txs.back());
+  m_txs.pop_back();
+  m_tx_indices.erase(tx_hash);
+  m_data_size -= tr.pruned.size() + tr.prunable.size();
+
+  push_undo([this, tr]() {
+    m_data_size += tr.pruned.size() + tr.prunable.size();
+    m_tx_indices.emplace(tr.hash, m_txs.size());
+    m_txs.push_back(tr);
+  });
+}
+
+uint64_t BlockchainMemory::add_output(const crypto::hash& tx_hash,
+    const tx_out& tx_output,
+    const uint64_t& local_index,
+    const uint64_t unlock_time,
+    const rct::key *commitment)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  if (tx_output.target.type() != typeid(txout_to_key))
+    throw0(DB_ERROR("Wrong output type: expected txout_to_key"));
+  if (tx_output.amount == 0 && !commitment)
+    throw0(DB_ERROR("RCT output without commitment"));
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const uint64_t output_id = num_outputs();
+  m_output_txs.push_back({tx_hash, local_index, true});
+
+  amount_output ao;
+  ao.output_id = output_id;
+  ao.data.pubkey = boost::get<txout_to_key>(tx_output.target).key;
+  ao.data.unlock_time = unlock_time;
+  ao.data.height = m_blocks.size();
+  // pre rct outputs get their commitment computed on lookup, as in LMDB
+  ao.data.commitment = tx_output.amount == 0 ? *commitment : rct::key();
+
+  std::vector<amount_output> &outputs = m_output_amounts[tx_output.amount];
+  const uint64_t amount_index = outputs.size();
+  outputs.push_back(ao);
+
+  const uint64_t amount = tx_output.amount;
+  push_undo([this, amount]() {
+    const auto i = m_output_amounts.find(amount);
+    i->second.pop_back();
+    if (i->second.empty())
+      m_output_amounts.erase(i);
+    m_output_txs.pop_back();
+  });
+
+  return amount_index;
+}
+
+void BlockchainMemory::add_tx_amount_output_indices(const uint64_t tx_id,
+    const std::vector<uint64_t>& amount_output_indices)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (tx_id >= m_txs.size())
+    throw0(DB_ERROR("Failed to add <tx hash, amount output index array>: tx not in db"));
+
+  std::vector<uint64_t> previous = std::move(m_txs[tx_id].amount_output_indices);
+  m_txs[tx_id].amount_output_indices = amount_output_indices;
+
+  push_undo([this, tx_id, previous]() {
+    m_txs[tx_id].amount_output_indices = previous;
+  });
+}
+
+void BlockchainMemory::remove_output(const uint64_t amount, const uint64_t& out_index)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+
+  // called from remove_transaction_data, with the lock held
+  const auto i = m_output_amounts.find(amount);
+  if (i == m_output_amounts.end() || out_index >= i->second.size())
+    throw1(OUTPUT_DNE("Attempting to get an output index by amount and amount index, but amount not found"));
+  if (out_index + 1 != i->second.size())
+    throw0(DB_ERROR(std::string("Error deleting output index ").append(boost::lexical_cast<std::string>(out_index)).append(": not the most recent output for its amount").c_str()));
+
+  const amount_output ao = i->second.back();
+  if (ao.output_id >= m_output_txs.size() || !m_output_txs[ao.output_id].valid)
+    throw0(DB_ERROR("Unexpected: global output index not found in m_output_txs"));
+  const output_tx ot = m_output_txs[ao.output_id];
+
+  i->second.pop_back();
+  if (i->second.empty())
+    m_output_amounts.erase(i);
+  // outputs are removed newest first, but prune_outputs may have left holes below
+  m_output_txs[ao.output_id].valid = false;
+  while (!m_output_txs.empty() && !m_output_txs.back().valid)
+    m_output_txs.pop_back();
+
+  push_undo([this, amount, ao, ot]() {
+    if (m_output_txs.size() <= ao.output_id)
+      m_output_txs.resize(ao.output_id + 1, {crypto::null_hash, 0, false});
+    m_output_txs[ao.output_id] = ot;
+    m_output_amounts[amount].push_back(ao);
+  });
+}
+
+void BlockchainMemory::prune_outputs(uint64_t amount)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  MINFO("Pruning outputs for amount " << amount);
+
+  const auto i = m_output_amounts.find(amount);
+  if (i == m_output_amounts.end())
+    return;
+
+  MINFO(i->second.size() << " outputs found");
+  std::vector<amount_output> outputs = std::move(i->second);
+  m_output_amounts.erase(i);
+  for (const amount_output &ao: outputs)
+  {
+    MDEBUG("output id " << ao.output_id);
+    m_output_txs[ao.output_id].valid = false;
+  }
+
+  push_undo([this, amount, outputs]() {
+    for (const amount_output &ao: outputs)
+      m_output_txs[ao.output_id].valid = true;
+    m_output_amounts[amount] = outputs;
+  });
+}
+
+void BlockchainMemory::add_spent_key(const crypto::key_image& k_image)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (!m_spent_keys.insert(k_image).second)
+    throw1(KEY_IMAGE_EXISTS("Attempting to add spent key image that's already in the db"));
+
+  push_undo([this, k_image]() { m_spent_keys.erase(k_image); });
+}
+
+void BlockchainMemory::remove_spent_key(const crypto::key_image& k_image)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (m_spent_keys.erase(k_image))
+    push_undo([this, k_image]() { m_spent_keys.insert(k_image); });
+}
+
+void BlockchainMemory::add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (!m_txpool.emplace(txid, txpool_record{meta, blob}).second)
+    throw1(DB_ERROR("Attempting to add txpool tx metadata that's already in the db"));
+
+  push_undo([this, txid]() { m_txpool.erase(txid); });
+}
+
+void BlockchainMemory::update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_txpool.find(txid);
+  if (i == m_txpool.end())
+    throw1(DB_ERROR("Error finding txpool tx meta to update"));
+
+  const txpool_tx_meta_t previous = i->second.meta;
+  i->second.meta = meta;
+
+  push_undo([this, txid, previous]() { m_txpool[txid].meta = previous; });
+}
+
+uint64_t BlockchainMemory::get_txpool_tx_count(relay_category category) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (category == relay_category::all)
+    return m_txpool.size();
+
+  uint64_t num_entries = 0;
+  for (const auto &e: m_txpool)
+    if (e.second.meta.matches(category))
+      ++num_entries;
+  return num_entries;
+}
+
+bool BlockchainMemory::txpool_has_tx(const crypto::hash& txid, relay_category tx_category) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_txpool.find(txid);
+  if (i == m_txpool.end())
+    return false;
+  return tx_category == relay_category::all || i->second.meta.matches(tx_category);
+}
+
+void BlockchainMemory::remove_txpool_tx(const crypto::hash& txid)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_txpool.find(txid);
+  if (i == m_txpool.end())
+    return;
+
+  txpool_record tr = std::move(i->second);
+  m_txpool.erase(i);
+
+  push_undo([this, txid, tr]() { m_txpool.emplace(txid, tr); });
+}
+
+bool BlockchainMemory::get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_txpool.find(txid);
+  if (i == m_txpool.end())
+    return false;
+  meta = i->second.meta;
+  return true;
+}
+
+bool BlockchainMemory::get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd, relay_category tx_category) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_txpool.find(txid);
+  if (i == m_txpool.end())
+    return false;
+  if (tx_category != relay_category::all && !i->second.meta.matches(tx_category))
+    return false;
+  bd = i->second.blob;
+  return true;
+}
+
+cryptonote::blobdata BlockchainMemory::get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const
+{
+  cryptonote::blobdata bd;
+  if (!get_txpool_tx_blob(txid, bd, tx_category))
+    throw1(DB_ERROR("Tx not found in txpool: "));
+  return bd;
+}
+
+uint32_t BlockchainMemory::get_blockchain_pruning_seed() const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return m_pruning_seed;
+}
+
+bool BlockchainMemory::prune_worker(int mode, uint32_t pruning_seed)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  const uint32_t log_stripes = tools::get_pruning_log_stripes(pruning_seed);
+  if (log_stripes && log_stripes != CRYPTONOTE_PRUNING_LOG_STRIPES)
+    throw0(DB_ERROR("Pruning seed not in range"));
+  pruning_seed = tools::get_pruning_stripe(pruning_seed);
+  if (pruning_seed > (1ul << CRYPTONOTE_PRUNING_LOG_STRIPES))
+    throw0(DB_ERROR("Pruning seed not in range"));
+  if (mode == prune_mode_check)
+    check_open();
+  else
+    check_writable();
+
+  TIME_MEASURE_START(t);
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const uint32_t previous_seed = m_pruning_seed;
+  if (m_pruning_seed == 0)
+  {
+    // not pruned yet
+    if (mode != prune_mode_prune)
+    {
+      MDEBUG("Pruning not enabled, nothing to do");
+      return true;
+    }
+    if (pruning_seed == 0)
+      pruning_seed = tools::get_random_stripe();
+    pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
+    m_pruning_seed = pruning_seed;
+  }
+  else
+  {
+    // pruned already
+    if (pruning_seed == 0)
+      pruning_seed = tools::get_pruning_stripe(m_pruning_seed);
+    if (tools::get_pruning_stripe(m_pruning_seed) != pruning_seed)
+      throw0(DB_ERROR("Blockchain already pruned with different seed"));
+    if (tools::get_pruning_log_stripes(m_pruning_seed) != CRYPTONOTE_PRUNING_LOG_STRIPES)
+      throw0(DB_ERROR("Blockchain already pruned with different base"));
+    pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
+  }
+  if (previous_seed != m_pruning_seed)
+    push_undo([this, previous_seed]() { m_pruning_seed = previous_seed; });
+
+  if (mode == prune_mode_check)
+    MINFO("Checking blockchain pruning...");
+  else
+    MINFO("Pruning blockchain...");
+
+  // there is no tip table here: each tx knows its height, so the whole
+  // chain is walked every time, which is fast enough in memory
+  size_t n_total_records = 0, n_prunable_records = 0, n_pruned_records = 0;
+  uint64_t n_bytes = 0;
+  const uint64_t blockchain_height = m_blocks.size();
+  for (tx_record &tr: m_txs)
+  {
+    ++n_total_records;
+    const uint64_t block_height = tr.data.block_id;
+    const bool prunable = block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS < blockchain_height &&
+        !tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !cryptonote::is_v1_tx(tr.pruned);
+    if (mode == prune_mode_check)
+    {
+      if (prunable && tr.has_prunable)
+        MERROR("Prunable data found for pruned height " << block_height << "/" << blockchain_height <<
+            ", seed " << epee::string_tools::to_string_hex(pruning_seed));
+      else if (!prunable && !tr.has_prunable)
+        MERROR("Prunable data not found for unpruned height " << block_height << "/" << blockchain_height <<
+            ", seed " << epee::string_tools::to_string_hex(pruning_seed));
+      continue;
+    }
+    if (!prunable)
+      continue;
+    ++n_prunable_records;
+    if (!tr.has_prunable)
+    {
+      MDEBUG("Already pruned at height " << block_height << "/" << blockchain_height);
+      continue;
+    }
+    MDEBUG("Pruning at height " << block_height << "/" << blockchain_height);
+    ++n_pruned_records;
+    n_bytes += tr.prunable.size();
+    m_data_size -= tr.prunable.size();
+    cryptonote::blobdata prunable_blob;
+    prunable_blob.swap(tr.prunable);
+    tr.has_prunable = false;
+    const uint64_t tx_id = tr.data.tx_id;
+    push_undo([this, tx_id, prunable_blob]() {
+      tx_record &tr = m_txs[tx_id];
+      m_data_size += prunable_blob.size();
+      tr.prunable = prunable_blob;
+      tr.has_prunable = true;
+    });
+  }
+
+  TIME_MEASURE_FINISH(t);
+
+  MINFO((mode == prune_mode_check ? "Checked" : "Pruned") << " blockchain in " <<
+      t << " ms: " << (n_bytes/1024.0f/1024.0f) << " MB pruned in " <<
+      n_pruned_records << " records, " << n_prunable_records << "/" << n_total_records << " pruned records");
+  return true;
+}
+
+bool BlockchainMemory::prune_blockchain(uint32_t pruning_seed)
+{
+  return prune_worker(prune_mode_prune, pruning_seed);
+}
+
+bool BlockchainMemory::update_pruning()
+{
+  return prune_worker(prune_mode_update, 0);
+}
+
+bool BlockchainMemory::check_pruning()
+{
+  return prune_worker(prune_mode_check, 0);
+}
+
+bool BlockchainMemory::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob, relay_category category) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (const auto &e: m_txpool)
+  {
+    if (!e.second.meta.matches(category))
+      continue;
+    if (!f(e.first, e.second.meta, include_blob ? &e.second.blob : NULL))
+      return false;
+  }
+  return true;
+}
+
+bool BlockchainMemory::for_all_alt_blocks(std::function<bool(const crypto::hash&, const alt_block_data_t&, const cryptonote::blobdata*)> f, bool include_blob) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (const auto &e: m_alt_blocks)
+  {
+    if (!f(e.first, e.second.data, include_blob ? &e.second.blob : NULL))
+      return false;
+  }
+  return true;
+}
+
+bool BlockchainMemory::block_exists(const crypto::hash& h, uint64_t *height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_block_heights.find(h);
+  if (i == m_block_heights.end())
+  {
+    LOG_PRINT_L3("Block with hash " << epee::string_tools::pod_to_hex(h) << " not found in db");
+    return false;
+  }
+  if (height)
+    *height = i->second;
+  return true;
+}
+
+cryptonote::blobdata BlockchainMemory::get_block_blob(const crypto::hash& h) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_blob_from_height(get_block_height(h));
+}
+
+uint64_t BlockchainMemory::get_block_height(const crypto::hash& h) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_block_heights.find(h);
+  if (i == m_block_heights.end())
+    throw1(BLOCK_DNE("Attempted to retrieve non-existent block height"));
+  return i->second;
+}
+
+block_header BlockchainMemory::get_block_header(const crypto::hash& h) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  // block_header object is automatically cast from block object
+  return get_block(h);
+}
+
+cryptonote::blobdata BlockchainMemory::get_block_blob_from_height(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_record(height, "block").blob;
+}
+
+std::vector<uint64_t> BlockchainMemory::get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  std::vector<uint64_t> res;
+  res.reserve(heights.size());
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (uint64_t height: heights)
+    res.push_back(get_block_record(height, "rct distribution").cum_rct);
+  return res;
+}
+
+uint64_t BlockchainMemory::get_block_timestamp(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_record(height, "timestamp").timestamp;
+}
+
+uint64_t BlockchainMemory::get_top_block_timestamp() const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  // if no blocks, return 0
+  if (m_blocks.empty())
+    return 0;
+  return m_blocks.back().timestamp;
+}
+
+size_t BlockchainMemory::get_block_weight(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_record(height, "block weight").weight;
+}
+
+std::vector<uint64_t> BlockchainMemory::get_block_weights(uint64_t start_height, size_t count) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (start_height >= m_blocks.size())
+    throw0(DB_ERROR(("Height " + std::to_string(start_height) + " not in blockchain").c_str()));
+
+  std::vector<uint64_t> ret;
+  ret.reserve(count);
+  for (uint64_t height = start_height; height < m_blocks.size() && count--; ++height)
+    ret.push_back(m_blocks[height].weight);
+  return ret;
+}
+
+std::vector<uint64_t> BlockchainMemory::get_long_term_block_weights(uint64_t start_height, size_t count) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (start_height >= m_blocks.size())
+    throw0(DB_ERROR(("Height " + std::to_string(start_height) + " not in blockchain").c_str()));
+
+  std::vector<uint64_t> ret;
+  ret.reserve(count);
+  for (uint64_t height = start_height; height < m_blocks.size() && count--; ++height)
+    ret.push_back(m_blocks[height].long_term_weight);
+  return ret;
+}
+
+uint64_t BlockchainMemory::get_max_block_size()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return m_max_block_size;
+}
+
+void BlockchainMemory::add_max_block_size(uint64_t sz)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const uint64_t previous = m_max_block_size;
+  // unset is stored as max, as LMDB returns max when the property is missing
+  uint64_t max_block_size = previous == std::numeric_limits<uint64_t>::max() ? 0 : previous;
+  if (sz > max_block_size)
+    max_block_size = sz;
+  m_max_block_size = max_block_size;
+
+  push_undo([this, previous]() { m_max_block_size = previous; });
+}
+
+difficulty_type BlockchainMemory::get_block_cumulative_difficulty(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__ << "  height: " << height);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_record(height, "cumulative difficulty").cumulative_difficulty;
+}
+
+difficulty_type BlockchainMemory::get_block_difficulty(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  difficulty_type diff1 = get_block_record(height, "difficulty").cumulative_difficulty;
+  difficulty_type diff2 = height ? m_blocks[height - 1].cumulative_difficulty : 0;
+  return diff1 - diff2;
+}
+
+uint64_t BlockchainMemory::get_block_already_generated_coins(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_record(height, "generated coins").coins;
+}
+
+uint64_t BlockchainMemory::get_block_long_term_weight(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_record(height, "block long term weight").long_term_weight;
+}
+
+crypto::hash BlockchainMemory::get_block_hash_from_height(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return get_block_record(height, "hash").hash;
+}
+
+std::vector<block> BlockchainMemory::get_blocks_range(const uint64_t& h1, const uint64_t& h2) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+  std::vector<block> v;
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (uint64_t height = h1; height <= h2; ++height)
+  {
+    v.push_back(get_block_from_height(height));
+  }
+
+  return v;
+}
+
+std::vector<crypto::hash> BlockchainMemory::get_hashes_range(const uint64_t& h1, const uint64_t& h2) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+  std::vector<crypto::hash> v;
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (uint64_t height = h1; height <= h2; ++height)
+  {
+    v.push_back(get_block_record(height, "hash").hash);
+  }
+
+  return v;
+}
+
+crypto::hash BlockchainMemory::top_block_hash(uint64_t *block_height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (block_height)
+    *block_height = m_blocks.size() - 1;
+  if (!m_blocks.empty())
+    return m_blocks.back().hash;
+
+  return crypto::null_hash;
+}
+
+block BlockchainMemory::get_top_block() const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (!m_blocks.empty())
+  {
+    return get_block_from_height(m_blocks.size() - 1);
+  }
+
+  block b;
+  return b;
+}
+
+uint64_t BlockchainMemory::height() const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return m_blocks.size();
+}
+
+bool BlockchainMemory::tx_exists(const crypto::hash& h) const
+{
+  uint64_t tx_id;
+  return tx_exists(h, tx_id);
+}
+
+bool BlockchainMemory::tx_exists(const crypto::hash& h, uint64_t& tx_id) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  TIME_MEASURE_START(time1);
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_tx_indices.find(h);
+  const bool found = i != m_tx_indices.end();
+  if (found)
+    tx_id = i->second;
+  TIME_MEASURE_FINISH(time1);
+  time_tx_exists += time1;
+
+  if (!found)
+    LOG_PRINT_L1("transaction with hash " << epee::string_tools::pod_to_hex(h) << " not found in db");
+  return found;
+}
+
+uint64_t BlockchainMemory::get_tx_unlock_time(const crypto::hash& h) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const tx_record *tr = find_tx(h);
+  if (!tr)
+    throw1(TX_DNE(std::string("tx data with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
+  return tr->data.unlock_time;
+}
+
+bool BlockchainMemory::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const tx_record *tr = find_tx(h);
+  if (!tr || !tr->has_prunable)
+    return false;
+  bd.reserve(tr->pruned.size() + tr->prunable.size());
+  bd = tr->pruned;
+  bd.append(tr->prunable);
+  return true;
+}
+
+bool BlockchainMemory::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const tx_record *tr = find_tx(h);
+  if (!tr)
+    return false;
+  bd = tr->pruned;
+  return true;
+}
+
+bool BlockchainMemory::get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  if (!count)
+    return true;
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_tx_indices.find(h);
+  if (i == m_tx_indices.end())
+    return false;
+
+  bd.reserve(bd.size() + count);
+  for (uint64_t tx_id = i->second; count--; ++tx_id)
+  {
+    if (tx_id >= m_txs.size())
+      return false;
+    bd.push_back(m_txs[tx_id].pruned);
+  }
+  return true;
+}
+
+bool BlockchainMemory::get_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>>& blocks, bool pruned, bool skip_coinbase, bool get_miner_tx_hash) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  blocks.reserve(std::min<size_t>(max_count, 10000)); // guard against very large max count if only checking bytes
+  const uint64_t blockchain_height = m_blocks.size();
+  uint64_t size = 0;
+  uint64_t tx_id = 0;
+  for (uint64_t h = start_height; h < blockchain_height && blocks.size() < max_count && (size < max_size || blocks.size() < min_count); ++h)
+  {
+    blocks.resize(blocks.size() + 1);
+    auto &current_block = blocks.back();
+
+    current_block.first.first = m_blocks[h].blob;
+    size += current_block.first.first.size();
+
+    cryptonote::block b;
+    if (!parse_and_validate_block_from_blob(current_block.first.first, b))
+      throw0(DB_ERROR("Invalid block"));
+    const crypto::hash miner_tx_hash = cryptonote::get_transaction_hash(b.miner_tx);
+    current_block.first.second = get_miner_tx_hash ? miner_tx_hash : crypto::null_hash;
+
+    // get the tx_id for the first tx (the first block's coinbase tx),
+    // the txes of the following blocks come right after it
+    if (h == start_height)
+    {
+      const auto i = m_tx_indices.find(miner_tx_hash);
+      if (i == m_tx_indices.end())
+        throw0(DB_ERROR("Error attempting to retrieve block coinbase transaction from the db"));
+      tx_id = i->second;
+    }
+
+    if (tx_id + b.tx_hashes.size() >= m_txs.size())
+      throw0(DB_ERROR("Error attempting to retrieve transaction data from the db"));
+
+    current_block.second.reserve(b.tx_hashes.size() + (skip_coinbase ? 0 : 1));
+    for (size_t n = skip_coinbase ? 1 : 0; n <= b.tx_hashes.size(); ++n)
+    {
+      const tx_record &tr = m_txs[tx_id + n];
+      if (!pruned && !tr.has_prunable)
+        throw0(DB_ERROR("Error attempting to retrieve transaction data from the db: prunable data not found"));
+      cryptonote::blobdata tx_blob;
+      tx_blob.reserve(tr.pruned.size() + (pruned ? 0 : tr.prunable.size()));
+      tx_blob = tr.pruned;
+      if (!pruned)
+        tx_blob.append(tr.prunable);
+      current_block.second.push_back(std::make_pair(n ? b.tx_hashes[n - 1] : miner_tx_hash, std::move(tx_blob)));
+      size += current_block.second.back().second.size();
+    }
+    tx_id += b.tx_hashes.size() + 1;
+  }
+
+  return true;
+}
+
+bool BlockchainMemory::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const tx_record *tr = find_tx(h);
+  if (!tr || !tr->has_prunable)
+    return false;
+  bd = tr->prunable;
+  return true;
+}
+
+bool BlockchainMemory::get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const tx_record *tr = find_tx(tx_hash);
+  if (!tr || !tr->has_prunable_hash)
+    return false;
+  prunable_hash = tr->prunable_hash;
+  return true;
+}
+
+uint64_t BlockchainMemory::get_tx_count() const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return m_txs.size();
+}
+
+std::vector<transaction> BlockchainMemory::get_tx_list(const std::vector<crypto::hash>& hlist) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+  std::vector<transaction> v;
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (auto& h : hlist)
+  {
+    v.push_back(get_tx(h));
+  }
+
+  return v;
+}
+
+uint64_t BlockchainMemory::get_tx_block_height(const crypto::hash& h) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const tx_record *tr = find_tx(h);
+  if (!tr)
+    throw1(TX_DNE(std::string("tx_data_t with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
+  return tr->data.block_id;
+}
+
+uint64_t BlockchainMemory::get_num_outputs(const uint64_t& amount) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_output_amounts.find(amount);
+  return i == m_output_amounts.end() ? 0 : i->second.size();
+}
+
+output_data_t BlockchainMemory::get_output_key(const uint64_t& amount, const uint64_t& index, bool include_commitmemt) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  output_data_t ret = get_amount_output(amount, index).data;
+  if (amount != 0 && include_commitmemt)
+    ret.commitment = rct::zeroCommit(amount);
+  return ret;
+}
+
+void BlockchainMemory::get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial) const
+{
+  if (amounts.size() != 1 && amounts.size() != offsets.size())
+    throw0(DB_ERROR("Invalid sizes of amounts and offsets"));
+
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  TIME_MEASURE_START(db3);
+  check_open();
+  outputs.clear();
+  outputs.reserve(offsets.size());
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const std::vector<amount_output> *amount_outputs = NULL;
+  for (size_t i = 0; i < offsets.size(); ++i)
+  {
+    const uint64_t amount = amounts.size() == 1 ? amounts[0] : amounts[i];
+    if (i == 0 || amounts.size() != 1)
+    {
+      const auto it = m_output_amounts.find(amount);
+      amount_outputs = it == m_output_amounts.end() ? NULL : &it->second;
+    }
+
+    if (!amount_outputs || offsets[i] >= amount_outputs->size())
+    {
+      if (allow_partial)
+      {
+        MDEBUG("Partial result: " << outputs.size() << "/" << offsets.size());
+        break;
+      }
+      throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + boost::lexical_cast<std::string>(amount) + ", index " + boost::lexical_cast<std::string>(offsets[i]) + ", count " + boost::lexical_cast<std::string>(amount_outputs ? amount_outputs->size() : 0) + "), but key does not exist (current height " + boost::lexical_cast<std::string>(m_blocks.size()) + ")").c_str()));
+    }
+
+    outputs.push_back((*amount_outputs)[offsets[i]].data);
+    if (amount != 0)
+      outputs.back().commitment = rct::zeroCommit(amount);
+  }
+
+  TIME_MEASURE_FINISH(db3);
+  LOG_PRINT_L3("db3: " << db3);
+}
+
+tx_out_index BlockchainMemory::get_output_tx_and_index_from_global(const uint64_t& output_id) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (output_id >= m_output_txs.size() || !m_output_txs[output_id].valid)
+    throw1(OUTPUT_DNE("output with given index not in db"));
+  const output_tx &ot = m_output_txs[output_id];
+  return tx_out_index(ot.tx_hash, ot.local_index);
+}
+
+tx_out_index BlockchainMemory::get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  std::vector < uint64_t > offsets;
+  std::vector<tx_out_index> indices;
+  offsets.push_back(index);
+  get_output_tx_and_index(amount, offsets, indices);
+  if (!indices.size())
+    throw1(OUTPUT_DNE("Attempting to get an output index by amount and amount index, but amount not found"));
+
+  return indices[0];
+}
+
+void BlockchainMemory::get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+  indices.clear();
+  indices.reserve(offsets.size());
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_output_amounts.find(amount);
+  for (const uint64_t &index : offsets)
+  {
+    if (i == m_output_amounts.end() || index >= i->second.size())
+      throw1(OUTPUT_DNE("Attempting to get output by index, but key does not exist"));
+    const output_tx &ot = m_output_txs[i->second[index].output_id];
+    indices.push_back(tx_out_index(ot.tx_hash, ot.local_index));
+  }
+}
+
+std::vector<std::vector<uint64_t>> BlockchainMemory::get_tx_amount_output_indices(uint64_t tx_id, size_t n_txes) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  std::vector<std::vector<uint64_t>> amount_output_indices_set;
+  amount_output_indices_set.reserve(n_txes);
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  while (n_txes-- > 0)
+  {
+    if (tx_id >= m_txs.size())
+      throw0(DB_ERROR("DB error attempting to get data for tx_outputs[tx_index]"));
+    amount_output_indices_set.push_back(m_txs[tx_id++].amount_output_indices);
+  }
+  return amount_output_indices_set;
+}
+
+bool BlockchainMemory::has_key_image(const crypto::key_image& img) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return m_spent_keys.find(img) != m_spent_keys.end();
+}
+
+bool BlockchainMemory::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (const crypto::key_image &k_image: m_spent_keys)
+    if (!f(k_image))
+      return false;
+  return true;
+}
+
+bool BlockchainMemory::for_blocks_range(const uint64_t& h1, const uint64_t& h2, std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> f) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (uint64_t height = h1; height < m_blocks.size(); ++height)
+  {
+    block b;
+    if (!parse_and_validate_block_from_blob(m_blocks[height].blob, b))
+      throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
+    if (!f(height, m_blocks[height].hash, b))
+      return false;
+    if (height >= h2)
+      break;
+  }
+  return true;
+}
+
+bool BlockchainMemory::for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)> f, bool pruned) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (size_t tx_id = 0; tx_id < m_txs.size(); ++tx_id)
+  {
+    const tx_record &tr = m_txs[tx_id];
+    transaction tx;
+    if (pruned)
+    {
+      if (!parse_and_validate_tx_base_from_blob(tr.pruned, tx))
+        throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+    }
+    else
+    {
+      if (!tr.has_prunable)
+        throw0(DB_ERROR("Failed to get prunable tx data the db"));
+      if (!parse_and_validate_tx_from_blob(tr.pruned + tr.prunable, tx))
+        throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+    }
+    if (!f(tr.hash, tx))
+      return false;
+  }
+  return true;
+}
+
+bool BlockchainMemory::for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  for (const auto &e: m_output_amounts)
+  {
+    for (const amount_output &ao: e.second)
+    {
+      const output_tx &ot = m_output_txs[ao.output_id];
+      if (!f(e.first, ot.tx_hash, ao.data.height, ot.local_index))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool BlockchainMemory::for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_output_amounts.find(amount);
+  if (i == m_output_amounts.end())
+    return true;
+  for (const amount_output &ao: i->second)
+    if (!f(ao.data.height))
+      return false;
+  return true;
+}
+
+bool BlockchainMemory::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  if (! m_batch_transactions)
+    throw0(DB_ERROR("batch transactions not enabled"));
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (m_batch_active)
+    return false;
+  if (m_write_txn)
+    throw0(DB_ERROR("batch transaction attempted, but m_write_txn already in use"));
+
+  m_writer = boost::this_thread::get_id();
+  m_write_txn = true;
+  m_batch_active = true;
+  m_undo.clear();
+
+  LOG_PRINT_L3("batch transaction: begin");
+  return true;
+}
+
+void BlockchainMemory::batch_stop()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  if (! m_batch_transactions)
+    throw0(DB_ERROR("batch transactions not enabled"));
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (! m_batch_active)
+    throw1(DB_ERROR("batch transaction not in progress"));
+  if (m_writer != boost::this_thread::get_id())
+    throw1(DB_ERROR("batch transaction owned by other thread"));
+
+  m_undo.clear();
+  m_write_txn = false;
+  m_batch_active = false;
+  LOG_PRINT_L3("batch transaction: end");
+}
+
+void BlockchainMemory::batch_abort()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  if (! m_batch_transactions)
+    throw0(DB_ERROR("batch transactions not enabled"));
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (! m_batch_active)
+    throw1(DB_ERROR("batch transaction not in progress"));
+  if (m_writer != boost::this_thread::get_id())
+    throw1(DB_ERROR("batch transaction owned by other thread"));
+
+  rollback();
+  m_write_txn = false;
+  m_batch_active = false;
+  LOG_PRINT_L3("batch transaction: aborted");
+}
+
+void BlockchainMemory::set_batch_transactions(bool batch_transactions)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  if ((batch_transactions) && (m_batch_transactions))
+  {
+    MINFO("batch transaction mode already enabled, but asked to enable batch mode");
+  }
+  m_batch_transactions = batch_transactions;
+  MINFO("batch transactions " << (m_batch_transactions ? "enabled" : "disabled"));
+}
+
+void BlockchainMemory::block_wtxn_start()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (! m_batch_active && m_write_txn)
+    throw0(DB_ERROR_TXN_START((std::string("Attempted to start new write txn when write txn already exists in ")+__FUNCTION__).c_str()));
+  if (! m_batch_active)
+  {
+    m_writer = boost::this_thread::get_id();
+    m_write_txn = true;
+    m_undo.clear();
+  }
+  else if (m_writer != boost::this_thread::get_id())
+    throw0(DB_ERROR_TXN_START((std::string("Attempted to start new write txn when batch txn already exists in ")+__FUNCTION__).c_str()));
+}
+
+void BlockchainMemory::block_wtxn_stop()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (!m_write_txn)
+    throw0(DB_ERROR_TXN_START((std::string("Attempted to stop write txn when no such txn exists in ")+__FUNCTION__).c_str()));
+  if (m_writer != boost::this_thread::get_id())
+    throw0(DB_ERROR_TXN_START((std::string("Attempted to stop write txn from the wrong thread in ")+__FUNCTION__).c_str()));
+  if (! m_batch_active)
+  {
+    m_undo.clear();
+    m_write_txn = false;
+  }
+}
+
+void BlockchainMemory::block_wtxn_abort()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (!m_write_txn)
+    throw0(DB_ERROR_TXN_START((std::string("Attempted to abort write txn when no such txn exists in ")+__FUNCTION__).c_str()));
+  if (m_writer != boost::this_thread::get_id())
+    throw0(DB_ERROR_TXN_START((std::string("Attempted to abort write txn from the wrong thread in ")+__FUNCTION__).c_str()));
+
+  if (! m_batch_active)
+  {
+    rollback();
+    m_write_txn = false;
+  }
+}
+
+bool BlockchainMemory::block_rtxn_start() const
+{
+  // reads always see the latest data, there is no snapshot to set up
+  return false;
+}
+
+void BlockchainMemory::block_rtxn_stop() const
+{
+}
+
+void BlockchainMemory::block_rtxn_abort() const
+{
+}
+
+uint64_t BlockchainMemory::add_block(const std::pair<block, blobdata>& blk, size_t block_weight, uint64_t long_term_block_weight, const difficulty_type& cumulative_difficulty, const uint64_t& coins_generated,
+    const std::vector<std::pair<transaction, blobdata>>& txs)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  BlockchainDB::add_block(blk, block_weight, long_term_block_weight, cumulative_difficulty, coins_generated, txs);
+
+  return height();
+}
+
+void BlockchainMemory::pop_block(block& blk, std::vector<transaction>& txs)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  block_wtxn_start();
+
+  try
+  {
+    BlockchainDB::pop_block(blk, txs);
+    block_wtxn_stop();
+  }
+  catch (...)
+  {
+    block_wtxn_abort();
+    throw;
+  }
+}
+
+std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainMemory::get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff, uint64_t min_count) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> histogram;
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (amounts.empty())
+  {
+    for (const auto &e: m_output_amounts)
+      if (e.second.size() >= min_count)
+        histogram[e.first] = std::make_tuple(e.second.size(), 0, 0);
+  }
+  else
+  {
+    for (const auto &amount: amounts)
+    {
+      const auto i = m_output_amounts.find(amount);
+      const uint64_t num_elems = i == m_output_amounts.end() ? 0 : i->second.size();
+      if (num_elems >= min_count)
+        histogram[amount] = std::make_tuple(num_elems, 0, 0);
+    }
+  }
+
+  if (unlocked || recent_cutoff > 0) {
+    const uint64_t blockchain_height = m_blocks.size();
+    for (auto &e: histogram) {
+      const auto i = m_output_amounts.find(e.first);
+      if (i == m_output_amounts.end())
+        continue;
+      const std::vector<amount_output> &outputs = i->second;
+      uint64_t num_elems = std::get<0>(e.second);
+      while (num_elems > 0) {
+        const uint64_t height = outputs[num_elems - 1].data.height;
+        if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height)
+          break;
+        --num_elems;
+      }
+      std::get<1>(e.second) = num_elems;
+
+      if (recent_cutoff > 0)
+      {
+        uint64_t recent = 0;
+        while (num_elems > 0) {
+          const uint64_t height = outputs[num_elems - 1].data.height;
+          if (m_blocks[height].timestamp < recent_cutoff)
+            break;
+          --num_elems;
+          ++recent;
+        }
+        std::get<2>(e.second) = recent;
+      }
+    }
+  }
+
+  return histogram;
+}
+
+bool BlockchainMemory::get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  distribution.clear();
+  const uint64_t db_height = m_blocks.size();
+  if (from_height >= db_height)
+    return false;
+  distribution.resize(db_height - from_height, 0);
+
+  base = 0;
+  const auto i = m_output_amounts.find(amount);
+  if (i != m_output_amounts.end())
+  {
+    for (const amount_output &ao: i->second)
+    {
+      const uint64_t height = ao.data.height;
+      if (height >= from_height)
+        distribution[height - from_height]++;
+      else
+        base++;
+      if (to_height > 0 && height > to_height)
+        break;
+    }
+  }
+
+  distribution[0] += base;
+  for (size_t n = 1; n < distribution.size(); ++n)
+    distribution[n] += distribution[n - 1];
+  base = 0;
+
+  return true;
+}
+
+void BlockchainMemory::check_hard_fork_info()
+{
+}
+
+void BlockchainMemory::drop_hard_fork_info()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  std::vector<uint8_t> previous;
+  previous.swap(m_hf_versions);
+
+  push_undo([this, previous]() { m_hf_versions = previous; });
+}
+
+void BlockchainMemory::set_hard_fork_version(uint64_t height, uint8_t version)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const size_t previous_size = m_hf_versions.size();
+  if (height >= previous_size)
+    m_hf_versions.resize(height + 1, 0);
+  const uint8_t previous = m_hf_versions[height];
+  m_hf_versions[height] = version;
+
+  push_undo([this, height, previous, previous_size]() {
+    m_hf_versions[height] = previous;
+    m_hf_versions.resize(previous_size);
+  });
+}
+
+uint8_t BlockchainMemory::get_hard_fork_version(uint64_t height) const
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (height >= m_hf_versions.size() || m_hf_versions[height] == 0)
+    throw0(DB_ERROR(("Error attempting to retrieve a hard fork version at height " + boost::lexical_cast<std::string>(height) + " from the db").c_str()));
+  return m_hf_versions[height];
+}
+
+void BlockchainMemory::add_alt_block(const crypto::hash &blkid, const cryptonote::alt_block_data_t &data, const cryptonote::blobdata &blob)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  if (!m_alt_blocks.emplace(blkid, alt_block_record{data, blob}).second)
+    throw1(DB_ERROR("Attempting to add alternate block that's already in the db"));
+
+  push_undo([this, blkid]() { m_alt_blocks.erase(blkid); });
+}
+
+bool BlockchainMemory::get_alt_block(const crypto::hash &blkid, alt_block_data_t *data, cryptonote::blobdata *blob)
+{
+  LOG_PRINT_L3("BlockchainMemory:: " << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_alt_blocks.find(blkid);
+  if (i == m_alt_blocks.end())
+    return false;
+  if (data)
+    *data = i->second.data;
+  if (blob)
+    *blob = i->second.blob;
+  return true;
+}
+
+void BlockchainMemory::remove_alt_block(const crypto::hash &blkid)
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  const auto i = m_alt_blocks.find(blkid);
+  if (i == m_alt_blocks.end())
+    throw0(DB_ERROR(("Error locating alternate block " + epee::string_tools::pod_to_hex(blkid) + " in the db").c_str()));
+
+  alt_block_record ab = std::move(i->second);
+  m_alt_blocks.erase(i);
+
+  push_undo([this, blkid, ab]() { m_alt_blocks.emplace(blkid, ab); });
+}
+
+uint64_t BlockchainMemory::get_alt_block_count()
+{
+  LOG_PRINT_L3("BlockchainMemory:: " << __func__);
+  check_open();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  return m_alt_blocks.size();
+}
+
+void BlockchainMemory::drop_alt_blocks()
+{
+  LOG_PRINT_L3("BlockchainMemory::" << __func__);
+  check_writable();
+
+  CRITICAL_REGION_LOCAL(m_lock);
+  std::unordered_map<crypto::hash, alt_block_record> previous;
+  previous.swap(m_alt_blocks);
+
+  push_undo([this, previous]() { m_alt_blocks = previous; });
+}
+
+bool BlockchainMemory::is_read_only() const
+{
+  return m_db_flags & DBF_RDONLY;
+}
+
+uint64_t BlockchainMemory::get_database_size() const
+{
+  CRITICAL_REGION_LOCAL(m_lock);
+  return m_data_size;
+}
+
+}  // namespace cryptonote
@@ -0,0 +1,370 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <boost/thread/thread.hpp>
+
+#include "blockchain_db/blockchain_db.h"
+#include "cryptonote_basic/blobdatatype.h" // for type blobdata
+#include "syncobj.h"
+
+namespace cryptonote
+{
+
+/**
+ * @brief A BlockchainDB held entirely in memory
+ *
+ * Every table of the LMDB schema has an in-memory counterpart. Blocks,
+ * transactions and global output ids are dense and only ever appended or
+ * popped from the top, so they live in vectors indexed by height/id, with
+ * hash maps on the side for lookups by hash. Outputs of each amount are a
+ * vector indexed by amount index, like the duplicate lists in LMDB.
+ *
+ * A single recursive lock guards all tables, so the callbacks of the
+ * for_all_* iterators may call back into the db. Write transactions are
+ * emulated with an undo log: mutations done by the thread owning the write
+ * (or batch) transaction record their inverse, which is replayed on abort
+ * and dropped on commit. Readers on other threads are not isolated from an
+ * uncommitted write transaction; Blockchain and tx_memory_pool serialize
+ * access above the db anyway.
+ *
+ * Nothing is persisted: the database is empty after open(), and gone after
+ * close().
+ */
+class BlockchainMemory : public BlockchainDB
+{
+public:
+  BlockchainMemory(bool batch_transactions=true);
+  ~BlockchainMemory();
+
+  virtual void open(const std::string& filename, const int db_flags=0);
+
+  virtual void close();
+
+  virtual void sync();
+
+  virtual void safesyncmode(const bool onoff);
+
+  virtual void reset();
+
+  virtual std::vector<std::string> get_filenames() const;
+
+  virtual bool remove_data_file(const std::string& folder) const;
+
+  virtual std::string get_db_name() const;
+
+  virtual bool lock();
+
+  virtual void unlock();
+
+  virtual bool block_exists(const crypto::hash& h, uint64_t *height = NULL) const;
+
+  virtual uint64_t get_block_height(const crypto::hash& h) const;
+
+  virtual block_header get_block_header(const crypto::hash& h) const;
+
+  virtual cryptonote::blobdata get_block_blob(const crypto::hash& h) const;
+
+  virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t& height) const;
+
+  virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const;
+
+  virtual uint64_t get_block_timestamp(const uint64_t& height) const;
+
+  virtual uint64_t get_top_block_timestamp() const;
+
+  virtual size_t get_block_weight(const uint64_t& height) const;
+
+  virtual std::vector<uint64_t> get_block_weights(uint64_t start_height, size_t count) const;
+
+  virtual difficulty_type get_block_cumulative_difficulty(const uint64_t& height) const;
+
+  virtual difficulty_type get_block_difficulty(const uint64_t& height) const;
+
+  virtual uint64_t get_block_already_generated_coins(const uint64_t& height) const;
+
+  virtual uint64_t get_block_long_term_weight(const uint64_t& height) const;
+
+  virtual std::vector<uint64_t> get_long_term_block_weights(uint64_t start_height, size_t count) const;
+
+  virtual crypto::hash get_block_hash_from_height(const uint64_t& height) const;
+
+  virtual std::vector<block> get_blocks_range(const uint64_t& h1, const uint64_t& h2) const;
+
+  virtual std::vector<crypto::hash> get_hashes_range(const uint64_t& h1, const uint64_t& h2) const;
+
+  virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const;
+
+  virtual block get_top_block() const;
+
+  virtual uint64_t height() const;
+
+  virtual bool tx_exists(const crypto::hash& h) const;
+  virtual bool tx_exists(const crypto::hash& h, uint64_t& tx_index) const;
+
+  virtual uint64_t get_tx_unlock_time(const crypto::hash& h) const;
+
+  virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const;
+  virtual bool get_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>>& blocks, bool pruned, bool skip_coinbase, bool get_miner_tx_hash) const;
+  virtual bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual bool get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const;
+
+  virtual uint64_t get_tx_count() const;
+
+  virtual std::vector<transaction> get_tx_list(const std::vector<crypto::hash>& hlist) const;
+
+  virtual uint64_t get_tx_block_height(const crypto::hash& h) const;
+
+  virtual uint64_t get_num_outputs(const uint64_t& amount) const;
+
+  virtual output_data_t get_output_key(const uint64_t& amount, const uint64_t& index, bool include_commitmemt) const;
+  virtual void get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial = false) const;
+
+  virtual tx_out_index get_output_tx_and_index_from_global(const uint64_t& index) const;
+
+  virtual tx_out_index get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const;
+  virtual void get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const;
+
+  virtual std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_id, size_t n_txes) const;
+
+  virtual bool has_key_image(const crypto::key_image& img) const;
+
+  virtual void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t& meta);
+  virtual void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t& meta);
+  virtual uint64_t get_txpool_tx_count(relay_category category = relay_category::broadcasted) const;
+  virtual bool txpool_has_tx(const crypto::hash &txid, relay_category tx_category) const;
+  virtual void remove_txpool_tx(const crypto::hash& txid);
+  virtual bool get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const;
+  virtual bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata& bd, relay_category tx_category) const;
+  virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
+  virtual uint32_t get_blockchain_pruning_seed() const;
+  virtual bool prune_blockchain(uint32_t pruning_seed = 0);
+  virtual bool update_pruning();
+  virtual bool check_pruning();
+
+  virtual void add_alt_block(const crypto::hash &blkid, const cryptonote::alt_block_data_t &data, const cryptonote::blobdata &blob);
+  virtual bool get_alt_block(const crypto::hash &blkid, alt_block_data_t *data, cryptonote::blobdata *blob);
+  virtual void remove_alt_block(const crypto::hash &blkid);
+  virtual uint64_t get_alt_block_count();
+  virtual void drop_alt_blocks();
+
+  virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob = false, relay_category category = relay_category::broadcasted) const;
+
+  virtual bool for_all_key_images(std::function<bool(const crypto::key_image&)>) const;
+  virtual bool for_blocks_range(const uint64_t& h1, const uint64_t& h2, std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)>) const;
+  virtual bool for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)>, bool pruned) const;
+  virtual bool for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const;
+  virtual bool for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const;
+  virtual bool for_all_alt_blocks(std::function<bool(const crypto::hash &blkid, const alt_block_data_t &data, const cryptonote::blobdata *blob)> f, bool include_blob = false) const;
+
+  virtual uint64_t add_block( const std::pair<block, blobdata>& blk
+                            , size_t block_weight
+                            , uint64_t long_term_block_weight
+                            , const difficulty_type& cumulative_difficulty
+                            , const uint64_t& coins_generated
+                            , const std::vector<std::pair<transaction, blobdata>>& txs
+                            );
+
+  virtual void set_batch_transactions(bool batch_transactions);
+  virtual bool batch_start(uint64_t batch_num_blocks=0, uint64_t batch_bytes=0);
+  virtual void batch_stop();
+  virtual void batch_abort();
+
+  virtual void block_wtxn_start();
+  virtual void block_wtxn_stop();
+  virtual void block_wtxn_abort();
+  virtual bool block_rtxn_start() const;
+  virtual void block_rtxn_stop() const;
+  virtual void block_rtxn_abort() const;
+
+  virtual void pop_block(block& blk, std::vector<transaction>& txs);
+
+  // lookups are cheap and serialized on m_lock, threads would only add overhead
+  virtual bool can_thread_bulk_indices() const { return false; }
+
+  std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff, uint64_t min_count) const;
+
+  bool get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const;
+
+private:
+  virtual void add_block( const block& blk
+                , size_t block_weight
+                , uint64_t long_term_block_weight
+                , const difficulty_type& cumulative_difficulty
+                , const uint64_t& coins_generated
+                , uint64_t num_rct_outs
+                , const crypto::hash& block_hash
+                );
+
+  virtual void remove_block();
+
+  virtual uint64_t add_transaction_data(const crypto::hash& blk_hash, const std::pair<transaction, blobdata>& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash);
+
+  virtual void remove_transaction_data(const crypto::hash& tx_hash, const transaction& tx);
+
+  virtual uint64_t add_output(const crypto::hash& tx_hash,
+      const tx_out& tx_output,
+      const uint64_t& local_index,
+      const uint64_t unlock_time,
+      const rct::key *commitment
+      );
+
+  virtual void add_tx_amount_output_indices(const uint64_t tx_id,
+      const std::vector<uint64_t>& amount_output_indices
+      );
+
+  void remove_output(const uint64_t amount, const uint64_t& out_index);
+
+  virtual void prune_outputs(uint64_t amount);
+
+  virtual void add_spent_key(const crypto::key_image& k_image);
+
+  virtual void remove_spent_key(const crypto::key_image& k_image);
+
+  // Hard fork
+  virtual void set_hard_fork_version(uint64_t height, uint8_t version);
+  virtual uint8_t get_hard_fork_version(uint64_t height) const;
+  virtual void check_hard_fork_info();
+  virtual void drop_hard_fork_info();
+
+  inline void check_open() const;
+  void check_writable() const;
+
+  bool prune_worker(int mode, uint32_t pruning_seed);
+
+  virtual bool is_read_only() const;
+
+  virtual uint64_t get_database_size() const;
+
+  uint64_t get_max_block_size();
+  void add_max_block_size(uint64_t sz);
+
+  // record the inverse of a mutation if the calling thread owns the write txn
+  void push_undo(std::function<void()> undo);
+  // replay the undo log, newest first
+  void rollback();
+
+  void clear();
+
+  struct block_record
+  {
+    cryptonote::blobdata blob;
+    crypto::hash hash;
+    uint64_t timestamp;
+    uint64_t coins;
+    uint64_t weight;
+    uint64_t long_term_weight;
+    uint64_t cum_rct;
+    difficulty_type cumulative_difficulty;
+  };
+
+  struct tx_record
+  {
+    crypto::hash hash;
+    tx_data_t data;
+    cryptonote::blobdata pruned;
+    cryptonote::blobdata prunable;
+    bool has_prunable;
+    bool has_prunable_hash;
+    crypto::hash prunable_hash;
+    std::vector<uint64_t> amount_output_indices;
+  };
+
+  struct output_tx
+  {
+    crypto::hash tx_hash;
+    uint64_t local_index;
+    bool valid;  // false once removed by prune_outputs
+  };
+
+  struct amount_output
+  {
+    uint64_t output_id;
+    output_data_t data;
+  };
+
+  struct txpool_record
+  {
+    txpool_tx_meta_t meta;
+    cryptonote::blobdata blob;
+  };
+
+  struct alt_block_record
+  {
+    alt_block_data_t data;
+    cryptonote::blobdata blob;
+  };
+
+  const block_record &get_block_record(uint64_t height, const char *what) const;
+  const tx_record *find_tx(const crypto::hash& h) const;
+  const amount_output &get_amount_output(uint64_t amount, uint64_t index) const;
+  uint64_t num_outputs() const;
+
+  std::vector<block_record> m_blocks;
+  std::unordered_map<crypto::hash, uint64_t> m_block_heights;
+
+  std::vector<tx_record> m_txs;
+  std::unordered_map<crypto::hash, uint64_t> m_tx_indices;
+
+  std::vector<output_tx> m_output_txs;
+  std::map<uint64_t, std::vector<amount_output>> m_output_amounts;
+
+  std::unordered_set<crypto::key_image> m_spent_keys;
+
+  std::unordered_map<crypto::hash, txpool_record> m_txpool;
+
+  std::unordered_map<crypto::hash, alt_block_record> m_alt_blocks;
+
+  std::vector<uint8_t> m_hf_versions;  // by height, 0 if not set
+
+  uint64_t m_max_block_size;
+  uint32_t m_pruning_seed;
+  uint64_t m_data_size;  // bytes of blobs held, for get_database_size
+
+  mutable epee::critical_section m_lock;
+  std::string m_folder;
+  int m_db_flags;
+
+  std::vector<std::function<void()>> m_undo;
+  bool m_write_txn;  // a write or batch txn is in progress
+  boost::thread::id m_writer;
+
+  bool m_batch_transactions; // support for batch transactions
+  bool m_batch_active; // whether batch transaction is in progress
+};
+
+}  // namespace cryptonote
@@ -0,0 +1,228 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "tx_compression.h"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#include "misc_log_ex.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db"
+
+namespace cryptonote
+{
+
+#ifdef HAVE_ZSTD
+
+namespace
+{
+  struct cctx_deleter { void operator()(ZSTD_CCtx *ctx) const noexcept { ZSTD_freeCCtx(ctx); } };
+  struct dctx_deleter { void operator()(ZSTD_DCtx *ctx) const noexcept { ZSTD_freeDCtx(ctx); } };
+
+  // contexts are not thread safe, but dictionaries are, so keep one context
+  // per thread and share the digested dictionaries between threads
+  ZSTD_CCtx *get_cctx()
+  {
+    static thread_local std::unique_ptr<ZSTD_CCtx, cctx_deleter> ctx{ZSTD_createCCtx()};
+    return ctx.get();
+  }
+
+  ZSTD_DCtx *get_dctx()
+  {
+    static thread_local std::unique_ptr<ZSTD_DCtx, dctx_deleter> ctx{ZSTD_createDCtx()};
+    return ctx.get();
+  }
+}
+
+struct tx_blob_compressor::impl
+{
+  std::string dictionary;
+  ZSTD_CDict *cdict;
+  ZSTD_DDict *ddict;
+
+  impl(): cdict(nullptr), ddict(nullptr) {}
+  ~impl()
+  {
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+  }
+};
+
+tx_blob_compressor::tx_blob_compressor() {}
+tx_blob_compressor::~tx_blob_compressor() {}
+
+bool tx_blob_compressor::is_supported() noexcept
+{
+  return true;
+}
+
+bool tx_blob_compressor::train(const std::vector<std::string> &samples, size_t max_dict_size, std::string &dictionary)
+{
+  std::string buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const std::string &sample: samples)
+  {
+    if (sample.empty())
+      continue;
+    buffer.append(sample);
+    sizes.push_back(sample.size());
+  }
+  if (sizes.empty())
+  {
+    MERROR("No samples to train a dictionary from");
+    return false;
+  }
+
+  dictionary.resize(max_dict_size);
+  const size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), buffer.data(), sizes.data(), sizes.size());
+  if (ZDICT_isError(size))
+  {
+    MERROR("Failed to train dictionary from " << sizes.size() << " samples: " << ZDICT_getErrorName(size));
+    return false;
+  }
+  dictionary.resize(size);
+  return true;
+}
+
+bool tx_blob_compressor::set_dictionary(const std::string &dictionary, int level)
+{
+  std::unique_ptr<impl> i(new impl());
+  i->dictionary = dictionary;
+  i->cdict = ZSTD_createCDict(i->dictionary.data(), i->dictionary.size(), level);
+  i->ddict = ZSTD_createDDict(i->dictionary.data(), i->dictionary.size());
+  if (!i->cdict || !i->ddict)
+  {
+    MERROR("Failed to load compression dictionary");
+    return false;
+  }
+  m_impl = std::move(i);
+  return true;
+}
+
+bool tx_blob_compressor::compress(const epee::span<const uint8_t> blob, std::string &out) const
+{
+  if (!m_impl)
+    return false;
+  if (blob.empty())
+  {
+    out.clear();
+    return true;
+  }
+  ZSTD_CCtx *ctx = get_cctx();
+  if (!ctx)
+    return false;
+  out.resize(ZSTD_compressBound(blob.size()));
+  const size_t size = ZSTD_compress_usingCDict(ctx, &out[0], out.size(), blob.data(), blob.size(), m_impl->cdict);
+  if (ZSTD_isError(size))
+  {
+    MERROR("Failed to compress blob: " << ZSTD_getErrorName(size));
+    return false;
+  }
+  out.resize(size);
+  return true;
+}
+
+bool tx_blob_compressor::decompress_append(const epee::span<const uint8_t> data, std::string &out) const
+{
+  if (!m_impl)
+    return false;
+  if (data.empty())
+    return true;
+  const unsigned long long content_size = ZSTD_getFrameContentSize(data.data(), data.size());
+  if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN)
+    return false;
+  ZSTD_DCtx *ctx = get_dctx();
+  if (!ctx)
+    return false;
+  const size_t offset = out.size();
+  out.resize(offset + content_size);
+  const size_t size = ZSTD_decompress_usingDDict(ctx, &out[offset], content_size, data.data(), data.size(), m_impl->ddict);
+  if (ZSTD_isError(size) || size != content_size)
+  {
+    out.resize(offset);
+    return false;
+  }
+  return true;
+}
+
+#else // HAVE_ZSTD
+
+struct tx_blob_compressor::impl
+{
+  std::string dictionary;
+};
+
+tx_blob_compressor::tx_blob_compressor() {}
+tx_blob_compressor::~tx_blob_compressor() {}
+
+bool tx_blob_compressor::is_supported() noexcept
+{
+  return false;
+}
+
+bool tx_blob_compressor::train(const std::vector<std::string> &samples, size_t max_dict_size, std::string &dictionary)
+{
+  MERROR("Built without zstd, cannot train a compression dictionary");
+  return false;
+}
+
+bool tx_blob_compressor::set_dictionary(const std::string &dictionary, int level)
+{
+  MERROR("Built without zstd, cannot load a compression dictionary");
+  return false;
+}
+
+bool tx_blob_compressor::compress(const epee::span<const uint8_t> blob, std::string &out) const
+{
+  return false;
+}
+
+bool tx_blob_compressor::decompress_append(const epee::span<const uint8_t> data, std::string &out) const
+{
+  return false;
+}
+
+#endif // HAVE_ZSTD
+
+void tx_blob_compressor::reset() noexcept
+{
+  m_impl.reset();
+}
+
+const std::string &tx_blob_compressor::dictionary() const noexcept
+{
+  static const std::string empty;
+  return m_impl ? m_impl->dictionary : empty;
+}
+
+}
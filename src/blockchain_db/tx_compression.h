@@ -0,0 +1,121 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "span.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief dictionary based compression of stored transaction blobs
+   *
+   * Pruned and prunable transaction blobs share a lot of structure (field
+   * tags, varints, ring offsets, tx extra layouts), but are individually
+   * too small for a general purpose compressor to find it. A zstd dictionary
+   * trained on blobs from the chain lets each record be compressed on its own
+   * while still benefitting from that shared structure.
+   *
+   * Compression and decompression use per-thread contexts, so a single
+   * instance may be shared between reader threads once a dictionary has been
+   * set. Setting the dictionary is not thread safe.
+   *
+   * When built without zstd, is_supported() returns false and all other
+   * operations fail.
+   */
+  class tx_blob_compressor
+  {
+  public:
+    tx_blob_compressor();
+    ~tx_blob_compressor();
+
+    tx_blob_compressor(const tx_blob_compressor&) = delete;
+    tx_blob_compressor& operator=(const tx_blob_compressor&) = delete;
+
+    //! whether this build has compression support
+    static bool is_supported() noexcept;
+
+    /**
+     * @brief train a dictionary from sample blobs
+     *
+     * @param samples the sample blobs, ideally spread over the whole chain
+     * @param max_dict_size the maximum size of the resulting dictionary
+     * @param dictionary the trained dictionary
+     *
+     * @return true on success, false if training failed (eg, too few samples)
+     */
+    static bool train(const std::vector<std::string> &samples, size_t max_dict_size, std::string &dictionary);
+
+    /**
+     * @brief load a dictionary, enabling compression and decompression
+     *
+     * @param dictionary a dictionary as returned by train()
+     * @param level the zstd compression level to use when compressing
+     *
+     * @return true on success
+     */
+    bool set_dictionary(const std::string &dictionary, int level = default_level);
+
+    //! drops the dictionary, if any
+    void reset() noexcept;
+
+    //! whether a dictionary is loaded
+    bool enabled() const noexcept { return m_impl != nullptr; }
+
+    //! the loaded dictionary, empty if none
+    const std::string &dictionary() const noexcept;
+
+    /**
+     * @brief compress a blob
+     *
+     * Empty blobs compress to empty blobs, so they can be told apart cheaply.
+     *
+     * @return true on success, with the compressed data in out
+     */
+    bool compress(const epee::span<const uint8_t> blob, std::string &out) const;
+
+    /**
+     * @brief decompress a blob and append it to out
+     *
+     * @return true on success, false if the data is not a valid frame
+     */
+    bool decompress_append(const epee::span<const uint8_t> data, std::string &out) const;
+
+    static constexpr int default_level = 9;
+
+  private:
+    struct impl;
+    std::unique_ptr<impl> m_impl;
+  };
+}
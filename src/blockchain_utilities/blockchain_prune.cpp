@@ -232,7 +232,7 @@ static void copy_table(MDB_env *env0, MDB_env *env1, const char *table, unsigned
   mdb_dbi_close(env0, dbi0);
 }
 
-static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
+static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id, const tx_blob_compressor &compressor)
 {
   MDB_val v;
   int ret = mdb_cursor_get(c_txs_pruned, tx_id, &v, MDB_SET);
@@ -240,6 +240,13 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
     throw std::runtime_error("Failed to find transaction pruned data: " + std::string(mdb_strerror(ret)));
   if (v.mv_size == 0)
     throw std::runtime_error("Invalid transaction pruned data");
+  if (compressor.enabled())
+  {
+    cryptonote::blobdata bd;
+    if (!compressor.decompress_append({(const uint8_t*)v.mv_data, v.mv_size}, bd))
+      throw std::runtime_error("Failed to decompress transaction pruned data");
+    return cryptonote::is_v1_tx(bd);
+  }
   return cryptonote::is_v1_tx(cryptonote::blobdata_ref{(const char*)v.mv_data, v.mv_size});
 }
 
@@ -304,6 +311,21 @@ static void prune(MDB_env *env0, MDB_env *env1)
   if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
 
   MDB_val k, v;
+
+  // the properties were copied over already, so the dictionary is in both
+  tx_blob_compressor compressor;
+  static char zdict_key[] = "txs_pruned_zdict";
+  k.mv_data = zdict_key;
+  k.mv_size = strlen("txs_pruned_zdict") + 1;
+  dbr = mdb_get(txn1, dbi1_properties, &k, &v);
+  if (dbr == 0)
+  {
+    if (!compressor.set_dictionary(std::string((const char*)v.mv_data, v.mv_size)))
+      throw std::runtime_error("Failed to load transaction compression dictionary");
+  }
+  else if (dbr != MDB_NOTFOUND)
+    throw std::runtime_error("Failed to read transaction compression dictionary: " + std::string(mdb_strerror(dbr)));
+
   uint32_t pruning_seed = tools::make_pruning_seed(tools::get_random_stripe(), CRYPTONOTE_PRUNING_LOG_STRIPES);
   static char pruning_seed_key[] = "pruning_seed";
   k.mv_data = pruning_seed_key;
@@ -342,7 +364,7 @@ static void prune(MDB_env *env0, MDB_env *env1)
       if (dbr) throw std::runtime_error("Failed to write prunable tx tip data: " + std::string(mdb_strerror(dbr)));
       bytes += kk.mv_size + vv.mv_size;
     }
-    if (tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) || is_v1_tx(cur0_txs_pruned, &kk))
+    if (tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) || is_v1_tx(cur0_txs_pruned, &kk, compressor))
     {
       MDB_val vv;
       dbr = mdb_cursor_get(cur0_txs_prunable, &kk, &vv, MDB_SET);
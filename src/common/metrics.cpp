@@ -0,0 +1,232 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "metrics.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/thread/locks.hpp>
+
+namespace tools
+{
+namespace metrics
+{
+  namespace
+  {
+    std::atomic<unsigned> next_shard{0};
+
+    void write_label(std::string& out, const std::string& label, const std::string& value, const char* extra_name = nullptr, const std::string& extra_value = {})
+    {
+      if (label.empty() && !extra_name)
+        return;
+      out.push_back('{');
+      bool first = true;
+      const auto append = [&out, &first](const std::string& name, const std::string& value) {
+        if (!first)
+          out.push_back(',');
+        first = false;
+        out += name;
+        out += "=\"";
+        for (const char c : value)
+        {
+          if (c == '\\' || c == '"')
+            out.push_back('\\');
+          if (c == '\n')
+            out += "\\n";
+          else
+            out.push_back(c);
+        }
+        out.push_back('"');
+      };
+      if (!label.empty())
+        append(label, value);
+      if (extra_name)
+        append(extra_name, extra_value);
+      out.push_back('}');
+    }
+
+    void write_header(std::string& out, const std::string& name, const char* type, const std::string& help)
+    {
+      out += "# HELP " + name + " " + help + "\n";
+      out += "# TYPE " + name + " " + type + "\n";
+    }
+
+    std::string seconds(const std::uint64_t ns)
+    {
+      std::string fraction = std::to_string(ns % 1000000000);
+      fraction.insert(0, 9 - fraction.size(), '0');
+      return std::to_string(ns / 1000000000) + "." + fraction;
+    }
+  }
+
+  constexpr std::array<std::uint64_t, 13> histogram::bounds_ns;
+
+  unsigned shard() noexcept
+  {
+    static thread_local const unsigned index = next_shard.fetch_add(1, std::memory_order_relaxed) % shards;
+    return index;
+  }
+
+  counter::counter() noexcept
+  {
+    for (slot& s : m_shards)
+      s.value.store(0, std::memory_order_relaxed);
+  }
+
+  std::uint64_t counter::value() const noexcept
+  {
+    std::uint64_t total = 0;
+    for (const slot& s : m_shards)
+      total += s.value.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  histogram::histogram() noexcept
+  {
+    for (slot& s : m_shards)
+    {
+      for (auto& b : s.buckets)
+        b.store(0, std::memory_order_relaxed);
+      s.sum_ns.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void histogram::observe_ns(const std::uint64_t ns) noexcept
+  {
+    const std::size_t bucket = std::lower_bound(bounds_ns.begin(), bounds_ns.end(), ns) - bounds_ns.begin();
+    slot& s = m_shards[shard()];
+    s.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    s.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  std::array<std::uint64_t, histogram::bounds_ns.size() + 1> histogram::buckets() const noexcept
+  {
+    std::array<std::uint64_t, bounds_ns.size() + 1> out{};
+    for (const slot& s : m_shards)
+      for (std::size_t i = 0; i < out.size(); ++i)
+        out[i] += s.buckets[i].load(std::memory_order_relaxed);
+    return out;
+  }
+
+  std::uint64_t histogram::count() const noexcept
+  {
+    std::uint64_t total = 0;
+    for (const std::uint64_t b : buckets())
+      total += b;
+    return total;
+  }
+
+  std::uint64_t histogram::sum_ns() const noexcept
+  {
+    std::uint64_t total = 0;
+    for (const slot& s : m_shards)
+      total += s.sum_ns.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  registry::family& registry::get_family(const std::string& name, const type kind, const std::string& help, const std::string& label)
+  {
+    const auto it = m_families.find(name);
+    if (it != m_families.end())
+    {
+      if (it->second.kind != kind || it->second.label != label)
+        throw std::logic_error("Metric " + name + " registered with another type or label");
+      return it->second;
+    }
+    family& f = m_families[name];
+    f.kind = kind;
+    f.help = help;
+    f.label = label;
+    return f;
+  }
+
+  counter& registry::get_counter(const std::string& name, const std::string& help, const std::string& label, const std::string& label_value)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    std::unique_ptr<counter>& c = get_family(name, type::counter, help, label).counters[label_value];
+    if (!c)
+      c.reset(new counter());
+    return *c;
+  }
+
+  histogram& registry::get_histogram(const std::string& name, const std::string& help, const std::string& label, const std::string& label_value)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    std::unique_ptr<histogram>& h = get_family(name, type::histogram, help, label).histograms[label_value];
+    if (!h)
+      h.reset(new histogram());
+    return *h;
+  }
+
+  void registry::write(std::string& out) const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    for (const auto& f : m_families)
+    {
+      const std::string& name = f.first;
+      const family& fam = f.second;
+      write_header(out, name, fam.kind == type::counter ? "counter" : "histogram", fam.help);
+
+      for (const auto& c : fam.counters)
+      {
+        out += name;
+        write_label(out, fam.label, c.first);
+        out += " " + std::to_string(c.second->value()) + "\n";
+      }
+      for (const auto& h : fam.histograms)
+      {
+        const auto buckets = h.second->buckets();
+        std::uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < buckets.size(); ++i)
+        {
+          cumulative += buckets[i];
+          out += name + "_bucket";
+          write_label(out, fam.label, h.first, "le", i < histogram::bounds_ns.size() ? seconds(histogram::bounds_ns[i]) : "+Inf");
+          out += " " + std::to_string(cumulative) + "\n";
+        }
+        out += name + "_sum";
+        write_label(out, fam.label, h.first);
+        out += " " + seconds(h.second->sum_ns()) + "\n";
+        out += name + "_count";
+        write_label(out, fam.label, h.first);
+        out += " " + std::to_string(cumulative) + "\n";
+      }
+    }
+  }
+
+  void registry::write_sampled(std::string& out, const std::string& name, const char* type, const std::string& help, const std::string& label, const std::vector<std::pair<std::string, std::uint64_t>>& values)
+  {
+    write_header(out, name, type, help);
+    for (const auto& v : values)
+    {
+      out += name;
+      write_label(out, label, v.first);
+      out += " " + std::to_string(v.second) + "\n";
+    }
+  }
+}
+}
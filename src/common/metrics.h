@@ -0,0 +1,129 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+namespace tools
+{
+namespace metrics
+{
+  //! Number of slots writers are spread over, each thread always writes the same one
+  constexpr unsigned shards = 8;
+
+  //! Index of the calling thread's slot
+  unsigned shard() noexcept;
+
+  //! Monotonic count, summed over the shards when read
+  class counter
+  {
+  public:
+    counter() noexcept;
+    void inc(std::uint64_t n = 1) noexcept { m_shards[shard()].value.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t value() const noexcept;
+  private:
+    struct alignas(64) slot { std::atomic<std::uint64_t> value; };
+    std::array<slot, shards> m_shards;
+  };
+
+  //! Latency distribution over fixed buckets, from 100us to 10s
+  class histogram
+  {
+  public:
+    static constexpr std::array<std::uint64_t, 13> bounds_ns{{
+      100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+      25000000, 50000000, 100000000, 250000000, 1000000000, 10000000000
+    }};
+
+    histogram() noexcept;
+    void observe_ns(std::uint64_t ns) noexcept;
+
+    //! Non cumulative count per bucket, the last one being for values above all bounds
+    std::array<std::uint64_t, bounds_ns.size() + 1> buckets() const noexcept;
+    std::uint64_t count() const noexcept;
+    std::uint64_t sum_ns() const noexcept;
+  private:
+    struct alignas(64) slot
+    {
+      std::array<std::atomic<std::uint64_t>, bounds_ns.size() + 1> buckets;
+      std::atomic<std::uint64_t> sum_ns;
+    };
+    std::array<slot, shards> m_shards;
+  };
+
+  /*! Named metrics, exported in the Prometheus text format.
+
+    Lookups take a lock, so callers keep the returned reference, typically in a
+    function local static. Updating a metric does not lock. */
+  class registry
+  {
+  public:
+    static registry& getInstance() {
+      static registry instance;
+      return instance;
+    }
+
+    //! `label` may be empty for a metric without labels. The same name must always be used with the same type and label.
+    counter& get_counter(const std::string& name, const std::string& help, const std::string& label = {}, const std::string& label_value = {});
+    histogram& get_histogram(const std::string& name, const std::string& help, const std::string& label = {}, const std::string& label_value = {});
+
+    //! Appends every metric in the text exposition format, version 0.0.4
+    void write(std::string& out) const;
+
+    //! Appends a family whose values the caller sampled, `type` being "counter" or "gauge"
+    static void write_sampled(std::string& out, const std::string& name, const char* type, const std::string& help, const std::string& label, const std::vector<std::pair<std::string, std::uint64_t>>& values);
+
+  private:
+    enum class type : std::uint8_t { counter = 0, histogram };
+
+    struct family
+    {
+      type kind;
+      std::string help;
+      std::string label;
+      std::map<std::string, std::unique_ptr<counter>> counters;
+      std::map<std::string, std::unique_ptr<histogram>> histograms;
+    };
+
+    registry() = default;
+    family& get_family(const std::string& name, type kind, const std::string& help, const std::string& label);
+
+    mutable boost::mutex m_mutex;
+    std::map<std::string, family> m_families;
+  };
+}
+}
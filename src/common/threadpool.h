@@ -50,6 +50,10 @@ public:
   static threadpool *getNewForUnitTests(unsigned max_threads = 0) {
     return new threadpool(max_threads);
   }
+  //! A pool of its own, for work that must not run inside waiters of the global one
+  static threadpool *getNew(unsigned max_threads) {
+    return new threadpool(max_threads);
+  }
 
   // The waiter lets the caller know when all of its
   // tasks are completed.
@@ -198,6 +198,25 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::generate_key_derivations(const public_key &key1, const secret_key *keys2, std::size_t count, key_derivation *derivations) {
+    ge_p3 point;
+    ge_p2 point2;
+    ge_p1p1 point3;
+    if (ge_frombytes_vartime(&point, &key1) != 0) {
+      return false;
+    }
+    // a * (8 * P) == 8 * (a * P)
+    ge_p3_to_p2(&point2, &point);
+    ge_mul8(&point3, &point2);
+    ge_p1p1_to_p3(&point, &point3);
+    for (std::size_t i = 0; i < count; ++i) {
+      assert(sc_check(&keys2[i]) == 0);
+      ge_scalarmult(&point2, &unwrap(keys2[i]), &point);
+      ge_tobytes(&derivations[i], &point2);
+    }
+    return true;
+  }
+
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     struct {
       key_derivation derivation;
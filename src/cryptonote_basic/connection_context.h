@@ -31,10 +31,12 @@
 #pragma once
 #include <unordered_set>
 #include <atomic>
+#include <memory>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "net/net_utils_base.h"
 #include "copyable_atomic.h"
 #include "crypto/hash.h"
+#include "cryptonote_basic/tx_reconciliation.h"
 
 namespace cryptonote
 {
@@ -43,7 +45,8 @@ namespace cryptonote
   {
     cryptonote_connection_context(): m_state(state_before_handshake), m_remote_blockchain_height(0), m_last_response_height(0),
         m_last_request_time(boost::date_time::not_a_date_time), m_callback_request_count(0),
-        m_last_known_hash(crypto::null_hash), m_pruning_seed(0), m_rpc_port(0), m_rpc_credits_per_hash(0),  m_anchor(false) {}
+        m_last_known_hash(crypto::null_hash), m_pruning_seed(0), m_rpc_port(0), m_rpc_credits_per_hash(0),  m_anchor(false),
+        m_tx_reconciliation(std::make_shared<tx_reconciliation>()) {}
 
     enum state
     {
@@ -66,6 +69,7 @@ namespace cryptonote
     uint16_t m_rpc_port;
     uint32_t m_rpc_credits_per_hash;
     bool m_anchor;
+    std::shared_ptr<tx_reconciliation> m_tx_reconciliation; //!< shared by copies of the context
     //size_t m_score;  TODO: add score calculations
   };
 
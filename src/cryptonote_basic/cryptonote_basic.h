@@ -497,6 +497,21 @@ namespace cryptonote
     END_SERIALIZE()
   };
 
+  // enough of a block to get its id and check its proof of work without the body
+  struct compact_block_header: public block_header
+  {
+    crypto::hash tx_tree_root;
+    uint64_t tx_count; // including the miner tx
+
+    BEGIN_SERIALIZE_OBJECT()
+      FIELDS(*static_cast<block_header *>(this))
+      FIELD(tx_tree_root)
+      VARINT_FIELD(tx_count)
+      if (tx_count > CRYPTONOTE_MAX_TX_PER_BLOCK + 1)
+        return false;
+    END_SERIALIZE()
+  };
+
 
   /************************************************************************/
   /*                                                                      */
@@ -37,6 +37,8 @@
 #include "cryptonote_config.h"
 #include "crypto/crypto.h"
 #include "crypto/hash.h"
+#include "crypto/siphash.h"
+#include "int-util.h"
 #include "ringct/rctSigs.h"
 
 using namespace epee;
@@ -1228,13 +1230,13 @@ namespace cryptonote
     return get_transaction_hash(t, res, &blob_size);
   }
   //---------------------------------------------------------------
-  blobdata get_block_hashing_blob(const block& b)
+  static blobdata get_block_hashing_blob(const block_header& b, const crypto::hash &tree_root_hash, uint64_t tx_count)
   {
     blobdata blob;
 
     if(b.major_version < HF_VERSION_CUCKOO)
     {
-      blob = t_serializable_object_to_blob(static_cast<block_header>(b));
+      blob = t_serializable_object_to_blob(b);
     }
     else
     {
@@ -1243,15 +1245,40 @@ namespace cryptonote
       blob.append(reinterpret_cast<const char*>(&b.timestamp), sizeof(b.timestamp));
       blob.append(reinterpret_cast<const char*>(&b.prev_id), sizeof(b.prev_id));
     }
-    crypto::hash tree_root_hash = get_tx_tree_hash(b);
     blob.append(reinterpret_cast<const char*>(&tree_root_hash), sizeof(tree_root_hash));
-    blob.append(tools::get_varint_data(b.tx_hashes.size()+1));
+    blob.append(tools::get_varint_data(tx_count));
     if (b.major_version >= HF_VERSION_NONCE8) {
         blob.append(reinterpret_cast<const char*>(&b.nonce8), sizeof(b.nonce8));
     }
     return blob;
   }
   //---------------------------------------------------------------
+  blobdata get_block_hashing_blob(const block& b)
+  {
+    return get_block_hashing_blob(static_cast<const block_header&>(b), get_tx_tree_hash(b), b.tx_hashes.size() + 1);
+  }
+  //---------------------------------------------------------------
+  blobdata get_block_hashing_blob(const compact_block_header& h)
+  {
+    return get_block_hashing_blob(static_cast<const block_header&>(h), h.tx_tree_root, h.tx_count);
+  }
+  //---------------------------------------------------------------
+  compact_block_header get_compact_block_header(const block& b)
+  {
+    compact_block_header h;
+    static_cast<block_header&>(h) = b;
+    h.tx_tree_root = get_tx_tree_hash(b);
+    h.tx_count = b.tx_hashes.size() + 1;
+    return h;
+  }
+  //---------------------------------------------------------------
+  crypto::hash get_compact_block_header_hash(const compact_block_header& h)
+  {
+    crypto::hash res;
+    get_object_hash(get_block_hashing_blob(h), res);
+    return res;
+  }
+  //---------------------------------------------------------------
   bool calculate_block_hash(const block& b, crypto::hash& res, const blobdata *blob)
   {
     bool hash_result = get_object_hash(get_block_hashing_blob(b), res);
@@ -1287,6 +1314,22 @@ namespace cryptonote
     return p;
   }
   //---------------------------------------------------------------
+  crypto::hash get_compact_block_salt(const crypto::hash &block_hash, uint64_t nonce)
+  {
+    char data[sizeof(crypto::hash) + sizeof(uint64_t)];
+    memcpy(data, &block_hash, sizeof(crypto::hash));
+    nonce = SWAP64LE(nonce);
+    memcpy(data + sizeof(crypto::hash), &nonce, sizeof(nonce));
+    return crypto::cn_fast_hash(data, sizeof(data));
+  }
+  //---------------------------------------------------------------
+  uint64_t get_compact_block_short_id(const crypto::hash &salt, const crypto::hash &txid)
+  {
+    // short ids are 48 bits, keyed per block so collisions can't be precomputed
+    static_assert(sizeof(crypto::hash) >= SIPHASH_KEY_SIZE, "Salt too small for siphash key");
+    return siphash24(&txid, sizeof(txid), (const uint8_t*)&salt) & 0xffffffffffffull;
+  }
+  //---------------------------------------------------------------
   std::vector<uint64_t> relative_output_offsets_to_absolute(const std::vector<uint64_t>& off)
   {
     std::vector<uint64_t> res = off;
@@ -117,12 +117,17 @@ namespace cryptonote
   crypto::hash get_pruned_transaction_hash(const transaction& t, const crypto::hash &pruned_data_hash);
 
   blobdata get_block_hashing_blob(const block& b);
+  blobdata get_block_hashing_blob(const compact_block_header& h);
+  compact_block_header get_compact_block_header(const block& b);
+  crypto::hash get_compact_block_header_hash(const compact_block_header& h);
   bool calculate_block_hash(const block& b, crypto::hash& res, const blobdata *blob = NULL);
   bool get_block_hash(const block& b, crypto::hash& res);
   crypto::hash get_block_hash(const block& b);
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b, crypto::hash *block_hash);
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b);
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b, crypto::hash &block_hash);
+  crypto::hash get_compact_block_salt(const crypto::hash &block_hash, uint64_t nonce);
+  uint64_t get_compact_block_short_id(const crypto::hash &salt, const crypto::hash &txid);
   bool get_inputs_money_amount(const transaction& tx, uint64_t& money);
   uint64_t get_outs_money_amount(const transaction& tx);
   bool check_inputs_types_supported(const transaction& tx);
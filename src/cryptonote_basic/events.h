@@ -29,6 +29,7 @@
 #pragma once
 
 #include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 
 namespace cryptonote
@@ -42,5 +43,6 @@ namespace cryptonote
     cryptonote::transaction tx;
     crypto::hash hash;
     bool res; //!< Listeners must ignore `tx` when this is false.
+    cryptonote::blobdata blob; //!< `tx` as received, may be empty
   };
 }
@@ -0,0 +1,536 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "tx_reconciliation.h"
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+
+#include "crypto/crypto.h"
+#include "crypto/siphash.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_config.h"
+#include "int-util.h"
+
+namespace cryptonote
+{
+  namespace
+  {
+    constexpr const std::chrono::seconds round_timeout{CRYPTONOTE_TX_RECONCILIATION_TIMEOUT};
+
+    //! Half the interval between rounds, so that network jitter does not get honest rounds refused
+    constexpr const std::chrono::milliseconds sketch_interval{CRYPTONOTE_TX_RECONCILIATION_INTERVAL * 1000 / 2};
+
+    //! Coefficients over GF(2^32), lowest degree first
+    using poly = std::vector<std::uint32_t>;
+
+    //! \return `a * b` in GF(2^32), modulo x^32 + x^7 + x^3 + x^2 + 1
+    std::uint32_t gf_mul(const std::uint32_t a, const std::uint32_t b) noexcept
+    {
+      std::uint32_t r = 0;
+      for (int i = 31; i >= 0; --i)
+      {
+        r = (r << 1) ^ ((r >> 31) ? 0x8d : 0);
+        if ((b >> i) & 1)
+          r ^= a;
+      }
+      return r;
+    }
+
+    //! \return `1 / a` in GF(2^32), computed as a^(2^32 - 2)
+    std::uint32_t gf_inv(const std::uint32_t a) noexcept
+    {
+      std::uint32_t r = 1;
+      std::uint32_t p = a;
+      for (std::uint32_t exp = 0xfffffffe; exp; exp >>= 1)
+      {
+        if (exp & 1)
+          r = gf_mul(r, p);
+        p = gf_mul(p, p);
+      }
+      return r;
+    }
+
+    void poly_trim(poly& a)
+    {
+      while (!a.empty() && a.back() == 0)
+        a.pop_back();
+    }
+
+    void poly_add(poly& a, const poly& b)
+    {
+      if (a.size() < b.size())
+        a.resize(b.size(), 0);
+      for (std::size_t i = 0; i < b.size(); ++i)
+        a[i] ^= b[i];
+      poly_trim(a);
+    }
+
+    void poly_make_monic(poly& a)
+    {
+      if (a.empty() || a.back() == 1)
+        return;
+      const std::uint32_t inv = gf_inv(a.back());
+      for (auto& c : a)
+        c = gf_mul(c, inv);
+    }
+
+    //! `a` becomes `a mod f`, and the quotient is returned. `f` must be monic.
+    poly poly_divmod(poly& a, const poly& f)
+    {
+      const std::size_t degree = f.size() - 1;
+      poly quotient(a.size() > degree ? a.size() - degree : 0, 0);
+      while (a.size() > degree)
+      {
+        const std::uint32_t c = a.back();
+        const std::size_t shift = a.size() - 1 - degree;
+        quotient[shift] = c;
+        if (c)
+        {
+          for (std::size_t i = 0; i < degree; ++i)
+            a[shift + i] ^= gf_mul(c, f[i]);
+        }
+        a.pop_back();
+      }
+      poly_trim(a);
+      return quotient;
+    }
+
+    //! \return `a^2 mod f`, squaring is linear in characteristic 2
+    poly poly_sqrmod(const poly& a, const poly& f)
+    {
+      poly r(a.empty() ? 0 : 2 * a.size() - 1, 0);
+      for (std::size_t i = 0; i < a.size(); ++i)
+        r[2 * i] = gf_mul(a[i], a[i]);
+      poly_divmod(r, f);
+      return r;
+    }
+
+    //! \return Monic gcd of `a` and `b`
+    poly poly_gcd(poly a, poly b)
+    {
+      poly_trim(a);
+      poly_trim(b);
+      while (!b.empty())
+      {
+        poly_make_monic(b);
+        poly_divmod(a, b);
+        std::swap(a, b);
+      }
+      poly_make_monic(a);
+      return a;
+    }
+
+    /*! Finds the roots of `f` by splitting it with the trace map (Berlekamp
+        trace algorithm). `f` must be monic and a product of distinct linear
+        factors. */
+    bool poly_find_roots(const poly& f, std::vector<std::uint32_t>& roots, std::uint64_t& rng)
+    {
+      if (f.size() <= 1)
+        return true;
+      if (f.size() == 2)
+      {
+        roots.push_back(f[0]);
+        return true;
+      }
+
+      for (unsigned attempt = 0; attempt < 64; ++attempt)
+      {
+        // xorshift, the choice of splitting element only affects speed
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        const std::uint32_t beta = std::uint32_t(rng);
+        if (beta == 0)
+          continue;
+
+        // trace of beta * x, which is 0 for about half the roots of f
+        poly term{0, beta};
+        poly trace = term;
+        for (unsigned i = 1; i < 32; ++i)
+        {
+          term = poly_sqrmod(term, f);
+          poly_add(trace, term);
+        }
+
+        poly factor = poly_gcd(f, std::move(trace));
+        if (1 < factor.size() && factor.size() < f.size())
+        {
+          poly rest = f;
+          const poly other = poly_divmod(rest, factor);
+          return poly_find_roots(factor, roots, rng) && poly_find_roots(other, roots, rng);
+        }
+      }
+      return false;
+    }
+  } // anonymous
+
+  void tx_sketch::add(const std::uint32_t element)
+  {
+    const std::uint32_t square = gf_mul(element, element);
+    std::uint32_t power = element;
+    for (auto& syndrome : syndromes_)
+    {
+      syndrome ^= power;
+      power = gf_mul(power, square);
+    }
+  }
+
+  void tx_sketch::merge(const tx_sketch& other)
+  {
+    // a sketch cut down to a smaller capacity is still a valid sketch
+    syndromes_.resize(std::min(capacity(), other.capacity()));
+    for (std::size_t i = 0; i < syndromes_.size(); ++i)
+      syndromes_[i] ^= other.syndromes_[i];
+  }
+
+  bool tx_sketch::decode(std::vector<std::uint32_t>& elements) const
+  {
+    elements.clear();
+
+    // power sums S_1 .. S_2c, the even ones are squares of earlier ones
+    const std::size_t capacity = this->capacity();
+    std::vector<std::uint32_t> sums(2 * capacity);
+    for (std::size_t i = 0; i < sums.size(); ++i)
+      sums[i] = (i % 2 == 0) ? syndromes_[i / 2] : gf_mul(sums[i / 2], sums[i / 2]);
+
+    // Berlekamp-Massey gives the error locator, prod(1 - e*x)
+    poly locator{1};
+    poly previous{1};
+    std::size_t length = 0;
+    std::size_t shift = 1;
+    std::uint32_t previous_discrepancy = 1;
+    for (std::size_t n = 0; n < sums.size(); ++n)
+    {
+      std::uint32_t discrepancy = sums[n];
+      for (std::size_t i = 1; i <= length && i < locator.size(); ++i)
+        discrepancy ^= gf_mul(locator[i], sums[n - i]);
+      if (discrepancy == 0)
+      {
+        ++shift;
+        continue;
+      }
+
+      const std::uint32_t coefficient = gf_mul(discrepancy, gf_inv(previous_discrepancy));
+      poly next = locator;
+      if (next.size() < previous.size() + shift)
+        next.resize(previous.size() + shift, 0);
+      for (std::size_t i = 0; i < previous.size(); ++i)
+        next[i + shift] ^= gf_mul(coefficient, previous[i]);
+
+      if (2 * length <= n)
+      {
+        previous = std::move(locator);
+        length = n + 1 - length;
+        previous_discrepancy = discrepancy;
+        shift = 1;
+      }
+      else
+        ++shift;
+      locator = std::move(next);
+    }
+
+    poly_trim(locator);
+    if (length > capacity || locator.size() != length + 1)
+      return false;
+    if (length == 0)
+      return true;
+
+    // the elements are the roots of the reversed locator
+    poly f(locator.rbegin(), locator.rend());
+    if (f[0] == 0)
+      return false;
+
+    // it must split into distinct linear factors, ie divide x^(2^32) - x
+    poly x{0, 1};
+    poly_divmod(x, f);
+    poly frobenius = x;
+    for (unsigned i = 0; i < 32; ++i)
+      frobenius = poly_sqrmod(frobenius, f);
+    if (frobenius != x)
+      return false;
+
+    std::uint64_t rng = 0x9e3779b97f4a7c15ull ^ f[0];
+    if (!poly_find_roots(f, elements, rng) || elements.size() != length)
+    {
+      elements.clear();
+      return false;
+    }
+    return true;
+  }
+
+  std::string tx_sketch::serialize() const
+  {
+    std::string blob;
+    blob.reserve(syndromes_.size() * sizeof(std::uint32_t));
+    for (const std::uint32_t syndrome : syndromes_)
+    {
+      const std::uint32_t le = SWAP32LE(syndrome);
+      blob.append(reinterpret_cast<const char*>(&le), sizeof(le));
+    }
+    return blob;
+  }
+
+  bool tx_sketch::deserialize(const std::string& blob)
+  {
+    if (blob.size() % sizeof(std::uint32_t))
+      return false;
+    syndromes_.resize(blob.size() / sizeof(std::uint32_t));
+    for (std::size_t i = 0; i < syndromes_.size(); ++i)
+    {
+      std::uint32_t le;
+      memcpy(&le, blob.data() + i * sizeof(le), sizeof(le));
+      syndromes_[i] = SWAP32LE(le);
+    }
+    return true;
+  }
+
+  tx_reconciliation::tx_reconciliation()
+    : tx_reconciliation(sketch_interval)
+  {}
+
+  tx_reconciliation::tx_reconciliation(const std::chrono::steady_clock::duration sketch_interval)
+    : lock_(), pending_(), local_(), remote_(), last_round_(std::chrono::steady_clock::now()),
+      last_sketch_(), sketch_interval_(sketch_interval)
+  {}
+
+  std::uint32_t tx_reconciliation::get_short_id(const crypto::hash& salt, const crypto::hash& blob_hash)
+  {
+    static_assert(sizeof(crypto::hash) >= SIPHASH_KEY_SIZE, "Salt too small for siphash key");
+    const std::uint32_t id = std::uint32_t(siphash24(&blob_hash, sizeof(blob_hash), reinterpret_cast<const std::uint8_t*>(&salt)));
+    return id ? id : 1; // zero can not be sketched
+  }
+
+  std::size_t tx_reconciliation::get_capacity(const std::uint64_t local_size, const std::uint64_t remote_size)
+  {
+    // the sets mostly overlap, allow for a quarter of the smaller one to differ
+    const std::uint64_t difference = std::max(local_size, remote_size) - std::min(local_size, remote_size);
+    const std::uint64_t capacity = difference + (std::min(local_size, remote_size) + 3) / 4 + 1;
+    return capacity > CRYPTONOTE_TX_RECONCILIATION_MAX_CAPACITY ? 0 : capacity;
+  }
+
+  void tx_reconciliation::take_snapshot(round& r, const crypto::hash& salt)
+  {
+    r.txs.clear();
+    r.salt = salt;
+    r.start = std::chrono::steady_clock::now();
+    r.active = true;
+    for (auto tx = pending_.begin(); tx != pending_.end(); )
+    {
+      // on a short id collision, the tx waits for the next round and salt
+      if (r.txs.emplace(get_short_id(salt, tx->first), tx->second).second)
+        tx = pending_.erase(tx);
+      else
+        ++tx;
+    }
+  }
+
+  void tx_reconciliation::restore_snapshot(round& r)
+  {
+    for (auto& tx : r.txs)
+      pending_.emplace(get_blob_hash(tx.second), std::move(tx.second));
+    r.txs.clear();
+    r.active = false;
+  }
+
+  std::size_t tx_reconciliation::size() const
+  {
+    boost::lock_guard<boost::mutex> lock{lock_};
+    return pending_.size();
+  }
+
+  bool tx_reconciliation::add(const std::vector<blobdata>& txs)
+  {
+    boost::lock_guard<boost::mutex> lock{lock_};
+    if (CRYPTONOTE_TX_RECONCILIATION_MAX_PENDING < pending_.size() + txs.size())
+      return false;
+    for (const blobdata& tx : txs)
+      pending_.emplace(get_blob_hash(tx), tx);
+    return true;
+  }
+
+  void tx_reconciliation::remove(const std::vector<blobdata>& txs)
+  {
+    boost::lock_guard<boost::mutex> lock{lock_};
+    for (const blobdata& tx : txs)
+    {
+      const crypto::hash blob_hash = get_blob_hash(tx);
+      pending_.erase(blob_hash);
+      for (round* r : {&local_, &remote_})
+      {
+        if (r->active)
+          r->txs.erase(get_short_id(r->salt, blob_hash));
+      }
+    }
+  }
+
+  std::vector<blobdata> tx_reconciliation::take_all()
+  {
+    restore_snapshot(local_);
+    restore_snapshot(remote_);
+
+    std::vector<blobdata> txs;
+    txs.reserve(pending_.size());
+    for (auto& tx : pending_)
+      txs.push_back(std::move(tx.second));
+    pending_.clear();
+    last_round_ = std::chrono::steady_clock::now();
+    return txs;
+  }
+
+  std::vector<blobdata> tx_reconciliation::flush()
+  {
+    boost::lock_guard<boost::mutex> lock{lock_};
+    return take_all();
+  }
+
+  std::vector<blobdata> tx_reconciliation::flush_stalled(const std::chrono::steady_clock::duration timeout)
+  {
+    boost::lock_guard<boost::mutex> lock{lock_};
+    if (std::chrono::steady_clock::now() - last_round_ < timeout)
+      return {};
+    return take_all();
+  }
+
+  bool tx_reconciliation::start_round(crypto::hash& salt, std::uint64_t& set_size)
+  {
+    boost::lock_guard<boost::mutex> lock{lock_};
+    if (local_.active)
+    {
+      if (std::chrono::steady_clock::now() - local_.start < round_timeout)
+        return false;
+      restore_snapshot(local_); // peer never answered
+    }
+
+    salt = crypto::rand<crypto::hash>();
+    take_snapshot(local_, salt);
+    set_size = local_.txs.size();
+    return true;
+  }
+
+  bool tx_reconciliation::finish_round(const std::string& sketch, std::vector<blobdata>& send, std::vector<std::uint32_t>& request, bool& success)
+  {
+    send.clear();
+    request.clear();
+
+    boost::lock_guard<boost::mutex> lock{lock_};
+    if (!local_.active)
+      return false;
+
+    tx_sketch remote{};
+    std::vector<std::uint32_t> difference;
+    success = !sketch.empty() && remote.deserialize(sketch) && remote.capacity() <= CRYPTONOTE_TX_RECONCILIATION_MAX_CAPACITY;
+    if (success)
+    {
+      tx_sketch local{remote.capacity()};
+      for (const auto& tx : local_.txs)
+        local.add(tx.first);
+      local.merge(remote);
+      success = local.decode(difference);
+    }
+
+    if (success)
+    {
+      for (const std::uint32_t id : difference)
+      {
+        const auto tx = local_.txs.find(id);
+        if (tx != local_.txs.end())
+          send.push_back(std::move(tx->second));
+        else
+          request.push_back(id);
+      }
+    }
+    else
+    {
+      for (auto& tx : local_.txs)
+        send.push_back(std::move(tx.second));
+    }
+
+    local_.txs.clear();
+    local_.active = false;
+    last_round_ = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  bool tx_reconciliation::make_sketch(const crypto::hash& salt, const std::uint64_t remote_set_size, std::string& sketch)
+  {
+    sketch.clear();
+
+    boost::lock_guard<boost::mutex> lock{lock_};
+    const auto now = std::chrono::steady_clock::now();
+    if (last_sketch_ != std::chrono::steady_clock::time_point{} && now - last_sketch_ < sketch_interval_)
+      return false;
+    last_sketch_ = now;
+
+    if (remote_.active)
+      restore_snapshot(remote_); // peer never finished the last round
+
+    take_snapshot(remote_, salt);
+    const std::size_t capacity = get_capacity(remote_.txs.size(), remote_set_size);
+    if (capacity == 0)
+      return true;
+
+    tx_sketch local{capacity};
+    for (const auto& tx : remote_.txs)
+      local.add(tx.first);
+    sketch = local.serialize();
+    return true;
+  }
+
+  void tx_reconciliation::get_requested(const bool success, const std::vector<std::uint32_t>& short_ids, std::vector<blobdata>& send)
+  {
+    send.clear();
+
+    boost::lock_guard<boost::mutex> lock{lock_};
+    if (!remote_.active)
+      return;
+
+    if (success)
+    {
+      for (const std::uint32_t id : short_ids)
+      {
+        const auto tx = remote_.txs.find(id);
+        if (tx != remote_.txs.end())
+        {
+          send.push_back(std::move(tx->second));
+          remote_.txs.erase(tx);
+        }
+      }
+    }
+    else
+    {
+      for (auto& tx : remote_.txs)
+        send.push_back(std::move(tx.second));
+    }
+
+    // whatever was not asked for, the peer has already
+    remote_.txs.clear();
+    remote_.active = false;
+    last_round_ = std::chrono::steady_clock::now();
+  }
+}
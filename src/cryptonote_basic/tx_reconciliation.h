@@ -0,0 +1,176 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+
+namespace cryptonote
+{
+  /*! A PinSketch over GF(2^32), in the style of minisketch. A sketch of
+      capacity `c` holds the odd power sums of its elements, so merging two
+      sketches yields a sketch of the symmetric difference of their sets,
+      which can be decoded as long as it has at most `c` elements. Zero can
+      not be an element. */
+  class tx_sketch
+  {
+    std::vector<std::uint32_t> syndromes_;
+
+  public:
+    explicit tx_sketch(std::size_t capacity = 0)
+      : syndromes_(capacity, 0)
+    {}
+
+    std::size_t capacity() const noexcept { return syndromes_.size(); }
+
+    //! Toggle `element` in the sketch, adding it twice removes it.
+    void add(std::uint32_t element);
+
+    //! Merge in `other`, which must have the same capacity.
+    void merge(const tx_sketch& other);
+
+    //! \return True iff the set difference fits in the capacity; `elements` then holds it.
+    bool decode(std::vector<std::uint32_t>& elements) const;
+
+    //! \return Little endian syndromes, 4 bytes per unit of capacity.
+    std::string serialize() const;
+
+    //! \return False if `blob` is not a whole number of syndromes.
+    bool deserialize(const std::string& blob);
+  };
+
+  /*! Per peer state for relaying txes by set reconciliation. Txes that would
+      have been flooded to the peer are queued here instead; periodically the
+      outbound side of the connection starts a round, the inbound side answers
+      with a sketch of its queue, and each side then sends only the txes the
+      other is missing. Txes are identified by 32 bit short ids of their blob
+      hash, salted per round by the initiator.
+
+      All functions are thread-safe, the connection handlers and the tx relay
+      timers both use this. */
+  class tx_reconciliation
+  {
+    struct round
+    {
+      round()
+        : txs(), salt(crypto::null_hash), start(), active(false)
+      {}
+
+      std::unordered_map<std::uint32_t, blobdata> txs; //!< Snapshot of the queue, by short id
+      crypto::hash salt;
+      std::chrono::steady_clock::time_point start;
+      bool active;
+    };
+
+    mutable boost::mutex lock_;
+    std::unordered_map<crypto::hash, blobdata> pending_; //!< Queued txes, by blob hash
+    round local_;  //!< Round we initiated
+    round remote_; //!< Round the peer initiated
+    std::chrono::steady_clock::time_point last_round_; //!< Last round completed, or last flush
+    std::chrono::steady_clock::time_point last_sketch_; //!< Last sketch made for the peer
+    const std::chrono::steady_clock::duration sketch_interval_;
+
+    void take_snapshot(round& r, const crypto::hash& salt);
+    void restore_snapshot(round& r);
+    std::vector<blobdata> take_all();
+
+  public:
+    tx_reconciliation();
+
+    //! Sketch at most once per `sketch_interval` for the peer.
+    explicit tx_reconciliation(std::chrono::steady_clock::duration sketch_interval);
+
+    //! \return Short id for a tx blob hash in the round salted with `salt`.
+    static std::uint32_t get_short_id(const crypto::hash& salt, const crypto::hash& blob_hash);
+
+    //! \return Sketch capacity for reconciling sets of these sizes, 0 if too large.
+    static std::size_t get_capacity(std::uint64_t local_size, std::uint64_t remote_size);
+
+    //! \return Number of txes queued for the next round.
+    std::size_t size() const;
+
+    /*! Queue `txs` for the next round.
+
+        \return False if the queue is full; nothing is queued, and `txs`
+          should be flooded along with everything `flush()` returns. */
+    bool add(const std::vector<blobdata>& txs);
+
+    //! Drop `txs` from the queue, the peer sent them to us.
+    void remove(const std::vector<blobdata>& txs);
+
+    //! Drop the queue and any round in flight, returning all txes for flooding.
+    std::vector<blobdata> flush();
+
+    /*! `flush()` if no round completed within `timeout`, because the peer
+        stopped answering or, as responder, never starts rounds.
+
+        \return Txes to flood, empty if the peer is reconciling. */
+    std::vector<blobdata> flush_stalled(std::chrono::steady_clock::duration timeout);
+
+    /*! Initiator: snapshot the queue for a new round.
+
+        \param[out] salt Random salt for the short ids of this round.
+        \param[out] set_size Size of the snapshot.
+
+        \return False if a previous round is still in flight. */
+    bool start_round(crypto::hash& salt, std::uint64_t& set_size);
+
+    /*! Initiator: finish the round with the peer's sketch.
+
+        \param sketch Sketch of the peer's queue, empty if the peer gave up.
+        \param[out] send Txes the peer is missing.
+        \param[out] request Short ids of the txes we are missing.
+        \param[out] success False if the difference could not be decoded. In
+          that case `send` is the whole snapshot, and the peer has to send us
+          its whole snapshot too.
+
+        \return False if no round was in flight. */
+    bool finish_round(const std::string& sketch, std::vector<blobdata>& send, std::vector<std::uint32_t>& request, bool& success);
+
+    /*! Responder: snapshot the queue and sketch it for the peer's round.
+        Sketching costs up to capacity times set size field multiplications,
+        so a peer gets one sketch per reconciliation interval.
+
+        \param[out] sketch The sketch, empty if the difference is expected to
+          be too large to decode.
+
+        \return False if the peer asked again too soon; nothing is done. */
+    bool make_sketch(const crypto::hash& salt, std::uint64_t remote_set_size, std::string& sketch);
+
+    //! Responder: txes the peer asked for at the end of its round; all of them if `success` is false.
+    void get_requested(bool success, const std::vector<std::uint32_t>& short_ids, std::vector<blobdata>& send);
+  };
+}
@@ -90,6 +90,7 @@
 
 
 #define BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT          10000  //by default, blocks ids count in synchronizing
+#define BLOCKS_HEADERS_SYNCHRONIZING_COUNT              2000   //blocks ids count in synchronizing when headers are sent too
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT_PRE_V4       100    //by default, blocks count in blocks downloading
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT              20     //by default, blocks count in blocks downloading
 #define BLOCKS_SYNCHRONIZING_MAX_COUNT                  2048   //must be a power of 2, greater than 128, equal to SEEDHASH_EPOCH_BLOCKS
@@ -110,10 +111,19 @@
 
 #define CRYPTONOTE_MAX_FRAGMENTS                        20 // ~20 * NOISE_BYTES max payload size for covert/noise send
 
+#define CRYPTONOTE_TX_RECONCILIATION_INTERVAL           2      // seconds between rounds per outgoing connection
+#define CRYPTONOTE_TX_RECONCILIATION_TIMEOUT            30     // seconds before a round in flight is abandoned, or a queue without rounds flooded
+#define CRYPTONOTE_TX_RECONCILIATION_FLOOD_PEERS        2      // outgoing reconciling connections still flooded to
+#define CRYPTONOTE_TX_RECONCILIATION_MAX_CAPACITY       128    // max set difference a sketch can decode
+#define CRYPTONOTE_TX_RECONCILIATION_MAX_PENDING        1000   // txes queued per connection before flooding instead
+
 #define COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT           1000
 
 #define P2P_LOCAL_WHITE_PEERLIST_LIMIT                  1000
 #define P2P_LOCAL_GRAY_PEERLIST_LIMIT                   5000
+#define P2P_PEERLIST_JOURNAL_MAX_PENDING                100000 // unsaved changes per zone before falling back to a full save
+#define P2P_PEERLIST_JOURNAL_COMPACT_SIZE               (8*1024*1024) // journal bytes before it is folded into the snapshot
+#define P2P_PEERLIST_STORE_INTERVAL                     (60*5) // seconds between peerlist saves
 
 #define P2P_DEFAULT_CONNECTIONS_COUNT                   30
 #define P2P_DEFAULT_HANDSHAKE_INTERVAL                  60           //secondes
@@ -136,7 +146,9 @@
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_COMPACT_BLOCKS                 0x02
+#define P2P_SUPPORT_FLAG_TX_RECONCILIATION              0x04 // only with --tx-reconciliation
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_COMPACT_BLOCKS)
 
 #define RPC_IP_FAILS_BEFORE_BLOCK                       3
 
@@ -145,7 +157,9 @@
 #define CRYPTONOTE_BLOCKCHAINDATA_FILENAME      "data.mdb"
 #define CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME "lock.mdb"
 #define P2P_NET_DATA_FILENAME                   "p2pstate.bin"
+#define P2P_NET_JOURNAL_FILENAME                "p2pstate.journal"
 #define RPC_PAYMENTS_DATA_FILENAME              "rpcpayments.bin"
+#define LIGHT_WALLET_DATA_FILENAME              "lightwallet.bin"
 #define MINER_CONFIG_FILE_NAME                  "miner_conf.json"
 
 #define THREAD_STACK_SIZE                       5 * 1024 * 1024
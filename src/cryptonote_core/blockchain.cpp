@@ -52,6 +52,7 @@
 #include "crypto/hash.h"
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
+#include "common/metrics.h"
 #include "common/perf_timer.h"
 #include "common/notify.h"
 #include "common/varint.h"
@@ -85,10 +86,16 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+static tools::metrics::histogram &block_stage_histogram(const char *stage)
+{
+  return tools::metrics::registry::getInstance().get_histogram("monero_block_verification_seconds", "Time spent adding a block to the main chain, by stage", "stage", stage);
+}
+
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_reset_timestamps_and_difficulties_height(true), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
   m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false),
+  m_checked_headers_start(0), m_checked_headers_base(crypto::null_hash),
   m_long_term_block_weights_window(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_long_term_effective_median_block_weight(0),
   m_long_term_block_weights_cache_tip_hash(crypto::null_hash),
@@ -2536,6 +2543,37 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
   return true;
 }
 //------------------------------------------------------------------
+bool Blockchain::find_blockchain_supplement_range(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& total_height, uint64_t& start_height, size_t& count, size_t max_count) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  if(req_start_block > 0)
+  {
+    if (req_start_block >= m_db->height())
+    {
+      return false;
+    }
+    start_height = req_start_block;
+  }
+  else
+  {
+    if(!find_blockchain_supplement(qblock_ids, start_height))
+    {
+      return false;
+    }
+  }
+
+  db_rtxn_guard rtxn_guard(m_db);
+  total_height = get_current_blockchain_height();
+  const std::vector<uint64_t> weights = m_db->get_block_weights(start_height, std::min<uint64_t>(max_count, total_height - start_height));
+  uint64_t size = 0;
+  count = 0;
+  while (count < weights.size() && (size < FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE || count < 3))
+    size += weights[count++];
+
+  return true;
+}
 bool Blockchain::add_block_as_invalid(const block& bl, const crypto::hash& h)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -2759,6 +2797,49 @@ bool Blockchain::check_tx_inputs(transaction& tx, uint64_t& max_used_block_heigh
   return true;
 }
 //------------------------------------------------------------------
+bool Blockchain::check_tx_inputs_no_signatures(transaction& tx, uint64_t& max_used_block_height, crypto::hash& max_used_block_id, tx_verification_context &tvc) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  if (!check_tx_inputs(tx, tvc, &max_used_block_height, false))
+    return false;
+
+  CHECK_AND_ASSERT_MES(max_used_block_height < m_db->height(), false,  "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_db->height());
+  max_used_block_id = m_db->get_block_hash_from_height(max_used_block_height);
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::verify_tx_input_signatures(const transaction& tx)
+{
+  if (tx.version < 2 || tx.pruned)
+    return true;
+
+  const rct::rctSig &rv = tx.rct_signatures;
+  switch (rv.type)
+  {
+  case rct::RCTTypeSimple:
+  case rct::RCTTypeBulletproof:
+  case rct::RCTTypeBulletproof2:
+    if (!rct::verRctNonSemanticsSimple(rv))
+    {
+      MERROR_VER("Failed to check ringct signatures!");
+      return false;
+    }
+    return true;
+  case rct::RCTTypeFull:
+    if (!rct::verRct(rv, false))
+    {
+      MERROR_VER("Failed to check ringct signatures!");
+      return false;
+    }
+    return true;
+  default:
+    MERROR_VER("Unsupported rct type: " << rv.type);
+    return false;
+  }
+}
+//------------------------------------------------------------------
 bool Blockchain::check_tx_outputs(const transaction& tx, tx_verification_context &tvc) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -2933,7 +3014,7 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
 //        check_tx_input() rather than here, and use this function simply
 //        to iterate the inputs as necessary (splitting the task
 //        using threads, etc.)
-bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height) const
+bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height, bool verify_signatures) const
 {
   PERF_TIMER(check_tx_inputs);
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -3247,7 +3328,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRctNonSemanticsSimple(rv))
+      if (verify_signatures && !rct::verRctNonSemanticsSimple(rv))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
@@ -3306,7 +3387,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRct(rv, false))
+      if (verify_signatures && !rct::verRct(rv, false))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
@@ -4040,6 +4121,18 @@ leave:
         << "/" << t_checktx << "/" << t_dblspnd << "/" << vmt << "/" << addblock << ")ms");
   }
 
+  {
+    // TIME_MEASURE points are in milliseconds
+    static tools::metrics::histogram &pow_time = block_stage_histogram("pow");
+    static tools::metrics::histogram &inputs_time = block_stage_histogram("inputs");
+    static tools::metrics::histogram &db_write_time = block_stage_histogram("db_write");
+    static tools::metrics::histogram &total_time = block_stage_histogram("total");
+    pow_time.observe_ns(longhash_calculating_time * 1000000);
+    inputs_time.observe_ns((t_checktx + t_dblspnd) * 1000000);
+    db_write_time.observe_ns(addblock * 1000000);
+    total_time.observe_ns((block_processing_time + addblock) * 1000000);
+  }
+
   bvc.m_added_to_main_chain = true;
   ++m_sync_counter;
 
@@ -4307,12 +4400,309 @@ void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const b
     if (m_cancel)
        break;
     crypto::hash id = get_block_hash(block);
-    crypto::hash pow = get_block_longhash(this, block, height++, 0, ctx);
+    crypto::hash pow;
+    if (!get_checked_header_pow(block, id, pow))
+      pow = get_block_longhash(this, block, height, 0, ctx);
+    ++height;
     map.emplace(id, pow);
   }
 
   TIME_MEASURE_FINISH(t);
 }
+//------------------------------------------------------------------
+bool Blockchain::get_checked_header_pow(const block &b, const crypto::hash &id, crypto::hash &pow) const
+{
+  boost::unique_lock<boost::mutex> lock(m_checked_headers_lock);
+  const auto i = m_checked_header_heights.find(id);
+  if (i == m_checked_header_heights.end())
+    return false;
+  const checked_header &h = m_checked_headers[i->second - m_checked_headers_start];
+  if (h.nonce8 != b.nonce8 || h.nonce != b.nonce || memcmp(&h.cycle, &b.cycle, sizeof(h.cycle)))
+  {
+    MDEBUG("Block " << id << " has a different nonce or cycle than its checked header");
+    return false;
+  }
+  pow = h.pow;
+  return true;
+}
+//------------------------------------------------------------------
+void Blockchain::prune_checked_headers()
+{
+  const uint64_t db_height = m_db->height();
+  while (!m_checked_headers.empty() && m_checked_headers_start < db_height && m_db->get_block_hash_from_height(m_checked_headers_start) == m_checked_headers.front().id)
+  {
+    m_checked_headers_base = m_checked_headers.front().id;
+    m_checked_header_heights.erase(m_checked_headers_base);
+    m_checked_headers.pop_front();
+    ++m_checked_headers_start;
+  }
+  if (m_checked_headers.empty())
+    return;
+  if (m_checked_headers_start > db_height || m_db->get_block_hash_from_height(m_checked_headers_start - 1) != m_checked_headers_base)
+  {
+    MDEBUG("Checked headers no longer follow from the main chain, dropping them");
+    m_checked_headers.clear();
+    m_checked_header_heights.clear();
+  }
+}
+//------------------------------------------------------------------
+bool Blockchain::check_block_headers(uint64_t start_height, const std::vector<compact_block_header> &headers, const std::vector<crypto::hash> &ids, uint64_t &checked, difficulty_type &cumulative_difficulty)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  checked = 0;
+  cumulative_difficulty = 0;
+  CHECK_AND_ASSERT_MES(headers.size() == ids.size(), false, "Mismatched header and id counts");
+  if (headers.empty())
+    return true;
+
+  // the headers must hash to the ids we were given, and chain up
+  for (size_t i = 0; i < headers.size(); ++i)
+  {
+    if (get_compact_block_header_hash(headers[i]) != ids[i])
+    {
+      MERROR_VER("Header at height " << start_height + i << " does not hash to " << ids[i]);
+      return false;
+    }
+    if (i > 0 && headers[i].prev_id != ids[i - 1])
+    {
+      MERROR_VER("Header " << ids[i] << " does not follow from " << ids[i - 1]);
+      return false;
+    }
+  }
+
+  size_t first = 0;
+  std::vector<difficulty_type> difficulties;
+  std::vector<checked_header> new_headers;
+  {
+    // the read txn is a consistent view of the chain, m_blockchain_lock is only
+    // needed to keep the result, as the chain may have moved on by then
+    boost::unique_lock<boost::mutex> lock(m_checked_headers_lock);
+    db_rtxn_guard rtxn_guard(m_db);
+    prune_checked_headers();
+
+    const uint64_t db_height = m_db->height();
+    const uint64_t checked_end = m_checked_headers_start + m_checked_headers.size();
+    const auto get_known = [&](uint64_t height, crypto::hash &id, uint64_t &timestamp, difficulty_type &cumulative_difficulty, uint8_t &major_version) {
+      if (height < db_height)
+      {
+        id = m_db->get_block_hash_from_height(height);
+        timestamp = m_db->get_block_timestamp(height);
+        cumulative_difficulty = m_db->get_block_cumulative_difficulty(height);
+        major_version = m_db->get_hard_fork_version(height);
+      }
+      else
+      {
+        const checked_header &h = m_checked_headers[height - m_checked_headers_start];
+        id = h.id;
+        timestamp = h.timestamp;
+        cumulative_difficulty = h.cumulative_difficulty;
+        major_version = h.major_version;
+      }
+    };
+
+    // skip what we already know, in the main chain or from earlier headers
+    for (; first < headers.size(); ++first)
+    {
+      const uint64_t height = start_height + first;
+      if (height >= db_height && (m_checked_headers.empty() || height < m_checked_headers_start || height >= checked_end))
+        break;
+      crypto::hash id;
+      uint64_t timestamp;
+      uint8_t major_version;
+      get_known(height, id, timestamp, cumulative_difficulty, major_version);
+      if (id != ids[first])
+        break;
+    }
+    checked = first;
+    if (first == headers.size() || first == 0)
+    {
+      // either all known, or not following from anything we know, in which case normal sync will deal with it
+      if (first == 0)
+        cumulative_difficulty = 0;
+      return true;
+    }
+
+    // timestamps and cumulative difficulties before the first new header, as get_difficulty_for_next_block uses
+    const uint64_t height = start_height + first;
+    std::vector<uint64_t> timestamps;
+    std::vector<difficulty_type> cumulative_difficulties;
+    uint64_t window_start = height - std::min<uint64_t>(height, DIFFICULTY_BLOCKS_COUNT);
+    if (window_start == 0)
+      ++window_start;
+    timestamps.reserve(DIFFICULTY_BLOCKS_COUNT + 1);
+    cumulative_difficulties.reserve(DIFFICULTY_BLOCKS_COUNT + 1);
+    crypto::hash id;
+    uint64_t timestamp;
+    uint8_t major_version = 0;
+    for (uint64_t h = window_start; h < height; ++h)
+    {
+      get_known(h, id, timestamp, cumulative_difficulty, major_version);
+      timestamps.push_back(timestamp);
+      cumulative_difficulties.push_back(cumulative_difficulty);
+    }
+    get_known(height - 1, id, timestamp, cumulative_difficulty, major_version);
+
+    const size_t target = get_difficulty_target();
+    difficulties.reserve(headers.size() - first);
+    new_headers.reserve(headers.size() - first);
+    for (size_t i = first; i < headers.size(); ++i)
+    {
+      const compact_block_header &header = headers[i];
+      const uint64_t h = start_height + i;
+      if (header.major_version < major_version)
+      {
+        MERROR_VER("Header " << ids[i] << " at height " << h << " has version " << (unsigned)header.major_version << ", lower than its parent's " << (unsigned)major_version);
+        return false;
+      }
+      major_version = header.major_version;
+      if (header.timestamp > get_adjusted_time() + CRYPTONOTE_BLOCK_FUTURE_TIME_LIMIT)
+      {
+        MERROR_VER("Timestamp of header " << ids[i] << ", " << header.timestamp << ", bigger than adjusted time + 2 hours");
+        return false;
+      }
+      if (timestamps.size() >= BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+      {
+        std::vector<uint64_t> recent(timestamps.end() - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW, timestamps.end());
+        const uint64_t median_ts = epee::misc_utils::median(recent);
+        if (header.timestamp < median_ts)
+        {
+          MERROR_VER("Timestamp of header " << ids[i] << ", " << header.timestamp << ", less than median of last " << BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW << " blocks, " << median_ts);
+          return false;
+        }
+      }
+      if (!m_checkpoints.check_block(h, ids[i]))
+      {
+        MERROR_VER("Header " << ids[i] << " at height " << h << " fails checkpoints");
+        return false;
+      }
+
+      difficulty_type difficulty;
+      if (m_fixed_difficulty)
+        difficulty = m_fixed_difficulty;
+      else
+        difficulty = next_difficulty(timestamps, cumulative_difficulties, target, h, m_hardfork->get_last_diff_reset_height(h), m_hardfork->get_last_diff_reset_value(h));
+      CHECK_AND_ASSERT_MES(difficulty, false, "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!");
+      difficulties.push_back(difficulty);
+      cumulative_difficulty += difficulty;
+      new_headers.push_back({ids[i], crypto::null_hash, header.timestamp, cumulative_difficulty, header.major_version, header.nonce8, header.nonce, header.cycle});
+
+      timestamps.push_back(header.timestamp);
+      cumulative_difficulties.push_back(cumulative_difficulty);
+      if (timestamps.size() > DIFFICULTY_BLOCKS_COUNT)
+      {
+        timestamps.erase(timestamps.begin());
+        cumulative_difficulties.erase(cumulative_difficulties.begin());
+      }
+    }
+  }
+
+  // the proof of work needs no lock, so other threads can add blocks meanwhile
+  TIME_MEASURE_START(pow_time);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+  const size_t chunk = (new_headers.size() + threads - 1) / threads;
+  for (size_t begin = 0; begin < new_headers.size(); begin += chunk)
+  {
+    const size_t end = std::min(begin + chunk, new_headers.size());
+    tpool.submit(&waiter, [&, begin, end]() {
+      cn_pow_hash_v3 ctx;
+      for (size_t i = begin; i < end && !m_cancel; ++i)
+        new_headers[i].pow = get_block_longhash(headers[first + i], ctx);
+    }, true);
+  }
+  waiter.wait(&tpool);
+  TIME_MEASURE_FINISH(pow_time);
+  if (m_cancel)
+    return true;
+  for (size_t i = 0; i < new_headers.size(); ++i)
+  {
+    if (!check_hash(new_headers[i].pow, difficulties[i]))
+    {
+      MERROR_VER("Header " << new_headers[i].id << " at height " << start_height + first + i << " does not have enough proof of work: " << new_headers[i].pow << ", difficulty " << difficulties[i]);
+      return false;
+    }
+  }
+  MDEBUG("Checked " << new_headers.size() << " headers from height " << start_height + first << " in " << pow_time << " ms");
+
+  // keep them, unless the chain moved under us while checking
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  boost::unique_lock<boost::mutex> lock(m_checked_headers_lock);
+  prune_checked_headers();
+  const uint64_t height = start_height + first;
+  const uint64_t db_height = m_db->height();
+  const crypto::hash &base = ids[first - 1];
+  if (height - 1 < db_height)
+  {
+    if (m_db->get_block_hash_from_height(height - 1) != base)
+      return true;
+    for (const checked_header &h: m_checked_headers)
+      m_checked_header_heights.erase(h.id);
+    m_checked_headers.clear();
+    m_checked_headers_start = height;
+    m_checked_headers_base = base;
+  }
+  else
+  {
+    if (m_checked_headers.empty() || height - 1 < m_checked_headers_start || height - 1 >= m_checked_headers_start + m_checked_headers.size()
+        || m_checked_headers[height - 1 - m_checked_headers_start].id != base)
+      return true;
+    while (m_checked_headers_start + m_checked_headers.size() > height)
+    {
+      m_checked_header_heights.erase(m_checked_headers.back().id);
+      m_checked_headers.pop_back();
+    }
+  }
+  for (size_t i = 0; i < new_headers.size(); ++i)
+  {
+    m_checked_header_heights[new_headers[i].id] = height + i;
+    m_checked_headers.push_back(new_headers[i]);
+  }
+  checked = headers.size();
+  cumulative_difficulty = new_headers.back().cumulative_difficulty;
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::get_compact_block_headers(uint64_t start_height, size_t count, std::vector<blobdata> &headers) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  headers.clear();
+
+  // the read txn is a consistent view of the chain, so the blobs can be read
+  // without m_blockchain_lock, and parsed once out of the txn too
+  std::vector<blobdata> blobs;
+  try
+  {
+    db_rtxn_guard rtxn_guard(m_db);
+    if (start_height + count > m_db->height())
+    {
+      MERROR("Failed to get blocks from height " << start_height << " to " << start_height + count << ", height is " << m_db->height());
+      return false;
+    }
+    blobs.reserve(count);
+    for (uint64_t height = start_height; height < start_height + count; ++height)
+      blobs.push_back(m_db->get_block_blob_from_height(height));
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to get blocks from height " << start_height << ": " << e.what());
+    return false;
+  }
+
+  headers.reserve(count);
+  for (size_t i = 0; i < blobs.size(); ++i)
+  {
+    block b;
+    if (!parse_and_validate_block_from_blob(blobs[i], b))
+    {
+      MERROR("Failed to parse block at height " << start_height + i);
+      headers.clear();
+      return false;
+    }
+    headers.push_back(t_serializable_object_to_blob(get_compact_block_header(b)));
+  }
+  return true;
+}
 
 //------------------------------------------------------------------
 bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
@@ -42,6 +42,7 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <unordered_map>
 #include <unordered_set>
@@ -242,6 +243,39 @@ namespace cryptonote
      */
     bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry>  &blocks_entry, std::vector<block> &blocks);
 
+    /**
+     * @brief checks a run of block headers before the block bodies are downloaded
+     *
+     * The headers must hash to the given ids and follow on from a block in the
+     * main chain, or from headers checked earlier. Their timestamps, checkpoints,
+     * difficulty and proof of work are checked, the latter in parallel, and the
+     * resulting proof of work hashes are kept so bodies with the same nonce and
+     * cycle do not need hashing again when they arrive.
+     *
+     * @param start_height the height of the first header
+     * @param headers the headers
+     * @param ids the ids announced for those headers
+     * @param checked return-by-reference the number of leading headers now known good
+     * @param cumulative_difficulty return-by-reference the cumulative difficulty at the last known good header
+     *
+     * @return false if a header is invalid, true otherwise, even if not all could be checked
+     */
+    bool check_block_headers(uint64_t start_height, const std::vector<compact_block_header> &headers, const std::vector<crypto::hash> &ids, uint64_t &checked, difficulty_type &cumulative_difficulty);
+
+    /**
+     * @brief gets compact headers for a run of main chain blocks
+     *
+     * The blocks are read in one read transaction, without the blockchain
+     * lock, and parsed after it ends.
+     *
+     * @param start_height the height of the first block
+     * @param count the number of blocks
+     * @param headers return-by-reference the serialized headers
+     *
+     * @return false if a block could not be found or parsed, true otherwise
+     */
+    bool get_compact_block_headers(uint64_t start_height, size_t count, std::vector<blobdata> &headers) const;
+
     /**
      * @brief incoming blocks post-processing, cleanup, and disk sync
      *
@@ -454,6 +488,25 @@ namespace cryptonote
      */
     bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_count) const;
 
+    /**
+     * @brief get the range of recent blocks for a foreign chain, without loading them
+     *
+     * Like the above, but only works out which blocks to send, for callers
+     * which then read them from the db themselves. The size limit is applied
+     * to block weights, which are never below the blob sizes, so the range
+     * never covers more than the above would return.
+     *
+     * @param req_start_block if non-zero, specifies a start point (otherwise find most recent commonality)
+     * @param qblock_ids the foreign chain's "short history" (see get_short_chain_history)
+     * @param total_height return-by-reference our current blockchain height
+     * @param start_height return-by-reference the height of the first block of the range
+     * @param count return-by-reference the number of blocks in the range
+     * @param max_count the max number of blocks to get
+     *
+     * @return true if a block found in common or req_start_block specified, else false
+     */
+    bool find_blockchain_supplement_range(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& total_height, uint64_t& start_height, size_t& count, size_t max_count) const;
+
     /**
      * @brief retrieves a set of blocks and their transactions, and possibly other transactions
      *
@@ -568,6 +621,35 @@ namespace cryptonote
      */
     bool check_tx_inputs(transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
+    /**
+     * @brief validates a transaction's inputs, except for the ringct signatures
+     *
+     * Does all the checks of check_tx_inputs which need the chain (key images,
+     * ring members, ring size rules, expanding the rct signatures), but leaves
+     * the ringct signature verification to verify_tx_input_signatures, which
+     * does not need the blockchain lock and so can run in parallel for a batch.
+     *
+     * @param tx the transaction to validate
+     * @param max_used_block_height return-by-reference block height of most recent input
+     * @param max_used_block_id return-by-reference block hash of most recent input
+     * @param tvc returned information about tx verification
+     *
+     * @return false if any checked input is invalid, otherwise true
+     */
+    bool check_tx_inputs_no_signatures(transaction& tx, uint64_t& max_used_block_height, crypto::hash& max_used_block_id, tx_verification_context &tvc) const;
+
+    /**
+     * @brief verifies the ringct signatures of a transaction
+     *
+     * The transaction must have been expanded by check_tx_inputs_no_signatures
+     * first. Transactions without ringct signatures pass.
+     *
+     * @param tx the transaction to verify
+     *
+     * @return false if the signatures do not verify, otherwise true
+     */
+    static bool verify_tx_input_signatures(const transaction& tx);
+
     /**
      * @brief get fee quantization mask
      *
@@ -958,6 +1040,27 @@ namespace cryptonote
     void block_longhash_worker(uint64_t height, const epee::span<const block> &blocks,
         std::unordered_map<crypto::hash, crypto::hash> &map) const;
 
+    /**
+     * @brief looks up the proof of work hash of a block whose header was checked ahead
+     *
+     * The block id does not cover the nonce and cycle, so the proof of work
+     * is only reused if those match the checked header's too.
+     *
+     * @param b the block
+     * @param id the block id
+     * @param pow return-by-reference the proof of work hash
+     *
+     * @return true if the header was checked, false otherwise
+     */
+    bool get_checked_header_pow(const block &b, const crypto::hash &id, crypto::hash &pow) const;
+
+    /**
+     * @brief drops checked headers which made it to the main chain, or no longer follow from it
+     *
+     * Must be called with both the blockchain and checked headers locks held.
+     */
+    void prune_checked_headers();
+
     /**
      * @brief returns a set of known alternate chains
      *
@@ -1052,6 +1155,24 @@ namespace cryptonote
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
 
+    // headers checked ahead of their bodies, following on from m_checked_headers_base
+    struct checked_header
+    {
+      crypto::hash id;
+      crypto::hash pow;
+      uint64_t timestamp;
+      difficulty_type cumulative_difficulty;
+      uint8_t major_version;
+      uint64_t nonce8;
+      uint32_t nonce;
+      crypto::cycle cycle;
+    };
+    mutable boost::mutex m_checked_headers_lock;
+    std::deque<checked_header> m_checked_headers;
+    std::unordered_map<crypto::hash, uint64_t> m_checked_header_heights;
+    uint64_t m_checked_headers_start;
+    crypto::hash m_checked_headers_base;
+
     // Keccak hashes for each block and for fast pow checking
     std::vector<std::pair<crypto::hash, crypto::hash>> m_blocks_hash_of_hashes;
     std::vector<std::pair<crypto::hash, uint64_t>> m_blocks_hash_check;
@@ -1188,10 +1309,11 @@ namespace cryptonote
      * @param tx the transaction to validate
      * @param tvc returned information about tx verification
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
+     * @param verify_signatures false to skip the ringct signature verification
      *
      * @return false if any validation step fails, otherwise true
      */
-    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL) const;
+    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL, bool verify_signatures = true) const;
 
     /**
      * @brief performs a blockchain reorganization according to the longest chain rule
@@ -126,6 +126,10 @@ namespace cryptonote
     "sync-pruned-blocks"
   , "Allow syncing from nodes with only pruned blocks"
   };
+  const command_line::arg_descriptor<bool> arg_sync_headers_first  = {
+    "sync-headers-first"
+  , "Ask peers for block headers, and check their proof of work before downloading the blocks"
+  };
 
   static const command_line::arg_descriptor<bool> arg_test_drop_download = {
     "test-drop-download"
@@ -342,6 +346,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_disable_dns_checkpoints);
     command_line::add_arg(desc, arg_block_download_max_size);
     command_line::add_arg(desc, arg_sync_pruned_blocks);
+    command_line::add_arg(desc, arg_sync_headers_first);
     command_line::add_arg(desc, arg_max_txpool_weight);
     command_line::add_arg(desc, arg_block_notify);
     command_line::add_arg(desc, arg_prune_blockchain);
@@ -471,8 +476,11 @@ namespace cryptonote
     bool r = handle_command_line(vm);
     CHECK_AND_ASSERT_MES(r, false, "Failed to handle command line");
 
+    std::string db_type = command_line::get_arg(vm, cryptonote::arg_db_type);
     std::string db_sync_mode = command_line::get_arg(vm, cryptonote::arg_db_sync_mode);
     bool db_salvage = command_line::get_arg(vm, cryptonote::arg_db_salvage) != 0;
+    bool db_compress_txs = command_line::get_arg(vm, cryptonote::arg_db_compress_txs) != 0;
+    bool db_stats = command_line::get_arg(vm, cryptonote::arg_db_stats) != 0;
     bool fast_sync = command_line::get_arg(vm, arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, arg_prep_blocks_threads);
     std::string check_updates_string = command_line::get_arg(vm, arg_check_updates);
@@ -505,10 +513,10 @@ namespace cryptonote
     // folder might not be a directory, etc, etc
     catch (...) { }
 
-    std::unique_ptr<BlockchainDB> db(new_db());
+    std::unique_ptr<BlockchainDB> db(new_db(db_type));
     if (db == NULL)
     {
-      LOG_ERROR("Failed to initialize a database");
+      LOG_ERROR("Failed to initialize a database of type " << db_type);
       return false;
     }
 
@@ -607,6 +615,10 @@ namespace cryptonote
 
       if (db_salvage)
         db_flags |= DBF_SALVAGE;
+      if (db_compress_txs)
+        db_flags |= DBF_COMPRESS_TXS;
+      if (db_stats)
+        db_flags |= DBF_STATS;
 
       db->open(filename, db_flags);
       if(!db->m_open)
@@ -1045,6 +1057,22 @@ namespace cryptonote
     if (!tx_info.empty())
       handle_incoming_tx_accumulated_batch(tx_info, tx_relay == relay_method::block);
 
+    // check the inputs of the whole batch up front, so adding each tx below
+    // only holds the pool lock for the key image checks and the insert
+    if (tx_relay != relay_method::block)
+    {
+      std::vector<std::tuple<crypto::hash, transaction*, size_t>> precheck;
+      precheck.reserve(tx_info.size());
+      for (size_t i = 0; i < tx_blobs.size(); i++) {
+        if (!results[i].res || already_have[i])
+          continue;
+        const size_t weight = results[i].tx.pruned ? get_pruned_transaction_weight(results[i].tx) : get_transaction_weight(results[i].tx, tx_blobs[i].blob.size());
+        precheck.push_back(std::make_tuple(results[i].hash, &results[i].tx, weight));
+      }
+      if (!precheck.empty())
+        m_mempool.precheck_tx_inputs(precheck);
+    }
+
     bool valid_events = false;
     bool ok = true;
     it = tx_blobs.begin();
@@ -1071,6 +1099,8 @@ namespace cryptonote
       {
         MDEBUG("tx added: " << results[i].hash);
         valid_events = true;
+        if (m_zmq_pub && matches_category(tx_relay, relay_category::legacy))
+          results[i].blob = tx_blobs[i].blob;
       }
       else
         results[i].res = false;
@@ -1362,6 +1392,16 @@ namespace cryptonote
     return m_blockchain_storage.find_blockchain_supplement(qblock_ids, clip_pruned, resp);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_compact_block_headers(uint64_t start_height, size_t count, std::vector<blobdata> &headers) const
+  {
+    return m_blockchain_storage.get_compact_block_headers(start_height, count, headers);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::check_block_headers(uint64_t start_height, const std::vector<compact_block_header> &headers, const std::vector<crypto::hash> &ids, uint64_t &checked, difficulty_type &cumulative_difficulty)
+  {
+    return m_blockchain_storage.check_block_headers(start_height, headers, ids, checked, cumulative_difficulty);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_count) const
   {
     return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, blocks, total_height, start_height, pruned, get_miner_tx_hash, max_count);
@@ -1576,6 +1616,11 @@ namespace cryptonote
     return m_mempool.get_transactions_count(include_sensitive_txes);
   }
   //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_pool_cookie() const
+  {
+    return m_mempool.cookie();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block(const crypto::hash& id) const
   {
     return m_blockchain_storage.have_block(id);
@@ -1943,6 +1988,11 @@ namespace cryptonote
     return m_mempool.get_complement(hashes, txes);
   }
   //-----------------------------------------------------------------------------------------------
+  void core::get_pool_short_id_index(const crypto::hash &salt, std::unordered_map<uint64_t, crypto::hash> &index) const
+  {
+    m_mempool.get_short_id_index(salt, index);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::update_blockchain_pruning()
   {
     return m_blockchain_storage.update_blockchain_pruning();
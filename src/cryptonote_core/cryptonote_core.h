@@ -70,6 +70,7 @@ namespace cryptonote
   extern const command_line::arg_descriptor<bool> arg_offline;
   extern const command_line::arg_descriptor<size_t> arg_block_download_max_size;
   extern const command_line::arg_descriptor<bool> arg_sync_pruned_blocks;
+  extern const command_line::arg_descriptor<bool> arg_sync_headers_first;
 
   /************************************************************************/
   /*                                                                      */
@@ -531,6 +532,13 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count(bool include_sensitive_txes = false) const;
 
+     /**
+      * @copydoc tx_memory_pool::cookie
+      *
+      * @note see tx_memory_pool::cookie
+      */
+     uint64_t get_pool_cookie() const;
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
@@ -559,6 +567,20 @@ namespace cryptonote
       */
      bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, bool clip_pruned, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) const;
 
+     /**
+      * @copydoc Blockchain::get_compact_block_headers
+      *
+      * @note see Blockchain::get_compact_block_headers
+      */
+     bool get_compact_block_headers(uint64_t start_height, size_t count, std::vector<blobdata> &headers) const;
+
+     /**
+      * @copydoc Blockchain::check_block_headers
+      *
+      * @note see Blockchain::check_block_headers
+      */
+     bool check_block_headers(uint64_t start_height, const std::vector<compact_block_header> &headers, const std::vector<crypto::hash> &ids, uint64_t &checked, difficulty_type &cumulative_difficulty);
+
      /**
       * @copydoc Blockchain::find_blockchain_supplement(const uint64_t, const std::list<crypto::hash>&, std::vector<std::pair<cryptonote::blobdata, std::vector<cryptonote::blobdata> > >&, uint64_t&, uint64_t&, size_t) const
       *
@@ -875,6 +897,13 @@ namespace cryptonote
       */
      bool get_txpool_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes);
 
+     /**
+      * @copydoc tx_memory_pool::get_short_id_index
+      *
+      * @note see tx_memory_pool::get_short_id_index
+      */
+     void get_pool_short_id_index(const crypto::hash &salt, std::unordered_map<uint64_t, crypto::hash> &index) const;
+
    private:
 
      /**
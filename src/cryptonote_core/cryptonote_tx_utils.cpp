@@ -640,9 +640,8 @@ namespace cryptonote
     //cn_slow_hash(main_height, seed_height, seed_hash.data, bd.data(), bd.size(), res.data, 0, 1);
   }
 
-  bool get_block_longhash(const Blockchain *pbc, const block& b, crypto::hash& res, const uint64_t height, const int miners, cn_pow_hash_v3& ctx)
+  static void get_block_longhash(const block_header& b, const blobdata& bd, crypto::hash& res, cn_pow_hash_v3& ctx)
   {
-    blobdata bd = get_block_hashing_blob(b);
     if (b.major_version >= HF_VERSION_CUCKOO) {
         uint32_t edges[32];
         for(int i = 0; i < 32; i++) edges[i] = b.cycle.data[i];
@@ -652,9 +651,21 @@ namespace cryptonote
     else{
         ctx.hash(bd.data(), bd.size(), res.data);
     }
+  }
+
+  bool get_block_longhash(const Blockchain *pbc, const block& b, crypto::hash& res, const uint64_t height, const int miners, cn_pow_hash_v3& ctx)
+  {
+    get_block_longhash(b, get_block_hashing_blob(b), res, ctx);
     return true;
   }
 
+  crypto::hash get_block_longhash(const compact_block_header& h, cn_pow_hash_v3& ctx)
+  {
+    crypto::hash p = crypto::null_hash;
+    get_block_longhash(h, get_block_hashing_blob(h), p, ctx);
+    return p;
+  }
+
   crypto::hash get_block_longhash(const Blockchain *pbc, const block& b, const uint64_t height, const int miners, cn_pow_hash_v3& ctx)
   {
     crypto::hash p = crypto::null_hash;
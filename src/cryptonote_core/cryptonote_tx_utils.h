@@ -139,6 +139,7 @@ namespace cryptonote
   void get_altblock_longhash(const block& b, crypto::hash& res, const uint64_t main_height, const uint64_t height,
     const uint64_t seed_height, const crypto::hash& seed_hash);
   crypto::hash get_block_longhash(const Blockchain *pb, const block& b, const uint64_t height, const int miners, cn_pow_hash_v3& ctx);
+  crypto::hash get_block_longhash(const compact_block_header& h, cn_pow_hash_v3& ctx);
   void get_block_longhash_reorg(const uint64_t split_height);
 
 }
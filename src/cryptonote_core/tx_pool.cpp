@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <algorithm>
+#include <cmath>
 #include <boost/filesystem.hpp>
 #include <unordered_set>
 #include <vector>
@@ -43,8 +44,11 @@
 #include "common/boost_serialization_helper.h"
 #include "int-util.h"
 #include "misc_language.h"
+#include "profile_tools.h"
 #include "warnings.h"
+#include "common/metrics.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "crypto/hash.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -67,6 +71,11 @@ namespace cryptonote
     time_t const MAX_RELAY_TIME = (60 * 60 * 4); // at most that many seconds between resends
     float const ACCEPT_THRESHOLD = 1.0f;
 
+    tools::metrics::counter &admission_counter(const char *result)
+    {
+      return tools::metrics::registry::getInstance().get_counter("monero_txpool_admissions_total", "Transactions offered to the pool, by outcome", "result", result);
+    }
+
     // a kind of increasing backoff within min/max bounds
     uint64_t get_relay_delay(time_t now, time_t received)
     {
@@ -91,20 +100,166 @@ namespace cryptonote
     }
   }
   //---------------------------------------------------------------------------------
+  void txpool_meta_index::clear()
+  {
+    m_meta.clear();
+    m_by_receive_time.clear();
+    m_by_last_relayed_time.clear();
+    m_broadcasted = 0;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_meta_index::erase_from_index(time_index &index, time_t t, const crypto::hash &txid)
+  {
+    const auto range = index.equal_range(t);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second == txid)
+      {
+        index.erase(it);
+        return;
+      }
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_meta_index::insert(const crypto::hash &txid, const txpool_tx_meta_t &meta)
+  {
+    erase(txid);
+    m_meta.emplace(txid, meta);
+    m_by_receive_time.emplace(meta.receive_time, txid);
+    m_by_last_relayed_time.emplace(meta.last_relayed_time, txid);
+    if (meta.matches(relay_category::broadcasted))
+      ++m_broadcasted;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_meta_index::erase(const crypto::hash &txid)
+  {
+    const auto it = m_meta.find(txid);
+    if (it == m_meta.end())
+      return;
+    const txpool_tx_meta_t &meta = it->second;
+    erase_from_index(m_by_receive_time, meta.receive_time, txid);
+    erase_from_index(m_by_last_relayed_time, meta.last_relayed_time, txid);
+    if (meta.matches(relay_category::broadcasted))
+      --m_broadcasted;
+    m_meta.erase(it);
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_meta_index::pending::apply()
+  {
+    for (const change &c: m_changes)
+    {
+      if (c.insert)
+        m_index.insert(c.txid, c.meta);
+      else
+        m_index.erase(c.txid);
+    }
+    m_changes.clear();
+  }
+  //---------------------------------------------------------------------------------
+  const txpool_tx_meta_t *txpool_meta_index::find(const crypto::hash &txid) const
+  {
+    const auto it = m_meta.find(txid);
+    return it == m_meta.end() ? NULL : &it->second;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_meta_index::matches(const crypto::hash &txid, relay_category category) const
+  {
+    const txpool_tx_meta_t *meta = find(txid);
+    return meta && meta->matches(category);
+  }
+  //---------------------------------------------------------------------------------
+  size_t txpool_meta_index::count(relay_category category) const
+  {
+    if (category == relay_category::all)
+      return m_meta.size();
+    if (category == relay_category::broadcasted)
+      return m_broadcasted;
+    size_t n = 0;
+    for (const auto &e: m_meta)
+      if (e.second.matches(category))
+        ++n;
+    return n;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_meta_index::for_each(const std::function<bool(const crypto::hash&, const txpool_tx_meta_t&)> &f, relay_category category) const
+  {
+    for (const auto &e: m_meta)
+    {
+      if (!e.second.matches(category))
+        continue;
+      if (!f(e.first, e.second))
+        return false;
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  size_t txpool_template_candidates::get_bucket(double fee_per_byte)
+  {
+    if (!(fee_per_byte >= 1.0))
+      return 0;
+    const double b = std::log2(fee_per_byte) * 4 + 1;
+    return b >= NUM_BUCKETS - 1 ? NUM_BUCKETS - 1 : (size_t)b;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_template_candidates::key_compare::operator()(const key &a, const key &b) const
+  {
+    if (std::get<0>(a) != std::get<0>(b))
+      return std::get<0>(a) > std::get<0>(b);
+    if (std::get<1>(a) != std::get<1>(b))
+      return std::get<1>(a) < std::get<1>(b);
+    return memcmp(&std::get<2>(a), &std::get<2>(b), sizeof(crypto::hash)) < 0;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_template_candidates::clear()
+  {
+    for (bucket &b: m_buckets)
+      b.clear();
+    m_keys.clear();
+    m_size = 0;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_template_candidates::insert(entry e)
+  {
+    erase(e.txid);
+    const size_t b = get_bucket(e.fee_per_byte);
+    const crypto::hash txid = e.txid;
+    key k(e.fee_per_byte, e.receive_time, e.txid);
+    const auto it = m_buckets[b].emplace(std::move(k), std::move(e)).first;
+    m_keys[txid] = std::make_pair(b, it);
+    ++m_size;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_template_candidates::erase(const crypto::hash &txid)
+  {
+    const auto k = m_keys.find(txid);
+    if (k == m_keys.end())
+      return;
+    m_buckets[k->second.first].erase(k->second.second);
+    m_keys.erase(k);
+    --m_size;
+  }
+  //---------------------------------------------------------------------------------
+  txpool_template_candidates::entry *txpool_template_candidates::find(const crypto::hash &txid)
+  {
+    const auto k = m_keys.find(txid);
+    return k == m_keys.end() ? NULL : &k->second.second->second;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_template_candidates::reset_readiness()
+  {
+    for (bucket &b: m_buckets)
+      for (auto &e: b)
+        e.second.ready_top = crypto::null_hash;
+  }
+  //---------------------------------------------------------------------------------
   //---------------------------------------------------------------------------------
   tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_cookie(0)
   {
 
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_hash,*/ const crypto::hash &id, const cryptonote::blobdata &blob, size_t tx_weight, tx_verification_context& tvc, relay_method tx_relay, bool relayed, uint8_t version)
+  bool tx_memory_pool::check_tx_admission(const transaction &tx, const crypto::hash &id, size_t tx_weight, bool kept_by_block, uint8_t version, uint64_t &fee, tx_verification_context &tvc) const
   {
-    const bool kept_by_block = (tx_relay == relay_method::block);
-
-    // this should already be called with that lock, but let's make it explicit for clarity
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-
-    PERF_TIMER(add_tx);
     if (tx.version == 0)
     {
       // v0 never accepted
@@ -130,9 +285,6 @@ namespace cryptonote
       return false;
     }
 
-    // fee per kilobyte, size rounded up.
-    uint64_t fee;
-
     if (tx.version == 1)
     {
       uint64_t inputs_amount = 0;
@@ -181,6 +333,30 @@ namespace cryptonote
       return false;
     }
 
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_hash,*/ const crypto::hash &id, const cryptonote::blobdata &blob, size_t tx_weight, tx_verification_context& tvc, relay_method tx_relay, bool relayed, uint8_t version)
+  {
+    const bool kept_by_block = (tx_relay == relay_method::block);
+
+    // this should already be called with that lock, but let's make it explicit for clarity
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    static tools::metrics::counter &rejected = admission_counter("rejected");
+    TIME_MEASURE_NS_START(pool_lock_time);
+    const auto pool_lock_guard = epee::misc_utils::create_scope_leave_handler([&]() {
+      TIME_MEASURE_NS_FINISH(pool_lock_time);
+      m_admission_stats.pool_lock_ns += pool_lock_time;
+      if (tvc.m_verifivation_failed)
+        rejected.inc();
+    });
+
+    PERF_TIMER(add_tx);
+    // fee per kilobyte, size rounded up.
+    uint64_t fee;
+    if (!check_tx_admission(tx, id, tx_weight, kept_by_block, version, fee, tvc))
+      return false;
+
     // if the transaction came from a block popped from the chain,
     // don't check if we have its key images as spent.
     // TODO: Investigate why not?
@@ -243,8 +419,9 @@ namespace cryptonote
             return false;
 
           m_blockchain.add_txpool_tx(id, blob, meta);
-          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id);
-          lock.commit();
+          add_tx_to_sorted_containers(tx, id, tx_weight, fee, receive_time);
+          if (lock.commit())
+            m_meta_index.insert(id, meta);
         }
         catch (const std::exception &e)
         {
@@ -289,8 +466,9 @@ namespace cryptonote
           return false;
 
         m_blockchain.add_txpool_tx(id, blob, meta);
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id);
-        lock.commit();
+        add_tx_to_sorted_containers(tx, id, tx_weight, fee, receive_time);
+        if (lock.commit())
+          m_meta_index.insert(id, meta);
       }
       catch (const std::exception &e)
       {
@@ -307,6 +485,9 @@ namespace cryptonote
     m_txpool_weight += tx_weight;
 
     ++m_cookie;
+    ++m_admission_stats.txs_added;
+    static tools::metrics::counter &added = admission_counter("added");
+    added.inc();
 
     MINFO("Transaction added to pool: txid " << id << " weight: " << tx_weight << " fee/byte: " << (fee / (double)(tx_weight ? tx_weight : 1)));
 
@@ -326,6 +507,96 @@ namespace cryptonote
     return add_tx(tx, h, bl, get_transaction_weight(tx, bl.size()), tvc, tx_relay, relayed, version);
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::precheck_tx_inputs(const std::vector<std::tuple<crypto::hash, transaction*, size_t>> &txs)
+  {
+    struct precheck
+    {
+      crypto::hash txid;
+      transaction *tx;
+      bool res;
+      tx_verification_context tvc;
+      uint64_t max_used_block_height;
+      crypto::hash max_used_block_id;
+    };
+
+    TIME_MEASURE_NS_START(check_time);
+    std::vector<precheck> checks;
+    checks.reserve(txs.size());
+    {
+      // leave the txes add_tx rejects cheaply to add_tx, checking their
+      // inputs would only cost a low fee or double spending relay CPU time
+      const uint8_t version = m_blockchain.get_current_hard_fork_version();
+      CRITICAL_REGION_LOCAL(m_transactions_lock);
+      for (const auto &e: txs)
+      {
+        const crypto::hash &txid = std::get<0>(e);
+        const transaction &tx = *std::get<1>(e);
+        if (m_input_cache.find(txid) != m_input_cache.end())
+          continue;
+        uint64_t fee;
+        tx_verification_context tvc{};
+        if (!check_tx_admission(tx, txid, std::get<2>(e), false, version, fee, tvc) || have_tx_keyimges_as_spent(tx, txid))
+          continue;
+        checks.push_back({txid, std::get<1>(e), false, {}, 0, null_hash});
+      }
+    }
+    if (checks.empty())
+      return;
+
+    // ring members, key images and chain rules, under one hold of the blockchain lock
+    crypto::hash top_id;
+    TIME_MEASURE_NS_START(chain_lock_time);
+    {
+      CRITICAL_REGION_LOCAL(m_blockchain);
+      top_id = m_blockchain.get_tail_id();
+      for (precheck &c: checks)
+      {
+        try
+        {
+          c.res = m_blockchain.check_tx_inputs_no_signatures(*c.tx, c.max_used_block_height, c.max_used_block_id, c.tvc);
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to check inputs of tx " << c.txid << ": " << e.what());
+          c.res = false;
+          c.tvc.m_verifivation_failed = true;
+        }
+      }
+    }
+    TIME_MEASURE_NS_FINISH(chain_lock_time);
+
+    // ringct signatures need no lock, verify them in parallel
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+    for (precheck &c: checks)
+    {
+      if (!c.res)
+        continue;
+      tpool.submit(&waiter, [&c] {
+        c.res = Blockchain::verify_tx_input_signatures(*c.tx);
+      });
+    }
+    waiter.wait(&tpool);
+
+    {
+      CRITICAL_REGION_LOCAL(m_transactions_lock);
+      CRITICAL_REGION_LOCAL1(m_blockchain);
+      // results are only valid for the chain they were checked against
+      if (m_blockchain.get_tail_id() == top_id)
+      {
+        for (const precheck &c: checks)
+          m_input_cache.insert(std::make_pair(c.txid, std::make_tuple(c.res, c.tvc, c.max_used_block_height, c.max_used_block_id)));
+      }
+    }
+
+    TIME_MEASURE_NS_FINISH(check_time);
+    ++m_admission_stats.batches;
+    m_admission_stats.txs_checked += checks.size();
+    m_admission_stats.check_ns += check_time;
+    m_admission_stats.chain_lock_ns += chain_lock_time;
+    MDEBUG("Prechecked inputs of " << checks.size() << " txes in " << check_time / 1000 << " us, blockchain lock held " << chain_lock_time / 1000 << " us");
+  }
+  //---------------------------------------------------------------------------------
   size_t tx_memory_pool::get_txpool_weight() const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -345,6 +616,7 @@ namespace cryptonote
       bytes = m_txpool_max_weight;
     CRITICAL_REGION_LOCAL1(m_blockchain);
     LockedTXN lock(m_blockchain.get_db());
+    txpool_meta_index::pending meta_changes(m_meta_index);
     bool changed = false;
 
     // this will never remove the first one, but we don't care
@@ -357,7 +629,7 @@ namespace cryptonote
       {
         const crypto::hash &txid = it->second;
         txpool_tx_meta_t meta;
-        if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+        if (!get_tx_meta(txid, meta))
         {
           MERROR("Failed to find tx_meta in txpool");
           return;
@@ -378,9 +650,11 @@ namespace cryptonote
         // remove first, in case this throws, so key images aren't removed
         MINFO("Pruning tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
         m_blockchain.remove_txpool_tx(txid);
+        meta_changes.erase(txid);
         m_txpool_weight -= meta.weight;
         remove_transaction_keyimages(tx, txid);
         MINFO("Pruned tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
+        m_template_candidates.erase(txid);
         m_txs_by_fee_and_receive_time.erase(it--);
         changed = true;
       }
@@ -390,7 +664,8 @@ namespace cryptonote
         return;
       }
     }
-    lock.commit();
+    if (lock.commit())
+      meta_changes.apply();
     if (changed)
       ++m_cookie;
     if (m_txpool_weight > bytes)
@@ -418,7 +693,7 @@ namespace cryptonote
 
       const bool new_or_previously_private =
         kei_image_set.insert(id).second ||
-        !m_blockchain.txpool_tx_matches_category(id, relay_category::legacy);
+        !m_meta_index.matches(id, relay_category::legacy);
       CHECK_AND_ASSERT_MES(new_or_previously_private, false, "internal error: try to insert duplicate iterator in key_image set");
     }
     ++m_cookie;
@@ -469,7 +744,7 @@ namespace cryptonote
     {
       LockedTXN lock(m_blockchain.get_db());
       txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(id, meta))
+      if (!get_tx_meta(id, meta))
       {
         MERROR("Failed to find tx_meta in txpool");
         return false;
@@ -500,7 +775,8 @@ namespace cryptonote
       m_blockchain.remove_txpool_tx(id);
       m_txpool_weight -= tx_weight;
       remove_transaction_keyimages(tx, id);
-      lock.commit();
+      if (lock.commit())
+        m_meta_index.erase(id);
     }
     catch (const std::exception &e)
     {
@@ -510,6 +786,7 @@ namespace cryptonote
 
     if (sorted_it != m_txs_by_fee_and_receive_time.end())
       m_txs_by_fee_and_receive_time.erase(sorted_it);
+    m_template_candidates.erase(id);
     ++m_cookie;
     return true;
   }
@@ -524,7 +801,7 @@ namespace cryptonote
     {
       LockedTXN lock(m_blockchain.get_db());
       txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+      if (!get_tx_meta(txid, meta))
       {
         MERROR("Failed to find tx in txpool");
         return false;
@@ -572,12 +849,12 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
 
-    m_blockchain.for_all_txpool_txes([this, &hashes, &txes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata*) {
+    const std::unordered_set<crypto::hash> known(hashes.begin(), hashes.end());
+    m_meta_index.for_each([this, &known, &txes](const crypto::hash &txid, const txpool_tx_meta_t &meta) {
       const auto tx_relay_method = meta.get_relay_method();
       if (tx_relay_method != relay_method::block && tx_relay_method != relay_method::fluff)
         return true;
-      const auto i = std::find(hashes.begin(), hashes.end(), txid);
-      if (i == hashes.end())
+      if (known.find(txid) == known.end())
       {
         cryptonote::blobdata bd;
         try
@@ -596,10 +873,25 @@ namespace cryptonote
         }
       }
       return true;
-    }, false);
+    }, relay_category::broadcasted);
     return true;
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::get_short_id_index(const crypto::hash &salt, std::unordered_map<uint64_t, crypto::hash> &index) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+
+    index.clear();
+    index.reserve(m_meta_index.count(relay_category::broadcasted));
+    m_meta_index.for_each([&salt, &index](const crypto::hash &txid, const txpool_tx_meta_t &meta) {
+      const uint64_t short_id = get_compact_block_short_id(salt, txid);
+      const auto res = index.emplace(short_id, txid);
+      if (!res.second)
+        res.first->second = crypto::null_hash;
+      return true;
+    }, relay_category::broadcasted);
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::on_idle()
   {
     m_remove_stuck_tx_interval.do_call([this](){return remove_stuck_transactions();});
@@ -607,6 +899,15 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
   {
+    // the sort key can be rebuilt from the metadata, fall back to a linear
+    // search if that fails (txCompare does not order equal fee/time entries)
+    const txpool_tx_meta_t *meta = m_meta_index.find(id);
+    if (meta)
+    {
+      const auto it = m_txs_by_fee_and_receive_time.find(tx_by_fee_and_receive_time_entry(std::pair<double, std::time_t>(meta->fee / (double)(meta->weight ? meta->weight : 1), meta->receive_time), id));
+      if (it != m_txs_by_fee_and_receive_time.end() && it->second == id)
+        return it;
+    }
     return std::find_if( m_txs_by_fee_and_receive_time.begin(), m_txs_by_fee_and_receive_time.end()
                        , [&](const sorted_tx_container::value_type& a){
                          return a.second == id;
@@ -614,17 +915,36 @@ namespace cryptonote
     );
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_tx_meta(const crypto::hash &txid, txpool_tx_meta_t &meta) const
+  {
+    const txpool_tx_meta_t *m = m_meta_index.find(txid);
+    if (!m)
+      return false;
+    meta = *m;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
   bool tx_memory_pool::remove_stuck_transactions()
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     std::list<std::pair<crypto::hash, uint64_t>> remove;
-    m_blockchain.for_all_txpool_txes([this, &remove](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata*) {
-      uint64_t tx_age = time(nullptr) - meta.receive_time;
+    const time_t now = time(nullptr);
+    const uint64_t min_livetime = std::min<uint64_t>(CRYPTONOTE_MEMPOOL_TX_LIVETIME, CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME);
+    for (const auto &e: m_meta_index.by_receive_time())
+    {
+      uint64_t tx_age = now - e.first;
+      // oldest first, so nothing after this can be stuck either
+      if (tx_age <= min_livetime)
+        break;
 
-      if((tx_age > CRYPTONOTE_MEMPOOL_TX_LIVETIME && !meta.kept_by_block) ||
-         (tx_age > CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME && meta.kept_by_block) )
+      const crypto::hash &txid = e.second;
+      const txpool_tx_meta_t *meta = m_meta_index.find(txid);
+      if (!meta)
+        continue;
+      if((tx_age > CRYPTONOTE_MEMPOOL_TX_LIVETIME && !meta->kept_by_block) ||
+         (tx_age > CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME && meta->kept_by_block) )
       {
         LOG_PRINT_L1("Tx " << txid << " removed from tx pool due to outdated, age: " << tx_age );
         auto sorted_it = find_tx_in_sorted_container(txid);
@@ -636,15 +956,16 @@ namespace cryptonote
         {
           m_txs_by_fee_and_receive_time.erase(sorted_it);
         }
+        m_template_candidates.erase(txid);
         m_timed_out_transactions.insert(txid);
-        remove.push_back(std::make_pair(txid, meta.weight));
+        remove.push_back(std::make_pair(txid, meta->weight));
       }
-      return true;
-    }, false, relay_category::all);
+    }
 
     if (!remove.empty())
     {
       LockedTXN lock(m_blockchain.get_db());
+      txpool_meta_index::pending meta_changes(m_meta_index);
       for (const std::pair<crypto::hash, uint64_t> &entry: remove)
       {
         const crypto::hash &txid = entry.first;
@@ -661,6 +982,7 @@ namespace cryptonote
           {
             // remove first, so we only remove key images if the tx removal succeeds
             m_blockchain.remove_txpool_tx(txid);
+            meta_changes.erase(txid);
             m_txpool_weight -= entry.second;
             remove_transaction_keyimages(tx, txid);
           }
@@ -671,7 +993,8 @@ namespace cryptonote
           // ignore error
         }
       }
-      lock.commit();
+      if (lock.commit())
+        meta_changes.apply();
       ++m_cookie;
     }
     return true;
@@ -683,20 +1006,28 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     const uint64_t now = time(NULL);
-    txs.reserve(m_blockchain.get_txpool_tx_count());
-    m_blockchain.for_all_txpool_txes([this, now, &txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *){
+    for (const auto &e: m_meta_index.by_last_relayed_time())
+    {
+      // least recently relayed first, and no tx is re-relayed before MIN_RELAY_TIME
+      if (now - e.first <= (uint64_t)MIN_RELAY_TIME)
+        break;
+
+      const crypto::hash &txid = e.second;
+      const txpool_tx_meta_t *meta = m_meta_index.find(txid);
+      if (!meta || !meta->matches(relay_category::relayable))
+        continue;
       // 0 fee transactions are never relayed
-      if(!meta.pruned && meta.fee > 0 && !meta.do_not_relay && now - meta.last_relayed_time > get_relay_delay(now, meta.receive_time))
+      if(!meta->pruned && meta->fee > 0 && !meta->do_not_relay && now - meta->last_relayed_time > get_relay_delay(now, meta->receive_time))
       {
         // if the tx is older than half the max lifetime, we don't re-relay it, to avoid a problem
         // mentioned by smooth where nodes would flush txes at slightly different times, causing
         // flushed txes to be re-added when received from a node which was just about to flush it
-        uint64_t max_age = meta.kept_by_block ? CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME : CRYPTONOTE_MEMPOOL_TX_LIVETIME;
-        if (now - meta.receive_time <= max_age / 2)
+        uint64_t max_age = meta->kept_by_block ? CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME : CRYPTONOTE_MEMPOOL_TX_LIVETIME;
+        if (now - meta->receive_time <= max_age / 2)
         {
           try
           {
-            txs.emplace_back(txid, m_blockchain.get_txpool_tx_blob(txid, relay_category::all), meta.get_relay_method());
+            txs.emplace_back(txid, m_blockchain.get_txpool_tx_blob(txid, relay_category::all), meta->get_relay_method());
           }
           catch (const std::exception &e)
           {
@@ -705,8 +1036,7 @@ namespace cryptonote
           }
         }
       }
-      return true;
-    }, false, relay_category::relayable);
+    }
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -716,17 +1046,19 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL1(m_blockchain);
     const time_t now = time(NULL);
     LockedTXN lock(m_blockchain.get_db());
+    txpool_meta_index::pending meta_changes(m_meta_index);
     for (const auto& hash : hashes)
     {
       try
       {
         txpool_tx_meta_t meta;
-        if (m_blockchain.get_txpool_tx_meta(hash, meta))
+        if (get_tx_meta(hash, meta))
         {
           meta.relayed = true;
           meta.last_relayed_time = now;
           meta.set_relay_method(method);
           m_blockchain.update_txpool_tx(hash, meta);
+          meta_changes.insert(hash, meta);
         }
       }
       catch (const std::exception &e)
@@ -735,14 +1067,15 @@ namespace cryptonote
         // continue
       }
     }
-    lock.commit();
+    if (lock.commit())
+      meta_changes.apply();
   }
   //---------------------------------------------------------------------------------
   size_t tx_memory_pool::get_transactions_count(bool include_sensitive) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    return m_blockchain.get_txpool_tx_count(include_sensitive);
+    return m_meta_index.count(include_sensitive ? relay_category::all : relay_category::broadcasted);
   }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::get_transactions(std::vector<transaction>& txs, bool include_sensitive) const
@@ -750,7 +1083,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
-    txs.reserve(m_blockchain.get_txpool_tx_count(include_sensitive));
+    txs.reserve(m_meta_index.count(category));
     m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
       transaction tx;
       if (!(meta.pruned ? parse_and_validate_tx_base_from_blob(*bd, tx) : parse_and_validate_tx_from_blob(*bd, tx)))
@@ -770,7 +1103,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
-    txs.reserve(m_blockchain.get_txpool_tx_count(include_sensitive));
+    txs.reserve(m_meta_index.count(category));
     m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
       txs.push_back(txid);
       return true;
@@ -783,11 +1116,11 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL1(m_blockchain);
     const uint64_t now = time(NULL);
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
-    backlog.reserve(m_blockchain.get_txpool_tx_count(include_sensitive));
-    m_blockchain.for_all_txpool_txes([&backlog, now](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
+    backlog.reserve(m_meta_index.count(category));
+    m_meta_index.for_each([&backlog, now](const crypto::hash &txid, const txpool_tx_meta_t &meta){
       backlog.push_back({meta.weight, meta.fee, meta.receive_time - now});
       return true;
-    }, false, category);
+    }, category);
   }
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_stats(struct txpool_stats& stats, bool include_sensitive) const
@@ -797,10 +1130,10 @@ namespace cryptonote
     const uint64_t now = time(NULL);
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
     std::map<uint64_t, txpool_histo> agebytes;
-    stats.txs_total = m_blockchain.get_txpool_tx_count(include_sensitive);
+    stats.txs_total = m_meta_index.count(category);
     std::vector<uint32_t> weights;
     weights.reserve(stats.txs_total);
-    m_blockchain.for_all_txpool_txes([&stats, &weights, now, &agebytes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
+    m_meta_index.for_each([&stats, &weights, now, &agebytes](const crypto::hash &txid, const txpool_tx_meta_t &meta){
       weights.push_back(meta.weight);
       stats.bytes_total += meta.weight;
       if (!stats.bytes_min || meta.weight < stats.bytes_min)
@@ -822,9 +1155,15 @@ namespace cryptonote
       if (meta.double_spend_seen)
         ++stats.num_double_spends;
       return true;
-    }, false, category);
+    }, category);
 
     stats.bytes_med = epee::misc_utils::median(weights);
+    stats.admission_batches = m_admission_stats.batches;
+    stats.admission_txs_checked = m_admission_stats.txs_checked;
+    stats.admission_txs_added = m_admission_stats.txs_added;
+    stats.admission_check_us = m_admission_stats.check_ns / 1000;
+    stats.admission_chain_lock_us = m_admission_stats.chain_lock_ns / 1000;
+    stats.admission_pool_lock_us = m_admission_stats.pool_lock_ns / 1000;
     if (stats.txs_total > 1)
     {
       /* looking for 98th percentile */
@@ -882,7 +1221,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     const relay_category category = include_sensitive_data ? relay_category::all : relay_category::broadcasted;
-    const size_t count = m_blockchain.get_txpool_tx_count(include_sensitive_data);
+    const size_t count = m_meta_index.count(category);
     tx_infos.reserve(count);
     key_image_infos.reserve(count);
     m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos, include_sensitive_data](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
@@ -925,7 +1264,7 @@ namespace cryptonote
       ki.id_hash = epee::string_tools::pod_to_hex(k_image);
       for (const crypto::hash& tx_id_hash : kei_image_set)
       {
-        if (m_blockchain.txpool_tx_matches_category(tx_id_hash, category))
+        if (m_meta_index.matches(tx_id_hash, category))
           ki.txs_hashes.push_back(epee::string_tools::pod_to_hex(tx_id_hash));
       }
 
@@ -940,8 +1279,8 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    tx_infos.reserve(m_blockchain.get_txpool_tx_count());
-    key_image_infos.reserve(m_blockchain.get_txpool_tx_count());
+    tx_infos.reserve(m_meta_index.count(relay_category::broadcasted));
+    key_image_infos.reserve(m_meta_index.count(relay_category::broadcasted));
     m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
       cryptonote::rpc::tx_in_pool txi;
       txi.tx_hash = txid;
@@ -974,7 +1313,7 @@ namespace cryptonote
       const std::unordered_set<crypto::hash>& kei_image_set = kee.second;
       for (const crypto::hash& tx_id_hash : kei_image_set)
       {
-        if (m_blockchain.txpool_tx_matches_category(tx_id_hash, relay_category::broadcasted))
+        if (m_meta_index.matches(tx_id_hash, relay_category::broadcasted))
           tx_hashes.push_back(tx_id_hash);
       }
 
@@ -998,7 +1337,7 @@ namespace cryptonote
       if (found != m_spent_key_images.end())
       {
         for (const crypto::hash& tx_hash : found->second)
-          is_spent |= m_blockchain.txpool_tx_matches_category(tx_hash, relay_category::broadcasted);
+          is_spent |= m_meta_index.matches(tx_hash, relay_category::broadcasted);
       }
       spent.push_back(is_spent);
     }
@@ -1033,6 +1372,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
     m_parsed_tx_cache.clear();
+    m_template_candidates.reset_readiness();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -1040,7 +1380,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    return m_blockchain.get_db().txpool_has_tx(id, tx_category);
+    return m_meta_index.matches(id, tx_category);
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimges_as_spent(const transaction& tx, const crypto::hash& txid) const
@@ -1066,7 +1406,7 @@ namespace cryptonote
       // See `insert_key_images`.
       if (1 < found->second.size() || *(found->second.cbegin()) != txid)
         return true;
-      return m_blockchain.txpool_tx_matches_category(txid, relay_category::legacy);
+      return m_meta_index.matches(txid, relay_category::legacy);
     }
     return false;
   }
@@ -1167,24 +1507,57 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::have_key_images(const std::unordered_set<crypto::key_image>& k_images, const transaction_prefix& tx)
+  bool tx_memory_pool::is_candidate_still_ready(const txpool_template_candidates::entry &candidate, uint64_t height) const
   {
-    for(size_t i = 0; i!= tx.vin.size(); i++)
+    if (candidate.ready_top == null_hash || candidate.ready_height >= height)
+      return false;
+    if (candidate.ready_version != m_blockchain.get_current_hard_fork_version())
+      return false;
+    if (m_blockchain.get_block_id_by_height(candidate.ready_height) != candidate.ready_top)
+      return false;
+    for (const crypto::key_image &ki: candidate.key_images)
+      if (m_blockchain.have_tx_keyimg_as_spent(ki))
+        return false;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::add_tx_to_sorted_containers(const transaction_prefix &tx, const crypto::hash &txid, uint64_t weight, uint64_t fee, time_t receive_time)
+  {
+    const double fee_per_byte = fee / (double)(weight ? weight : 1);
+    m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee_per_byte, receive_time), txid);
+
+    txpool_template_candidates::entry e;
+    e.fee_per_byte = fee_per_byte;
+    e.receive_time = receive_time;
+    e.txid = txid;
+    e.weight = weight;
+    e.fee = fee;
+    e.key_images.reserve(tx.vin.size());
+    for (const auto &in: tx.vin)
+      if (in.type() == typeid(txin_to_key))
+        e.key_images.push_back(boost::get<txin_to_key>(in).k_image);
+    e.ready_height = 0;
+    e.ready_top = null_hash;
+    e.ready_version = 0;
+    m_template_candidates.insert(std::move(e));
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::have_key_images(const std::unordered_set<crypto::key_image>& k_images, const std::vector<crypto::key_image>& key_images)
+  {
+    for (const crypto::key_image &k_image: key_images)
     {
-      CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, false);
-      if(k_images.count(itk.k_image))
+      if(k_images.count(k_image))
         return true;
     }
     return false;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::append_key_images(std::unordered_set<crypto::key_image>& k_images, const transaction_prefix& tx)
+  bool tx_memory_pool::append_key_images(std::unordered_set<crypto::key_image>& k_images, const std::vector<crypto::key_image>& key_images)
   {
-    for(size_t i = 0; i!= tx.vin.size(); i++)
+    for (const crypto::key_image &k_image: key_images)
     {
-      CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, false);
-      auto i_res = k_images.insert(itk.k_image);
-      CHECK_AND_ASSERT_MES(i_res.second, false, "internal error: key images pool cache - inserted duplicate image in set: " << itk.k_image);
+      auto i_res = k_images.insert(k_image);
+      CHECK_AND_ASSERT_MES(i_res.second, false, "internal error: key images pool cache - inserted duplicate image in set: " << k_image);
     }
     return true;
   }
@@ -1195,6 +1568,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL1(m_blockchain);
     bool changed = false;
     LockedTXN lock(m_blockchain.get_db());
+    txpool_meta_index::pending meta_changes(m_meta_index);
     for(size_t i = 0; i!= tx.vin.size(); i++)
     {
       CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, void());
@@ -1204,7 +1578,7 @@ namespace cryptonote
         for (const crypto::hash &txid: it->second)
         {
           txpool_tx_meta_t meta;
-          if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+          if (!get_tx_meta(txid, meta))
           {
             MERROR("Failed to find tx meta in txpool");
             // continue, not fatal
@@ -1218,6 +1592,7 @@ namespace cryptonote
             try
             {
               m_blockchain.update_txpool_tx(txid, meta);
+              meta_changes.insert(txid, meta);
             }
             catch (const std::exception &e)
             {
@@ -1228,7 +1603,8 @@ namespace cryptonote
         }
       }
     }
-    lock.commit();
+    if (lock.commit())
+      meta_changes.apply();
     if (changed)
       ++m_cookie;
   }
@@ -1288,32 +1664,37 @@ namespace cryptonote
     size_t max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
     std::unordered_set<crypto::key_image> k_images;
 
-    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
+    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_template_candidates.size() << " txes in the pool");
 
     LockedTXN lock(m_blockchain.get_db());
+    txpool_meta_index::pending meta_changes(m_meta_index);
+
+    const uint64_t height = m_blockchain.get_current_blockchain_height();
+    const crypto::hash top_id = m_blockchain.get_block_id_by_height(height - 1);
+    const uint8_t hf_version = m_blockchain.get_current_hard_fork_version();
 
-    auto sorted_it = m_txs_by_fee_and_receive_time.begin();
-    for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
+    m_template_candidates.for_each_by_fee([&](txpool_template_candidates::entry &candidate)
     {
+      const crypto::hash &txid = candidate.txid;
       txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta) || !meta.matches(relay_category::legacy))
+      if (!get_tx_meta(txid, meta) || !meta.matches(relay_category::legacy))
       {
         MERROR("  failed to find tx meta");
-        continue;
+        return true;
       }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
+      LOG_PRINT_L2("Considering " << txid << ", weight " << candidate.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
 
       if (meta.pruned)
       {
         LOG_PRINT_L2("  tx is pruned");
-        continue;
+        return true;
       }
 
       // Can not exceed maximum block weight
-      if (max_total_weight < total_weight + meta.weight)
+      if (max_total_weight < total_weight + candidate.weight)
       {
         LOG_PRINT_L2("  would exceed maximum block weight");
-        continue;
+        return true;
       }
 
       // start using the optimal filling algorithm from v5
@@ -1322,16 +1703,16 @@ namespace cryptonote
         // If we're getting lower coinbase tx,
         // stop including more tx
         uint64_t block_reward;
-        if(!get_block_reward(median_weight, total_weight + meta.weight, already_generated_coins, block_reward, version))
+        if(!get_block_reward(median_weight, total_weight + candidate.weight, already_generated_coins, block_reward, version))
         {
           LOG_PRINT_L2("  would exceed maximum block weight");
-          continue;
+          return true;
         }
-        coinbase = block_reward + fee + meta.fee;
+        coinbase = block_reward + fee + candidate.fee;
         if (coinbase < template_accept_threshold(best_coinbase))
         {
           LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
-          continue;
+          return true;
         }
       }
       else
@@ -1341,60 +1722,80 @@ namespace cryptonote
         if (total_weight > median_weight)
         {
           LOG_PRINT_L2("  would exceed median block weight");
-          break;
+          return false;
         }
       }
 
-      // "local" and "stem" txes are filtered above
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second, relay_category::all);
-
-      cryptonote::transaction tx;
-
       // Skip transactions that are not ready to be
       // included into the blockchain or that are
-      // missing key images
-      const cryptonote::txpool_tx_meta_t original_meta = meta;
+      // missing key images. Txes found ready at an
+      // ancestor of the current top only need their
+      // key images checked against the newer blocks
       bool ready = false;
       try
       {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
+        ready = is_candidate_still_ready(candidate, height);
       }
       catch (const std::exception &e)
       {
         MERROR("Failed to check transaction readiness: " << e.what());
-        // continue, not fatal
+        // fall back to the full check
       }
-      if (memcmp(&original_meta, &meta, sizeof(meta)))
+      if (!ready)
       {
+        const cryptonote::txpool_tx_meta_t original_meta = meta;
         try
-	{
-	  m_blockchain.update_txpool_tx(sorted_it->second, meta);
-	}
+        {
+          // "local" and "stem" txes are filtered above
+          cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
+          cryptonote::transaction tx;
+          ready = is_transaction_ready_to_go(meta, txid, txblob, tx);
+        }
         catch (const std::exception &e)
-	{
-	  MERROR("Failed to update tx meta: " << e.what());
-	  // continue, not fatal
-	}
+        {
+          MERROR("Failed to check transaction readiness: " << e.what());
+          // continue, not fatal
+        }
+        if (memcmp(&original_meta, &meta, sizeof(meta)))
+        {
+          try
+          {
+            m_blockchain.update_txpool_tx(txid, meta);
+            meta_changes.insert(txid, meta);
+          }
+          catch (const std::exception &e)
+          {
+            MERROR("Failed to update tx meta: " << e.what());
+            // continue, not fatal
+          }
+        }
       }
       if (!ready)
       {
+        candidate.ready_top = null_hash;
         LOG_PRINT_L2("  not ready to go");
-        continue;
+        return true;
       }
-      if (have_key_images(k_images, tx))
+      candidate.ready_height = height - 1;
+      candidate.ready_top = top_id;
+      candidate.ready_version = hf_version;
+
+      if (have_key_images(k_images, candidate.key_images))
       {
         LOG_PRINT_L2("  key images already seen");
-        continue;
+        return true;
       }
 
-      bl.tx_hashes.push_back(sorted_it->second);
-      total_weight += meta.weight;
-      fee += meta.fee;
+      bl.tx_hashes.push_back(txid);
+      total_weight += candidate.weight;
+      fee += candidate.fee;
       best_coinbase = coinbase;
-      append_key_images(k_images, tx);
+      append_key_images(k_images, candidate.key_images);
       LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
-    }
-    lock.commit();
+      return true;
+    });
+    if (lock.commit())
+      meta_changes.apply();
 
     expected_reward = best_coinbase;
     LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
@@ -1428,6 +1829,7 @@ namespace cryptonote
     if (!remove.empty())
     {
       LockedTXN lock(m_blockchain.get_db());
+      txpool_meta_index::pending meta_changes(m_meta_index);
       for (const crypto::hash &txid: remove)
       {
         try
@@ -1440,10 +1842,11 @@ namespace cryptonote
             continue;
           }
           // remove tx from db first
+          auto sorted_it = find_tx_in_sorted_container(txid);
           m_blockchain.remove_txpool_tx(txid);
+          meta_changes.erase(txid);
           m_txpool_weight -= get_transaction_weight(tx, txblob.size());
           remove_transaction_keyimages(tx, txid);
-          auto sorted_it = find_tx_in_sorted_container(txid);
           if (sorted_it == m_txs_by_fee_and_receive_time.end())
           {
             LOG_PRINT_L1("Removing tx " << txid << " from tx pool, but it was not found in the sorted txs container!");
@@ -1452,6 +1855,7 @@ namespace cryptonote
           {
             m_txs_by_fee_and_receive_time.erase(sorted_it);
           }
+          m_template_candidates.erase(txid);
           ++n_removed;
         }
         catch (const std::exception &e)
@@ -1460,7 +1864,8 @@ namespace cryptonote
           // continue
         }
       }
-      lock.commit();
+      if (lock.commit())
+        meta_changes.apply();
     }
     if (n_removed > 0)
       ++m_cookie;
@@ -1474,6 +1879,8 @@ namespace cryptonote
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
+    m_template_candidates.clear();
+    m_meta_index.clear();
     m_spent_key_images.clear();
     m_txpool_weight = 0;
     std::vector<crypto::hash> remove;
@@ -1498,7 +1905,8 @@ namespace cryptonote
           MFATAL("Failed to insert key images from txpool tx");
           return false;
         }
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.weight, meta.receive_time), txid);
+        add_tx_to_sorted_containers(tx, txid, meta.weight, meta.fee, meta.receive_time);
+        m_meta_index.insert(txid, meta);
         m_txpool_weight += meta.weight;
         return true;
       }, true, relay_category::all);
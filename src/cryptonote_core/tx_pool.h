@@ -31,6 +31,8 @@
 #pragma once
 #include "include_base_utils.h"
 
+#include <functional>
+#include <map>
 #include <set>
 #include <tuple>
 #include <unordered_map>
@@ -79,6 +81,167 @@ namespace cryptonote
   //! container for sorting transactions by fee per unit size
   typedef std::set<tx_by_fee_and_receive_time_entry, txCompare> sorted_tx_container;
 
+  /**
+   * @brief in-memory copy of the txpool metadata stored in the database
+   *
+   * The txpool tables are only written by tx_memory_pool, which mirrors each
+   * successful write here. Queries which only need metadata can then be
+   * answered without walking the database, and the time ordered indices
+   * let age based scans stop as soon as the remaining entries are too young.
+   */
+  class txpool_meta_index
+  {
+  public:
+    typedef std::unordered_map<crypto::hash, txpool_tx_meta_t> container;
+    typedef std::multimap<time_t, crypto::hash> time_index;
+
+    /**
+     * @brief mirror changes made inside a db txn
+     *
+     * Changes are queued and only reach the index on apply(), which is to be
+     * called once the txn has committed, so an aborted txn leaves the index
+     * matching the database.
+     */
+    class pending
+    {
+    public:
+      explicit pending(txpool_meta_index &index): m_index(index) {}
+
+      //! queue an insert or replace
+      void insert(const crypto::hash &txid, const txpool_tx_meta_t &meta) { m_changes.push_back({txid, true, meta}); }
+
+      //! queue a removal
+      void erase(const crypto::hash &txid) { m_changes.push_back({txid, false, {}}); }
+
+      //! apply the queued changes in order, and forget them
+      void apply();
+
+    private:
+      struct change
+      {
+        crypto::hash txid;
+        bool insert;
+        txpool_tx_meta_t meta;
+      };
+
+      txpool_meta_index &m_index;
+      std::vector<change> m_changes;
+    };
+
+    txpool_meta_index(): m_broadcasted(0) {}
+
+    //! drop all entries
+    void clear();
+
+    //! add an entry, or replace the existing one for this txid
+    void insert(const crypto::hash &txid, const txpool_tx_meta_t &meta);
+
+    //! remove an entry, if present
+    void erase(const crypto::hash &txid);
+
+    //! look up an entry, NULL if not present
+    const txpool_tx_meta_t *find(const crypto::hash &txid) const;
+
+    //! true iff the txid is present and matches the given category
+    bool matches(const crypto::hash &txid, relay_category category) const;
+
+    //! number of entries matching the given category
+    size_t count(relay_category category) const;
+
+    //! calls f for each entry matching category, stops early if f returns false
+    bool for_each(const std::function<bool(const crypto::hash&, const txpool_tx_meta_t&)> &f, relay_category category) const;
+
+    //! txids ordered by the time they entered the pool, oldest first
+    const time_index &by_receive_time() const { return m_by_receive_time; }
+
+    //! txids ordered by the time they were last relayed, oldest first
+    const time_index &by_last_relayed_time() const { return m_by_last_relayed_time; }
+
+  private:
+    static void erase_from_index(time_index &index, time_t t, const crypto::hash &txid);
+
+    container m_meta;
+    time_index m_by_receive_time;
+    time_index m_by_last_relayed_time;
+    size_t m_broadcasted;
+  };
+
+  /**
+   * @brief block template candidates, bucketed by fee per weight unit
+   *
+   * Buckets cover a quarter power of two of fee rate each and keep their
+   * entries in an ordered map sorted like txCompare, so walking the buckets
+   * from the top gives the txes in m_txs_by_fee_and_receive_time order, and
+   * adding or removing a tx is logarithmic in its bucket. Each entry carries what fill_block_template needs to decide on a
+   * tx without reading and parsing its blob: weight, fee, key images, and
+   * the top block it was last found ready at.
+   */
+  class txpool_template_candidates
+  {
+  public:
+    static const size_t NUM_BUCKETS = 256;
+
+    struct entry
+    {
+      double fee_per_byte;
+      time_t receive_time;
+      crypto::hash txid;
+      uint64_t weight;
+      uint64_t fee;
+      std::vector<crypto::key_image> key_images;
+      uint64_t ready_height; //!< height of ready_top
+      crypto::hash ready_top; //!< top block when last found ready, null_hash if not known
+      uint8_t ready_version; //!< hard fork version when last found ready
+    };
+
+    txpool_template_candidates(): m_buckets(NUM_BUCKETS), m_size(0) {}
+
+    //! drop all entries
+    void clear();
+
+    //! add an entry, or replace the existing one for this txid
+    void insert(entry e);
+
+    //! remove an entry, if present
+    void erase(const crypto::hash &txid);
+
+    //! look up an entry, NULL if not present; valid until it is erased or replaced
+    entry *find(const crypto::hash &txid);
+
+    //! forget the readiness of every entry
+    void reset_readiness();
+
+    //! number of entries
+    size_t size() const { return m_size; }
+
+    //! calls f on entries from highest to lowest fee rate, stops early if f returns false
+    template<typename F> void for_each_by_fee(F f)
+    {
+      for (size_t b = NUM_BUCKETS; b-- > 0; )
+        for (auto &e: m_buckets[b])
+          if (!f(e.second))
+            return;
+    }
+
+    //! bucket index for a fee rate
+    static size_t get_bucket(double fee_per_byte);
+
+  private:
+    typedef std::tuple<double, time_t, crypto::hash> key;
+
+    //! same order as txCompare: highest fee rate first, then oldest first
+    struct key_compare
+    {
+      bool operator()(const key &a, const key &b) const;
+    };
+
+    typedef std::map<key, entry, key_compare> bucket;
+
+    std::vector<bucket> m_buckets;
+    std::unordered_map<crypto::hash, std::pair<size_t, bucket::iterator>> m_keys; //!< bucket index and position of each entry
+    size_t m_size;
+  };
+
   /**
    * @brief Transaction pool, handles transactions which are not part of a block
    *
@@ -131,6 +294,23 @@ namespace cryptonote
      */
     bool add_tx(transaction &tx, tx_verification_context& tvc, relay_method tx_relay, bool relayed, uint8_t version);
 
+    /**
+     * @brief check the inputs of a batch of transactions ahead of add_tx
+     *
+     * Transactions add_tx would reject on fee, weight or a key image
+     * already in the pool are skipped first, so they cost no ring or
+     * signature checks. Ring members, key images and chain rules are then
+     * checked for the whole batch under a single hold of the blockchain
+     * lock, and the ringct signatures are verified in parallel without
+     * holding any lock. Results are stored in the input cache, so the
+     * following add_tx calls only hold the pool lock for the key image
+     * conflict checks and the insert. Results are dropped if the chain
+     * changed in the meantime.
+     *
+     * @param txs the transactions, their hashes and weights, as received from the network
+     */
+    void precheck_tx_inputs(const std::vector<std::tuple<crypto::hash, transaction*, size_t>> &txs);
+
     /**
      * @brief takes a transaction with the given hash from the pool
      *
@@ -446,6 +626,18 @@ namespace cryptonote
      */
     bool get_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes) const;
 
+    /**
+     * @brief map compact block short ids to the pool transactions they stand for
+     *
+     * Only broadcasted transactions are indexed, like get_complement.
+     * Short ids shared by more than one pool transaction map to null_hash,
+     * so the caller can tell a collision from a miss.
+     *
+     * @param salt the per block salt the short ids were computed with
+     * @param index return-by-reference the short id to txid map
+     */
+    void get_short_id_index(const crypto::hash &salt, std::unordered_map<uint64_t, crypto::hash> &index) const;
+
   private:
 
     /**
@@ -476,6 +668,24 @@ namespace cryptonote
      */
     bool have_tx_keyimg_as_spent(const crypto::key_image& key_im, const crypto::hash& txid) const;
 
+    /**
+     * @brief the checks add_tx makes before looking at a transaction's inputs
+     *
+     * Version, timeout, input types, fee and weight: everything which needs
+     * neither the chain's outputs nor signature verification.
+     *
+     * @param tx the transaction
+     * @param id the transaction's hash
+     * @param tx_weight the transaction's weight
+     * @param kept_by_block whether the transaction comes from a block
+     * @param version the current hard fork version
+     * @param fee return-by-reference the transaction's fee
+     * @param tvc return-by-reference the reason for a rejection
+     *
+     * @return true if the transaction passes these checks, otherwise false
+     */
+    bool check_tx_admission(const transaction &tx, const crypto::hash &id, size_t tx_weight, bool kept_by_block, uint8_t version, uint64_t &fee, tx_verification_context &tvc) const;
+
     /**
      * @brief check if any spent key image in a transaction is in the pool
      *
@@ -509,21 +719,21 @@ namespace cryptonote
      * @brief check if any of a transaction's spent key images are present in a given set
      *
      * @param kic the set of key images to check against
-     * @param tx the transaction to check
+     * @param key_images the transaction's key images
      *
      * @return true if any key images present in the set, otherwise false
      */
-    static bool have_key_images(const std::unordered_set<crypto::key_image>& kic, const transaction_prefix& tx);
+    static bool have_key_images(const std::unordered_set<crypto::key_image>& kic, const std::vector<crypto::key_image>& key_images);
 
     /**
      * @brief append the key images from a transaction to the given set
      *
      * @param kic the set of key images to append to
-     * @param tx the transaction
+     * @param key_images the transaction's key images
      *
      * @return false if any append fails, otherwise true
      */
-    static bool append_key_images(std::unordered_set<crypto::key_image>& kic, const transaction_prefix& tx);
+    static bool append_key_images(std::unordered_set<crypto::key_image>& kic, const std::vector<crypto::key_image>& key_images);
 
     /**
      * @brief check if a transaction is a valid candidate for inclusion in a block
@@ -537,6 +747,25 @@ namespace cryptonote
      */
     bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction&tx) const;
 
+    /**
+     * @brief check if a candidate found ready at an earlier top block still is
+     *
+     * Valid only if the chain merely grew on top of that block since then:
+     * ring members and fork rules are unchanged, so only the key images need
+     * checking against the new blocks.
+     *
+     * @param candidate the candidate to check
+     * @param height the current blockchain height
+     *
+     * @return true if known ready, false if a full check is needed
+     */
+    bool is_candidate_still_ready(const txpool_template_candidates::entry &candidate, uint64_t height) const;
+
+    /**
+     * @brief add a tx to the sorted container and the template candidates
+     */
+    void add_tx_to_sorted_containers(const transaction_prefix &tx, const crypto::hash &txid, uint64_t weight, uint64_t fee, time_t receive_time);
+
     /**
      * @brief mark all transactions double spending the one passed
      */
@@ -579,8 +808,27 @@ private:
     //!< container for transactions organized by fee per size and receive time
     sorted_tx_container m_txs_by_fee_and_receive_time;
 
+    //! mirror of the txpool metadata in the db, updated after each db write
+    txpool_meta_index m_meta_index;
+
+    //! pre-parsed block template candidates, same txes as m_txs_by_fee_and_receive_time
+    txpool_template_candidates m_template_candidates;
+
     std::atomic<uint64_t> m_cookie; //!< incremented at each change
 
+    //! transaction admission counters, reported in the pool stats
+    struct admission_stats
+    {
+      admission_stats(): batches(0), txs_checked(0), txs_added(0), check_ns(0), chain_lock_ns(0), pool_lock_ns(0) {}
+
+      std::atomic<uint64_t> batches; //!< batches passed to precheck_tx_inputs
+      std::atomic<uint64_t> txs_checked; //!< txes whose inputs were prechecked
+      std::atomic<uint64_t> txs_added; //!< txes added to the pool
+      std::atomic<uint64_t> check_ns; //!< time spent in precheck_tx_inputs
+      std::atomic<uint64_t> chain_lock_ns; //!< time the blockchain lock was held by prechecks
+      std::atomic<uint64_t> pool_lock_ns; //!< time the pool lock was held by add_tx
+    } m_admission_stats;
+
     /**
      * @brief get an iterator to a transaction in the sorted container
      *
@@ -590,6 +838,16 @@ private:
      */
     sorted_tx_container::iterator find_tx_in_sorted_container(const crypto::hash& id) const;
 
+    /**
+     * @brief get a transaction's metadata from the in-memory mirror
+     *
+     * @param txid the hash of the transaction
+     * @param meta return-by-reference the metadata
+     *
+     * @return true if the transaction is in the pool, otherwise false
+     */
+    bool get_tx_meta(const crypto::hash &txid, txpool_tx_meta_t &meta) const;
+
     //! cache/call Blockchain::check_tx_inputs results
     bool check_tx_inputs(const std::function<cryptonote::transaction&(void)> &get_tx, const crypto::hash &txid, uint64_t &max_used_block_height, crypto::hash &max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
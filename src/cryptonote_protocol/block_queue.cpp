@@ -40,6 +40,10 @@
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "cn.block_queue"
 
+#define PEER_STATS_WEIGHT 0.25f // weight of the latest measurement
+#define SPAN_TARGET_TIME 4.0f // seconds
+#define SPAN_MIN_SIZE_DIVISOR 4 // smallest span is the default size divided by this
+
 namespace std {
   static_assert(sizeof(size_t) <= sizeof(boost::uuids::uuid), "boost::uuids::uuid too small");
   template<> struct hash<boost::uuids::uuid> {
@@ -49,6 +53,14 @@ namespace std {
   };
 }
 
+namespace
+{
+  float average(float previous, float latest)
+  {
+    return previous + PEER_STATS_WEIGHT * (latest - previous);
+  }
+}
+
 namespace cryptonote
 {
 
@@ -113,6 +125,13 @@ void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_con
       erase_block(j);
     }
   }
+  for (auto i = peers.begin(); i != peers.end(); )
+  {
+    if (live_connections.find(i->first) == live_connections.end())
+      i = peers.erase(i);
+    else
+      ++i;
+  }
 }
 
 bool block_queue::remove_span(uint64_t start_block_height, std::vector<crypto::hash> *hashes)
@@ -305,6 +324,7 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
     return std::make_pair(0, 0);
   }
   MDEBUG("Reserving span " << span_start_height << " - " << (span_start_height + span_length - 1) << " for " << connection_id);
+  peers[connection_id].span_size = span_length;
   add_blocks(span_start_height, span_length, connection_id, time);
   set_span_hashes(span_start_height, connection_id, hashes);
   return std::make_pair(span_start_height, span_length);
@@ -539,4 +559,87 @@ bool block_queue::foreach(std::function<bool(const span&)> f) const
   return true;
 }
 
+void block_queue::update_peer_stats(const boost::uuids::uuid &connection_id, uint64_t nblocks, size_t size, float seconds)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  if (nblocks == 0 || seconds <= 0.0f)
+    return;
+  peer_stats &stats = peers[connection_id];
+  // the request time includes a round trip, which would make small spans look slow
+  const float transfer_time = std::max(seconds - stats.rtt, seconds / 4);
+  const float rate = size / transfer_time;
+  const float block_size = size / (float)nblocks;
+  stats.rate = stats.nspans ? average(stats.rate, rate) : rate;
+  stats.block_size = stats.nspans ? average(stats.block_size, block_size) : block_size;
+  ++stats.nspans;
+  stats.nblocks += nblocks;
+  stats.size += size;
+  MTRACE("Peer " << connection_id << ": " << stats.rate << " b/s, rtt " << stats.rtt << " s, " << stats.block_size << " bytes/block");
+}
+
+void block_queue::update_peer_rtt(const boost::uuids::uuid &connection_id, size_t size, float seconds)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  if (seconds <= 0.0f)
+    return;
+  peer_stats &stats = peers[connection_id];
+  float rtt = seconds;
+  if (stats.rate > 0.0f)
+    rtt = std::max(0.0f, rtt - size / stats.rate);
+  stats.rtt = stats.rtt > 0.0f ? average(stats.rtt, rtt) : rtt;
+}
+
+void block_queue::add_peer_stall(const boost::uuids::uuid &connection_id)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  ++peers[connection_id].nstalls;
+}
+
+uint64_t block_queue::get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_size) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peers.find(connection_id);
+  if (i == peers.end() || i->second.nspans == 0 || i->second.rate <= 0.0f || i->second.block_size <= 0.0f)
+    return default_size;
+  const peer_stats &stats = i->second;
+
+  // size the span so it downloads in about SPAN_TARGET_TIME at this peer's rate, so slow
+  // peers do not sit on large spans, and grow at most twofold per span to ride out noise
+  const float transfer_time = std::max(SPAN_TARGET_TIME - stats.rtt, SPAN_TARGET_TIME / 4);
+  const uint64_t min_size = std::max<uint64_t>(1, default_size / SPAN_MIN_SIZE_DIVISOR);
+  uint64_t max_size = BLOCKS_SYNCHRONIZING_MAX_COUNT;
+  if (stats.span_size)
+    max_size = std::min(max_size, std::max(default_size, 2 * stats.span_size));
+  const uint64_t span_size = stats.rate * transfer_time / stats.block_size;
+  return std::max(min_size, std::min(max_size, span_size));
+}
+
+float block_queue::get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peers.find(connection_id);
+  if (i == peers.end() || i->second.nspans == 0 || i->second.rate <= 0.0f)
+    return -1.0f;
+  return i->second.rtt + nblocks * i->second.block_size / i->second.rate;
+}
+
+bool block_queue::get_peer_stats(const boost::uuids::uuid &connection_id, peer_stats &stats) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peers.find(connection_id);
+  if (i == peers.end())
+    return false;
+  stats = i->second;
+  return true;
+}
+
+bool block_queue::foreach_peer(std::function<bool(const boost::uuids::uuid&, const peer_stats&)> f) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  for (const auto &i: peers)
+    if (!f(i.first, i.second))
+      return false;
+  return true;
+}
+
 }
@@ -33,6 +33,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
 #include <unordered_set>
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/uuid/uuid.hpp>
@@ -67,6 +68,20 @@ namespace cryptonote
     };
     typedef std::set<span> block_map;
 
+    struct peer_stats
+    {
+      float rate; // bytes per second, not counting the round trip
+      float rtt; // seconds
+      float block_size; // bytes
+      uint64_t span_size; // size of the last span reserved
+      uint64_t nspans;
+      uint64_t nblocks;
+      uint64_t size;
+      uint64_t nstalls; // spans downloaded again from another peer
+
+      peer_stats(): rate(0.0f), rtt(0.0f), block_size(0.0f), span_size(0), nspans(0), nblocks(0), size(0), nstalls(0) {}
+    };
+
   public:
     void add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
     void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, boost::posix_time::ptime time = boost::date_time::min_date_time);
@@ -94,6 +109,13 @@ namespace cryptonote
     float get_speed(const boost::uuids::uuid &connection_id) const;
     float get_download_rate(const boost::uuids::uuid &connection_id) const;
     bool foreach(std::function<bool(const span&)> f) const;
+    void update_peer_stats(const boost::uuids::uuid &connection_id, uint64_t nblocks, size_t size, float seconds);
+    void update_peer_rtt(const boost::uuids::uuid &connection_id, size_t size, float seconds);
+    void add_peer_stall(const boost::uuids::uuid &connection_id);
+    uint64_t get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_size) const;
+    float get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const;
+    bool get_peer_stats(const boost::uuids::uuid &connection_id, peer_stats &stats) const;
+    bool foreach_peer(std::function<bool(const boost::uuids::uuid&, const peer_stats&)> f) const;
     bool requested(const crypto::hash &hash) const;
     bool have(const crypto::hash &hash) const;
 
@@ -106,5 +128,6 @@ namespace cryptonote
     mutable boost::recursive_mutex mutex;
     std::unordered_set<crypto::hash> requested_hashes;
     std::unordered_set<crypto::hash> have_blocks;
+    std::map<boost::uuids::uuid, peer_stats> peers;
   };
 }
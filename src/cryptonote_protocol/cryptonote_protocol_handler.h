@@ -36,6 +36,7 @@
 
 #include <boost/program_options/variables_map.hpp>
 #include <string>
+#include <unordered_set>
 
 #include "math_helper.h"
 #include "storages/levin_abstract_invoke2.h"
@@ -92,6 +93,10 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, &cryptonote_protocol_handler::handle_notify_new_fluffy_block)			
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)						
       HANDLE_NOTIFY_T2(NOTIFY_GET_TXPOOL_COMPLEMENT, &cryptonote_protocol_handler::handle_notify_get_txpool_complement)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_TX_SKETCH, &cryptonote_protocol_handler::handle_request_tx_sketch)
+      HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_TX_SKETCH, &cryptonote_protocol_handler::handle_response_tx_sketch)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_RECONCILIATION_RESULT, &cryptonote_protocol_handler::handle_tx_reconciliation_result)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -127,6 +132,10 @@ namespace cryptonote
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
     int handle_notify_get_txpool_complement(int command, NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_request_tx_sketch(int command, NOTIFY_REQUEST_TX_SKETCH::request& arg, cryptonote_connection_context& context);
+    int handle_response_tx_sketch(int command, NOTIFY_RESPONSE_TX_SKETCH::request& arg, cryptonote_connection_context& context);
+    int handle_tx_reconciliation_result(int command, NOTIFY_TX_RECONCILIATION_RESULT::request& arg, cryptonote_connection_context& context);
 		
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
@@ -138,6 +147,7 @@ namespace cryptonote
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();
     bool should_download_next_span(cryptonote_connection_context& context, bool standby);
+    bool is_fastest_idle_peer(cryptonote_connection_context& context, const boost::uuids::uuid &exclude, uint64_t blockchain_height);
     bool should_ask_for_pruned_data(cryptonote_connection_context& context, uint64_t first_block_height, uint64_t nblocks, bool check_block_weights) const;
     void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
     void drop_connection_with_score(cryptonote_connection_context &context, unsigned int score, bool flush_all_spans);
@@ -148,6 +158,8 @@ namespace cryptonote
     void notify_new_stripe(cryptonote_connection_context &context, uint32_t stripe);
     void skip_unneeded_hashes(cryptonote_connection_context& context, bool check_block_queue) const;
     bool request_txpool_complement(cryptonote_connection_context &context);
+    void send_reconciled_txs(std::vector<cryptonote::blobdata> txs, cryptonote_connection_context &context);
+    bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::unordered_set<crypto::hash> &prefill);
 
     t_core& m_core;
 
@@ -170,6 +182,7 @@ namespace cryptonote
     uint64_t m_sync_download_chain_size, m_sync_download_objects_size;
     size_t m_block_download_max_size;
     bool m_sync_pruned_blocks;
+    bool m_sync_headers_first;
 
     // Values for sync time estimates
     boost::posix_time::ptime m_sync_start_time;
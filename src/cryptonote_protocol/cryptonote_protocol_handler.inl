@@ -72,6 +72,8 @@
 #define PASSIVE_PEER_KICK_TIME (60 * 1000000) // microseconds
 #define DROP_ON_SYNC_WEDGE_THRESHOLD (30 * 1000000000ull) // nanoseconds
 #define LAST_ACTIVITY_STALL_THRESHOLD (2.0f) // seconds
+#define REQUEST_NEXT_SCHEDULED_SPAN_STALL_FACTOR (2.0f) // times the expected download time
+#define REQUEST_NEXT_SCHEDULED_SPAN_STALL_MIN (1 * 1000000) // microseconds
 
 namespace cryptonote
 {
@@ -109,6 +111,7 @@ namespace cryptonote
 
     m_block_download_max_size = command_line::get_arg(vm, cryptonote::arg_block_download_max_size);
     m_sync_pruned_blocks = command_line::get_arg(vm, cryptonote::arg_sync_pruned_blocks);
+    m_sync_headers_first = command_line::get_arg(vm, cryptonote::arg_sync_headers_first);
 
     return true;
   }
@@ -142,6 +145,7 @@ namespace cryptonote
       m_core.get_short_chain_history(r.block_ids);
       handler_request_blocks_history( r.block_ids ); // change the limit(?), sleep(?)
       r.prune = m_sync_pruned_blocks;
+      r.headers = m_sync_headers_first;
       MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
       MLOG_PEER_STATE("requesting chain");
@@ -444,6 +448,12 @@ namespace cryptonote
       m_core.resume_mine();
       return 1;
     }
+    // txes we did not have are likely missing from our peers' pools too
+    std::unordered_set<crypto::hash> prefill;
+    if (!pblocks.empty())
+      for (const auto &tx_hash: pblocks[0].tx_hashes)
+        if (!m_core.pool_has_tx(tx_hash))
+          prefill.insert(tx_hash);
     for(auto tx_blob_it = arg.b.txs.begin(); tx_blob_it!=arg.b.txs.end();tx_blob_it++)
     {
       cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
@@ -476,7 +486,7 @@ namespace cryptonote
     if(bvc.m_added_to_main_chain)
     {
       //TODO: Add here announce protocol usage
-      relay_block(arg, context);
+      relay_block(arg, context, prefill);
     }else if(bvc.m_marked_as_orphaned)
     {
       context.m_needed_objects.clear();
@@ -484,6 +494,7 @@ namespace cryptonote
       NOTIFY_REQUEST_CHAIN::request r = {};
       m_core.get_short_chain_history(r.block_ids);
       r.prune = m_sync_pruned_blocks;
+      r.headers = m_sync_headers_first;
       handler_request_blocks_history( r.block_ids ); // change the limit(?), sleep(?)
       MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
@@ -541,6 +552,9 @@ namespace cryptonote
       // Also, remember to pepper some whitespace changes around to bother
       // moneromooo ... only because I <3 him. 
       std::vector<uint64_t> need_tx_indices;
+
+      // txes we did not have are likely missing from our peers' pools too
+      std::unordered_set<crypto::hash> prefill;
         
       transaction tx;
       crypto::hash tx_hash;
@@ -610,6 +624,7 @@ namespace cryptonote
           if(!m_core.pool_has_tx(tx_hash))
           {
             MDEBUG("Incoming tx " << tx_hash << " not in pool, adding");
+            prefill.insert(tx_hash);
             cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);                        
             if(!m_core.handle_incoming_tx(tx_blob, tvc, relay_method::block, true) || tvc.m_verifivation_failed)
             {
@@ -753,7 +768,7 @@ namespace cryptonote
           NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
           reg_arg.current_blockchain_height = arg.current_blockchain_height;
           reg_arg.b = b;
-          relay_block(reg_arg, context);
+          relay_block(reg_arg, context, prefill);
         }
         else if( bvc.m_marked_as_orphaned )
         {
@@ -763,6 +778,7 @@ namespace cryptonote
           m_core.get_short_chain_history(r.block_ids);
           handler_request_blocks_history( r.block_ids ); // change the limit(?), sleep(?)
           r.prune = m_sync_pruned_blocks;
+          r.headers = m_sync_headers_first;
           MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
           post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
           MLOG_PEER_STATE("requesting chain");
@@ -885,6 +901,189 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    static const size_t SHORT_ID_SIZE = NOTIFY_NEW_COMPACT_BLOCK::SHORT_ID_SIZE;
+
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK " << arg.block_hash << " (height " << arg.current_blockchain_height << ", " << arg.short_ids.size() / SHORT_ID_SIZE << " short ids, " << arg.prefilled_txs.size() << " prefilled txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized() || m_no_sync) // can happen if a peer connection goes to normal but another thread still hasn't finished adding queued blocks
+    {
+      LOG_DEBUG_CC(context, "Received new block while syncing, ignored");
+      return 1;
+    }
+    if(m_core.have_block(arg.block_hash))
+    {
+      LOG_DEBUG_CC(context, "Received compact block " << arg.block_hash << " which we already have, ignored");
+      return 1;
+    }
+
+    block new_block;
+    if(!parse_and_validate_block_from_blob(arg.block, new_block) || !new_block.tx_hashes.empty() || arg.short_ids.size() % SHORT_ID_SIZE)
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: failed to parse and validate block " << arg.block_hash << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    const size_t n_txes = arg.short_ids.size() / SHORT_ID_SIZE + arg.prefilled_txs.size();
+    if(n_txes > CRYPTONOTE_MAX_TX_PER_BLOCK)
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: too many txes (" << n_txes << "), dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // prefilled txes go in as is, the rest is looked up in our pool by short id
+    new_block.tx_hashes.resize(n_txes, crypto::null_hash);
+    std::vector<bool> prefilled(n_txes, false);
+    for(const auto &ptx: arg.prefilled_txs)
+    {
+      transaction tx;
+      if(ptx.index >= n_txes || prefilled[ptx.index] || !parse_and_validate_tx_from_blob(ptx.blob, tx, new_block.tx_hashes[ptx.index]))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong compact block: bad prefilled tx at index " << ptx.index << ", dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      prefilled[ptx.index] = true;
+    }
+
+    std::unordered_map<uint64_t, crypto::hash> short_id_index;
+    m_core.get_pool_short_id_index(get_compact_block_salt(arg.block_hash, arg.nonce), short_id_index);
+
+    std::vector<uint64_t> need_tx_indices;
+    const uint8_t *short_id = (const uint8_t*)arg.short_ids.data();
+    for(size_t tx_idx = 0; tx_idx < n_txes; ++tx_idx)
+    {
+      if(prefilled[tx_idx])
+        continue;
+      uint64_t id = 0;
+      for(size_t i = 0; i < SHORT_ID_SIZE; ++i)
+        id |= ((uint64_t)short_id[i]) << (8 * i);
+      short_id += SHORT_ID_SIZE;
+      const auto it = short_id_index.find(id);
+      if(it == short_id_index.end() || it->second == crypto::null_hash)
+        need_tx_indices.push_back(tx_idx);
+      else
+        new_block.tx_hashes[tx_idx] = it->second;
+    }
+
+    if(need_tx_indices.empty())
+    {
+      if(get_block_hash(new_block) == arg.block_hash)
+      {
+        MDEBUG("We have all needed txes for compact block " << arg.block_hash);
+        NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
+        fluffy_arg.b.block = t_serializable_object_to_blob(new_block);
+        fluffy_arg.current_blockchain_height = arg.current_blockchain_height;
+        for(auto &ptx: arg.prefilled_txs)
+          fluffy_arg.b.txs.push_back({std::move(ptx.blob), crypto::null_hash});
+        return handle_notify_new_fluffy_block(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffy_arg, context);
+      }
+
+      // a short id matched the wrong pool tx: ask for the plain fluffy block,
+      // which carries the full tx hashes
+      MDEBUG("Compact block " << arg.block_hash << " failed to reconstruct, falling back to fluffy block");
+    }
+    else
+    {
+      MDEBUG("We are missing " << need_tx_indices.size() << " txes for compact block " << arg.block_hash);
+
+      // the fluffy block we get back will only carry what we ask for
+      for(auto &ptx: arg.prefilled_txs)
+      {
+        const crypto::hash &tx_hash = new_block.tx_hashes[ptx.index];
+        if(m_core.pool_has_tx(tx_hash))
+          continue;
+        cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+        if(!m_core.handle_incoming_tx({std::move(ptx.blob), crypto::null_hash}, tvc, relay_method::block, true) || tvc.m_verifivation_failed)
+        {
+          LOG_PRINT_CCONTEXT_L1("Block verification failed: transaction verification failed, dropping connection");
+          drop_connection(context, false, false);
+          return 1;
+        }
+      }
+    }
+
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size() );
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_tx_sketch(int command, NOTIFY_REQUEST_TX_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TX_SKETCH (" << arg.set_size << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    NOTIFY_RESPONSE_TX_SKETCH::request r = AUTO_VAL_INIT(r);
+    if(!context.m_tx_reconciliation->make_sketch(arg.salt, arg.set_size, r.sketch))
+    {
+      LOG_DEBUG_CC(context, "Received NOTIFY_REQUEST_TX_SKETCH too soon after the last one, ignored");
+      return 1;
+    }
+    MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_TX_SKETCH: sketch.size()=" << r.sketch.size());
+    post_notify<NOTIFY_RESPONSE_TX_SKETCH>(r, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_response_tx_sketch(int command, NOTIFY_RESPONSE_TX_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_RESPONSE_TX_SKETCH (" << arg.sketch.size() << " bytes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    std::vector<cryptonote::blobdata> txs;
+    NOTIFY_TX_RECONCILIATION_RESULT::request r = AUTO_VAL_INIT(r);
+    if(!context.m_tx_reconciliation->finish_round(arg.sketch, txs, r.short_ids, r.success))
+    {
+      LOG_DEBUG_CC(context, "Received tx sketch without a reconciliation round in flight, ignored");
+      return 1;
+    }
+    if(!r.success)
+      MDEBUG("Tx reconciliation failed, exchanging " << txs.size() << " txes in full");
+
+    MLOG_P2P_MESSAGE("-->>NOTIFY_TX_RECONCILIATION_RESULT: success=" << r.success << ", short_ids.size()=" << r.short_ids.size());
+    post_notify<NOTIFY_TX_RECONCILIATION_RESULT>(r, context);
+    send_reconciled_txs(std::move(txs), context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_tx_reconciliation_result(int command, NOTIFY_TX_RECONCILIATION_RESULT::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_RECONCILIATION_RESULT (success " << arg.success << ", " << arg.short_ids.size() << " txes requested)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    std::vector<cryptonote::blobdata> txs;
+    context.m_tx_reconciliation->get_requested(arg.success, arg.short_ids, txs);
+    send_reconciled_txs(std::move(txs), context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::send_reconciled_txs(std::vector<cryptonote::blobdata> txs, cryptonote_connection_context &context)
+  {
+    if (txs.empty())
+      return;
+
+    NOTIFY_NEW_TRANSACTIONS::request r = AUTO_VAL_INIT(r);
+    r.txs = std::move(txs);
+    std::sort(r.txs.begin(), r.txs.end()); // don't leak receive order
+    MLOG_P2P_MESSAGE("-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << r.txs.size());
+    post_notify<NOTIFY_NEW_TRANSACTIONS>(r, context);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_get_txpool_complement(int command, NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_GET_TXPOOL_COMPLEMENT (" << arg.hashes.size() << " txes)");
@@ -924,6 +1123,9 @@ namespace cryptonote
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
 
+    // the peer has these, no need to reconcile them with it
+    context.m_tx_reconciliation->remove(arg.txs);
+
     // while syncing, core will lock for a long time, so we ignore
     // those txes as they aren't really needed anyway, and avoid a
     // long block before replying
@@ -1187,6 +1389,8 @@ namespace cryptonote
       const boost::posix_time::time_duration dt = now - request_time;
       const float rate = size * 1e6 / (dt.total_microseconds() + 1);
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.total_microseconds()/1e6 << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
+      if (!request_time.is_special())
+        m_block_queue.update_peer_stats(context.m_connection_id, arg.blocks.size(), size, dt.total_microseconds() / 1e6f);
       m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
 
       const crypto::hash last_block_hash = cryptonote::get_block_hash(b);
@@ -1714,6 +1918,18 @@ skip:
       LOG_ERROR_CCONTEXT("Failed to handle NOTIFY_REQUEST_CHAIN.");
       return 1;
     }
+    if (arg.headers && !r.m_block_ids.empty())
+    {
+      // headers are much larger than ids, so send fewer
+      if (r.m_block_ids.size() > BLOCKS_HEADERS_SYNCHRONIZING_COUNT)
+      {
+        r.m_block_ids.resize(BLOCKS_HEADERS_SYNCHRONIZING_COUNT);
+        if (r.m_block_weights.size() > BLOCKS_HEADERS_SYNCHRONIZING_COUNT)
+          r.m_block_weights.resize(BLOCKS_HEADERS_SYNCHRONIZING_COUNT);
+      }
+      if (!m_core.get_compact_block_headers(r.start_height, r.m_block_ids.size(), r.m_block_headers))
+        r.m_block_headers.clear();
+    }
     MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_CHAIN_ENTRY: m_start_height=" << r.start_height << ", m_total_height=" << r.total_height << ", m_block_ids.size()=" << r.m_block_ids.size());
     post_notify<NOTIFY_RESPONSE_CHAIN_ENTRY>(r, context);
     return 1;
@@ -1750,6 +1966,20 @@ skip:
           return true;
         }
 
+        // if the peer it was reserved for is well past the time it should have taken,
+        // let the fastest idle peer have a go at it too
+        if (dt >= REQUEST_NEXT_SCHEDULED_SPAN_STALL_MIN)
+        {
+          span = m_block_queue.get_next_span_if_scheduled(hashes, span_connection_id, request_time);
+          const float expected = m_block_queue.get_expected_span_time(connection_id, span.second);
+          if (span.second > 0 && expected > 0.0f && dt / 1e6f > expected * REQUEST_NEXT_SCHEDULED_SPAN_STALL_FACTOR && is_fastest_idle_peer(context, connection_id, blockchain_height))
+          {
+            MDEBUG(context << " we should download it as it's not been received after " << dt/1e6 << " seconds, "
+                << expected << " expected, and we are the fastest idle peer");
+            return true;
+          }
+        }
+
         // in standby, be ready to double download early since we're idling anyway
         // let the fastest peer trigger first
         long threshold;
@@ -1808,6 +2038,32 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::is_fastest_idle_peer(cryptonote_connection_context& context, const boost::uuids::uuid &exclude, uint64_t blockchain_height)
+  {
+    block_queue::peer_stats stats;
+    if (!m_block_queue.get_peer_stats(context.m_connection_id, stats) || stats.rate <= 0.0f)
+      return false;
+
+    bool fastest = true;
+    m_p2p->for_each_connection([&](cryptonote_connection_context& ctx, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+      if (ctx.m_connection_id == context.m_connection_id || ctx.m_connection_id == exclude)
+        return true;
+      const bool idle = ctx.m_state == cryptonote_connection_context::state_standby ||
+          (ctx.m_state == cryptonote_connection_context::state_synchronizing && ctx.m_last_request_time == boost::date_time::not_a_date_time);
+      if (!idle || ctx.m_remote_blockchain_height <= blockchain_height || !tools::has_unpruned_block(blockchain_height, ctx.m_remote_blockchain_height, ctx.m_pruning_seed))
+        return true;
+      block_queue::peer_stats ctx_stats;
+      if (m_block_queue.get_peer_stats(ctx.m_connection_id, ctx_stats) && ctx_stats.rate > stats.rate)
+      {
+        fastest = false;
+        return false;
+      }
+      return true;
+    });
+    return fastest;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::should_drop_connection(cryptonote_connection_context& context, uint32_t next_stripe)
   {
     if (context.m_anchor)
@@ -2042,7 +2298,7 @@ skip:
       NOTIFY_REQUEST_GET_OBJECTS::request req;
       bool is_next = false;
       size_t count = 0;
-      const size_t count_limit = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+      const size_t count_limit = m_block_queue.get_span_size(context.m_connection_id, m_core.get_block_sync_size(m_core.get_current_blockchain_height()));
       std::pair<uint64_t, uint64_t> span = std::make_pair(0, 0);
       if (force_next_span)
       {
@@ -2061,6 +2317,8 @@ skip:
               context.m_requested_objects.insert(hash);
             }
             m_block_queue.reset_next_span_time();
+            if (span_connection_id != context.m_connection_id)
+              m_block_queue.add_peer_stall(span_connection_id);
           }
         }
       }
@@ -2103,6 +2361,8 @@ skip:
         if (span.second > 0)
         {
           is_next = true;
+          if (span_connection_id != context.m_connection_id)
+            m_block_queue.add_peer_stall(span_connection_id);
           for (const auto &hash: hashes)
           {
             req.blocks.push_back(hash);
@@ -2243,6 +2503,7 @@ skip:
 
       handler_request_blocks_history( r.block_ids ); // change the limit(?), sleep(?)
       r.prune = m_sync_pruned_blocks;
+      r.headers = m_sync_headers_first;
 
       //std::string blob; // for calculate size of request
       //epee::serialization::store_t_to_binary(r, blob);
@@ -2372,6 +2633,13 @@ skip:
       << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height);
     MLOG_PEER_STATE("received chain");
 
+    if (context.m_last_request_time != boost::date_time::not_a_date_time)
+    {
+      // chain entries are small next to spans, so they give a decent round trip estimate
+      const boost::posix_time::time_duration dt = boost::posix_time::microsec_clock::universal_time() - context.m_last_request_time;
+      const size_t size = arg.m_block_ids.size() * sizeof(crypto::hash) + arg.m_block_weights.size() * sizeof(uint64_t);
+      m_block_queue.update_peer_rtt(context.m_connection_id, size, dt.total_microseconds() / 1e6f);
+    }
     context.m_last_request_time = boost::date_time::not_a_date_time;
 
     m_sync_download_chain_size += arg.m_block_ids.size() * sizeof(crypto::hash);
@@ -2413,6 +2681,49 @@ skip:
       return 1;
     }
 
+    if (!arg.m_block_headers.empty())
+    {
+      if (arg.m_block_headers.size() != arg.m_block_ids.size())
+      {
+        LOG_ERROR_CCONTEXT("sent invalid block header array, dropping connection");
+        drop_connection(context, true, false);
+        return 1;
+      }
+      std::vector<compact_block_header> headers(arg.m_block_headers.size());
+      for (size_t i = 0; i < headers.size(); ++i)
+      {
+        if (!t_serializable_object_from_blob(headers[i], arg.m_block_headers[i]))
+        {
+          LOG_ERROR_CCONTEXT("sent unparsable block header, dropping connection");
+          drop_connection(context, true, false);
+          return 1;
+        }
+      }
+
+      // reject a bad chain before downloading any of its blocks
+      uint64_t checked = 0;
+      difficulty_type cumulative_difficulty = 0;
+      if (!m_core.check_block_headers(arg.start_height, headers, arg.m_block_ids, checked, cumulative_difficulty))
+      {
+        LOG_ERROR_CCONTEXT("sent invalid block headers, dropping connection");
+        drop_connection(context, true, false);
+        return 1;
+      }
+      MDEBUG(context << checked << "/" << headers.size() << " headers known good, cumulative difficulty " << cumulative_difficulty);
+      if (checked == headers.size() && arg.start_height + headers.size() == arg.total_height)
+      {
+        difficulty_type claimed_cumulative_difficulty = arg.cumulative_difficulty_top64;
+        claimed_cumulative_difficulty = (claimed_cumulative_difficulty << 64) + arg.cumulative_difficulty;
+        if (claimed_cumulative_difficulty != cumulative_difficulty)
+        {
+          LOG_ERROR_CCONTEXT("claimed cumulative difficulty " << claimed_cumulative_difficulty << ", but its headers add up to "
+              << cumulative_difficulty << ", dropping connection");
+          drop_connection(context, true, false);
+          return 1;
+        }
+      }
+    }
+
     uint64_t n_use_blocks = m_core.prevalidate_block_hashes(arg.start_height, arg.m_block_ids, arg.m_block_weights);
     if (n_use_blocks + HASH_OF_HASHES_STEP <= arg.m_block_ids.size())
     {
@@ -2447,6 +2758,12 @@ skip:
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  {
+    return relay_block(arg, exclude_context, std::unordered_set<crypto::hash>());
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::unordered_set<crypto::hash> &prefill)
   {
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
     fluffy_arg.current_blockchain_height = arg.current_blockchain_height;    
@@ -2454,13 +2771,18 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact, fluffy ones and others
+    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id && context.m_remote_address.get_zone() == epee::net_utils::zone::public_)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING SHORT ID BLOCK");
+          compactConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
@@ -2474,7 +2796,48 @@ skip:
       return true;
     });
 
-    // send fluffy ones first, we want to encourage people to run that
+    // send compact and fluffy ones first, we want to encourage people to run that
+    if (!compactConnections.empty())
+    {
+      block b;
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      if (parse_and_validate_block_from_blob(arg.b.block, b, compact_arg.block_hash))
+      {
+        compact_arg.nonce = crypto::rand<uint64_t>();
+        compact_arg.current_blockchain_height = arg.current_blockchain_height;
+        const crypto::hash salt = get_compact_block_salt(compact_arg.block_hash, compact_arg.nonce);
+        compact_arg.short_ids.reserve(b.tx_hashes.size() * NOTIFY_NEW_COMPACT_BLOCK::SHORT_ID_SIZE);
+        for (size_t tx_idx = 0; tx_idx < b.tx_hashes.size(); ++tx_idx)
+        {
+          const crypto::hash &tx_hash = b.tx_hashes[tx_idx];
+          if (prefill.find(tx_hash) != prefill.end() && tx_idx < arg.b.txs.size())
+          {
+            // only prefill if the blob really is that tx, the short id is good enough otherwise
+            transaction tx;
+            crypto::hash blob_tx_hash;
+            if (parse_and_validate_tx_from_blob(arg.b.txs[tx_idx].blob, tx, blob_tx_hash) && blob_tx_hash == tx_hash)
+            {
+              compact_arg.prefilled_txs.push_back({tx_idx, arg.b.txs[tx_idx].blob});
+              continue;
+            }
+          }
+          const uint64_t short_id = get_compact_block_short_id(salt, tx_hash);
+          for (size_t i = 0; i < NOTIFY_NEW_COMPACT_BLOCK::SHORT_ID_SIZE; ++i)
+            compact_arg.short_ids.push_back((char)(short_id >> (8 * i)));
+        }
+        b.tx_hashes.clear();
+        compact_arg.block = t_serializable_object_to_blob(b);
+
+        std::string compactBlob;
+        epee::serialization::store_t_to_binary(compact_arg, compactBlob);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, epee::strspan<uint8_t>(compactBlob), std::move(compactConnections));
+      }
+      else
+      {
+        MERROR("Failed to parse block to relay, relaying it as a fluffy block");
+        fluffyConnections.insert(fluffyConnections.end(), compactConnections.begin(), compactConnections.end());
+      }
+    }
     if (!fluffyConnections.empty())
     {
       std::string fluffyBlob;
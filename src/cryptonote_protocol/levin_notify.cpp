@@ -30,6 +30,7 @@
 
 #include <boost/asio/steady_timer.hpp>
 #include <boost/system/system_error.hpp>
+#include <algorithm>
 #include <chrono>
 #include <deque>
 #include <stdexcept>
@@ -85,6 +86,9 @@ namespace levin
 	1/4s increments. */
     constexpr const fluff_stepsize fluff_average_out{fluff_stepsize{fluff_average_in} / 2};
 
+    constexpr const std::chrono::seconds reconciliation_interval{CRYPTONOTE_TX_RECONCILIATION_INTERVAL};
+    constexpr const std::chrono::seconds reconciliation_timeout{CRYPTONOTE_TX_RECONCILIATION_TIMEOUT};
+
     class random_poisson
     {
       std::poisson_distribution<fluff_stepsize::rep> dist;
@@ -240,18 +244,20 @@ namespace levin
   {
     struct zone
     {
-      explicit zone(boost::asio::io_service& io_service, std::shared_ptr<connections> p2p, epee::byte_slice noise_in, bool is_public, bool pad_txs)
+      explicit zone(boost::asio::io_service& io_service, std::shared_ptr<connections> p2p, epee::byte_slice noise_in, bool is_public, bool pad_txs, bool reconcile_txs)
         : p2p(std::move(p2p)),
           noise(std::move(noise_in)),
           next_epoch(io_service),
           flush_txs(io_service),
+          reconcile(io_service),
           strand(io_service),
           map(),
           channels(),
           flush_time(std::chrono::steady_clock::time_point::max()),
           connection_count(0),
           is_public(is_public),
-          pad_txs(pad_txs)
+          pad_txs(pad_txs),
+          reconcile_txs(reconcile_txs && is_public && noise.empty())
       {
         for (std::size_t count = 0; !noise.empty() && count < CRYPTONOTE_NOISE_CHANNELS; ++count)
           channels.emplace_back(io_service);
@@ -261,6 +267,7 @@ namespace levin
       const epee::byte_slice noise; //!< `!empty()` means zone is using noise channels
       boost::asio::steady_timer next_epoch;
       boost::asio::steady_timer flush_txs;
+      boost::asio::steady_timer reconcile;
       boost::asio::io_service::strand strand;
       net::dandelionpp::connection_map map;//!< Tracks outgoing uuid's for noise channels or Dandelion++ stems
       std::deque<noise_channel> channels;  //!< Never touch after init; only update elements on `noise_channel.strand`
@@ -268,6 +275,7 @@ namespace levin
       std::atomic<std::size_t> connection_count; //!< Only update in strand, can be read at any time
       const bool is_public;                      //!< Zone is public ipv4/ipv6 connections
       const bool pad_txs;                        //!< Pad txs to the next boundary for privacy
+      const bool reconcile_txs;                  //!< Use set reconciliation with peers supporting it
     };
   } // detail
 
@@ -398,19 +406,45 @@ namespace levin
         random_poisson in_duration(fluff_average_in);
         random_poisson out_duration(fluff_average_out);
 
+        /* Reconciling peers get the txs in the next round instead, except for
+           a few random outgoing ones which keep propagation fast. */
+        std::vector<boost::uuids::uuid> flood{};
+        if (zone_->reconcile_txs)
+        {
+          zone_->p2p->foreach_connection([this, &flood] (detail::p2p_context& context)
+          {
+            if (this->source_ != context.m_connection_id && !context.m_is_income && (context.support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION))
+              flood.push_back(context.m_connection_id);
+            return true;
+          });
+          std::shuffle(flood.begin(), flood.end(), crypto::random_device{});
+          flood.resize(std::min<std::size_t>(flood.size(), CRYPTONOTE_TX_RECONCILIATION_FLOOD_PEERS));
+        }
+
         bool available = false;
-        zone_->p2p->foreach_connection([this, now, &in_duration, &out_duration, &next_flush, &available] (detail::p2p_context& context)
+        zone_->p2p->foreach_connection([this, now, &in_duration, &out_duration, &next_flush, &available, &flood] (detail::p2p_context& context)
         {
           if (this->source_ != context.m_connection_id && (this->zone_->is_public || !context.m_is_income))
           {
             available = true;
+            std::vector<blobdata> queued{};
+            if (this->zone_->reconcile_txs && (context.support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION) &&
+                std::find(flood.begin(), flood.end(), context.m_connection_id) == flood.end())
+            {
+              if (context.m_tx_reconciliation->add(this->txs_))
+                return true;
+              queued = context.m_tx_reconciliation->flush(); // queue full, flood it all
+            }
+
             if (context.fluff_txs.empty())
               context.flush_time = now + (context.m_is_income ? in_duration() : out_duration());
 
             next_flush = std::min(next_flush, context.flush_time);
-            context.fluff_txs.reserve(context.fluff_txs.size() + this->txs_.size());
+            context.fluff_txs.reserve(context.fluff_txs.size() + this->txs_.size() + queued.size());
             for (const blobdata& tx : this->txs_)
               context.fluff_txs.push_back(tx); // must copy instead of move (multiple conns)
+            for (blobdata& tx : queued)
+              context.fluff_txs.push_back(std::move(tx));
           }
           return true;
         });
@@ -618,10 +652,71 @@ namespace levin
         alias.next_epoch.async_wait(start_epoch{std::move(*this)});
       }
     };
+
+    /*! Starts a tx reconciliation round on every outgoing reconciling
+        connection, floods the queues of connections that stopped
+        reconciling, and sets timer for next rounds */
+    struct start_reconciliation
+    {
+      std::shared_ptr<detail::zone> zone_;
+
+      //! \pre Should not be invoked within any strand to prevent blocking.
+      void operator()(const boost::system::error_code error = {})
+      {
+        if (!zone_ || !zone_->p2p)
+          return;
+
+        if (error && error != boost::system::errc::operation_canceled)
+          throw boost::system::system_error{error, "start_reconciliation timer failed"};
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::string, boost::uuids::uuid>> requests{};
+        std::vector<std::pair<std::vector<blobdata>, boost::uuids::uuid>> stalled{};
+        zone_->p2p->foreach_connection([&requests, &stalled] (detail::p2p_context& context)
+        {
+          if (context.m_state != cryptonote_connection_context::state_normal || !(context.support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION))
+            return true;
+
+          std::vector<blobdata> txs = context.m_tx_reconciliation->flush_stalled(reconciliation_timeout);
+          if (!txs.empty())
+          {
+            MDEBUG("No tx reconciliation with " << context.m_remote_address.str() << " for " << reconciliation_timeout.count() << " s, flooding " << txs.size() << " queued txes");
+            stalled.emplace_back(std::move(txs), context.m_connection_id);
+          }
+
+          if (!context.m_is_income)
+          {
+            NOTIFY_REQUEST_TX_SKETCH::request request{};
+            if (context.m_tx_reconciliation->start_round(request.salt, request.set_size))
+            {
+              std::string blob;
+              if (!epee::serialization::store_t_to_binary(request, blob))
+                throw std::runtime_error{"Failed to serialize to epee binary format"};
+              on_levin_traffic(context, true, true, false, blob.size(), NOTIFY_REQUEST_TX_SKETCH::ID);
+              requests.emplace_back(std::move(blob), context.m_connection_id);
+            }
+          }
+          return true;
+        });
+
+        for (const auto& request : requests)
+          zone_->p2p->notify(NOTIFY_REQUEST_TX_SKETCH::ID, epee::strspan<std::uint8_t>(request.first), request.second);
+
+        for (auto& connection : stalled)
+        {
+          std::sort(connection.first.begin(), connection.first.end()); // don't leak receive order
+          make_payload_send_txs(*zone_->p2p, std::move(connection.first), connection.second, zone_->pad_txs);
+        }
+
+        detail::zone& alias = *zone_;
+        alias.reconcile.expires_at(start + reconciliation_interval);
+        alias.reconcile.async_wait(start_reconciliation{std::move(*this)});
+      }
+    };
   } // anonymous
 
-  notify::notify(boost::asio::io_service& service, std::shared_ptr<connections> p2p, epee::byte_slice noise, const bool is_public, const bool pad_txs)
-    : zone_(std::make_shared<detail::zone>(service, std::move(p2p), std::move(noise), is_public, pad_txs))
+  notify::notify(boost::asio::io_service& service, std::shared_ptr<connections> p2p, epee::byte_slice noise, const bool is_public, const bool pad_txs, const bool reconcile_txs)
+    : zone_(std::make_shared<detail::zone>(service, std::move(p2p), std::move(noise), is_public, pad_txs, reconcile_txs))
   {
     if (!zone_->p2p)
       throw std::logic_error{"cryptonote::levin::notify cannot have nullptr p2p argument"};
@@ -633,6 +728,9 @@ namespace levin
       for (std::size_t channel = 0; channel < zone_->channels.size(); ++channel)
         send_noise::wait(now, zone_, channel);
     }
+
+    if (zone_->reconcile_txs)
+      start_reconciliation{zone_}();
   }
 
   notify::~notify() noexcept
@@ -679,6 +777,13 @@ namespace levin
     zone_->flush_txs.cancel();
   }
 
+  void notify::run_reconciliation()
+  {
+    if (!zone_)
+      return;
+    zone_->reconcile.cancel();
+  }
+
   bool notify::send_txs(std::vector<blobdata> txs, const boost::uuids::uuid& source)
   {
     if (txs.empty())
@@ -81,8 +81,10 @@ namespace levin
       : zone_(nullptr)
     {}
 
-    //! Construct an instance with available notification `zones`.
-    explicit notify(boost::asio::io_service& service, std::shared_ptr<connections> p2p, epee::byte_slice noise, bool is_public, bool pad_txs);
+    /*! Construct an instance with available notification `zones`. If
+        `reconcile_txs` is set and the zone is public, txs are relayed by set
+        reconciliation to peers that support it. */
+    explicit notify(boost::asio::io_service& service, std::shared_ptr<connections> p2p, epee::byte_slice noise, bool is_public, bool pad_txs, bool reconcile_txs = false);
 
     notify(const notify&) = delete;
     notify(notify&&) = default;
@@ -107,11 +109,15 @@ namespace levin
     //! Run the logic for flushing all Dandelion++ fluff queued txs. Only use in testing.
     void run_fluff();
 
+    //! Run the logic for starting tx reconciliation rounds immediately. Only use in testing.
+    void run_reconciliation();
+
     /*! Send txs using `cryptonote_protocol_defs.h` payload format wrapped in a
         levin header. The message will be sent in a "discreet" manner if
         enabled - if `!noise.empty()` then the `command`/`payload` will be
         queued to send at the next available noise interval. Otherwise, a
-        Dandelion++ fluff algorithm will be used.
+        Dandelion++ fluff algorithm will be used, with txs for reconciling
+        peers queued for the next reconciliation round instead.
 
         \note Eventually Dandelion++ stem sending will be used here when
           enabled.
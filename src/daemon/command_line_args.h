@@ -126,6 +126,12 @@ namespace daemon_args
   , "Address for ZMQ pub - tcp://ip:port or ipc://path"
   };
 
+  const command_line::arg_descriptor<uint32_t> arg_zmq_pub_hwm = {
+    "zmq-pub-hwm"
+  , "Messages queued per ZMQ pub subscriber before new ones are dropped"
+  , 1000
+  };
+
   const command_line::arg_descriptor<bool> arg_zmq_rpc_disabled = {
     "no-zmq"
   , "Disable ZMQ RPC server"
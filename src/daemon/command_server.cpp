@@ -83,6 +83,11 @@ t_command_server::t_command_server(
     , std::bind(&t_command_parser_executor::print_net_stats, &m_parser, p::_1)
     , "Print network statistics."
     );
+  m_command_lookup.set_handler(
+      "print_db_stats"
+    , std::bind(&t_command_parser_executor::print_db_stats, &m_parser, p::_1)
+    , "Print blockchain database statistics (operation counters need --db-stats)."
+    );
   m_command_lookup.set_handler(
       "print_bc"
     , std::bind(&t_command_parser_executor::print_blockchain_info, &m_parser, p::_1)
@@ -28,6 +28,8 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <stdexcept>
 #include <boost/algorithm/string/split.hpp>
@@ -114,7 +116,8 @@ public:
 
       std::shared_ptr<cryptonote::listener::zmq_pub> shared;
       const std::vector<std::string> zmq_pub = command_line::get_arg(vm, daemon_args::arg_zmq_pub);
-      if (!zmq_pub.empty() && !(shared = zmq->server.init_pub(epee::to_span(zmq_pub))))
+      const int zmq_pub_hwm = std::min<uint32_t>(command_line::get_arg(vm, daemon_args::arg_zmq_pub_hwm), std::numeric_limits<int>::max());
+      if (!zmq_pub.empty() && !(shared = zmq->server.init_pub(epee::to_span(zmq_pub), zmq_pub_hwm)))
         throw std::runtime_error{"Failed to initialize zmq_pub"};
 
       if (shared)
@@ -148,6 +148,28 @@ namespace {
       return base;
     return base + " -- " + status;
   }
+
+  // upper bound in microseconds of the histogram bucket holding the given fraction of operations
+  uint64_t get_latency_percentile(const cryptonote::db_latency_entry &latency, double fraction)
+  {
+    const uint64_t target = latency.count * fraction;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < latency.buckets.size(); ++i)
+    {
+      seen += latency.buckets[i];
+      if (seen > target)
+        return (uint64_t)1 << i;
+    }
+    return latency.buckets.empty() ? 0 : (uint64_t)1 << (latency.buckets.size() - 1);
+  }
+
+  std::string print_latency(const cryptonote::db_latency_entry &latency)
+  {
+    if (latency.count == 0)
+      return "-";
+    return (boost::format("%.1f/%u/%u") % (latency.total_ns / (double)latency.count / 1000.0)
+        % get_latency_percentile(latency, 0.5) % get_latency_percentile(latency, 0.99)).str();
+  }
 }
 
 t_rpc_command_executor::t_rpc_command_executor(
@@ -764,6 +786,66 @@ bool t_rpc_command_executor::print_net_stats()
   return true;
 }
 
+bool t_rpc_command_executor::print_db_stats()
+{
+  cryptonote::COMMAND_RPC_GET_DB_STATS::request req;
+  cryptonote::COMMAND_RPC_GET_DB_STATS::response res;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/get_db_stats", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_get_db_stats(req, res) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  tools::success_msg_writer() << boost::format("Database %s: map size %s, %s used (%.1f%%), page size %u, readers %u/%u, %u map resizes")
+    % res.db_type
+    % tools::get_human_readable_bytes(res.map_size)
+    % tools::get_human_readable_bytes(res.used_size)
+    % (res.map_size ? 100.0 * res.used_size / res.map_size : 0.0)
+    % res.page_size
+    % res.num_readers
+    % res.max_readers
+    % res.map_resizes;
+  tools::msg_writer() << boost::format("Page faults: %u major, %u minor") % res.major_page_faults % res.minor_page_faults;
+  if (res.enabled)
+    tools::msg_writer() << boost::format("Read txns: %u, commits: %u, commit latency avg/p50/p99 (us): %s")
+      % res.read_txns % res.commits.count % print_latency(res.commits);
+  else
+    tools::msg_writer() << "Operation counters are disabled, restart with --db-stats to collect them";
+
+  tools::msg_writer() << boost::format("%-18s %12s %5s %10s %10s %9s %12s %10s %10s %10s  %s")
+    % "table" % "entries" % "depth" % "branch" % "leaf" % "overflow" % "reads" % "writes" % "deletes" % "cursors" % "avg/p50/p99 us";
+  for (const auto &table: res.tables)
+  {
+    tools::msg_writer() << boost::format("%-18s %12u %5u %10u %10u %9u %12u %10u %10u %10u  %s")
+      % table.name
+      % table.entries
+      % table.depth
+      % table.branch_pages
+      % table.leaf_pages
+      % table.overflow_pages
+      % table.reads
+      % table.writes
+      % table.deletes
+      % table.cursor_opens
+      % print_latency(table.latency);
+  }
+
+  return true;
+}
+
 bool t_rpc_command_executor::print_blockchain_info(int64_t start_block_index, uint64_t end_block_index) {
   cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request req;
   cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response res;
@@ -1336,6 +1418,15 @@ bool t_rpc_command_executor::print_transaction_pool_stats() {
       << "fees " << cryptonote::print_money(res.pool_stats.fee_total) << " (avg " << cryptonote::print_money(n_transactions ? res.pool_stats.fee_total / n_transactions : 0) << " per tx" << ", " << cryptonote::print_money(res.pool_stats.bytes_total ? res.pool_stats.fee_total / res.pool_stats.bytes_total : 0) << " per byte)" << std::endl
       << res.pool_stats.num_double_spends << " double spends, " << res.pool_stats.num_not_relayed << " not relayed, " << res.pool_stats.num_failing << " failing, " << res.pool_stats.num_10m << " older than 10 minutes (oldest " << (res.pool_stats.oldest == 0 ? "-" : get_human_time_ago(res.pool_stats.oldest, now)) << "), " << backlog_message;
 
+  if (res.pool_stats.admission_txs_checked > 0)
+  {
+    const uint64_t check_us = res.pool_stats.admission_check_us ? res.pool_stats.admission_check_us : 1;
+    tools::msg_writer() << "admission: " << res.pool_stats.admission_txs_checked << " txes checked in " << res.pool_stats.admission_batches << " batches ("
+        << res.pool_stats.admission_txs_checked * 1000000 / check_us << " tx/s), " << res.pool_stats.admission_txs_added << " added, blockchain lock held "
+        << res.pool_stats.admission_chain_lock_us / res.pool_stats.admission_batches << " us/batch, pool lock held "
+        << (res.pool_stats.admission_txs_added ? res.pool_stats.admission_pool_lock_us / res.pool_stats.admission_txs_added : 0) << " us/tx";
+  }
+
   if (n_transactions > 1 && res.pool_stats.histo.size())
   {
     std::vector<uint64_t> times;
@@ -2301,6 +2392,9 @@ bool t_rpc_command_executor::sync_info()
           epee::string_tools::pad_string(p.info.state, 16) << "  " <<
           epee::string_tools::pad_string(epee::string_tools::to_string_hex(p.info.pruning_seed), 8) << "  " << p.info.height << "  "  <<
           p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued";
+      if (p.spans_downloaded)
+        tools::msg_writer() << "    " << p.sync_rate/1000 << " kB/s sync rate, " << p.rtt << " ms rtt, next span " << p.span_size <<
+            " blocks, " << p.spans_downloaded << " spans / " << p.blocks_downloaded << " blocks downloaded, " << p.stalls << " stalled";
     }
 
     uint64_t total_size = 0;
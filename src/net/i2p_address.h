@@ -77,7 +77,8 @@ namespace net
         static expect<i2p_address> make(boost::string_ref address, std::uint16_t default_port = 0);
 
         //! Load from epee p2p format, and \return false if not valid tor address
-        bool _load(epee::serialization::portable_storage& src, epee::serialization::section* hparent);
+        template<typename t_storage>
+        bool _load(t_storage& src, typename t_storage::hsection hparent);
 
         //! Store in epee p2p format
         bool store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const;
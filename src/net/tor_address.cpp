@@ -38,6 +38,7 @@
 #include "net/error.h"
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_reader.h"
 #include "string_tools.h"
 
 namespace net
@@ -122,7 +123,8 @@ namespace net
         return tor_address{host, porti};
     }
 
-    bool tor_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    template<typename t_storage>
+    bool tor_address::_load(t_storage& src, typename t_storage::hsection hparent)
     {
         tor_serialized in{};
         if (in._load(src, hparent) && in.host.size() < sizeof(host_) && (in.host == unknown_host || !host_check(in.host).has_error()))
@@ -138,6 +140,9 @@ namespace net
         return false;
     }
 
+    template bool tor_address::_load(epee::serialization::portable_storage&, epee::serialization::portable_storage::hsection);
+    template bool tor_address::_load(epee::serialization::portable_storage_reader&, epee::serialization::portable_storage_reader::hsection);
+
     bool tor_address::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
     {
         const tor_serialized out{std::string{host_}, port_};
@@ -165,6 +165,10 @@ namespace nodetool
       "pad-transactions", "Pad relayed transactions to help defend against traffic volume analysis", false
     };
 
+    const command_line::arg_descriptor<bool> arg_tx_reconciliation = {
+      "tx-reconciliation", "Relay transactions to supporting public peers by set reconciliation instead of flooding", false
+    };
+
     boost::optional<std::vector<proxy>> get_proxies(boost::program_options::variables_map const& vm)
     {
         namespace ip = boost::asio::ip;
@@ -247,7 +247,9 @@ namespace nodetool
         m_hide_my_port(false),
         m_igd(no_igd),
         m_offline(false),
+        m_tx_reconciliation(false),
         is_closing(false),
+        m_peerlist_compact_needed(false),
         m_network_id()
     {}
     virtual ~node_server();
@@ -262,6 +264,9 @@ namespace nodetool
     uint32_t get_this_peer_port(){return m_listening_port;}
     t_payload_net_handler& get_payload_object();
 
+    //! Levin messages and bytes per command, summed over the network zones
+    std::vector<epee::levin::command_stats::entry> get_command_stats();
+
     // debug functions
     bool log_peerlist();
     bool log_connections();
@@ -447,6 +452,7 @@ namespace nodetool
     bool m_offline;
     bool m_use_ipv6;
     bool m_require_ipv4;
+    bool m_tx_reconciliation;
     std::atomic<bool> is_closing;
     std::unique_ptr<boost::thread> mPeersLoggerThread;
     //critical_section m_connections_lock;
@@ -454,10 +460,11 @@ namespace nodetool
 
     t_payload_net_handler& m_payload_handler;
     peerlist_storage m_peerlist_storage;
+    bool m_peerlist_compact_needed; //!< next save writes a full snapshot instead of appending to the journal
 
     epee::math_helper::once_a_time_seconds<P2P_DEFAULT_HANDSHAKE_INTERVAL> m_peer_handshake_idle_maker_interval;
     epee::math_helper::once_a_time_seconds<1> m_connections_maker_interval;
-    epee::math_helper::once_a_time_seconds<60*30, false> m_peerlist_store_interval;
+    epee::math_helper::once_a_time_seconds<P2P_PEERLIST_STORE_INTERVAL, false> m_peerlist_store_interval;
     epee::math_helper::once_a_time_seconds<60> m_gray_peerlist_housekeeping_interval;
     epee::math_helper::once_a_time_seconds<3600, false> m_incoming_connections_interval;
 
@@ -533,6 +540,7 @@ namespace nodetool
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate_down;
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate;
     extern const command_line::arg_descriptor<bool> arg_pad_transactions;
+    extern const command_line::arg_descriptor<bool> arg_tx_reconciliation;
 }
 
 POP_WARNINGS
@@ -117,6 +117,7 @@ namespace nodetool
     command_line::add_arg(desc, arg_limit_rate_down);
     command_line::add_arg(desc, arg_limit_rate);
     command_line::add_arg(desc, arg_pad_transactions);
+    command_line::add_arg(desc, arg_tx_reconciliation);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -127,7 +128,16 @@ namespace nodetool
     if (storage)
       m_peerlist_storage = std::move(*storage);
 
-    m_network_zones[epee::net_utils::zone::public_].m_config.m_support_flags = P2P_SUPPORT_FLAGS;
+    // changes saved after the last snapshot; fold them in with the first save so a torn tail is not appended to
+    const std::string journal_file_path = m_config_folder + "/" + P2P_NET_JOURNAL_FILENAME;
+    const std::size_t replayed = m_peerlist_storage.replay_journal(journal_file_path);
+    if (replayed)
+      MDEBUG("Replayed " << replayed << " peerlist journal records");
+    boost::system::error_code ec{};
+    m_peerlist_compact_needed = boost::filesystem::exists(journal_file_path, ec);
+
+    m_network_zones[epee::net_utils::zone::public_].m_config.m_support_flags =
+      P2P_SUPPORT_FLAGS | (m_tx_reconciliation ? P2P_SUPPORT_FLAG_TX_RECONCILIATION : 0);
     m_first_connection_maker_call = true;
 
     CATCH_ENTRY_L0("node_server::init_config", false);
@@ -342,6 +352,7 @@ namespace nodetool
     bool testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
     bool stagenet = command_line::get_arg(vm, cryptonote::arg_stagenet_on);
     const bool pad_txs = command_line::get_arg(vm, arg_pad_transactions);
+    m_tx_reconciliation = command_line::get_arg(vm, arg_tx_reconciliation);
     m_nettype = testnet ? cryptonote::TESTNET : stagenet ? cryptonote::STAGENET : cryptonote::MAINNET;
 
     network_zone& public_zone = m_network_zones[epee::net_utils::zone::public_];
@@ -386,7 +397,7 @@ namespace nodetool
     m_use_ipv6 = command_line::get_arg(vm, arg_p2p_use_ipv6);
     m_require_ipv4 = !command_line::get_arg(vm, arg_p2p_ignore_ipv4);
     public_zone.m_notifier = cryptonote::levin::notify{
-      public_zone.m_net_server.get_io_service(), public_zone.m_net_server.get_config_shared(), nullptr, true, pad_txs
+      public_zone.m_net_server.get_io_service(), public_zone.m_net_server.get_config_shared(), nullptr, true, pad_txs, m_tx_reconciliation
     };
 
     if (command_line::has_arg(vm, arg_p2p_add_peer))
@@ -958,16 +969,43 @@ namespace nodetool
       return false;
     }
 
+    const std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
+    const std::string journal_file_path = m_config_folder + "/" + P2P_NET_JOURNAL_FILENAME;
+
+    std::vector<peerlist_journal_entry> journal{};
+    bool compact = m_peerlist_compact_needed;
+    for (auto& zone : m_network_zones)
+      compact = !zone.second.m_peerlist.take_journal(journal) || compact;
+
+    boost::system::error_code ec{};
+    if (!compact)
+    {
+      boost::system::error_code size_ec{};
+      const uint64_t journal_size = boost::filesystem::file_size(journal_file_path, size_ec);
+      compact = !boost::filesystem::exists(state_file_path, ec) || (!size_ec && journal_size >= P2P_PEERLIST_JOURNAL_COMPACT_SIZE);
+    }
+
+    if (!compact)
+    {
+      if (journal.empty() || peerlist_storage::append_journal(journal_file_path, journal))
+        return true;
+      MWARNING("Failed to append to " << journal_file_path << ", saving the full peerlist instead");
+    }
+
     peerlist_types active{};
     for (auto& zone : m_network_zones)
       zone.second.m_peerlist.get_peerlist(active);
 
-    const std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
     if (!m_peerlist_storage.store(state_file_path, active))
     {
       MWARNING("Failed to save config to file " << state_file_path);
+      m_peerlist_compact_needed = true;
       return false;
     }
+
+    // a crash before this replays older records over the new snapshot, which at worst brings back a few stale peers
+    boost::filesystem::remove(journal_file_path, ec);
+    m_peerlist_compact_needed = false;
     CATCH_ENTRY_L0("node_server::store", false);
     return true;
   }
@@ -1708,6 +1746,29 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
+  std::vector<epee::levin::command_stats::entry> node_server<t_payload_net_handler>::get_command_stats()
+  {
+    std::map<uint32_t, epee::levin::command_stats::entry> totals;
+    for (auto& zone : m_network_zones)
+    {
+      for (const auto& e : zone.second.m_net_server.get_config_object().m_command_stats.get())
+      {
+        auto& total = totals.emplace(e.command, epee::levin::command_stats::entry{e.command, 0, 0, 0, 0}).first->second;
+        total.messages_in += e.messages_in;
+        total.bytes_in += e.bytes_in;
+        total.messages_out += e.messages_out;
+        total.bytes_out += e.bytes_out;
+      }
+    }
+
+    std::vector<epee::levin::command_stats::entry> out;
+    out.reserve(totals.size());
+    for (const auto& t : totals)
+      out.push_back(t.second);
+    return out;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
   size_t node_server<t_payload_net_handler>::get_public_outgoing_connections_count()
   {
     auto public_zone = m_network_zones.find(epee::net_utils::zone::public_);
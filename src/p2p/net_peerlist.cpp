@@ -31,11 +31,15 @@
 #include <functional>
 #include <fstream>
 #include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/portable_binary_oarchive.hpp>
 #include <boost/archive/portable_binary_iarchive.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/range/join.hpp>
 #include <boost/serialization/version.hpp>
 
@@ -46,6 +50,7 @@ namespace nodetool
   namespace
   {
     constexpr unsigned CURRENT_PEERLIST_STORAGE_ARCHIVE_VER = 6;
+    constexpr std::uint32_t MAX_JOURNAL_RECORD_SIZE = 256 * 1024 * 1024;
 
     struct by_zone
     {
@@ -125,6 +130,58 @@ namespace nodetool
     {
       std::copy(src.begin(), src.end(), std::back_inserter(dest));
     }
+
+    bool is_anchor_op(const std::uint8_t op) noexcept
+    {
+      return op == peerlist_journal_entry::anchor_set || op == peerlist_journal_entry::anchor_erase;
+    }
+
+    //! Applies journal records to one list of a `peerlist_types`, in place.
+    template<typename T>
+    class journal_target
+    {
+      using address = epee::net_utils::network_address;
+
+      std::vector<T>& list;
+      std::unordered_map<address, std::size_t, boost::hash<address>> index;
+
+    public:
+      explicit journal_target(std::vector<T>& list)
+        : list(list), index()
+      {
+        index.reserve(list.size());
+        for (std::size_t i = 0; i < list.size(); ++i)
+          index.emplace(list[i].adr, i);
+      }
+
+      void set(const T& elem)
+      {
+        const auto it = index.find(elem.adr);
+        if (it != index.end())
+          list[it->second] = elem;
+        else
+        {
+          index.emplace(elem.adr, list.size());
+          list.push_back(elem);
+        }
+      }
+
+      void erase(const address& adr)
+      {
+        const auto it = index.find(adr);
+        if (it == index.end())
+          return;
+
+        const std::size_t i = it->second;
+        index.erase(it);
+        if (i + 1 != list.size())
+        {
+          list[i] = std::move(list.back());
+          index[list[i].adr] = i;
+        }
+        list.pop_back();
+      }
+    };
   } // anonymous
 
   struct peerlist_join
@@ -156,6 +213,43 @@ namespace nodetool
     save_peers(a, boost::range::join(elem.ours.anchor, elem.other.anchor));
   }
 
+  template<typename Archive>
+  void save_journal(Archive& a, const std::vector<peerlist_journal_entry>& entries)
+  {
+    const uint64_t size = entries.size();
+    a & size;
+    for (const peerlist_journal_entry& entry : entries)
+    {
+      a & entry.op;
+      if (is_anchor_op(entry.op))
+        a & entry.anchor;
+      else
+        a & entry.peer;
+    }
+  }
+
+  template<typename Archive>
+  std::vector<peerlist_journal_entry> load_journal(Archive& a)
+  {
+    uint64_t size = 0;
+    a & size;
+
+    std::vector<peerlist_journal_entry> entries{};
+    while (size--)
+    {
+      peerlist_journal_entry entry{};
+      a & entry.op;
+      if (peerlist_journal_entry::anchor_erase < entry.op)
+        throw std::runtime_error{"unknown peerlist journal op"};
+      if (is_anchor_op(entry.op))
+        a & entry.anchor;
+      else
+        a & entry.peer;
+      entries.push_back(std::move(entry));
+    }
+    return entries;
+  }
+
   boost::optional<peerlist_storage> peerlist_storage::open(std::istream& src, const bool new_format)
   {
     try
@@ -258,6 +352,111 @@ namespace nodetool
     return out;
   }
 
+  std::size_t peerlist_storage::replay_journal(std::istream& src)
+  {
+    journal_target<peerlist_entry> white{m_types.white};
+    journal_target<peerlist_entry> gray{m_types.gray};
+    journal_target<anchor_peerlist_entry> anchor{m_types.anchor};
+
+    std::size_t applied = 0;
+    std::string record{};
+    for (;;)
+    {
+      unsigned char length_bytes[4];
+      if (!src.read(reinterpret_cast<char*>(length_bytes), sizeof(length_bytes)))
+        break;
+      const std::uint32_t length = std::uint32_t(length_bytes[0]) | (std::uint32_t(length_bytes[1]) << 8) |
+        (std::uint32_t(length_bytes[2]) << 16) | (std::uint32_t(length_bytes[3]) << 24);
+      if (length == 0 || MAX_JOURNAL_RECORD_SIZE < length)
+        break;
+
+      record.resize(length);
+      if (!src.read(std::addressof(record[0]), length))
+        break; // torn by a crash during the append
+
+      std::vector<peerlist_journal_entry> entries{};
+      try
+      {
+        std::istringstream record_stream{record};
+        boost::archive::portable_binary_iarchive a{record_stream};
+        entries = load_journal(a);
+      }
+      catch (const std::exception& e)
+      {
+        break;
+      }
+
+      for (const peerlist_journal_entry& entry : entries)
+      {
+        switch (entry.op)
+        {
+          case peerlist_journal_entry::white_set:    white.set(entry.peer); break;
+          case peerlist_journal_entry::gray_set:     gray.set(entry.peer); break;
+          case peerlist_journal_entry::anchor_set:   anchor.set(entry.anchor); break;
+          case peerlist_journal_entry::white_erase:  white.erase(entry.peer.adr); break;
+          case peerlist_journal_entry::gray_erase:   gray.erase(entry.peer.adr); break;
+          case peerlist_journal_entry::anchor_erase: anchor.erase(entry.anchor.adr); break;
+          default: break;
+        }
+      }
+      ++applied;
+    }
+
+    if (applied)
+    {
+      std::stable_sort(m_types.white.begin(), m_types.white.end(), by_zone{});
+      std::stable_sort(m_types.gray.begin(), m_types.gray.end(), by_zone{});
+      std::stable_sort(m_types.anchor.begin(), m_types.anchor.end(), by_zone{});
+    }
+    return applied;
+  }
+
+  std::size_t peerlist_storage::replay_journal(const std::string& path)
+  {
+    std::ifstream src_file{};
+    src_file.open(path, std::ios_base::binary | std::ios_base::in);
+    if (src_file.fail())
+      return 0;
+    return replay_journal(src_file);
+  }
+
+  bool peerlist_storage::append_journal(std::ostream& dest, const std::vector<peerlist_journal_entry>& entries)
+  {
+    std::ostringstream record{};
+    try
+    {
+      boost::archive::portable_binary_oarchive a{record};
+      save_journal(a, entries);
+    }
+    catch (const boost::archive::archive_exception& e)
+    {
+      return false;
+    }
+
+    const std::string blob = record.str();
+    if (MAX_JOURNAL_RECORD_SIZE < blob.size())
+      return false;
+
+    const std::uint32_t length = blob.size();
+    const char length_bytes[4] = {
+      char(length & 0xff), char((length >> 8) & 0xff), char((length >> 16) & 0xff), char((length >> 24) & 0xff)
+    };
+    dest.write(length_bytes, sizeof(length_bytes));
+    dest.write(blob.data(), blob.size());
+    dest.flush();
+    return dest.good();
+  }
+
+  bool peerlist_storage::append_journal(const std::string& path, const std::vector<peerlist_journal_entry>& entries)
+  {
+    std::ofstream dest_file{};
+    dest_file.open(path, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+    if (dest_file.fail())
+      return false;
+
+    return append_journal(dest_file, entries);
+  }
+
   bool peerlist_manager::init(peerlist_types&& peers, bool allow_local_ip)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
@@ -36,6 +36,7 @@
 #include <vector>
 
 #include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/member.hpp>
@@ -59,6 +60,19 @@ namespace nodetool
     std::vector<anchor_peerlist_entry> anchor;
   };
 
+  //! One change to a zone's peerlist, as recorded between two saves.
+  struct peerlist_journal_entry
+  {
+    enum op_type : uint8_t
+    {
+      white_set = 0, gray_set, anchor_set, white_erase, gray_erase, anchor_erase
+    };
+
+    uint8_t op;
+    peerlist_entry peer;           //!< New state for `white_set`/`gray_set`, address for the erases
+    anchor_peerlist_entry anchor;  //!< New state for `anchor_set`, address for `anchor_erase`
+  };
+
   class peerlist_storage
   {
   public:
@@ -89,6 +103,18 @@ namespace nodetool
     //! \return Peers in `zone` and from remove from `this`.
     peerlist_types take_zone(epee::net_utils::zone zone);
 
+    //! Apply journal records from `src` on top of `this`, stopping at the first torn record. \return Records applied.
+    std::size_t replay_journal(std::istream& src);
+
+    //! Apply journal records from the file at `path` on top of `this`. \return Records applied.
+    std::size_t replay_journal(const std::string& path);
+
+    //! Append `entries` as a single record to stream `dest`.
+    static bool append_journal(std::ostream& dest, const std::vector<peerlist_journal_entry>& entries);
+
+    //! Append `entries` as a single record to the file at `path`.
+    static bool append_journal(const std::string& path, const std::vector<peerlist_journal_entry>& entries);
+
   private:
     peerlist_types m_types;
   };
@@ -99,6 +125,7 @@ namespace nodetool
   class peerlist_manager
   {
   public: 
+    peerlist_manager(): m_allow_local_ip(false), m_journal_overflow(false) {}
     bool init(peerlist_types&& peers, bool allow_local_ip);
     size_t get_white_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_white.size();}
     size_t get_gray_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_gray.size();}
@@ -119,6 +146,8 @@ namespace nodetool
     bool get_and_empty_anchor_peerlist(std::vector<anchor_peerlist_entry>& apl);
     bool remove_from_peer_anchor(const epee::net_utils::network_address& addr);
     bool remove_from_peer_white(const peerlist_entry& pe);
+    //! Move changes made since the last call into `journal`. \return False if changes were dropped and a full save is needed.
+    bool take_journal(std::vector<peerlist_journal_entry>& journal);
     
   private:
     struct by_time{};
@@ -163,7 +192,7 @@ namespace nodetool
       peerlist_entry,
       boost::multi_index::indexed_by<
       // access by peerlist_entry::net_adress
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
+      boost::multi_index::hashed_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
       // sort by peerlist_entry::last_seen<
       boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
       > 
@@ -173,7 +202,7 @@ namespace nodetool
       anchor_peerlist_entry,
       boost::multi_index::indexed_by<
       // access by anchor_peerlist_entry::net_adress
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<anchor_peerlist_entry,epee::net_utils::network_address,&anchor_peerlist_entry::adr> >,
+      boost::multi_index::hashed_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<anchor_peerlist_entry,epee::net_utils::network_address,&anchor_peerlist_entry::adr> >,
       // sort by anchor_peerlist_entry::first_seen
       boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<anchor_peerlist_entry,int64_t,&anchor_peerlist_entry::first_seen> >
       >
@@ -182,6 +211,11 @@ namespace nodetool
   private: 
     void trim_white_peerlist();
     void trim_gray_peerlist();
+    //! \return True if `ple` was not in `peers` yet
+    bool insert_or_update(peers_indexed& peers, const peerlist_entry& ple, uint8_t op);
+    bool journal_has_room();
+    void journal_peer(uint8_t op, const peerlist_entry& ple);
+    void journal_anchor(uint8_t op, const anchor_peerlist_entry& ple);
 
     friend class boost::serialization::access;
     epee::critical_section m_peerlist_lock;
@@ -192,6 +226,9 @@ namespace nodetool
     peers_indexed m_peers_gray;
     peers_indexed m_peers_white;
     anchor_peers_indexed m_peers_anchor;
+
+    std::vector<peerlist_journal_entry> m_journal;
+    bool m_journal_overflow;
   };
   //--------------------------------------------------------------------------------------------------
   inline void peerlist_manager::trim_gray_peerlist()
@@ -199,6 +236,7 @@ namespace nodetool
     while(m_peers_gray.size() > P2P_LOCAL_GRAY_PEERLIST_LIMIT)
     {
       peers_indexed::index<by_time>::type& sorted_index=m_peers_gray.get<by_time>();
+      journal_peer(peerlist_journal_entry::gray_erase, *sorted_index.begin());
       sorted_index.erase(sorted_index.begin());
     }
   }
@@ -208,18 +246,97 @@ namespace nodetool
     while(m_peers_white.size() > P2P_LOCAL_WHITE_PEERLIST_LIMIT)
     {
       peers_indexed::index<by_time>::type& sorted_index=m_peers_white.get<by_time>();
+      journal_peer(peerlist_journal_entry::white_erase, *sorted_index.begin());
       sorted_index.erase(sorted_index.begin());
     }
   }
   //--------------------------------------------------------------------------------------------------
+  inline bool peerlist_manager::journal_has_room()
+  {
+    if (m_journal_overflow)
+      return false;
+    if (m_journal.size() < P2P_PEERLIST_JOURNAL_MAX_PENDING)
+      return true;
+    // the next save has to write the whole list anyway, stop paying for records
+    m_journal.clear();
+    m_journal.shrink_to_fit();
+    m_journal_overflow = true;
+    return false;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline void peerlist_manager::journal_peer(uint8_t op, const peerlist_entry& ple)
+  {
+    if (journal_has_room())
+      m_journal.push_back({op, ple, {}});
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline void peerlist_manager::journal_anchor(uint8_t op, const anchor_peerlist_entry& ple)
+  {
+    if (journal_has_room())
+      m_journal.push_back({op, {}, ple});
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::take_journal(std::vector<peerlist_journal_entry>& journal)
+  {
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    const bool complete = !m_journal_overflow;
+    if (journal.empty())
+      journal.swap(m_journal);
+    else
+    {
+      journal.insert(journal.end(), std::make_move_iterator(m_journal.begin()), std::make_move_iterator(m_journal.end()));
+      m_journal.clear();
+    }
+    m_journal_overflow = false;
+    return complete;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::insert_or_update(peers_indexed& peers, const peerlist_entry& ple, uint8_t op)
+  {
+    auto by_addr_it = peers.get<by_addr>().find(ple.adr);
+    if(by_addr_it == peers.get<by_addr>().end())
+    {
+      peers.insert(ple);
+      journal_peer(op, ple);
+      return true;
+    }
+
+    peerlist_entry new_ple = ple;
+    if (by_addr_it->pruning_seed && ple.pruning_seed == 0) // guard against older nodes not passing pruning info around
+      new_ple.pruning_seed = by_addr_it->pruning_seed;
+    if (by_addr_it->rpc_port && ple.rpc_port == 0) // guard against older nodes not passing RPC port around
+      new_ple.rpc_port = by_addr_it->rpc_port;
+    new_ple.last_seen = by_addr_it->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
+
+    // most entries in a remote peerlist are ones we already know about, skip the reindex
+    if (new_ple.id == by_addr_it->id && new_ple.pruning_seed == by_addr_it->pruning_seed &&
+        new_ple.rpc_port == by_addr_it->rpc_port && new_ple.rpc_credits_per_hash == by_addr_it->rpc_credits_per_hash)
+      return false;
+
+    peers.replace(by_addr_it, new_ple);
+    journal_peer(op, new_ple);
+    return false;
+  }
+  //--------------------------------------------------------------------------------------------------
   inline 
   bool peerlist_manager::merge_peerlist(const std::vector<peerlist_entry>& outer_bs, const std::function<bool(const peerlist_entry&)> &f)
   {
-    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    // run the filters before taking the lock, they may take locks of their own
+    std::vector<const peerlist_entry*> accepted;
+    accepted.reserve(outer_bs.size());
     for(const peerlist_entry& be:  outer_bs)
     {
-      if (!f || f(be))
-        append_with_peer_gray(be);
+      if (is_host_allowed(be.adr) && (!f || f(be)))
+        accepted.push_back(std::addressof(be));
+    }
+
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    for(const peerlist_entry* be: accepted)
+    {
+      if (m_peers_white.get<by_addr>().find(be->adr) == m_peers_white.get<by_addr>().end())
+        insert_or_update(m_peers_gray, *be, peerlist_journal_entry::gray_set);
     }
     // delete extra elements
     trim_gray_peerlist();    
@@ -340,28 +457,14 @@ namespace nodetool
       return true;
 
      CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    //find in white list
-    auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
-    if(by_addr_it_wt == m_peers_white.get<by_addr>().end())
-    {
-      //put new record into white list
-      m_peers_white.insert(ple);
+    //put new record into white list, or update the existing one
+    if (insert_or_update(m_peers_white, ple, peerlist_journal_entry::white_set))
       trim_white_peerlist();
-    }else
-    {
-      //update record in white list
-      peerlist_entry new_ple = ple;
-      if (by_addr_it_wt->pruning_seed && ple.pruning_seed == 0) // guard against older nodes not passing pruning info around
-        new_ple.pruning_seed = by_addr_it_wt->pruning_seed;
-      if (by_addr_it_wt->rpc_port && ple.rpc_port == 0) // guard against older nodes not passing RPC port around
-        new_ple.rpc_port = by_addr_it_wt->rpc_port;
-      new_ple.last_seen = by_addr_it_wt->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
-      m_peers_white.replace(by_addr_it_wt, new_ple);
-    }
     //remove from gray list, if need
     auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
     if(by_addr_it_gr != m_peers_gray.get<by_addr>().end())
     {
+      journal_peer(peerlist_journal_entry::gray_erase, *by_addr_it_gr);
       m_peers_gray.erase(by_addr_it_gr);
     }
     return true;
@@ -382,23 +485,8 @@ namespace nodetool
       return true;
 
     //update gray list
-    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
-    if(by_addr_it_gr == m_peers_gray.get<by_addr>().end())
-    {
-      //put new record into white list
-      m_peers_gray.insert(ple);
-      trim_gray_peerlist();    
-    }else
-    {
-      //update record in gray list
-      peerlist_entry new_ple = ple;
-      if (by_addr_it_gr->pruning_seed && ple.pruning_seed == 0) // guard against older nodes not passing pruning info around
-        new_ple.pruning_seed = by_addr_it_gr->pruning_seed;
-      if (by_addr_it_gr->rpc_port && ple.rpc_port == 0) // guard against older nodes not passing RPC port around
-        new_ple.rpc_port = by_addr_it_gr->rpc_port;
-      new_ple.last_seen = by_addr_it_gr->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
-      m_peers_gray.replace(by_addr_it_gr, new_ple);
-    }
+    if (insert_or_update(m_peers_gray, ple, peerlist_journal_entry::gray_set))
+      trim_gray_peerlist();
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_gray()", false);
   }
@@ -414,6 +502,7 @@ namespace nodetool
 
     if(by_addr_it_anchor == m_peers_anchor.get<by_addr>().end()) {
       m_peers_anchor.insert(ple);
+      journal_anchor(peerlist_journal_entry::anchor_set, ple);
     }
 
     return true;
@@ -452,6 +541,7 @@ namespace nodetool
     peers_indexed::index_iterator<by_addr>::type iterator = m_peers_white.get<by_addr>().find(pe.adr);
 
     if (iterator != m_peers_white.get<by_addr>().end()) {
+      journal_peer(peerlist_journal_entry::white_erase, *iterator);
       m_peers_white.erase(iterator);
     }
 
@@ -470,6 +560,7 @@ namespace nodetool
     peers_indexed::index_iterator<by_addr>::type iterator = m_peers_gray.get<by_addr>().find(pe.adr);
 
     if (iterator != m_peers_gray.get<by_addr>().end()) {
+      journal_peer(peerlist_journal_entry::gray_erase, *iterator);
       m_peers_gray.erase(iterator);
     }
 
@@ -488,8 +579,9 @@ namespace nodetool
     auto begin = m_peers_anchor.get<by_time>().begin();
     auto end = m_peers_anchor.get<by_time>().end();
 
-    std::for_each(begin, end, [&apl](const anchor_peerlist_entry &a) {
+    std::for_each(begin, end, [this, &apl](const anchor_peerlist_entry &a) {
       apl.push_back(a);
+      journal_anchor(peerlist_journal_entry::anchor_erase, a);
     });
 
     m_peers_anchor.get<by_time>().clear();
@@ -509,6 +601,7 @@ namespace nodetool
     anchor_peers_indexed::index_iterator<by_addr>::type iterator = m_peers_anchor.get<by_addr>().find(addr);
 
     if (iterator != m_peers_anchor.get<by_addr>().end()) {
+      journal_anchor(peerlist_journal_entry::anchor_erase, *iterator);
       m_peers_anchor.erase(iterator);
     }
 
@@ -28,6 +28,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <boost/algorithm/string.hpp>
 #include <boost/preprocessor/stringize.hpp>
 #include <boost/uuid/nil_generator.hpp>
 #include "include_base_utils.h"
@@ -39,7 +40,9 @@ using namespace epee;
 #include "common/updates.h"
 #include "common/download.h"
 #include "common/util.h"
+#include "common/metrics.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "int-util.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
@@ -50,6 +53,7 @@ using namespace epee;
 #include "storages/http_abstract_invoke.h"
 #include "crypto/hash.h"
 #include "rpc/rpc_args.h"
+#include "rpc/rpc_blocks_stream.h"
 #include "rpc/rpc_handler.h"
 #include "rpc/rpc_payment_costs.h"
 #include "rpc/rpc_payment_signature.h"
@@ -73,9 +77,19 @@ using namespace epee;
 #define RESTRICTED_SPENT_KEY_IMAGES_COUNT 5000
 #define RESTRICTED_BLOCK_COUNT 1000
 
+#define BLOCKS_STREAM_CHUNK_SIZE (1024 * 1024)
+
+#define LIGHT_WALLET_FEE_GRACE_BLOCKS 10
+
+#define WAIT_FOR_EVENT_MAX_TIMEOUT 60 // seconds, well within the connection timeout
+#define WAIT_FOR_EVENT_CHECK_MS 250
+
 #define RPC_TRACKER(rpc) \
+  const rpc_admission::ticket admission_ticket = admit(#rpc, ctx); \
+  if (!admission_ticket) return refuse_busy(res); \
+  static tools::metrics::histogram &rpc_latency = rpc_latency_histogram(#rpc); \
   PERF_TIMER(rpc); \
-  RPCTracker tracker(#rpc, PERF_TIMER_NAME(rpc))
+  RPCTracker tracker(#rpc, PERF_TIMER_NAME(rpc), &rpc_latency)
 
 namespace
 {
@@ -89,15 +103,18 @@ namespace
       uint64_t credits;
     };
 
-    RPCTracker(const char *rpc, tools::LoggingPerformanceTimer &timer): rpc(rpc), timer(timer) {
+    RPCTracker(const char *rpc, tools::LoggingPerformanceTimer &timer, tools::metrics::histogram *latency = nullptr): rpc(rpc), timer(timer), latency(latency) {
     }
     ~RPCTracker() {
       try
       {
+        const uint64_t ns = timer.value();
+        if (latency)
+          latency->observe_ns(ns);
         boost::unique_lock<boost::mutex> lock(mutex);
         auto &e = tracker[rpc];
         ++e.count;
-        e.time += timer.value();
+        e.time += ns;
       }
       catch (...) { /* ignore */ }
     }
@@ -112,12 +129,66 @@ namespace
   private:
     std::string rpc;
     tools::LoggingPerformanceTimer &timer;
+    tools::metrics::histogram *latency;
     static boost::mutex mutex;
     static std::unordered_map<std::string, entry_t> tracker;
   };
   boost::mutex RPCTracker::mutex;
   std::unordered_map<std::string, RPCTracker::entry_t> RPCTracker::tracker;
 
+  tools::metrics::histogram &rpc_latency_histogram(const char *rpc)
+  {
+    return tools::metrics::registry::getInstance().get_histogram("monero_rpc_duration_seconds", "Time spent in RPC handlers, by method", "method", rpc);
+  }
+
+  const char *levin_command_name(uint32_t command)
+  {
+    switch (command)
+    {
+      case nodetool::COMMAND_HANDSHAKE_T<cryptonote::CORE_SYNC_DATA>::ID: return "handshake";
+      case nodetool::COMMAND_TIMED_SYNC_T<cryptonote::CORE_SYNC_DATA>::ID: return "timed_sync";
+      case nodetool::COMMAND_PING::ID: return "ping";
+      case nodetool::COMMAND_REQUEST_SUPPORT_FLAGS::ID: return "request_support_flags";
+      case cryptonote::NOTIFY_NEW_BLOCK::ID: return "new_block";
+      case cryptonote::NOTIFY_NEW_TRANSACTIONS::ID: return "new_transactions";
+      case cryptonote::NOTIFY_REQUEST_GET_OBJECTS::ID: return "request_get_objects";
+      case cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::ID: return "response_get_objects";
+      case cryptonote::NOTIFY_REQUEST_CHAIN::ID: return "request_chain";
+      case cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::ID: return "response_chain_entry";
+      case cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::ID: return "new_fluffy_block";
+      case cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID: return "request_fluffy_missing_tx";
+      case cryptonote::NOTIFY_GET_TXPOOL_COMPLEMENT::ID: return "get_txpool_complement";
+      case cryptonote::NOTIFY_NEW_COMPACT_BLOCK::ID: return "new_compact_block";
+      case cryptonote::NOTIFY_REQUEST_TX_SKETCH::ID: return "request_tx_sketch";
+      case cryptonote::NOTIFY_RESPONSE_TX_SKETCH::ID: return "response_tx_sketch";
+      case cryptonote::NOTIFY_TX_RECONCILIATION_RESULT::ID: return "tx_reconciliation_result";
+      default: return nullptr;
+    }
+  }
+
+  const char *light_wallet_error(cryptonote::light_wallet_scanner::status status)
+  {
+    switch (status)
+    {
+      case cryptonote::light_wallet_scanner::status::bad_address: return "Invalid address";
+      case cryptonote::light_wallet_scanner::status::bad_view_key: return "View key does not match the address";
+      case cryptonote::light_wallet_scanner::status::unknown_account: return "Account not found, log in to create it";
+      default: return "Failed";
+    }
+  }
+
+  template<typename t_response>
+  bool refuse_busy(t_response &res)
+  {
+    res.status = CORE_RPC_STATUS_BUSY;
+    return true;
+  }
+
+  bool refuse_busy(std::string &)
+  {
+    return false; // no status to report it through, fails the call
+  }
+
   void add_reason(std::string &reasons, const char *reason)
   {
     if (!reasons.empty())
@@ -159,6 +230,11 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_payment_difficulty);
     command_line::add_arg(desc, arg_rpc_payment_credits);
     command_line::add_arg(desc, arg_rpc_payment_allow_free_loopback);
+    command_line::add_arg(desc, arg_rpc_threads);
+    command_line::add_arg(desc, arg_rpc_method_limit);
+    command_line::add_arg(desc, arg_rpc_light_wallet);
+    command_line::add_arg(desc, arg_rpc_max_parked_waits);
+    command_line::add_arg(desc, arg_rpc_no_compression);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -170,6 +246,17 @@ namespace cryptonote
     , m_was_bootstrap_ever_used(false)
     , disable_rpc_ban(false)
     , m_rpc_payment_allow_free_loopback(false)
+    , m_response_cache(std::make_shared<rpc_response_cache>([&cr]() {
+        // readers only see committed blocks, unlike block notifiers which run inside the batch
+        rpc_response_cache::chain_tip tip{};
+        tip.id = cr.get_blockchain_storage().get_db().top_block_hash(&tip.height);
+        return tip;
+      }))
+    , m_rpc_threads(arg_rpc_threads.default_value)
+    , m_admission(new rpc_admission(m_rpc_threads))
+    , m_last_pool_cookie(0)
+    , m_public_pool_digest(crypto::null_hash)
+    , m_public_pool_cookie(0)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::set_bootstrap_daemon(const std::string &address, const std::string &username_password)
@@ -247,6 +334,13 @@ namespace cryptonote
   {
     if (m_rpc_payment)
       m_rpc_payment->store();
+    if (m_light_wallet)
+    {
+      m_light_wallet->stop();
+      m_light_wallet->store();
+    }
+    if (m_event_waiter)
+      m_event_waiter->stop();
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::init(
@@ -305,6 +399,43 @@ namespace cryptonote
         MWARNING("The RPC server is accessible from the outside, but no RPC payment was setup. RPC access will be free for all.");
     }
 
+    m_rpc_threads = command_line::get_arg(vm, arg_rpc_threads);
+    if (m_rpc_threads == 0)
+    {
+      MFATAL("RPC needs at least one thread");
+      return false;
+    }
+    m_admission.reset(new rpc_admission(m_rpc_threads));
+    m_batch_pool.reset(tools::threadpool::getNew(m_rpc_threads));
+    for (const std::string &limit: command_line::get_arg(vm, arg_rpc_method_limit))
+    {
+      std::vector<std::string> parts;
+      boost::split(parts, limit, boost::is_any_of(":"));
+      rpc_admission::limits limits{0, 0};
+      if ((parts.size() != 2 && parts.size() != 3) || parts[0].empty()
+        || !epee::string_tools::get_xtype_from_string(limits.concurrent, parts[1])
+        || (parts.size() == 3 && !epee::string_tools::get_xtype_from_string(limits.queued, parts[2])))
+      {
+        MFATAL("Invalid RPC method limit, expected <method>:<concurrent>[:<queued>]: " << limit);
+        return false;
+      }
+      m_admission->set_limits(parts[0], limits);
+    }
+
+    if (command_line::get_arg(vm, arg_rpc_light_wallet))
+    {
+      if (m_restricted)
+      {
+        MWARNING("Light wallet scanning is only served on unrestricted RPC");
+      }
+      else
+      {
+        m_light_wallet.reset(new light_wallet_scanner(nettype()));
+        m_light_wallet->load(command_line::get_arg(vm, cryptonote::arg_data_dir));
+        MINFO("Serving " << m_light_wallet->get_account_count() << " light wallet account(s)");
+      }
+    }
+
     if (!set_bootstrap_daemon(command_line::get_arg(vm, arg_bootstrap_daemon_address),
       command_line::get_arg(vm, arg_bootstrap_daemon_login)))
     {
@@ -319,6 +450,14 @@ namespace cryptonote
 
     if (m_rpc_payment)
       m_net_server.add_idle_handler([this](){ return m_rpc_payment->on_idle(); }, 60 * 1000);
+    if (m_light_wallet)
+      m_light_wallet->start(m_core.get_blockchain_storage());
+
+    m_event_waiter = std::make_shared<rpc_event_waiter>(command_line::get_arg(vm, arg_rpc_max_parked_waits));
+    m_net_server.add_idle_handler([this](){ return on_event_check(); }, WAIT_FOR_EVENT_CHECK_MS);
+
+    // responses hold no secrets, so compressing them does not open BREACH style attacks
+    m_net_server.get_config_object().m_compress = !command_line::get_arg(vm, arg_rpc_no_compression);
 
     auto rng = [](size_t len, uint8_t *ptr){ return crypto::rand(len, ptr); };
     return epee::http_server_impl_base<core_rpc_server, connection_context>::init(
@@ -328,6 +467,97 @@ namespace cryptonote
     );
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_event_check()
+  {
+    // block notifiers run inside the batch, before the blocks are committed and
+    // visible to the calls clients make once woken, so the tip is read back instead
+    uint64_t top_height;
+    const crypto::hash top_hash = m_core.get_blockchain_storage().get_db().top_block_hash(&top_height);
+    m_event_waiter->update_chain(top_height + 1, top_hash);
+
+    const uint64_t cookie = m_core.get_pool_cookie();
+    if (cookie == m_last_pool_cookie)
+      return true;
+    m_last_pool_cookie = cookie;
+
+    // the raw cookie also moves for txes restricted clients may not see, such as stem txes
+    if (m_restricted)
+    {
+      std::vector<crypto::hash> tx_hashes;
+      m_core.get_pool_transaction_hashes(tx_hashes, false);
+      crypto::hash digest = crypto::null_hash;
+      for (const crypto::hash &tx_hash: tx_hashes)
+        for (size_t i = 0; i < sizeof(digest.data); ++i)
+          digest.data[i] ^= tx_hash.data[i];
+      if (digest == m_public_pool_digest)
+        return true;
+      m_public_pool_digest = digest;
+      m_event_waiter->update_pool(++m_public_pool_cookie);
+    }
+    else
+      m_event_waiter->update_pool(cookie);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_response_cache::handle core_rpc_server::response_cache(const char *rpc, const rpc_response_cache::depends depends)
+  {
+    // paid calls are charged per call, and bootstrap daemon answers are not ours to keep
+    if (m_rpc_payment)
+      return {};
+    {
+      boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
+      if (m_bootstrap_daemon)
+        return {};
+    }
+    return m_response_cache->bind(rpc, depends, depends == rpc_response_cache::depends::live ? m_core.get_pool_cookie() : 0);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void core_rpc_server::run_json_rpc_batch(size_t count, const std::function<void(size_t)>& call, const connection_context& ctx)
+  {
+    // The batch takes this server thread as a whole. When it is refused, the
+    // elements run here one by one and go through admission on their own.
+    const rpc_admission::ticket admission_ticket = admit("json_rpc_batch", &ctx);
+    if (!admission_ticket)
+    {
+      for (size_t i = 0; i < count; ++i)
+        call(i);
+      return;
+    }
+
+    // A waiter on the global pool runs whatever is queued there, which may be
+    // block verification holding core locks. The batch pool only ever runs
+    // batch elements, so the calling thread can join in while waiting.
+    tools::threadpool::waiter waiter;
+    std::vector<uint8_t> deferred(count, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+      m_batch_pool->submit(&waiter, [&call, &deferred, i]() {
+        const rpc_admission::batch_element_scope scope{};
+        call(i);
+        deferred[i] = scope.deferred();
+      });
+    }
+    waiter.wait(m_batch_pool.get());
+
+    // Elements over a method cap run again one after the other on this
+    // thread, which the batch already holds, waiting for a slot if need be.
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (!deferred[i])
+        continue;
+      const rpc_admission::batch_element_scope scope{true};
+      call(i);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_admission::ticket core_rpc_server::admit(const char *rpc, const connection_context *ctx)
+  {
+    // internal calls, the local host on an unrestricted server and mining do not queue behind wallet traffic
+    const bool priority = !ctx || (!m_restricted && ctx->m_remote_address.is_loopback())
+      || !strcmp(rpc, "getblocktemplate") || !strcmp(rpc, "submitblock");
+    return m_admission->admit(rpc, priority ? rpc_admission::lane::priority : rpc_admission::lane::normal);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::check_payment(const std::string &client_message, uint64_t payment, const std::string &rpc, bool same_ts, std::string &message, uint64_t &credits, std::string &top_hash)
   {
     if (m_rpc_payment == NULL)
@@ -506,6 +736,56 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_db_stats(const COMMAND_RPC_GET_DB_STATS::request& req, COMMAND_RPC_GET_DB_STATS::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_db_stats);
+    // No bootstrap daemon check: Only ever get stats about local server
+    const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    db_stats_t stats;
+    if (!db.get_db_stats(stats))
+    {
+      res.status = "Database statistics not available for " + db.get_db_name();
+      return true;
+    }
+
+    const auto copy_histogram = [](const db_latency_histogram_t &from, db_latency_entry &to) {
+      to.count = from.count;
+      to.total_ns = from.total_ns;
+      to.buckets = from.buckets;
+    };
+    res.db_type = db.get_db_name();
+    res.enabled = stats.enabled;
+    res.page_size = stats.page_size;
+    res.map_size = stats.map_size;
+    res.used_size = stats.used_size;
+    res.max_readers = stats.max_readers;
+    res.num_readers = stats.num_readers;
+    res.map_resizes = stats.map_resizes;
+    res.read_txns = stats.read_txns;
+    copy_histogram(stats.commits, res.commits);
+    res.major_page_faults = stats.major_page_faults;
+    res.minor_page_faults = stats.minor_page_faults;
+    res.tables.reserve(stats.tables.size());
+    for (const db_table_stats_t &table: stats.tables)
+    {
+      res.tables.push_back({});
+      db_table_entry &t = res.tables.back();
+      t.name = table.name;
+      t.entries = table.entries;
+      t.depth = table.depth;
+      t.branch_pages = table.branch_pages;
+      t.leaf_pages = table.leaf_pages;
+      t.overflow_pages = table.overflow_pages;
+      t.reads = table.reads;
+      t.writes = table.writes;
+      t.deletes = table.deletes;
+      t.cursor_opens = table.cursor_opens;
+      copy_histogram(table.latency, t.latency);
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   class pruned_transaction {
     transaction& tx;
   public:
@@ -516,7 +796,7 @@ namespace cryptonote
     END_SERIALIZE()
   };
   //------------------------------------------------------------------------------------------------------------------------------
-  bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, const connection_context *ctx)
+  bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, const connection_context *ctx, epee::net_utils::http::body_generator *stream)
   {
     RPC_TRACKER(get_blocks);
 
@@ -561,6 +841,29 @@ namespace cryptonote
       }
     }
 
+    if (stream)
+    {
+      // blocks are encoded straight out of the db as the response goes out
+      size_t count = 0;
+      if (!m_core.get_blockchain_storage().find_blockchain_supplement_range(req.start_height, req.block_ids, res.current_height, res.start_height, count, max_blocks))
+      {
+        res.status = "Failed";
+        add_host_fail(ctx);
+        return false;
+      }
+
+      CHECK_PAYMENT_SAME_TS(req, res, count * COST_PER_BLOCK);
+
+      res.status = CORE_RPC_STATUS_OK;
+      if (count > 0)
+      {
+        const auto blocks = std::make_shared<rpc_blocks_stream>(m_core.get_blockchain_storage().get_db(), res, count, req.prune, req.no_miner_tx, BLOCKS_STREAM_CHUNK_SIZE);
+        *stream = [blocks](std::string& chunk) { return (*blocks)(chunk); };
+      }
+      MDEBUG("on_get_blocks: streaming " << count << " blocks from height " << res.start_height);
+      return true;
+    }
+
     std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
     if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, req.prune, !req.no_miner_tx, max_blocks))
     {
@@ -645,7 +948,7 @@ namespace cryptonote
       return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  bool core_rpc_server::on_get_blocks_by_height(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response& res, const connection_context *ctx)
+  bool core_rpc_server::on_get_blocks_by_height(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response& res, const connection_context *ctx, epee::net_utils::http::body_generator *stream)
   {
     RPC_TRACKER(get_blocks_by_height);
     bool r;
@@ -663,6 +966,18 @@ namespace cryptonote
     res.blocks.clear();
     res.blocks.reserve(req.heights.size());
     CHECK_PAYMENT_MIN1(req, res, req.heights.size() * COST_PER_BLOCK, false);
+    if (stream && !req.heights.empty())
+    {
+      // missing heights are reported below, with the blocks found before them
+      const uint64_t blockchain_height = m_core.get_current_blockchain_height();
+      if (std::all_of(req.heights.begin(), req.heights.end(), [blockchain_height](uint64_t height) { return height < blockchain_height; }))
+      {
+        res.status = CORE_RPC_STATUS_OK;
+        const auto blocks = std::make_shared<rpc_blocks_stream>(m_core.get_blockchain_storage().get_db(), res, req.heights, BLOCKS_STREAM_CHUNK_SIZE);
+        *stream = [blocks](std::string& chunk) { return (*blocks)(chunk); };
+        return true;
+      }
+    }
     for (uint64_t height : req.heights)
     {
       block blk;
@@ -1332,6 +1647,212 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx)
+  {
+    // No bootstrap daemon check: Only ever get stats about local server
+    using sampled = std::vector<std::pair<std::string, uint64_t>>;
+    using tools::metrics::registry;
+    std::string &out = response_info.m_body;
+    registry::getInstance().write(out);
+
+    registry::write_sampled(out, "monero_txpool_transactions", "gauge", "Transactions in the pool", {}, {{{}, m_core.get_pool_transactions_count(true)}});
+
+    sampled messages_in, bytes_in, messages_out, bytes_out;
+    for (const auto &e: m_p2p.get_command_stats())
+    {
+      const char *name = levin_command_name(e.command);
+      const std::string command = name ? name : std::to_string(e.command);
+      messages_in.emplace_back(command, e.messages_in);
+      bytes_in.emplace_back(command, e.bytes_in);
+      messages_out.emplace_back(command, e.messages_out);
+      bytes_out.emplace_back(command, e.bytes_out);
+    }
+    registry::write_sampled(out, "monero_p2p_messages_received_total", "counter", "P2P messages received, by command", "command", messages_in);
+    registry::write_sampled(out, "monero_p2p_received_bytes_total", "counter", "P2P bytes received, by command", "command", bytes_in);
+    registry::write_sampled(out, "monero_p2p_messages_sent_total", "counter", "P2P messages sent, by command", "command", messages_out);
+    registry::write_sampled(out, "monero_p2p_sent_bytes_total", "counter", "P2P bytes sent, by command", "command", bytes_out);
+
+    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
+    registry::write_sampled(out, "monero_sync_queue_spans", "gauge", "Downloaded block spans waiting to be added", {}, {{{}, block_queue.get_num_filled_spans()}});
+    registry::write_sampled(out, "monero_sync_queue_bytes", "gauge", "Size of the blocks waiting to be added", {}, {{{}, block_queue.get_data_size()}});
+
+    db_stats_t stats;
+    if (m_core.get_blockchain_storage().get_db().get_db_stats(stats))
+    {
+      registry::write_sampled(out, "monero_db_map_size_bytes", "gauge", "Size of the database memory map", {}, {{{}, stats.map_size}});
+      registry::write_sampled(out, "monero_db_used_bytes", "gauge", "Bytes of the database memory map in use", {}, {{{}, stats.used_size}});
+      registry::write_sampled(out, "monero_db_map_resizes_total", "counter", "Database memory map resizes", {}, {{{}, stats.map_resizes}});
+    }
+
+    response_info.m_mime_tipe = "text/plain; version=0.0.4";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_login(const tools::COMMAND_RPC_LOGIN::request& req, tools::COMMAND_RPC_LOGIN::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(light_wallet_login);
+    crypto::secret_key view_key;
+    if (!epee::string_tools::hex_to_pod(req.view_key, view_key))
+    {
+      res.status = "Failed";
+      res.reason = "Invalid view key";
+      return true;
+    }
+
+    const light_wallet_scanner::status status = m_light_wallet->login(req.address, view_key, req.create_account, m_core.get_current_blockchain_height());
+    res.new_address = status == light_wallet_scanner::status::created;
+    if (status != light_wallet_scanner::status::ok && !res.new_address)
+    {
+      res.status = "Failed";
+      res.reason = light_wallet_error(status);
+      return true;
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_import(const tools::COMMAND_RPC_IMPORT_WALLET_REQUEST::request& req, tools::COMMAND_RPC_IMPORT_WALLET_REQUEST::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(light_wallet_import);
+    crypto::secret_key view_key;
+    if (!epee::string_tools::hex_to_pod(req.view_key, view_key))
+    {
+      res.status = "Invalid view key";
+      return true;
+    }
+
+    const light_wallet_scanner::status status = m_light_wallet->import(req.address, view_key);
+    if (status != light_wallet_scanner::status::ok)
+    {
+      res.status = light_wallet_error(status);
+      return true;
+    }
+    res.import_fee = 0;
+    res.new_request = true;
+    res.request_fulfilled = true;
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_get_address_txs(const tools::COMMAND_RPC_GET_ADDRESS_TXS::request& req, tools::COMMAND_RPC_GET_ADDRESS_TXS::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(light_wallet_get_address_txs);
+    crypto::secret_key view_key;
+    if (!epee::string_tools::hex_to_pod(req.view_key, view_key))
+    {
+      res.status = "Invalid view key";
+      return true;
+    }
+
+    const uint64_t height = m_core.get_current_blockchain_height();
+    const time_t now = time(NULL);
+    res.blockchain_height = height;
+    const light_wallet_scanner::status status = m_light_wallet->with_account(req.address, view_key, [&](const light_wallet_scanner::account &account) {
+      res.scanned_height = res.scanned_block_height = account.scan_height ? account.scan_height - 1 : 0;
+
+      // outputs and spends are both in height order, merge them per transaction
+      std::unordered_map<crypto::hash, size_t> txes;
+      const auto get_tx = [&](const crypto::hash &hash, uint64_t tx_height, uint64_t timestamp, uint64_t unlock_time) -> tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction& {
+        const auto inserted = txes.emplace(hash, res.transactions.size());
+        if (inserted.second)
+        {
+          res.transactions.emplace_back();
+          tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction &tx = res.transactions.back();
+          tx.hash = epee::string_tools::pod_to_hex(hash);
+          tx.height = tx_height;
+          tx.timestamp = timestamp;
+          tx.unlock_time = unlock_time;
+        }
+        return res.transactions[inserted.first->second];
+      };
+
+      for (const light_wallet_scanner::output &out: account.outputs)
+      {
+        tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction &tx = get_tx(out.tx_hash, out.height, out.timestamp, out.unlock_time);
+        tx.total_received += out.amount;
+        tx.coinbase = out.coinbase;
+        res.total_received += out.amount;
+        const bool unlocked = out.height + (out.coinbase ? CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW : CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE) <= height &&
+          (out.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER ? out.unlock_time <= height : out.unlock_time <= (uint64_t)now);
+        if (unlocked)
+          res.total_received_unlocked += out.amount;
+      }
+      for (const light_wallet_scanner::spend &spend: account.spends)
+      {
+        const light_wallet_scanner::output &out = account.outputs[spend.output];
+        tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction &tx = get_tx(spend.tx_hash, spend.height, spend.timestamp, spend.unlock_time);
+        tx.total_sent += spend.amount;
+        tx.mixin = spend.mixin;
+        tx.spent_outputs.push_back({spend.amount, epee::string_tools::pod_to_hex(spend.key_image), epee::string_tools::pod_to_hex(out.tx_pub_key), out.index, spend.mixin});
+      }
+
+      std::stable_sort(res.transactions.begin(), res.transactions.end(), [](const tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction &a, const tools::COMMAND_RPC_GET_ADDRESS_TXS::transaction &b) {
+        return a.height < b.height;
+      });
+      for (size_t i = 0; i < res.transactions.size(); ++i)
+        res.transactions[i].id = i;
+    });
+    if (status != light_wallet_scanner::status::ok)
+    {
+      res.status = light_wallet_error(status);
+      return true;
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_light_wallet_get_unspent_outs(const tools::COMMAND_RPC_GET_UNSPENT_OUTS::request& req, tools::COMMAND_RPC_GET_UNSPENT_OUTS::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(light_wallet_get_unspent_outs);
+    crypto::secret_key view_key;
+    uint64_t dust_threshold = 0;
+    if (!epee::string_tools::hex_to_pod(req.view_key, view_key))
+    {
+      res.status = "Failed";
+      res.reason = "Invalid view key";
+      return true;
+    }
+    if (!req.use_dust && !req.dust_threshold.empty() && !epee::string_tools::get_xtype_from_string(dust_threshold, req.dust_threshold))
+    {
+      res.status = "Failed";
+      res.reason = "Invalid dust threshold";
+      return true;
+    }
+
+    // candidate spends are listed in spend_key_images, the wallet tells which are really its own
+    const light_wallet_scanner::status status = m_light_wallet->with_account(req.address, view_key, [&](const light_wallet_scanner::account &account) {
+      for (const light_wallet_scanner::output &out: account.outputs)
+      {
+        if (out.amount < dust_threshold)
+          continue;
+        res.outputs.emplace_back();
+        tools::COMMAND_RPC_GET_UNSPENT_OUTS::output &o = res.outputs.back();
+        o.amount = out.amount;
+        o.public_key = epee::string_tools::pod_to_hex(out.key);
+        o.index = out.index;
+        o.global_index = out.global_index;
+        o.rct = out.rct;
+        o.tx_hash = epee::string_tools::pod_to_hex(out.tx_hash);
+        o.tx_pub_key = epee::string_tools::pod_to_hex(out.tx_pub_key);
+        o.tx_prefix_hash = epee::string_tools::pod_to_hex(out.tx_prefix_hash);
+        for (const crypto::key_image &key_image: out.spend_key_images)
+          o.spend_key_images.push_back(epee::string_tools::pod_to_hex(key_image));
+        o.timestamp = out.timestamp;
+        o.height = out.height;
+        res.amount += out.amount;
+      }
+    });
+    if (status != light_wallet_scanner::status::ok)
+    {
+      res.status = "Failed";
+      res.reason = light_wallet_error(status);
+      return true;
+    }
+    res.per_kb_fee = m_core.get_blockchain_storage().get_dynamic_base_fee_estimate(LIGHT_WALLET_FEE_GRACE_BLOCKS) * 1024;
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_save_bc(const COMMAND_RPC_SAVE_BC::request& req, COMMAND_RPC_SAVE_BC::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(save_bc);
@@ -1541,6 +2062,69 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_wait_for_event(const COMMAND_RPC_WAIT_FOR_EVENT::request& req, COMMAND_RPC_WAIT_FOR_EVENT::response& res, const connection_context *ctx, epee::net_utils::http::json_deferrer<COMMAND_RPC_WAIT_FOR_EVENT::response> *defer)
+  {
+    RPC_TRACKER(wait_for_event);
+    if (!m_event_waiter)
+    {
+      res.status = "Events are not available";
+      return true;
+    }
+
+    // an empty hash never matches the chain, the call then returns the current state right away
+    crypto::hash top_hash = crypto::null_hash;
+    if (!req.top_hash.empty() && !epee::string_tools::hex_to_pod(req.top_hash, top_hash))
+    {
+      res.status = "Failed to parse top_hash";
+      return true;
+    }
+
+    // until the first check, the top is not known yet
+    if (m_event_waiter->get_state().top_hash == crypto::null_hash)
+    {
+      uint64_t top_height;
+      const crypto::hash hash = m_core.get_blockchain_storage().get_db().top_block_hash(&top_height);
+      m_event_waiter->init_chain(top_height + 1, hash);
+    }
+
+    const bool pool = req.pool;
+    const uint64_t pool_cookie = req.pool_cookie;
+    const auto fill = [top_hash, pool, pool_cookie](const rpc_event_waiter::result result, const rpc_event_waiter::state &state, COMMAND_RPC_WAIT_FOR_EVENT::response &res) {
+      if (result == rpc_event_waiter::result::busy)
+      {
+        refuse_busy(res);
+        return;
+      }
+      res.height = state.height;
+      res.top_hash = epee::string_tools::pod_to_hex(state.top_hash);
+      res.pool_cookie = state.pool_cookie;
+      res.new_block = state.top_hash != top_hash;
+      res.pool_changed = pool && state.pool_cookie != pool_cookie;
+      res.status = CORE_RPC_STATUS_OK;
+    };
+
+    // without a way to park the call, it gets what is known now
+    if (!defer)
+    {
+      m_event_waiter->wait(top_hash, pool, pool_cookie, std::chrono::milliseconds::zero(), [&](const rpc_event_waiter::result result, const rpc_event_waiter::state &state) {
+        fill(result, state, res);
+      });
+      return true;
+    }
+
+    // parked calls hold no thread, they are answered from whichever publishes the change, or times them out
+    const std::chrono::seconds timeout{std::min<uint32_t>(req.timeout, WAIT_FOR_EVENT_MAX_TIMEOUT)};
+    const std::shared_ptr<rpc_event_waiter> event_waiter = m_event_waiter;
+    *defer = [event_waiter, top_hash, pool, pool_cookie, timeout, fill](const std::function<void(const COMMAND_RPC_WAIT_FOR_EVENT::response&)> &done) {
+      event_waiter->wait(top_hash, pool, pool_cookie, timeout, [fill, done](const rpc_event_waiter::result result, const rpc_event_waiter::state &state) {
+        COMMAND_RPC_WAIT_FOR_EVENT::response res{};
+        fill(result, state, res);
+        done(res);
+      });
+    };
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_transaction_pool_stats(const COMMAND_RPC_GET_TRANSACTION_POOL_STATS::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_STATS::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(get_transaction_pool_stats);
@@ -2863,9 +3447,23 @@ namespace cryptonote
     res.target_height = m_core.get_target_blockchain_height();
     res.next_needed_pruning_seed = m_p2p.get_payload_object().get_next_needed_pruning_stripe().second;
 
+    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
     for (const auto &c: m_p2p.get_payload_object().get_connections())
+    {
       res.peers.push_back({c});
-    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
+      cryptonote::block_queue::peer_stats stats;
+      boost::uuids::uuid connection_id;
+      if (epee::string_tools::hex_to_pod(c.connection_id, connection_id) && block_queue.get_peer_stats(connection_id, stats))
+      {
+        COMMAND_RPC_SYNC_INFO::peer &peer = res.peers.back();
+        peer.sync_rate = (uint32_t)(stats.rate + 0.5f);
+        peer.rtt = (uint32_t)(stats.rtt * 1000.0f + 0.5f);
+        peer.span_size = block_queue.get_span_size(connection_id, m_core.get_block_sync_size(res.height));
+        peer.spans_downloaded = stats.nspans;
+        peer.blocks_downloaded = stats.nblocks;
+        peer.stalls = stats.nstalls;
+      }
+    }
     block_queue.foreach([&](const cryptonote::block_queue::span &span) {
       const std::string span_connection_id = epee::string_tools::pod_to_hex(span.connection_id);
       uint32_t speed = (uint32_t)(100.0f * block_queue.get_speed(span.connection_id) + 0.5f);
@@ -3182,6 +3780,8 @@ namespace cryptonote
     if (req.clear)
     {
       RPCTracker::clear();
+      m_response_cache->clear_counters();
+      m_admission->clear_counters();
       res.status = CORE_RPC_STATUS_OK;
       return true;
     }
@@ -3196,6 +3796,23 @@ namespace cryptonote
       res.data.back().credits = d.second.credits;
     }
 
+    for (const auto &c: m_response_cache->get_counters())
+    {
+      res.cache.resize(res.cache.size() + 1);
+      res.cache.back().rpc = c.first;
+      res.cache.back().hits = c.second.hits;
+      res.cache.back().misses = c.second.misses;
+    }
+
+    for (const auto &a: m_admission->get_counters())
+    {
+      res.admission.resize(res.admission.size() + 1);
+      res.admission.back().rpc = a.first;
+      res.admission.back().queued = a.second.queued;
+      res.admission.back().queue_time = a.second.queue_time;
+      res.admission.back().busy = a.second.busy;
+    }
+
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -3318,4 +3935,33 @@ namespace cryptonote
     , "Allow free access from the loopback address (ie, the local host)"
     , false
     };
+
+  const command_line::arg_descriptor<uint32_t> core_rpc_server::arg_rpc_threads = {
+      "rpc-threads"
+    , "Number of threads serving RPC requests, one of which is kept for local and mining calls"
+    , 4
+    };
+
+  const command_line::arg_descriptor<std::vector<std::string>> core_rpc_server::arg_rpc_method_limit = {
+      "rpc-method-limit"
+    , "Cap concurrent calls to an RPC method as <method>:<concurrent>[:<queued>], 0 lifts the cap"
+    };
+
+  const command_line::arg_descriptor<bool> core_rpc_server::arg_rpc_light_wallet = {
+      "rpc-light-wallet"
+    , "Scan the chain for accounts registered by light wallets, and serve them their outputs"
+    , false
+    };
+
+  const command_line::arg_descriptor<unsigned> core_rpc_server::arg_rpc_max_parked_waits = {
+      "rpc-max-parked-waits"
+    , "Maximum number of wait_for_event calls parked at once, parked calls hold a connection but no thread"
+    , 1000
+    };
+
+  const command_line::arg_descriptor<bool> core_rpc_server::arg_rpc_no_compression = {
+      "rpc-no-compression"
+    , "Do not gzip or zstd compress RPC responses, even for clients that accept it"
+    , false
+    };
 }  // namespace cryptonote
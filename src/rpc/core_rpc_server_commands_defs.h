@@ -88,7 +88,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 3
-#define CORE_RPC_VERSION_MINOR 1
+#define CORE_RPC_VERSION_MINOR 3
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -760,6 +760,95 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  //-----------------------------------------------
+  struct db_latency_entry
+  {
+    uint64_t count;
+    uint64_t total_ns;
+    std::vector<uint64_t> buckets;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(count)
+      KV_SERIALIZE(total_ns)
+      KV_SERIALIZE(buckets)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct db_table_entry
+  {
+    std::string name;
+    uint64_t entries;
+    uint64_t depth;
+    uint64_t branch_pages;
+    uint64_t leaf_pages;
+    uint64_t overflow_pages;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t deletes;
+    uint64_t cursor_opens;
+    db_latency_entry latency;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(entries)
+      KV_SERIALIZE(depth)
+      KV_SERIALIZE(branch_pages)
+      KV_SERIALIZE(leaf_pages)
+      KV_SERIALIZE(overflow_pages)
+      KV_SERIALIZE(reads)
+      KV_SERIALIZE(writes)
+      KV_SERIALIZE(deletes)
+      KV_SERIALIZE(cursor_opens)
+      KV_SERIALIZE(latency)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_GET_DB_STATS
+  {
+    struct request_t: public rpc_request_base
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_response_base
+    {
+      std::string db_type;
+      bool enabled;
+      uint64_t page_size;
+      uint64_t map_size;
+      uint64_t used_size;
+      uint64_t max_readers;
+      uint64_t num_readers;
+      uint64_t map_resizes;
+      uint64_t read_txns;
+      db_latency_entry commits;
+      uint64_t major_page_faults;
+      uint64_t minor_page_faults;
+      std::vector<db_table_entry> tables;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(db_type)
+        KV_SERIALIZE(enabled)
+        KV_SERIALIZE(page_size)
+        KV_SERIALIZE(map_size)
+        KV_SERIALIZE(used_size)
+        KV_SERIALIZE(max_readers)
+        KV_SERIALIZE(num_readers)
+        KV_SERIALIZE(map_resizes)
+        KV_SERIALIZE(read_txns)
+        KV_SERIALIZE(commits)
+        KV_SERIALIZE(major_page_faults)
+        KV_SERIALIZE(minor_page_faults)
+        KV_SERIALIZE(tables)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   //-----------------------------------------------
   struct COMMAND_RPC_STOP_MINING
   {
@@ -1503,8 +1592,15 @@ namespace cryptonote
     uint64_t histo_98pc;
     std::vector<txpool_histo> histo;
     uint32_t num_double_spends;
+    uint64_t admission_batches;
+    uint64_t admission_txs_checked;
+    uint64_t admission_txs_added;
+    uint64_t admission_check_us;
+    uint64_t admission_chain_lock_us;
+    uint64_t admission_pool_lock_us;
 
-    txpool_stats(): bytes_total(0), bytes_min(0), bytes_max(0), bytes_med(0), fee_total(0), oldest(0), txs_total(0), num_failing(0), num_10m(0), num_not_relayed(0), histo_98pc(0), num_double_spends(0) {}
+    txpool_stats(): bytes_total(0), bytes_min(0), bytes_max(0), bytes_med(0), fee_total(0), oldest(0), txs_total(0), num_failing(0), num_10m(0), num_not_relayed(0), histo_98pc(0), num_double_spends(0),
+      admission_batches(0), admission_txs_checked(0), admission_txs_added(0), admission_check_us(0), admission_chain_lock_us(0), admission_pool_lock_us(0) {}
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(bytes_total)
@@ -1520,6 +1616,12 @@ namespace cryptonote
       KV_SERIALIZE(histo_98pc)
       KV_SERIALIZE(histo)
       KV_SERIALIZE(num_double_spends)
+      KV_SERIALIZE_OPT(admission_batches, (uint64_t)0)
+      KV_SERIALIZE_OPT(admission_txs_checked, (uint64_t)0)
+      KV_SERIALIZE_OPT(admission_txs_added, (uint64_t)0)
+      KV_SERIALIZE_OPT(admission_check_us, (uint64_t)0)
+      KV_SERIALIZE_OPT(admission_chain_lock_us, (uint64_t)0)
+      KV_SERIALIZE_OPT(admission_pool_lock_us, (uint64_t)0)
     END_KV_SERIALIZE_MAP()
   };
 
@@ -2184,9 +2286,21 @@ namespace cryptonote
     struct peer
     {
       connection_info info;
+      uint32_t sync_rate;
+      uint32_t rtt; // milliseconds
+      uint64_t span_size;
+      uint64_t spans_downloaded;
+      uint64_t blocks_downloaded;
+      uint64_t stalls;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(info)
+        KV_SERIALIZE_OPT(sync_rate, (uint32_t)0)
+        KV_SERIALIZE_OPT(rtt, (uint32_t)0)
+        KV_SERIALIZE_OPT(span_size, (uint64_t)0)
+        KV_SERIALIZE_OPT(spans_downloaded, (uint64_t)0)
+        KV_SERIALIZE_OPT(blocks_downloaded, (uint64_t)0)
+        KV_SERIALIZE_OPT(stalls, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -2422,13 +2536,45 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
 
+    struct cache_entry
+    {
+      std::string rpc;
+      uint64_t hits;
+      uint64_t misses;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(rpc)
+        KV_SERIALIZE(hits)
+        KV_SERIALIZE(misses)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct admission_entry
+    {
+      std::string rpc;
+      uint64_t queued;
+      uint64_t queue_time;
+      uint64_t busy;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(rpc)
+        KV_SERIALIZE(queued)
+        KV_SERIALIZE(queue_time)
+        KV_SERIALIZE(busy)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response_t: public rpc_response_base
     {
       std::vector<entry> data;
+      std::vector<cache_entry> cache;
+      std::vector<admission_entry> admission;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_response_base)
         KV_SERIALIZE(data)
+        KV_SERIALIZE(cache)
+        KV_SERIALIZE(admission)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -2586,4 +2732,43 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_WAIT_FOR_EVENT
+  {
+    struct request_t: public rpc_request_base
+    {
+      std::string top_hash;
+      bool pool;
+      uint64_t pool_cookie;
+      uint32_t timeout;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+        KV_SERIALIZE(top_hash)
+        KV_SERIALIZE_OPT(pool, false)
+        KV_SERIALIZE_OPT(pool_cookie, (uint64_t)0)
+        KV_SERIALIZE_OPT(timeout, (uint32_t)30)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_response_base
+    {
+      uint64_t height;
+      std::string top_hash;
+      uint64_t pool_cookie;
+      bool new_block;
+      bool pool_changed;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(top_hash)
+        KV_SERIALIZE(pool_cookie)
+        KV_SERIALIZE(new_block)
+        KV_SERIALIZE(pool_changed)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
 }
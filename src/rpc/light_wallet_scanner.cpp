@@ -0,0 +1,714 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <boost/archive/portable_binary_iarchive.hpp>
+#include <boost/archive/portable_binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <fstream>
+#include <limits>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "misc_log_ex.h"
+#include "string_tools.h"
+#include "common/util.h"
+#include "common/unordered_containers_boost_serialization.h"
+#include "cryptonote_basic/cryptonote_boost_serialization.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "ringct/rctOps.h"
+#include "light_wallet_scanner.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc.light_wallet"
+
+#define BLOCK_IDS_KEPT 100
+#define BLOCKS_PER_BATCH 500
+#define BLOCKS_PER_SLICE 100 // for each cohort catching up, per batch
+#define SCAN_INTERVAL 1 // seconds, when caught up
+#define STORE_INTERVAL (10 * 60)
+
+namespace
+{
+  struct found_output
+  {
+    std::string account;
+    cryptonote::light_wallet_scanner::output out;
+  };
+
+  bool decode_amount(const cryptonote::transaction &tx, size_t i, const crypto::key_derivation &derivation, uint64_t &amount, std::string &rct)
+  {
+    if (tx.version < 2 || tx.rct_signatures.type == rct::RCTTypeNull)
+    {
+      amount = tx.vout[i].amount;
+      rct = tx.version < 2 ? std::string() : std::string("coinbase");
+      return true;
+    }
+    if (i >= tx.rct_signatures.ecdhInfo.size() || i >= tx.rct_signatures.outPk.size())
+      return false;
+
+    crypto::secret_key scalar;
+    crypto::derivation_to_scalar(derivation, i, scalar);
+    rct::ecdhTuple ecdh = tx.rct_signatures.ecdhInfo[i];
+    rct::ecdhDecode(ecdh, rct::sk2rct(scalar), tx.rct_signatures.type == rct::RCTTypeBulletproof2);
+    amount = rct::h2d(ecdh.amount);
+    if (!rct::equalKeys(rct::commit(amount, ecdh.mask), tx.rct_signatures.outPk[i].mask))
+      return false;
+
+    rct = epee::string_tools::pod_to_hex(tx.rct_signatures.outPk[i].mask) +
+      epee::string_tools::pod_to_hex(tx.rct_signatures.ecdhInfo[i].mask) +
+      epee::string_tools::pod_to_hex(tx.rct_signatures.ecdhInfo[i].amount);
+    return true;
+  }
+
+  typedef std::unordered_map<crypto::public_key, std::string> view_group; //!< Accounts by spend public key
+
+  void derive(const crypto::public_key &tx_pub_key, const std::vector<crypto::secret_key> &view_secret_keys, std::vector<crypto::key_derivation> &derivations)
+  {
+    derivations.resize(view_secret_keys.size());
+    if (tx_pub_key == crypto::null_pkey || !crypto::generate_key_derivations(tx_pub_key, view_secret_keys.data(), view_secret_keys.size(), derivations.data()))
+      std::fill(derivations.begin(), derivations.end(), crypto::key_derivation{});
+  }
+
+  void scan_tx(const cryptonote::light_wallet_scanner::block_data &block, size_t n, const std::vector<crypto::secret_key> &view_secret_keys, const std::vector<view_group> &groups, std::vector<found_output> &found)
+  {
+    const cryptonote::transaction &tx = block.txes[n];
+    const crypto::public_key tx_pub_key = cryptonote::get_tx_pub_key_from_extra(tx);
+    const std::vector<crypto::public_key> additional_tx_pub_keys = cryptonote::get_additional_tx_pub_keys_from_extra(tx);
+    if (tx_pub_key == crypto::null_pkey && additional_tx_pub_keys.empty())
+      return;
+
+    // per view group, each transaction key decompressed once for all of them
+    std::vector<crypto::key_derivation> derivations;
+    derive(tx_pub_key, view_secret_keys, derivations);
+    std::vector<std::vector<crypto::key_derivation>> additional_derivations(additional_tx_pub_keys.size());
+    for (size_t i = 0; i < additional_tx_pub_keys.size(); ++i)
+      derive(additional_tx_pub_keys[i], view_secret_keys, additional_derivations[i]);
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+      const view_group &group = groups[g];
+      for (size_t i = 0; i < tx.vout.size(); ++i)
+      {
+        if (tx.vout[i].target.type() != typeid(cryptonote::txout_to_key))
+          continue;
+        const crypto::public_key &key = boost::get<cryptonote::txout_to_key>(tx.vout[i].target).key;
+
+        crypto::public_key spend_public_key;
+        const crypto::key_derivation *used = nullptr;
+        auto account = group.end();
+        if (tx_pub_key != crypto::null_pkey && crypto::derive_subaddress_public_key(key, derivations[g], i, spend_public_key))
+        {
+          account = group.find(spend_public_key);
+          used = std::addressof(derivations[g]);
+        }
+        if (account == group.end() && i < additional_derivations.size() &&
+            crypto::derive_subaddress_public_key(key, additional_derivations[i][g], i, spend_public_key))
+        {
+          account = group.find(spend_public_key);
+          used = std::addressof(additional_derivations[i][g]);
+        }
+        if (account == group.end())
+          continue;
+
+        found.emplace_back();
+        found_output &f = found.back();
+        f.account = account->second;
+        if (!decode_amount(tx, i, *used, f.out.amount, f.out.rct))
+        {
+          MWARNING("Output " << i << " of " << block.tx_hashes[n] << " matches " << f.account << " but its amount does not decode");
+          found.pop_back();
+          continue;
+        }
+        f.out.tx_hash = block.tx_hashes[n];
+        f.out.tx_prefix_hash = cryptonote::get_transaction_prefix_hash(tx);
+        f.out.tx_pub_key = used == std::addressof(derivations[g]) ? tx_pub_key : additional_tx_pub_keys[i];
+        f.out.key = key;
+        f.out.index = i;
+        f.out.global_index = i < block.output_indices[n].size() ? block.output_indices[n][i] : 0;
+        f.out.height = block.height;
+        f.out.timestamp = block.timestamp;
+        f.out.unlock_time = tx.unlock_time;
+        f.out.coinbase = n == 0;
+      }
+    }
+  }
+
+  bool get_block_data(const cryptonote::Blockchain &chain, uint64_t height, cryptonote::light_wallet_scanner::block_data &data)
+  {
+    std::vector<std::pair<cryptonote::blobdata, cryptonote::block>> blocks;
+    if (!chain.get_blocks(height, 1, blocks) || blocks.size() != 1)
+    {
+      MERROR("Failed to get block at height " << height);
+      return false;
+    }
+    const cryptonote::block &b = blocks.front().second;
+
+    data.height = height;
+    data.id = cryptonote::get_block_hash(b);
+    data.timestamp = b.timestamp;
+    data.txes.push_back(b.miner_tx);
+    data.tx_hashes.push_back(cryptonote::get_transaction_hash(b.miner_tx));
+
+    std::vector<cryptonote::blobdata> blobs;
+    std::vector<crypto::hash> missed;
+    if (!chain.get_transactions_blobs(b.tx_hashes, blobs, missed, true) || !missed.empty() || blobs.size() != b.tx_hashes.size())
+    {
+      MERROR("Failed to get the transactions of block " << data.id);
+      return false;
+    }
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+      data.txes.emplace_back();
+      CHECK_AND_ASSERT_MES(cryptonote::parse_and_validate_tx_base_from_blob(blobs[i], data.txes.back()), false, "Failed to parse transaction " << b.tx_hashes[i]);
+      data.tx_hashes.push_back(b.tx_hashes[i]);
+    }
+
+    data.output_indices.resize(data.tx_hashes.size());
+    for (size_t i = 0; i < data.tx_hashes.size(); ++i)
+    {
+      if (!data.txes[i].vout.empty())
+        CHECK_AND_ASSERT_MES(chain.get_tx_outputs_gindexs(data.tx_hashes[i], data.output_indices[i]), false, "Failed to get output indices of " << data.tx_hashes[i]);
+    }
+    return true;
+  }
+}
+
+namespace cryptonote
+{
+  light_wallet_scanner::light_wallet_scanner(network_type nettype):
+    m_nettype(nettype),
+    m_last_store(time(NULL)),
+    m_stop(false)
+  {
+  }
+  //---------------------------------------------------------------------------------------------------
+  light_wallet_scanner::~light_wallet_scanner()
+  {
+    stop();
+  }
+  //---------------------------------------------------------------------------------------------------
+  light_wallet_scanner::status light_wallet_scanner::find_account(const std::string &address, const crypto::secret_key &view_key, std::string &key) const
+  {
+    address_parse_info info;
+    if (!get_account_address_from_str(info, m_nettype, address) || info.has_payment_id)
+      return status::bad_address;
+
+    // the view public key of a subaddress is its spend public key times the view secret key
+    if (info.is_subaddress)
+    {
+      if (rct::scalarmultKey(rct::pk2rct(info.address.m_spend_public_key), rct::sk2rct(view_key)) != info.address.m_view_public_key)
+        return status::bad_view_key;
+    }
+    else
+    {
+      crypto::public_key view_public_key;
+      if (!crypto::secret_key_to_public_key(view_key, view_public_key) || view_public_key != info.address.m_view_public_key)
+        return status::bad_view_key;
+    }
+
+    key = get_account_address_as_str(m_nettype, info.is_subaddress, info.address);
+    return m_accounts.count(key) ? status::ok : status::unknown_account;
+  }
+  //---------------------------------------------------------------------------------------------------
+  light_wallet_scanner::status light_wallet_scanner::login(const std::string &address, const crypto::secret_key &view_key, bool create, uint64_t height)
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    std::string key;
+    const status found = find_account(address, view_key, key);
+    if (found != status::unknown_account || !create)
+      return found;
+
+    address_parse_info info;
+    CHECK_AND_ASSERT_MES(get_account_address_from_str(info, m_nettype, key), status::bad_address, "Failed to parse address");
+    account &acc = m_accounts[key];
+    acc.spend_public_key = info.address.m_spend_public_key;
+    CHECK_AND_ASSERT_MES(crypto::secret_key_to_public_key(view_key, acc.view_group), status::bad_view_key, "Failed to derive view public key");
+    acc.view_secret_key = view_key;
+    acc.start_height = height;
+    acc.scan_height = height;
+
+    std::shared_ptr<const cohort> &slot = m_cohorts[height];
+    const std::shared_ptr<cohort> joined = slot ? std::make_shared<cohort>(*slot) : std::make_shared<cohort>();
+    add_to_cohort(*joined, key, acc);
+    slot = joined;
+    MINFO("Scanning " << key << " from height " << height);
+    return status::created;
+  }
+  //---------------------------------------------------------------------------------------------------
+  light_wallet_scanner::status light_wallet_scanner::import(const std::string &address, const crypto::secret_key &view_key)
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    std::string key;
+    const status found = find_account(address, view_key, key);
+    if (found != status::ok)
+      return found;
+
+    m_imports.insert(std::move(key));
+    m_wake.notify_one();
+    return status::ok;
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::apply_imports()
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    if (m_imports.empty())
+      return;
+    for (const std::string &key: m_imports)
+    {
+      account &acc = m_accounts.at(key);
+      acc.start_height = 0;
+      acc.scan_height = 0;
+      acc.outputs.clear();
+      acc.spends.clear();
+      MINFO("Rescanning " << key << " from the genesis block");
+    }
+    m_imports.clear();
+    index_outputs();
+    index_cohorts();
+  }
+  //---------------------------------------------------------------------------------------------------
+  light_wallet_scanner::status light_wallet_scanner::with_account(const std::string &address, const crypto::secret_key &view_key, const std::function<void(const account &)> &f) const
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    std::string key;
+    const status found = find_account(address, view_key, key);
+    if (found == status::ok)
+      f(m_accounts.at(key));
+    return found;
+  }
+  //---------------------------------------------------------------------------------------------------
+  size_t light_wallet_scanner::get_account_count() const
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    return m_accounts.size();
+  }
+  //---------------------------------------------------------------------------------------------------
+  uint64_t light_wallet_scanner::get_scan_height() const
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    return m_cohorts.empty() ? std::numeric_limits<uint64_t>::max() : m_cohorts.begin()->first;
+  }
+  //---------------------------------------------------------------------------------------------------
+  std::vector<uint64_t> light_wallet_scanner::get_cohort_heights() const
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    std::vector<uint64_t> heights;
+    heights.reserve(m_cohorts.size());
+    for (const auto &e: m_cohorts)
+      heights.push_back(e.first);
+    return heights;
+  }
+  //---------------------------------------------------------------------------------------------------
+  bool light_wallet_scanner::has_cohort(uint64_t height) const
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    return m_cohorts.count(height);
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::index_outputs()
+  {
+    m_output_index.clear();
+    for (const auto &e: m_accounts)
+    {
+      for (size_t i = 0; i < e.second.outputs.size(); ++i)
+      {
+        const output &out = e.second.outputs[i];
+        m_output_index[{out.rct.empty() ? out.amount : 0, out.global_index}].emplace_back(e.first, i);
+      }
+    }
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::add_to_cohort(cohort &c, const std::string &key, account &acc)
+  {
+    const auto inserted = c.group_index.emplace(acc.view_group, c.accounts.size());
+    if (inserted.second)
+    {
+      c.view_secret_keys.push_back(acc.view_secret_key);
+      c.accounts.emplace_back();
+    }
+    c.accounts[inserted.first->second].emplace(acc.spend_public_key, key);
+    c.members.push_back(std::addressof(acc));
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::index_cohorts()
+  {
+    std::map<uint64_t, std::shared_ptr<cohort>> cohorts;
+    for (auto &e: m_accounts)
+    {
+      std::shared_ptr<cohort> &c = cohorts[e.second.scan_height];
+      if (!c)
+        c = std::make_shared<cohort>();
+      add_to_cohort(*c, e.first, e.second);
+    }
+    m_cohorts.clear();
+    for (auto &e: cohorts)
+      m_cohorts.emplace(e.first, std::move(e.second));
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::scan_block(const block_data &block)
+  {
+    CHECK_AND_ASSERT_THROW_MES(block.txes.size() == block.tx_hashes.size() && block.txes.size() == block.output_indices.size(), "Inconsistent block data");
+
+    // key derivations are done without the lock, on a snapshot of the cohort
+    std::shared_ptr<const cohort> batch;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      const auto it = m_cohorts.find(block.height);
+      if (it == m_cohorts.end())
+        return;
+      batch = it->second;
+    }
+
+    std::vector<found_output> found;
+    for (size_t n = 0; n < block.txes.size(); ++n)
+      scan_tx(block, n, batch->view_secret_keys, batch->accounts, found);
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    // a login at this height replaced the cohort meanwhile, the accounts not in the snapshot are left for another pass
+    const auto current = m_cohorts.find(block.height);
+    const bool intact = current != m_cohorts.end() && current->second == batch;
+    std::set<std::string> snapshot;
+    if (!intact)
+      for (const view_group &group: batch->accounts)
+        for (const auto &e: group)
+          snapshot.insert(e.second);
+    const auto in_batch = [&](const std::string &key) -> account* {
+      const auto it = m_accounts.find(key);
+      if (it == m_accounts.end() || it->second.scan_height != block.height || (!intact && !snapshot.count(key)))
+        return nullptr;
+      return std::addressof(it->second);
+    };
+
+    for (found_output &f: found)
+    {
+      account *acc = in_batch(f.account);
+      if (!acc)
+        continue;
+      MDEBUG("Found " << f.out.amount << " for " << f.account << " in " << f.out.tx_hash);
+      m_output_index[{f.out.rct.empty() ? f.out.amount : 0, f.out.global_index}].emplace_back(f.account, acc->outputs.size());
+      acc->outputs.push_back(std::move(f.out));
+    }
+
+    for (size_t n = 1; n < block.txes.size(); ++n)
+    {
+      const transaction &tx = block.txes[n];
+      for (const txin_v &in: tx.vin)
+      {
+        if (in.type() != typeid(txin_to_key))
+          continue;
+        const txin_to_key &in_to_key = boost::get<txin_to_key>(in);
+        for (const uint64_t global_index: relative_output_offsets_to_absolute(in_to_key.key_offsets))
+        {
+          const auto used = m_output_index.find({in_to_key.amount, global_index});
+          if (used == m_output_index.end())
+            continue;
+          for (const auto &ref: used->second)
+          {
+            account *acc = in_batch(ref.first);
+            if (!acc)
+              continue;
+            output &out = acc->outputs[ref.second];
+            out.spend_key_images.push_back(in_to_key.k_image);
+            acc->spends.push_back({block.tx_hashes[n], in_to_key.k_image, out.amount, ref.second, uint32_t(in_to_key.key_offsets.size() - 1), block.height, block.timestamp, tx.unlock_time});
+          }
+        }
+      }
+    }
+
+    if (intact)
+    {
+      for (account *acc: batch->members)
+        acc->scan_height = block.height + 1;
+      m_cohorts.erase(current);
+      std::shared_ptr<const cohort> &next = m_cohorts[block.height + 1];
+      if (!next)
+        next = std::move(batch);
+      else
+      {
+        // caught up with the cohort ahead, both are scanned together from now on
+        const std::shared_ptr<cohort> merged = std::make_shared<cohort>(*next);
+        for (const view_group &group: batch->accounts)
+          for (const auto &e: group)
+            add_to_cohort(*merged, e.second, m_accounts.at(e.second));
+        next = merged;
+      }
+    }
+    else
+    {
+      for (const std::string &key: snapshot)
+      {
+        account *acc = in_batch(key);
+        if (acc)
+          acc->scan_height = block.height + 1;
+      }
+      index_cohorts();
+    }
+
+    m_block_ids[block.height] = block.id;
+    while (m_block_ids.size() > BLOCK_IDS_KEPT)
+      m_block_ids.erase(m_block_ids.begin());
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::rollback(uint64_t height)
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    MINFO("Rolling light wallet accounts back to height " << height);
+    for (auto &e: m_accounts)
+    {
+      account &acc = e.second;
+      if (acc.scan_height <= height)
+        continue;
+
+      // both are appended in height order
+      const auto first_output = std::find_if(acc.outputs.begin(), acc.outputs.end(), [height](const output &out) { return out.height >= height; });
+      acc.outputs.erase(first_output, acc.outputs.end());
+      const auto first_spend = std::find_if(acc.spends.begin(), acc.spends.end(), [height](const spend &s) { return s.height >= height; });
+      acc.spends.erase(first_spend, acc.spends.end());
+
+      for (output &out: acc.outputs)
+        out.spend_key_images.clear();
+      for (const spend &s: acc.spends)
+        acc.outputs[s.output].spend_key_images.push_back(s.key_image);
+
+      acc.scan_height = std::max(acc.start_height, height);
+    }
+    m_block_ids.erase(m_block_ids.lower_bound(height), m_block_ids.end());
+    index_outputs();
+    index_cohorts();
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::rollback_reorg(uint64_t chain_height, const std::function<crypto::hash(uint64_t)> &get_block_id)
+  {
+    std::map<uint64_t, crypto::hash> block_ids;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      block_ids = m_block_ids;
+    }
+    if (block_ids.empty())
+      return;
+
+    for (auto it = block_ids.rbegin(); it != block_ids.rend(); ++it)
+    {
+      if (it->first < chain_height && get_block_id(it->first) == it->second)
+      {
+        if (it != block_ids.rbegin())
+          rollback(it->first + 1);
+        return;
+      }
+    }
+
+    // the fork is below the kept ids, so nothing found on the chain can be trusted
+    MWARNING("Chain reorganized more than " << block_ids.size() << " blocks deep, rebuilding light wallet accounts");
+    rollback(0);
+  }
+  //---------------------------------------------------------------------------------------------------
+  size_t light_wallet_scanner::scan(uint64_t chain_height, const std::function<crypto::hash(uint64_t)> &get_block_id, const block_getter &get_block, size_t max_blocks)
+  {
+    apply_imports();
+    rollback_reorg(chain_height, get_block_id);
+
+    size_t scanned = 0;
+    const auto scan_at = [&](uint64_t height) {
+      block_data data;
+      if (!get_block(height, data))
+        return false;
+      scan_block(data);
+      ++scanned;
+      return true;
+    };
+
+    const std::vector<uint64_t> heights = get_cohort_heights();
+    if (heights.empty())
+      return 0;
+
+    // new blocks first, for the accounts caught up: an account far behind never delays them
+    for (uint64_t height = heights.back(); height < chain_height && scanned < max_blocks; ++height)
+    {
+      if (!scan_at(height))
+        return scanned;
+    }
+
+    // then a slice for each cohort behind, the lowest first, which merges into the next when it reaches it
+    for (const uint64_t from: get_cohort_heights())
+    {
+      for (uint64_t height = from; height < from + BLOCKS_PER_SLICE && height < chain_height && scanned < max_blocks && has_cohort(height); ++height)
+      {
+        if (!scan_at(height))
+          return scanned;
+      }
+    }
+    return scanned;
+  }
+  //---------------------------------------------------------------------------------------------------
+  size_t light_wallet_scanner::scan(const Blockchain &chain, size_t max_blocks)
+  {
+    return scan(chain.get_current_blockchain_height(),
+      [&chain](uint64_t height) { return chain.get_block_id_by_height(height); },
+      [&chain](uint64_t height, block_data &data) { return get_block_data(chain, height, data); },
+      max_blocks);
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::start(const Blockchain &chain)
+  {
+    m_stop = false;
+    m_thread = boost::thread([this, &chain]() { run(chain); });
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::stop()
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+  //---------------------------------------------------------------------------------------------------
+  void light_wallet_scanner::run(const Blockchain &chain)
+  {
+    MDEBUG("Light wallet scanner thread started");
+    for (;;)
+    {
+      size_t scanned = 0;
+      try
+      {
+        scanned = scan(chain, BLOCKS_PER_BATCH);
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to scan light wallet accounts: " << e.what());
+      }
+      if (time(NULL) >= m_last_store + STORE_INTERVAL)
+      {
+        store();
+        m_last_store = time(NULL);
+      }
+
+      boost::unique_lock<boost::mutex> lock(mutex);
+      // caught up, look again for new blocks after a while, or at once for an import
+      if (!m_stop && scanned == 0)
+        m_wake.wait_for(lock, boost::chrono::seconds(SCAN_INTERVAL), [this]() { return m_stop || !m_imports.empty(); });
+      if (m_stop)
+        break;
+    }
+    MDEBUG("Light wallet scanner thread stopped");
+  }
+  //---------------------------------------------------------------------------------------------------
+  bool light_wallet_scanner::load(std::string directory)
+  {
+    TRY_ENTRY();
+    boost::lock_guard<boost::mutex> lock(mutex);
+    m_directory = std::move(directory);
+    std::string state_file_path = m_directory + "/" + LIGHT_WALLET_DATA_FILENAME;
+    MINFO("loading light wallet accounts from " << state_file_path);
+    std::ifstream data;
+    data.open(state_file_path, std::ios_base::binary | std::ios_base::in);
+    if (!data.fail())
+    {
+      try
+      {
+        boost::archive::portable_binary_iarchive a(data);
+        a >> *this;
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to load light wallet accounts file: " << e.what());
+        m_accounts.clear();
+        m_block_ids.clear();
+      }
+    }
+    else
+    {
+      m_accounts.clear();
+      m_block_ids.clear();
+    }
+    index_outputs();
+    index_cohorts();
+
+    CATCH_ENTRY_L0("light_wallet_scanner::load", false);
+    return true;
+  }
+  //---------------------------------------------------------------------------------------------------
+  bool light_wallet_scanner::store(const std::string &directory_) const
+  {
+    TRY_ENTRY();
+    boost::lock_guard<boost::mutex> lock(mutex);
+    const std::string &directory = directory_.empty() ? m_directory : directory_;
+    MDEBUG("storing light wallet accounts to " << directory);
+    if (!tools::create_directories_if_necessary(directory))
+    {
+      MWARNING("Failed to create data directory: " << directory);
+      return false;
+    }
+    const boost::filesystem::path state_file_path = (boost::filesystem::path(directory) / LIGHT_WALLET_DATA_FILENAME);
+    if (boost::filesystem::exists(state_file_path))
+    {
+      std::string state_file_path_old = state_file_path.string() + ".old";
+      boost::system::error_code ec;
+      boost::filesystem::remove(state_file_path_old, ec);
+      std::error_code e = tools::replace_file(state_file_path.string(), state_file_path_old);
+      if (e)
+        MWARNING("Failed to rename " << state_file_path << " to " << state_file_path_old << ": " << e);
+      else
+        boost::filesystem::permissions(state_file_path_old, boost::filesystem::owner_read | boost::filesystem::owner_write, ec);
+    }
+#ifndef WIN32
+    // the file holds secret view keys, it is created readable by the owner only
+    const int fd = open(state_file_path.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0 || fchmod(fd, S_IRUSR | S_IWUSR) != 0)
+    {
+      if (fd >= 0)
+        close(fd);
+      MWARNING("Failed to create light wallet accounts file " << state_file_path);
+      return false;
+    }
+    close(fd);
+#endif
+    std::ofstream data;
+    data.open(state_file_path.string(), std::ios_base::binary | std::ios_base::out | std::ios::trunc);
+    if (data.fail())
+    {
+      MWARNING("Failed to save light wallet accounts to file " << state_file_path);
+      return false;
+    };
+    boost::archive::portable_binary_oarchive a(data);
+    a << *this;
+    return true;
+    CATCH_ENTRY_L0("light_wallet_scanner::store", false);
+  }
+}
@@ -0,0 +1,271 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/serialization/version.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_config.h"
+
+namespace cryptonote
+{
+  class Blockchain;
+
+  /*! Scans the chain on behalf of light wallets, which register with their
+    address and secret view key.
+
+    Accounts at the same height form a cohort, and each block is read and
+    parsed once for the cohort at its height. Accounts sharing a view key (a
+    wallet and its subaddresses) share the key derivation, one per transaction
+    key, then one subtraction and lookup per output, and the derivations of the
+    view keys of a cohort are done in a batch. The cohort furthest ahead gets
+    new blocks first, so that a login far behind or an import does not hold
+    back the accounts already caught up, and the others catch up in slices. Spends can not be recognised without the spend key, so inputs
+    using a known output in their ring are recorded as candidates, for the
+    wallet to check against its key images.
+
+    Scanning runs on a thread of its own, started with `start`, so that
+    catching up after a login or an import never holds an RPC thread. */
+  class light_wallet_scanner
+  {
+  public:
+    struct output
+    {
+      crypto::hash tx_hash;
+      crypto::hash tx_prefix_hash;
+      crypto::public_key tx_pub_key;
+      crypto::public_key key;
+      uint64_t amount;
+      uint64_t index;        //!< In the transaction
+      uint64_t global_index;
+      std::string rct;       //!< Hex commitment, encrypted mask and amount, "coinbase" for RingCT era coinbase, empty before RingCT
+      uint64_t height;
+      uint64_t timestamp;
+      uint64_t unlock_time;
+      bool coinbase;
+      std::vector<crypto::key_image> spend_key_images;
+
+      template <class t_archive>
+      inline void serialize(t_archive &a, const unsigned int ver)
+      {
+        a & tx_hash;
+        a & tx_prefix_hash;
+        a & tx_pub_key;
+        a & key;
+        a & amount;
+        a & index;
+        a & global_index;
+        a & rct;
+        a & height;
+        a & timestamp;
+        a & unlock_time;
+        a & coinbase;
+        a & spend_key_images;
+      }
+    };
+
+    //! Input whose ring uses one of the account outputs
+    struct spend
+    {
+      crypto::hash tx_hash;
+      crypto::key_image key_image;
+      uint64_t amount;     //!< Of the output in the ring
+      uint64_t output;     //!< Index in `account::outputs`
+      uint32_t mixin;
+      uint64_t height;
+      uint64_t timestamp;
+      uint64_t unlock_time;
+
+      template <class t_archive>
+      inline void serialize(t_archive &a, const unsigned int ver)
+      {
+        a & tx_hash;
+        a & key_image;
+        a & amount;
+        a & output;
+        a & mixin;
+        a & height;
+        a & timestamp;
+        a & unlock_time;
+      }
+    };
+
+    struct account
+    {
+      crypto::public_key spend_public_key;
+      crypto::public_key view_group;     //!< Public key of `view_secret_key`, shared with subaddresses
+      crypto::secret_key view_secret_key;
+      uint64_t start_height;
+      uint64_t scan_height; //!< Next block to scan
+      std::vector<output> outputs;
+      std::vector<spend> spends;
+
+      template <class t_archive>
+      inline void serialize(t_archive &a, const unsigned int ver)
+      {
+        a & spend_public_key;
+        a & view_group;
+        a & view_secret_key;
+        a & start_height;
+        a & scan_height;
+        a & outputs;
+        a & spends;
+      }
+    };
+
+    //! A block with its transactions, the miner transaction first
+    struct block_data
+    {
+      uint64_t height;
+      crypto::hash id;
+      uint64_t timestamp;
+      std::vector<cryptonote::transaction> txes;
+      std::vector<crypto::hash> tx_hashes;
+      std::vector<std::vector<uint64_t>> output_indices;
+    };
+
+    enum class status : uint8_t
+    {
+      ok = 0,
+      created,
+      bad_address,
+      bad_view_key,
+      unknown_account
+    };
+
+  public:
+    explicit light_wallet_scanner(network_type nettype);
+    ~light_wallet_scanner();
+
+    /*! Authenticates `address` with `view_key`, registering it to be scanned
+      from `height` when `create` is set and it is not known yet. */
+    status login(const std::string &address, const crypto::secret_key &view_key, bool create, uint64_t height);
+
+    //! Has the scanner thread rescan a known account from the genesis block, dropping what was found
+    status import(const std::string &address, const crypto::secret_key &view_key);
+
+    //! Calls `f` with the account, under the scanner lock
+    status with_account(const std::string &address, const crypto::secret_key &view_key, const std::function<void(const account &)> &f) const;
+
+    size_t get_account_count() const;
+
+    //! \return The lowest height an account still has to scan, or `uint64_t(-1)` when there is none
+    uint64_t get_scan_height() const;
+
+    //! Scans `block` for the accounts at its height and moves them past it
+    void scan_block(const block_data &block);
+
+    //! Forgets everything found from `height` on, accounts rescanning from there
+    void rollback(uint64_t height);
+
+    /*! Rolls back to the first kept block id `get_block_id` no longer matches.
+      When none of them match, the fork is older than what is kept, and every
+      account is rebuilt from its start height. */
+    void rollback_reorg(uint64_t chain_height, const std::function<crypto::hash(uint64_t)> &get_block_id);
+
+    //! Fills `block` with the block at `height`, false when it can not
+    typedef std::function<bool(uint64_t height, block_data &block)> block_getter;
+
+    /*! Applies pending imports, undoes what a reorg invalidated, then scans up
+      to `max_blocks` blocks below `chain_height`: up to the chain height for
+      the cohort furthest ahead, then a slice for each cohort behind it, the
+      lowest first. */
+    size_t scan(uint64_t chain_height, const std::function<crypto::hash(uint64_t)> &get_block_id, const block_getter &get_block, size_t max_blocks);
+    size_t scan(const Blockchain &chain, size_t max_blocks);
+
+    //! Scans `chain` on the scanner thread until `stop`, storing the accounts now and then
+    void start(const Blockchain &chain);
+    void stop();
+
+    template <class t_archive>
+    inline void serialize(t_archive &a, const unsigned int ver)
+    {
+      a & m_accounts;
+      a & m_block_ids;
+    }
+
+    bool load(std::string directory);
+    bool store(const std::string &directory = std::string()) const;
+
+  private:
+    //! Accounts at the same scan height, scanned together
+    struct cohort
+    {
+      std::unordered_map<crypto::public_key, size_t> group_index; //!< By view public key
+      std::vector<crypto::secret_key> view_secret_keys;           //!< Per view group
+      std::vector<std::unordered_map<crypto::public_key, std::string>> accounts; //!< Per view group, by spend public key
+      std::vector<account*> members;
+    };
+
+    status find_account(const std::string &address, const crypto::secret_key &view_key, std::string &key) const;
+    void index_outputs();
+    static void add_to_cohort(cohort &c, const std::string &key, account &acc);
+    void index_cohorts();
+    std::vector<uint64_t> get_cohort_heights() const;
+    bool has_cohort(uint64_t height) const;
+    void apply_imports();
+    void run(const Blockchain &chain);
+
+    network_type m_nettype;
+    std::unordered_map<std::string, account> m_accounts;
+    //! Ids of the last blocks scanned, to notice reorgs
+    std::map<uint64_t, crypto::hash> m_block_ids;
+    //! (amount, global index) of every output found, to their account and index there
+    std::map<std::pair<uint64_t, uint64_t>, std::vector<std::pair<std::string, uint64_t>>> m_output_index;
+    //! By scan height, replaced rather than changed, so that a block is scanned on a snapshot without the lock
+    std::map<uint64_t, std::shared_ptr<const cohort>> m_cohorts;
+    std::set<std::string> m_imports; //!< Accounts waiting for the scanner thread to rescan them
+    std::string m_directory;
+    time_t m_last_store;
+    mutable boost::mutex mutex;
+    boost::condition_variable m_wake;
+    bool m_stop;
+    boost::thread m_thread;
+  };
+}
+
+BOOST_CLASS_VERSION(cryptonote::light_wallet_scanner, 0);
+BOOST_CLASS_VERSION(cryptonote::light_wallet_scanner::account, 0);
+BOOST_CLASS_VERSION(cryptonote::light_wallet_scanner::output, 0);
+BOOST_CLASS_VERSION(cryptonote::light_wallet_scanner::spend, 0);
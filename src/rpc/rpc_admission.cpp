@@ -0,0 +1,211 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "rpc_admission.h"
+
+#include <boost/chrono/duration.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace cryptonote
+{
+  namespace
+  {
+    const boost::chrono::seconds max_queue_wait{10};
+
+    enum element_kind : std::uint8_t
+    {
+      no_element = 0,
+      pooled_element,  //!< On a batch pool thread, deferred at a method cap
+      deferred_element //!< On the thread holding the batch, may wait at a method cap
+    };
+
+    //! Admitted calls on this thread, calls made from within one are not counted again
+    thread_local unsigned admitted_depth = 0;
+    thread_local std::uint8_t batch_element = no_element;
+    thread_local bool element_deferred = false;
+  }
+
+  rpc_admission::ticket::ticket(ticket&& rhs) noexcept
+    : m_admission(rhs.m_admission), m_rpc(rhs.m_rpc), m_state(rhs.m_state)
+  {
+    rhs.m_admission = nullptr;
+    rhs.m_state = state::refused;
+  }
+
+  rpc_admission::ticket::~ticket()
+  {
+    if (m_state == state::refused)
+      return;
+    --admitted_depth;
+    if (m_admission)
+      m_admission->release(*this);
+  }
+
+  rpc_admission::batch_element_scope::batch_element_scope(const bool deferred) noexcept
+    : m_depth(admitted_depth), m_element(batch_element), m_deferred(element_deferred)
+  {
+    // the calling thread may be waiting on its own batch, whose admission does not cover the element
+    admitted_depth = 0;
+    batch_element = deferred ? deferred_element : pooled_element;
+    element_deferred = false;
+  }
+
+  rpc_admission::batch_element_scope::~batch_element_scope()
+  {
+    admitted_depth = m_depth;
+    batch_element = m_element;
+    element_deferred = m_deferred;
+  }
+
+  bool rpc_admission::batch_element_scope::deferred() const noexcept
+  {
+    return element_deferred;
+  }
+
+  rpc_admission::rpc_admission(const unsigned threads)
+    : m_mutex(), m_released(), m_slots(threads > 1 ? threads - 1 : 1), m_occupied(0), m_methods(), m_counters()
+  {
+    for (const auto& l : default_limits())
+      set_limits(l.first, l.second);
+  }
+
+  const std::map<std::string, rpc_admission::limits>& rpc_admission::default_limits()
+  {
+    static const std::map<std::string, limits> defaults{
+      {"get_output_histogram", {1, 2}},
+      {"get_output_distribution", {2, 4}},
+      {"get_output_distribution_bin", {2, 4}},
+      {"get_outs", {4, 8}},
+      {"get_outs_bin", {4, 8}},
+      {"get_txpool_backlog", {1, 2}}
+    };
+    return defaults;
+  }
+
+  void rpc_admission::set_limits(const std::string& rpc, const limits l)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    method& m = m_methods[rpc];
+    m.caps = l;
+  }
+
+  rpc_admission::ticket rpc_admission::admit(const char* const rpc, const lane l)
+  {
+    ticket out{};
+    out.m_rpc = rpc;
+    if (admitted_depth || l == lane::priority)
+    {
+      out.m_state = ticket::state::free;
+      ++admitted_depth;
+      return out;
+    }
+
+    const bool pooled = batch_element == no_element;
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (pooled && m_occupied >= m_slots)
+    {
+      ++m_counters[rpc].busy;
+      return out;
+    }
+
+    const auto it = m_methods.find(rpc);
+    method* const m = it == m_methods.end() ? nullptr : &it->second;
+    if (m && m->caps.concurrent && m->running >= m->caps.concurrent)
+    {
+      if (batch_element == pooled_element)
+      {
+        element_deferred = true;
+        return out;
+      }
+      if (m->waiting >= m->caps.queued)
+      {
+        ++m_counters[rpc].busy;
+        return out;
+      }
+
+      // only server threads get here, and a waiting call keeps its thread
+      ++m->waiting;
+      if (pooled)
+        ++m_occupied;
+      const auto start = std::chrono::steady_clock::now();
+      const bool ready = m_released.wait_for(lock, max_queue_wait, [m] {
+        return m->running < m->caps.concurrent;
+      });
+      --m->waiting;
+
+      counters& c = m_counters[rpc];
+      ++c.queued;
+      c.queue_time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      if (!ready)
+      {
+        if (pooled)
+          --m_occupied;
+        ++c.busy;
+        return out;
+      }
+    }
+    else if (pooled)
+      ++m_occupied;
+
+    if (m)
+      ++m->running;
+    out.m_admission = this;
+    out.m_state = pooled ? ticket::state::pooled : ticket::state::unpooled;
+    ++admitted_depth;
+    return out;
+  }
+
+  void rpc_admission::release(const ticket& t)
+  {
+    bool waiters = false;
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      if (t.m_state == ticket::state::pooled)
+        --m_occupied;
+      const auto it = m_methods.find(t.m_rpc);
+      if (it != m_methods.end())
+      {
+        --it->second.running;
+        waiters = it->second.waiting != 0;
+      }
+    }
+    if (waiters)
+      m_released.notify_all();
+  }
+
+  std::map<std::string, rpc_admission::counters> rpc_admission::get_counters() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_counters;
+  }
+
+  void rpc_admission::clear_counters()
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_counters.clear();
+  }
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace cryptonote
+{
+  /*! Decides whether an RPC call may run on the server threads that received it.
+
+    Handlers run synchronously on the HTTP server threads, so the budget is in
+    threads: calls on the normal lane may hold all but one of them, leaving the
+    last one to priority calls and to answering the rest with a busy error.
+    Methods with a cap may additionally wait, up to their queue limit, for one
+    of their slots. A JSON-RPC batch is admitted once, on the server thread
+    that received it; its elements then only go through the method caps. An
+    element over a cap is deferred rather than waiting, so it never holds a
+    batch pool thread, and runs after the others on the thread holding the
+    batch, where it waits for a slot like a single call would. */
+  class rpc_admission
+  {
+  public:
+    enum class lane : std::uint8_t
+    {
+      normal = 0, //!< Subject to the thread budget and per method caps
+      priority    //!< Local and mining calls, always admitted
+    };
+
+    struct limits
+    {
+      unsigned concurrent; //!< 0 means no cap
+      unsigned queued;     //!< Calls waiting for a slot beyond the cap
+    };
+
+    struct counters
+    {
+      std::uint64_t queued;     //!< Calls that had to wait for a slot
+      std::uint64_t queue_time; //!< Total time spent waiting, in nanoseconds
+      std::uint64_t busy;       //!< Calls refused
+    };
+
+    //! An admitted call holds its slot until the ticket is destroyed; false when refused.
+    class ticket
+    {
+    public:
+      ticket(ticket&& rhs) noexcept;
+      ticket(const ticket&) = delete;
+      ticket& operator=(const ticket&) = delete;
+      ticket& operator=(ticket&&) = delete;
+      ~ticket();
+
+      explicit operator bool() const noexcept { return m_state != state::refused; }
+
+    private:
+      friend class rpc_admission;
+
+      enum class state : std::uint8_t { refused = 0, free, pooled, unpooled };
+
+      ticket() noexcept
+        : m_admission(nullptr), m_rpc(nullptr), m_state(state::refused)
+      {}
+
+      rpc_admission* m_admission;
+      const char* m_rpc;
+      state m_state;
+    };
+
+    //! Marks the calling thread as running one element of an admitted JSON-RPC batch.
+    class batch_element_scope
+    {
+    public:
+      //! `deferred` when running an element a method cap deferred, on the thread holding the batch
+      explicit batch_element_scope(bool deferred = false) noexcept;
+      batch_element_scope(const batch_element_scope&) = delete;
+      batch_element_scope& operator=(const batch_element_scope&) = delete;
+      ~batch_element_scope();
+
+      //! \return True when a method cap deferred the element, which must run again with a deferred scope
+      bool deferred() const noexcept;
+    private:
+      unsigned m_depth;
+      std::uint8_t m_element;
+      bool m_deferred;
+    };
+
+    //! `threads` is the number of server threads handlers run on.
+    explicit rpc_admission(unsigned threads);
+
+    //! Default caps for methods that are expensive per call.
+    static const std::map<std::string, limits>& default_limits();
+
+    void set_limits(const std::string& rpc, limits l);
+
+    //! \return Ticket for one call to `rpc`, which must outlive the ticket. Calls made from within an admitted call are always admitted.
+    ticket admit(const char* rpc, lane l);
+
+    std::map<std::string, counters> get_counters() const;
+    void clear_counters();
+
+  private:
+    struct method
+    {
+      limits caps;
+      unsigned running;
+      unsigned waiting;
+    };
+
+    void release(const ticket& t);
+
+    mutable boost::mutex m_mutex;
+    boost::condition_variable m_released;
+    const unsigned m_slots; //!< Server threads the normal lane may occupy
+    unsigned m_occupied;    //!< Server threads running or waiting on the normal lane
+    std::map<std::string, method> m_methods;
+    std::map<std::string, counters> m_counters;
+  };
+}
@@ -0,0 +1,259 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rpc_blocks_stream.h"
+
+#include "blockchain_db/blockchain_db.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
+
+namespace cryptonote
+{
+  rpc_blocks_stream::rpc_blocks_stream(BlockchainDB& db, const COMMAND_RPC_GET_BLOCKS_FAST::response& res, std::size_t count, bool pruned, bool no_miner_tx, std::size_t chunk_size)
+    : m_db(db),
+      m_indices(),
+      m_out(&m_indices),
+      m_writer(m_indices),
+      m_heights(),
+      m_base(res),
+      m_start_height(res.start_height),
+      m_current_height(res.current_height),
+      m_next(0),
+      m_count(count),
+      m_chunk_size(chunk_size),
+      m_last_hash(db.get_block_hash_from_height(res.start_height + count - 1)),
+      m_state(state::header),
+      m_range(true),
+      m_pruned(pruned),
+      m_no_miner_tx(no_miner_tx)
+  {}
+
+  rpc_blocks_stream::rpc_blocks_stream(BlockchainDB& db, const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response& res, std::vector<std::uint64_t> heights, std::size_t chunk_size)
+    : m_db(db),
+      m_indices(),
+      m_out(&m_indices),
+      m_writer(m_indices),
+      m_heights(std::move(heights)),
+      m_base(res),
+      m_start_height(0),
+      m_current_height(0),
+      m_next(0),
+      m_count(m_heights.size()),
+      m_chunk_size(chunk_size),
+      m_last_hash(crypto::null_hash),
+      m_state(state::header),
+      m_range(false),
+      m_pruned(false),
+      m_no_miner_tx(false)
+  {}
+
+  bool rpc_blocks_stream::operator()(std::string& chunk)
+  {
+    try
+    {
+      m_out = &chunk;
+      m_writer.set_buffer(chunk);
+      switch (m_state)
+      {
+        case state::header:
+          // entries go in name order, as store_to_binary writes them, which puts the blocks first
+          m_writer.storage_header();
+          m_writer.section(m_range ? 8 : 5);
+          m_writer.name("blocks");
+          m_writer.array(SERIALIZE_TYPE_OBJECT, m_count);
+          m_state = state::blocks;
+          /* fall through */
+        case state::blocks:
+          if (!add_blocks())
+            return false;
+          if (m_next == m_count)
+            m_state = state::tail;
+          break;
+        case state::tail:
+          add_tail();
+          m_state = state::done;
+          break;
+        case state::done:
+          break;
+      }
+      return true;
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Failed to stream blocks: " << e.what());
+      return false;
+    }
+  }
+
+  bool rpc_blocks_stream::add_blocks()
+  {
+    const auto add = [this](std::uint64_t height, const epee::span<const std::uint8_t> block_blob, const block& b, std::vector<blobdata>& txs) {
+      return add_block(height, block_blob, b, txs);
+    };
+
+    // each chunk reads from its own txn, so the db is not held open while the client is slow
+    db_rtxn_guard rtxn_guard(&m_db);
+    if (m_range)
+    {
+      const std::uint64_t last = m_start_height + m_count - 1;
+      if (m_db.height() <= last || m_db.get_block_hash_from_height(last) != m_last_hash)
+      {
+        MWARNING("Chain reorganized while streaming blocks from height " << m_start_height << ", aborting");
+        return false;
+      }
+      const std::uint64_t next = m_next;
+      if (!m_db.for_blocks_from(m_start_height + m_next, 1, m_count - m_next, m_chunk_size, m_pruned, add))
+        return false;
+      return m_next != next;
+    }
+
+    while (m_next < m_count && m_out->size() < m_chunk_size)
+    {
+      const std::uint64_t next = m_next;
+      if (!m_db.for_blocks_from(m_heights[m_next], 1, 1, 0, false, add))
+        return false;
+      if (m_next == next)
+      {
+        MERROR("Block at height " << m_heights[m_next] << " not found while streaming blocks");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool rpc_blocks_stream::add_block(std::uint64_t height, const epee::span<const std::uint8_t> block_blob, const block& b, const std::vector<blobdata>& txs)
+  {
+    if (m_next == m_count)
+      return false;
+
+    // block_complete_entry: block_weight is left out as it is always 0, pruned when false
+    m_writer.section(1 + (m_pruned ? 1 : 0) + (txs.empty() ? 0 : 1));
+    m_writer.name("block");
+    m_writer.string(block_blob);
+    if (m_pruned)
+    {
+      m_writer.name("pruned");
+      m_writer.boolean(true);
+    }
+    if (!txs.empty())
+    {
+      m_writer.name("txs");
+      if (m_pruned)
+      {
+        m_writer.array(SERIALIZE_TYPE_OBJECT, txs.size());
+        for (const blobdata& tx: txs)
+        {
+          m_writer.section(2);
+          m_writer.name("blob");
+          m_writer.string(tx);
+          m_writer.name("prunable_hash");
+          m_writer.string(epee::as_byte_span(crypto::null_hash));
+        }
+      }
+      else
+      {
+        m_writer.array(SERIALIZE_TYPE_STRING, txs.size());
+        for (const blobdata& tx: txs)
+          m_writer.array_string(epee::strspan<std::uint8_t>(tx));
+      }
+    }
+
+    if (m_range && !add_output_indices(b, txs.size()))
+    {
+      MERROR("Failed to get output indices for block at height " << height);
+      return false;
+    }
+
+    ++m_next;
+    return true;
+  }
+
+  bool rpc_blocks_stream::add_output_indices(const block& b, std::size_t n_txes)
+  {
+    const std::size_t n_txes_to_lookup = n_txes + (m_no_miner_tx ? 0 : 1);
+    std::vector<std::vector<std::uint64_t>> indices;
+    if (n_txes_to_lookup > 0)
+    {
+      std::uint64_t tx_index;
+      if (!m_db.tx_exists(get_transaction_hash(b.miner_tx), tx_index))
+        return false;
+      indices = m_db.get_tx_amount_output_indices(tx_index + (m_no_miner_tx ? 1 : 0), n_txes_to_lookup);
+      if (indices.size() != n_txes_to_lookup)
+        return false;
+    }
+
+    // block_output_indices, with an empty entry standing in for a skipped miner tx
+    m_writer.set_buffer(m_indices);
+    m_writer.section(1);
+    m_writer.name("indices");
+    m_writer.array(SERIALIZE_TYPE_OBJECT, n_txes + 1);
+    if (m_no_miner_tx)
+      m_writer.section(0);
+    for (const std::vector<std::uint64_t>& tx_indices: indices)
+    {
+      if (tx_indices.empty())
+      {
+        m_writer.section(0);
+        continue;
+      }
+      m_writer.section(1);
+      m_writer.name("indices");
+      m_writer.array(SERIALIZE_TYPE_UINT64, tx_indices.size());
+      for (const std::uint64_t index: tx_indices)
+        m_writer.array_uint64(index);
+    }
+    m_writer.set_buffer(*m_out);
+    return true;
+  }
+
+  void rpc_blocks_stream::add_tail()
+  {
+    m_writer.name("credits");
+    m_writer.uint64(m_base.credits);
+    if (m_range)
+    {
+      m_writer.name("current_height");
+      m_writer.uint64(m_current_height);
+      m_writer.name("output_indices");
+      m_writer.array(SERIALIZE_TYPE_OBJECT, m_count);
+      m_out->append(m_indices);
+      m_indices.clear();
+      m_indices.shrink_to_fit();
+      m_writer.name("start_height");
+      m_writer.uint64(m_start_height);
+    }
+    m_writer.name("status");
+    m_writer.string(m_base.status);
+    m_writer.name("top_hash");
+    m_writer.string(m_base.top_hash);
+    m_writer.name("untrusted");
+    m_writer.boolean(m_base.untrusted);
+  }
+}
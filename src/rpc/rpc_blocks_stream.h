@@ -0,0 +1,86 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_writer.h"
+
+namespace cryptonote
+{
+  class BlockchainDB;
+
+  //! Encodes the binary body of a get_blocks.bin or get_blocks_by_height.bin response a chunk at a time, straight out of the db.
+  class rpc_blocks_stream
+  {
+  public:
+    //! get_blocks.bin: `count` blocks from `res.start_height` and their output indices, other fields from `res`.
+    rpc_blocks_stream(BlockchainDB& db, const COMMAND_RPC_GET_BLOCKS_FAST::response& res, std::size_t count, bool pruned, bool no_miner_tx, std::size_t chunk_size);
+
+    //! get_blocks_by_height.bin: the full blocks at `heights`, which must all exist, other fields from `res`.
+    rpc_blocks_stream(BlockchainDB& db, const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response& res, std::vector<std::uint64_t> heights, std::size_t chunk_size);
+
+    /*! Appends the next piece of the body to `chunk`, nothing once it is complete.
+        The output is byte for byte what `store_t_to_binary` gives for the filled in
+        response.
+
+        \return False if the chain reorganized under the blocks being sent, or on a
+          db error. */
+    bool operator()(std::string& chunk);
+
+  private:
+    enum class state : std::uint8_t { header, blocks, tail, done };
+
+    bool add_blocks();
+    bool add_output_indices(const block& b, std::size_t n_txes);
+    bool add_block(std::uint64_t height, const epee::span<const std::uint8_t> block_blob, const block& b, const std::vector<blobdata>& txs);
+    void add_tail();
+
+    BlockchainDB& m_db;
+    std::string m_indices;            //!< encoded output_indices elements, sent after the blocks
+    std::string* m_out;
+    epee::serialization::portable_storage_writer m_writer;
+    std::vector<std::uint64_t> m_heights;
+    rpc_access_response_base m_base;
+    std::uint64_t m_start_height;
+    std::uint64_t m_current_height;
+    std::uint64_t m_next;             //!< next height in range mode, next index into m_heights otherwise
+    std::size_t m_count;
+    std::size_t m_chunk_size;
+    crypto::hash m_last_hash;         //!< hash of the last block of the range, to detect reorgs between chunks
+    state m_state;
+    bool m_range;
+    bool m_pruned;
+    bool m_no_miner_tx;
+  };
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rpc_event_waiter.h"
+
+#include <algorithm>
+
+#include <boost/chrono/duration.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace cryptonote
+{
+  namespace
+  {
+    void complete(std::list<rpc_event_waiter::completion>& calls, const rpc_event_waiter::result result, const rpc_event_waiter::state& state)
+    {
+      for (const rpc_event_waiter::completion& done: calls)
+        done(result, state);
+    }
+  }
+
+  rpc_event_waiter::rpc_event_waiter(const unsigned max_parked)
+    : m_mutex(),
+      m_timer_wake(),
+      m_max_parked(max_parked),
+      m_parked(),
+      m_next_deadline(std::chrono::steady_clock::time_point::max()),
+      m_state{0, crypto::null_hash, 0},
+      m_stopped(false),
+      m_timer()
+  {
+    m_timer = boost::thread([this] { run_timer(); });
+  }
+
+  rpc_event_waiter::~rpc_event_waiter()
+  {
+    stop();
+  }
+
+  void rpc_event_waiter::init_chain(const std::uint64_t height, const crypto::hash& top_hash)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_state.top_hash == crypto::null_hash)
+    {
+      m_state.height = height;
+      m_state.top_hash = top_hash;
+    }
+  }
+
+  void rpc_event_waiter::update_chain(const std::uint64_t height, const crypto::hash& top_hash)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (m_state.top_hash == top_hash)
+      return;
+    m_state.height = height;
+    m_state.top_hash = top_hash;
+    wake_changed(lock);
+  }
+
+  void rpc_event_waiter::update_pool(const std::uint64_t pool_cookie)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (m_state.pool_cookie == pool_cookie)
+      return;
+    m_state.pool_cookie = pool_cookie;
+    wake_changed(lock);
+  }
+
+  rpc_event_waiter::state rpc_event_waiter::get_state() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_state;
+  }
+
+  void rpc_event_waiter::wait(const crypto::hash& top_hash, const bool pool, const std::uint64_t pool_cookie, const std::chrono::milliseconds timeout, completion done)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    const state current = m_state;
+    result r;
+    if (changed(top_hash, pool, pool_cookie))
+      r = result::changed;
+    else if (m_stopped)
+      r = result::stopped;
+    else if (timeout <= std::chrono::milliseconds::zero())
+      r = result::timeout;
+    else if (m_parked.size() >= m_max_parked)
+      r = result::busy;
+    else
+    {
+      const auto deadline = std::chrono::steady_clock::now() + timeout;
+      m_parked.push_back({top_hash, pool, pool_cookie, deadline, std::move(done)});
+      const bool earliest = deadline < m_next_deadline;
+      lock.unlock();
+      if (earliest)
+        m_timer_wake.notify_one();
+      return;
+    }
+    lock.unlock();
+    done(r, current);
+  }
+
+  void rpc_event_waiter::stop()
+  {
+    std::list<completion> stopped;
+    state current;
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_stopped = true;
+      for (parked_call& call: m_parked)
+        stopped.push_back(std::move(call.done));
+      m_parked.clear();
+      current = m_state;
+    }
+    m_timer_wake.notify_all();
+    if (m_timer.joinable())
+      m_timer.join();
+    complete(stopped, result::stopped, current);
+  }
+
+  unsigned rpc_event_waiter::get_parked() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_parked.size();
+  }
+
+  bool rpc_event_waiter::changed(const crypto::hash& top_hash, const bool pool, const std::uint64_t pool_cookie) const noexcept
+  {
+    return m_state.top_hash != top_hash || (pool && m_state.pool_cookie != pool_cookie);
+  }
+
+  void rpc_event_waiter::wake_changed(boost::unique_lock<boost::mutex>& lock)
+  {
+    std::list<completion> woken;
+    for (auto it = m_parked.begin(); it != m_parked.end();)
+    {
+      if (changed(it->top_hash, it->pool, it->pool_cookie))
+      {
+        woken.push_back(std::move(it->done));
+        it = m_parked.erase(it);
+      }
+      else
+        ++it;
+    }
+    const state current = m_state;
+    lock.unlock();
+    // completions send responses, never while holding the lock
+    complete(woken, result::changed, current);
+  }
+
+  void rpc_event_waiter::run_timer()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_stopped)
+    {
+      const auto now = std::chrono::steady_clock::now();
+      std::list<completion> expired;
+      m_next_deadline = std::chrono::steady_clock::time_point::max();
+      for (auto it = m_parked.begin(); it != m_parked.end();)
+      {
+        if (it->deadline <= now)
+        {
+          expired.push_back(std::move(it->done));
+          it = m_parked.erase(it);
+        }
+        else
+        {
+          m_next_deadline = std::min(m_next_deadline, it->deadline);
+          ++it;
+        }
+      }
+
+      if (!expired.empty())
+      {
+        const state current = m_state;
+        lock.unlock();
+        complete(expired, result::timeout, current);
+        lock.lock();
+        continue;
+      }
+
+      if (m_next_deadline == std::chrono::steady_clock::time_point::max())
+        m_timer_wake.wait(lock);
+      else
+      {
+        const boost::chrono::nanoseconds left{std::chrono::duration_cast<std::chrono::nanoseconds>(m_next_deadline - now).count()};
+        m_timer_wake.wait_for(lock, left);
+      }
+    }
+  }
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /*! Parks long-poll RPC calls until the chain top or the pool cookie moves.
+
+    A parked call holds no thread: it is completed from the thread publishing
+    the change, or from the waiter's own timer thread once it times out. The
+    number of parked calls is still capped; over the cap, calls are refused
+    rather than queued. */
+  class rpc_event_waiter
+  {
+  public:
+    struct state
+    {
+      std::uint64_t height;     //!< Chain height, ie top block height + 1
+      crypto::hash top_hash;
+      std::uint64_t pool_cookie;
+    };
+
+    enum class result : std::uint8_t
+    {
+      changed = 0, //!< `state` differs from what the caller knew
+      timeout,
+      busy,        //!< Too many calls parked already
+      stopped      //!< The server is shutting down
+    };
+
+    //! Called once with the outcome of a `wait`, and the latest state
+    typedef std::function<void(result, const state&)> completion;
+
+    //! `max_parked` calls may wait at once, 0 refuses every call that would wait.
+    explicit rpc_event_waiter(unsigned max_parked);
+    ~rpc_event_waiter();
+
+    //! Set the chain top the first time, unless it was published already.
+    void init_chain(std::uint64_t height, const crypto::hash& top_hash);
+
+    //! Publish the committed chain top, waiters only wake if it moved.
+    void update_chain(std::uint64_t height, const crypto::hash& top_hash);
+
+    //! Publish the pool cookie, waiters only wake if it moved.
+    void update_pool(std::uint64_t pool_cookie);
+
+    state get_state() const;
+
+    /*! Calls `done` once the top hash differs from `top_hash` or, when `pool`
+      is set, the pool cookie differs from `pool_cookie`, or once `timeout`
+      expired. Calls that need not, or can not, wait are completed before
+      this returns. */
+    void wait(const crypto::hash& top_hash, bool pool, std::uint64_t pool_cookie, std::chrono::milliseconds timeout, completion done);
+
+    //! Completes the parked calls with `stopped`, and any later call that would wait.
+    void stop();
+
+    unsigned get_parked() const;
+
+  private:
+    struct parked_call
+    {
+      crypto::hash top_hash;
+      bool pool;
+      std::uint64_t pool_cookie;
+      std::chrono::steady_clock::time_point deadline;
+      completion done;
+    };
+
+    bool changed(const crypto::hash& top_hash, bool pool, std::uint64_t pool_cookie) const noexcept;
+    void wake_changed(boost::unique_lock<boost::mutex>& lock);
+    void run_timer();
+
+    mutable boost::mutex m_mutex;
+    boost::condition_variable m_timer_wake;
+    const unsigned m_max_parked;
+    std::list<parked_call> m_parked;
+    std::chrono::steady_clock::time_point m_next_deadline; //!< The timer thread sleeps until then
+    state m_state;
+    bool m_stopped;
+    boost::thread m_timer;
+  };
+}
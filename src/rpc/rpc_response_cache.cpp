@@ -0,0 +1,139 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rpc_response_cache.h"
+
+#include <boost/thread/locks.hpp>
+
+namespace cryptonote
+{
+  namespace
+  {
+    constexpr std::size_t max_entries = 4096;
+    constexpr std::size_t max_request_size = 4096;
+    constexpr std::chrono::seconds live_max_age{1};
+
+    std::string make_key(const char* rpc, const std::string& request)
+    {
+      std::string key{rpc};
+      key.push_back('\0');
+      key.append(request);
+      return key;
+    }
+  }
+
+  bool rpc_response_cache::handle::find(const std::string& request, std::string& body) const
+  {
+    return m_cache && m_cache->find(*this, request, body);
+  }
+
+  void rpc_response_cache::handle::store(const std::string& request, const std::string& body) const
+  {
+    if (m_cache)
+      m_cache->store(*this, request, body);
+  }
+
+  rpc_response_cache::rpc_response_cache(std::function<chain_tip()> get_tip)
+    : m_get_tip(std::move(get_tip)), m_mutex(), m_entries(), m_counters()
+  {}
+
+  rpc_response_cache::handle rpc_response_cache::bind(const char* rpc, const depends dep, const std::uint64_t pool_cookie)
+  {
+    handle out{};
+    out.m_cache = this;
+    out.m_rpc = rpc;
+    out.m_depends = dep;
+    out.m_pool_cookie = pool_cookie;
+    out.m_tip = m_get_tip();
+    return out;
+  }
+
+  std::map<std::string, rpc_response_cache::counters> rpc_response_cache::get_counters() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_counters;
+  }
+
+  void rpc_response_cache::clear_counters()
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_counters.clear();
+  }
+
+  bool rpc_response_cache::find(const handle& h, const std::string& request, std::string& body)
+  {
+    if (max_request_size < request.size())
+      return false;
+
+    const std::string key = make_key(h.m_rpc, request);
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    counters& stats = m_counters[h.m_rpc];
+    const auto it = m_entries.find(key);
+    if (it == m_entries.end())
+    {
+      ++stats.misses;
+      return false;
+    }
+
+    // block notifiers fire before the batch commits, so the tip is compared instead of waiting for a signal
+    const bool stale = it->second.tip != h.m_tip || (h.m_depends == depends::live &&
+      (it->second.pool_cookie != h.m_pool_cookie || live_max_age <= std::chrono::steady_clock::now() - it->second.created));
+    if (stale)
+    {
+      m_entries.erase(it);
+      ++stats.misses;
+      return false;
+    }
+
+    body = it->second.body;
+    ++stats.hits;
+    return true;
+  }
+
+  void rpc_response_cache::store(const handle& h, const std::string& request, const std::string& body)
+  {
+    if (max_request_size < request.size())
+      return;
+
+    // built from a chain that has since changed, possibly a mix of both
+    if (m_get_tip() != h.m_tip)
+      return;
+
+    std::string key = make_key(h.m_rpc, request);
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (max_entries <= m_entries.size() && !m_entries.count(key))
+      m_entries.erase(m_entries.begin());
+    entry& e = m_entries[std::move(key)];
+    e.body = body;
+    e.tip = h.m_tip;
+    e.pool_cookie = h.m_pool_cookie;
+    e.created = std::chrono::steady_clock::now();
+  }
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include <boost/thread/mutex.hpp>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  //! Serialized bodies of hot RPC responses, reused until the state they were built from changes.
+  class rpc_response_cache
+  {
+  public:
+    //! What a response depends on besides the request itself.
+    enum class depends : std::uint8_t
+    {
+      chain = 0, //!< Valid while the chain tip stays the same
+      live       //!< Also dropped when the pool cookie moves, and after a second for connection counts and the like
+    };
+
+    //! Committed top of the main chain, read again on every bind and store.
+    struct chain_tip
+    {
+      std::uint64_t height;
+      crypto::hash id;
+
+      bool operator==(const chain_tip& rhs) const noexcept { return height == rhs.height && id == rhs.id; }
+      bool operator!=(const chain_tip& rhs) const noexcept { return !(*this == rhs); }
+    };
+
+    struct counters
+    {
+      std::uint64_t hits;
+      std::uint64_t misses;
+    };
+
+    //! One RPC call's view of the cache; false when the response must not be cached.
+    class handle
+    {
+    public:
+      handle() noexcept
+        : m_cache(nullptr), m_rpc(nullptr), m_depends(depends::chain), m_tip{0, crypto::null_hash}, m_pool_cookie(0)
+      {}
+
+      explicit operator bool() const noexcept { return m_cache != nullptr; }
+
+      //! \return True if a body for `request` was copied into `body`.
+      bool find(const std::string& request, std::string& body) const;
+
+      //! Keep `body` as the response to `request`, unless the chain tip moved since the handle was made.
+      void store(const std::string& request, const std::string& body) const;
+
+    private:
+      friend class rpc_response_cache;
+
+      rpc_response_cache* m_cache;
+      const char* m_rpc;
+      depends m_depends;
+      chain_tip m_tip;
+      std::uint64_t m_pool_cookie;
+    };
+
+    //! \param get_tip Reads the committed chain tip, without waiting on blocks being added.
+    explicit rpc_response_cache(std::function<chain_tip()> get_tip);
+
+    //! \return Handle for one call to `rpc`; `pool_cookie` is only used for `depends::live`.
+    handle bind(const char* rpc, depends dep, std::uint64_t pool_cookie);
+
+    std::map<std::string, counters> get_counters() const;
+    void clear_counters();
+
+  private:
+    struct entry
+    {
+      std::string body;
+      chain_tip tip;
+      std::uint64_t pool_cookie;
+      std::chrono::steady_clock::time_point created;
+    };
+
+    bool find(const handle& h, const std::string& request, std::string& body);
+    void store(const handle& h, const std::string& request, const std::string& body);
+
+    const std::function<chain_tip()> m_get_tip;
+    mutable boost::mutex m_mutex;
+    std::unordered_map<std::string, entry> m_entries; //!< Keyed by rpc name and raw request body
+    std::map<std::string, counters> m_counters;
+  };
+}
@@ -43,9 +43,11 @@
 #include <utility>
 
 #include "common/expect.h"
+#include "common/metrics.h"
 #include "crypto/crypto.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/events.h"
+#include "int-util.h"
 #include "misc_log_ex.h"
 #include "serialization/json_object.h"
 
@@ -56,8 +58,9 @@ namespace
 {
   constexpr const char txpool_signal[] = "tx_signal";
 
-  using chain_writer =  void(epee::byte_stream&, std::uint64_t, epee::span<const cryptonote::block>);
-  using txpool_writer = void(epee::byte_stream&, epee::span<const cryptonote::txpool_event>);
+  //! The second argument is the sequence number of the message in its topic
+  using chain_writer =  void(epee::byte_stream&, std::uint64_t, std::uint64_t, epee::span<const cryptonote::block>);
+  using txpool_writer = void(epee::byte_stream&, std::uint64_t, epee::span<const cryptonote::txpool_event>);
 
   template<typename F>
   struct context
@@ -159,12 +162,48 @@ namespace
     dest.EndObject();
   }
 
-  void json_full_chain(epee::byte_stream& buf, const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
+  void write_u32(epee::byte_stream& buf, std::uint32_t value)
+  {
+    value = SWAP32LE(value);
+    buf.write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(value));
+  }
+
+  void write_u64(epee::byte_stream& buf, std::uint64_t value)
+  {
+    value = SWAP64LE(value);
+    buf.write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(value));
+  }
+
+  //! Writes `id`, then `blob` prefixed by its 32-bit little-endian size
+  void write_binary_entry(epee::byte_stream& buf, const crypto::hash& id, const boost::string_ref blob)
+  {
+    buf.write(id.data, sizeof(id.data));
+    write_u32(buf, blob.size());
+    buf.write(blob.data(), blob.size());
+  }
+
+  void binary_full_chain(epee::byte_stream& buf, const std::uint64_t sequence, const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
+  {
+    write_u64(buf, sequence);
+    write_u64(buf, height);
+    write_u32(buf, blocks.size());
+    for (const cryptonote::block& bl : blocks)
+    {
+      // blocks reach the notifier deserialized, the blob is rebuilt here
+      const cryptonote::blobdata blob = cryptonote::block_to_blob(bl);
+      crypto::hash id;
+      if (!get_block_hash(bl, id))
+        MERROR("ZMQ/Pub failure: get_block_hash");
+      write_binary_entry(buf, id, blob);
+    }
+  }
+
+  void json_full_chain(epee::byte_stream& buf, std::uint64_t, const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
   {
     json_pub(buf, blocks);
   }
 
-  void json_minimal_chain(epee::byte_stream& buf, const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
+  void json_minimal_chain(epee::byte_stream& buf, std::uint64_t, const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
   {
     json_pub(buf, minimal_chain{height, blocks});
   }
@@ -172,7 +211,7 @@ namespace
   // boost::adaptors are in place "views" - no copy/move takes place
   // moving transactions (via sort, etc.), is expensive!
 
-  void json_full_txpool(epee::byte_stream& buf, epee::span<const cryptonote::txpool_event> txes)
+  void json_full_txpool(epee::byte_stream& buf, std::uint64_t, epee::span<const cryptonote::txpool_event> txes)
   {
     namespace adapt = boost::adaptors;
     const auto to_full_tx = [](const cryptonote::txpool_event& event)
@@ -182,7 +221,7 @@ namespace
     json_pub(buf, (txes | adapt::filtered(is_valid{}) | adapt::transformed(to_full_tx)));
   }
 
-  void json_minimal_txpool(epee::byte_stream& buf, epee::span<const cryptonote::txpool_event> txes)
+  void json_minimal_txpool(epee::byte_stream& buf, std::uint64_t, epee::span<const cryptonote::txpool_event> txes)
   {
     namespace adapt = boost::adaptors;
     const auto to_minimal_tx = [](const cryptonote::txpool_event& event)
@@ -192,18 +231,84 @@ namespace
     json_pub(buf, (txes | adapt::filtered(is_valid{}) | adapt::transformed(to_minimal_tx)));
   }
 
-  constexpr const std::array<context<chain_writer>, 2> chain_contexts =
+  void binary_full_txpool(epee::byte_stream& buf, const std::uint64_t sequence, epee::span<const cryptonote::txpool_event> txes)
+  {
+    const std::size_t count = std::count_if(txes.begin(), txes.end(), is_valid{});
+    write_u64(buf, sequence);
+    write_u32(buf, count);
+    for (const cryptonote::txpool_event& event : txes)
+    {
+      if (!event.res)
+        continue;
+
+      crypto::hash id = event.hash;
+      if (id == crypto::null_hash && !get_transaction_hash(event.tx, id))
+        MERROR("ZMQ/Pub failure: get_transaction_hash");
+
+      // core hands over the received blob, only re-serialize when it did not
+      if (event.blob.empty())
+        write_binary_entry(buf, id, cryptonote::tx_to_blob(event.tx));
+      else
+        write_binary_entry(buf, id, event.blob);
+    }
+  }
+
+  constexpr const std::array<context<chain_writer>, 3> chain_contexts =
   {{
+    {u8"binary-full-chain_main", binary_full_chain},
     {u8"json-full-chain_main", json_full_chain},
     {u8"json-minimal-chain_main", json_minimal_chain}
   }};
 
-  constexpr const std::array<context<txpool_writer>, 2> txpool_contexts =
+  constexpr const std::array<context<txpool_writer>, 3> txpool_contexts =
   {{
+    {u8"binary-full-txpool_add", binary_full_txpool},
     {u8"json-full-txpool_add", json_full_txpool},
     {u8"json-minimal-txpool_add", json_minimal_txpool}
   }};
 
+  //! Messages published and dropped for one topic
+  struct topic_stats
+  {
+    tools::metrics::counter* sent;
+    tools::metrics::counter* dropped;
+  };
+
+  template<typename T, std::size_t N>
+  std::array<topic_stats, N> make_stats(const std::array<context<T>, N>& contexts)
+  {
+    auto& metrics = tools::metrics::registry::getInstance();
+    std::array<topic_stats, N> out;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+      out[i].sent = std::addressof(metrics.get_counter("monero_zmq_pub_sent_total", "ZMQ/Pub messages queued for subscribers", "topic", contexts[i].name));
+      out[i].dropped = std::addressof(metrics.get_counter("monero_zmq_pub_dropped_total", "ZMQ/Pub messages dropped before reaching the pub socket, or on errors", "topic", contexts[i].name));
+    }
+    return out;
+  }
+
+  const std::array<topic_stats, chain_contexts.size()>& chain_stats()
+  {
+    static const auto stats = make_stats(chain_contexts);
+    return stats;
+  }
+
+  const std::array<topic_stats, txpool_contexts.size()>& txpool_stats()
+  {
+    static const auto stats = make_stats(txpool_contexts);
+    return stats;
+  }
+
+  //! \return Counters for the chain topic prefixing `message`, or `nullptr`.
+  const topic_stats* find_chain_stats(const boost::string_ref message)
+  {
+    const boost::string_ref topic = message.substr(0, message.find(':'));
+    const auto elem = std::lower_bound(chain_contexts.begin(), chain_contexts.end(), topic);
+    if (elem == chain_contexts.end() || topic != elem->name)
+      return nullptr;
+    return std::addressof(chain_stats()[elem - chain_contexts.begin()]);
+  }
+
   template<typename T, std::size_t N>
   epee::span<const context<T>> get_range(const std::array<context<T>, N>& contexts, const boost::string_ref value)
   {
@@ -243,8 +348,20 @@ namespace
     }
   }
 
+  //! Takes the next sequence number of each topic with subscribers. Callers hold the lock on `sequences`.
+  template<std::size_t N>
+  std::array<std::uint64_t, N> next_sequences(const std::array<std::size_t, N>& subs, std::array<std::uint64_t, N>& sequences)
+  {
+    for (std::size_t i = 0; i < N; ++i)
+    {
+      if (subs[i])
+        ++sequences[i];
+    }
+    return sequences;
+  }
+
   template<std::size_t N, typename T, typename... U>
-  std::array<epee::byte_slice, N> make_pubs(const std::array<std::size_t, N>& subs, const std::array<context<T>, N>& contexts, U&&... args)
+  std::array<epee::byte_slice, N> make_pubs(const std::array<std::size_t, N>& subs, const std::array<std::uint64_t, N>& sequences, const std::array<context<T>, N>& contexts, U&&... args)
   {
     epee::byte_stream buf{};
 
@@ -255,7 +372,7 @@ namespace
       if (subs[i])
       {
         write_header(buf, contexts[i].name);
-        contexts[i].generate_pub(buf, std::forward<U>(args)...);
+        contexts[i].generate_pub(buf, sequences[i], std::forward<U>(args)...);
         offsets[i] = buf.size() - last_offset;
         last_offset = buf.size();
       }
@@ -269,19 +386,29 @@ namespace
     return out;
   }
 
+  /*! Sends the non-empty `messages`, and counts drops in `stats`. Successful
+    sends are only counted when `count_sent`, relayed messages being counted
+    when they reach the pub socket. */
   template<std::size_t N>
-  std::size_t send_messages(void* const socket, std::array<epee::byte_slice, N>& messages)
+  std::size_t send_messages(void* const socket, std::array<epee::byte_slice, N>& messages, const std::array<topic_stats, N>& stats, const bool count_sent)
   {
     std::size_t count = 0;
-    for (epee::byte_slice& message : messages)
+    for (std::size_t i = 0; i < N; ++i)
     {
-      if (!message.empty())
+      if (!messages[i].empty())
       {
-        const expect<void> sent = net::zmq::send(std::move(message), socket, ZMQ_DONTWAIT);
+        const expect<void> sent = net::zmq::send(std::move(messages[i]), socket, ZMQ_DONTWAIT);
         if (!sent)
+        {
+          stats[i].dropped->inc();
           MERROR("Failed to send ZMQ/Pub message: " << sent.error().message());
+        }
         else
+        {
+          if (count_sent)
+            stats[i].sent->inc();
           ++count;
+        }
       }
     }
     return count;
@@ -305,12 +432,17 @@ namespace
     }
 
     // forward block messages (serialized on P2P thread for now)
+    const topic_stats* const stats = find_chain_stats(payload);
     const expect<void> sent = net::zmq::retry_op(zmq_msg_send, std::addressof(msg), pub, ZMQ_DONTWAIT);
     if (!sent)
     {
+      if (stats)
+        stats->dropped->inc();
       zmq_msg_close(std::addressof(msg));
       return sent.error();
     }
+    if (stats)
+      stats->sent->inc();
     return true;
   }
 } // anonymous
@@ -318,10 +450,12 @@ namespace
 namespace cryptonote { namespace listener
 {
 
-zmq_pub::zmq_pub(void* context)
+zmq_pub::zmq_pub(void* context, const int high_water_mark)
   : relay_(),
     chain_subs_{{0}},
     txpool_subs_{{0}},
+    chain_sequences_{{0}},
+    txpool_sequences_{{0}},
     sync_()
 {
   if (!context)
@@ -333,6 +467,8 @@ zmq_pub::zmq_pub(void* context)
   relay_.reset(zmq_socket(context, ZMQ_PAIR));
   if (!relay_)
     MONERO_ZMQ_THROW("Failed to create relay socket");
+  if (zmq_setsockopt(relay_.get(), ZMQ_SNDHWM, std::addressof(high_water_mark), sizeof(high_water_mark)) != 0)
+    MONERO_ZMQ_THROW("Failed to set relay high-water mark");
   if (zmq_connect(relay_.get(), relay_endpoint()) != 0)
     MONERO_ZMQ_THROW("Failed to connect relay socket");
 }
@@ -347,6 +483,11 @@ bool zmq_pub::sub_request(boost::string_ref message)
     const char tag = message[0];
     message.remove_prefix(1);
 
+    /* A catch-all subscription predates the binary format, so it only asks
+       for json. ZMQ still hands it binary messages another client asked for. */
+    if (message.empty())
+      message = u8"json-";
+
     const auto chain_range = get_range(chain_contexts, message);
     const auto txpool_range = get_range(txpool_contexts, message);
 
@@ -386,7 +527,8 @@ bool zmq_pub::relay_to_pub(void* const relay, void* const pub)
 
   if (!*relayed)
   {
-    std::array<std::size_t, 2> subs;
+    std::array<std::size_t, txpool_contexts.size()> subs;
+    std::array<std::uint64_t, txpool_contexts.size()> sequences;
     std::vector<cryptonote::txpool_event> events;
     {
       const boost::lock_guard<boost::mutex> lock{sync_};
@@ -394,11 +536,12 @@ bool zmq_pub::relay_to_pub(void* const relay, void* const pub)
         return false;
 
       subs = txpool_subs_;
+      sequences = next_sequences(subs, txpool_sequences_);
       events = std::move(txes_.front());
       txes_.pop_front();
     }
-    auto messages = make_pubs(subs, txpool_contexts, epee::to_span(events));
-    send_messages(pub, messages);
+    auto messages = make_pubs(subs, sequences, txpool_contexts, epee::to_span(events));
+    send_messages(pub, messages, txpool_stats(), true);
     MDEBUG("Sent txpool ZMQ/Pub");
   }
   else
@@ -418,6 +561,7 @@ std::size_t zmq_pub::send_chain_main(const std::uint64_t height, const epee::spa
   boost::unique_lock<boost::mutex> guard{sync_};
 
   const auto subs_copy = chain_subs_;
+  const auto sequences = next_sequences(subs_copy, chain_sequences_);
   guard.unlock();
 
   for (const std::size_t sub : subs_copy)
@@ -428,9 +572,9 @@ std::size_t zmq_pub::send_chain_main(const std::uint64_t height, const epee::spa
          does for txpool events. Since copying the block is expensive anyway,
          serialization is done right here on the p2p thread (for now). */
 
-        auto messages = make_pubs(subs_copy, chain_contexts, height, blocks);
+        auto messages = make_pubs(subs_copy, sequences, chain_contexts, height, blocks);
         guard.lock();
-        return send_messages(relay_.get(), messages);
+        return send_messages(relay_.get(), messages, chain_stats(), false);
     }
   }
   return 0;
@@ -450,7 +594,14 @@ std::size_t zmq_pub::send_txpool_add(std::vector<txpool_event> txes)
       if (sent)
         txes_.emplace_back(std::move(txes));
       else
+      {
+        for (std::size_t i = 0; i < txpool_subs_.size(); ++i)
+        {
+          if (txpool_subs_[i])
+            txpool_stats()[i].dropped->inc();
+        }
         MERROR("ZMQ/Pub failure, relay queue error: " << sent.error().message());
+      }
       return bool(sent);
     }
   }
@@ -58,15 +58,22 @@ class zmq_pub
 
     net::zmq::socket relay_;
     std::deque<std::vector<txpool_event>> txes_;
-    std::array<std::size_t, 2> chain_subs_;
-    std::array<std::size_t, 2> txpool_subs_;
-    boost::mutex sync_; //!< Synchronizes counts in `*_subs_` arrays.
+    std::array<std::size_t, 3> chain_subs_;
+    std::array<std::size_t, 3> txpool_subs_;
+    std::array<std::uint64_t, 3> chain_sequences_;  //!< Last message number of each topic
+    std::array<std::uint64_t, 3> txpool_sequences_;
+    boost::mutex sync_; //!< Synchronizes counts in `*_subs_` and `*_sequences_` arrays.
 
   public:
     //! \return Name of ZMQ_PAIR endpoint for pub notifications
     static constexpr const char* relay_endpoint() noexcept { return "inproc://pub_relay"; }
 
-    explicit zmq_pub(void* context);
+    //! Default for `high_water_mark`, in messages queued per socket
+    static constexpr int default_high_water_mark() noexcept { return 1000; }
+
+    /*! \param high_water_mark Messages queued to the relay before new ones are
+        dropped (and counted as such). */
+    explicit zmq_pub(void* context, int high_water_mark = default_high_water_mark());
 
     zmq_pub(const zmq_pub&) = delete;
     zmq_pub(zmq_pub&&) = delete;
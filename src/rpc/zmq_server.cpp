@@ -49,7 +49,8 @@ namespace
   constexpr const std::int64_t max_message_size = 10 * 1024 * 1024; // 10 MiB
   constexpr const std::chrono::seconds linger_timeout{2}; // wait period for pending out messages
 
-  net::zmq::socket init_socket(void* context, int type, epee::span<const std::string> addresses)
+  //! `high_water_mark` is the number of queued outgoing messages per peer, negative keeps the ZMQ default
+  net::zmq::socket init_socket(void* context, int type, epee::span<const std::string> addresses, const int high_water_mark = -1)
   {
     if (context == nullptr)
       throw std::logic_error{"NULL context provided"};
@@ -75,6 +76,12 @@ namespace
       return nullptr;
     }
 
+    if (0 <= high_water_mark && zmq_setsockopt(out.get(), ZMQ_SNDHWM, std::addressof(high_water_mark), sizeof(high_water_mark)) != 0)
+    {
+      MONERO_LOG_ZMQ_ERROR("Failed to set high-water mark");
+      return nullptr;
+    }
+
     for (const std::string& address : addresses)
     {
       if (zmq_bind(out.get(), address.c_str()) < 0)
@@ -205,17 +212,21 @@ void* ZmqServer::init_rpc(boost::string_ref address, boost::string_ref port)
   return bool(rep_socket) ? context.get() : nullptr;
 }
 
-std::shared_ptr<listener::zmq_pub> ZmqServer::init_pub(epee::span<const std::string> addresses)
+std::shared_ptr<listener::zmq_pub> ZmqServer::init_pub(epee::span<const std::string> addresses, const int high_water_mark)
 {
   try
   {
-    shared_state = std::make_shared<listener::zmq_pub>(context.get());
-    pub_socket = init_socket(context.get(), ZMQ_XPUB, addresses);
+    shared_state = std::make_shared<listener::zmq_pub>(context.get(), high_water_mark);
+    pub_socket = init_socket(context.get(), ZMQ_XPUB, addresses, high_water_mark);
     if (!pub_socket)
       throw std::runtime_error{"Unable to initialize ZMQ_XPUB socket"};
 
+    /* XPUB drops silently for a subscriber at the high-water mark, and only
+       for that one. Drops are counted where the relay pair refuses a message,
+       which is where a slow pub socket shows up. */
+
     const std::string relay_address[] = {listener::zmq_pub::relay_endpoint()};
-    relay_socket = init_socket(context.get(), ZMQ_PAIR, relay_address);
+    relay_socket = init_socket(context.get(), ZMQ_PAIR, relay_address, high_water_mark);
     if (!relay_socket)
       throw std::runtime_error{"Unable to initialize ZMQ_PAIR relay"};
   }
@@ -60,8 +60,10 @@ class ZmqServer final
     //! \return ZMQ context on success, `nullptr` on failure
     void* init_rpc(boost::string_ref address, boost::string_ref port);
 
-    //! \return `nullptr` on errors.
-    std::shared_ptr<listener::zmq_pub> init_pub(epee::span<const std::string> addresses);
+    /*! \param high_water_mark Messages queued per subscriber before new ones
+        are dropped.
+        \return `nullptr` on errors. */
+    std::shared_ptr<listener::zmq_pub> init_pub(epee::span<const std::string> addresses, int high_water_mark);
 
     void run();
     void stop();
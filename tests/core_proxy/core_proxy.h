@@ -82,6 +82,8 @@ namespace tests
     void resume_mine(){}
     bool on_idle(){return true;}
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, bool clip_pruned, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp){return true;}
+    bool get_compact_block_headers(uint64_t start_height, size_t count, std::vector<cryptonote::blobdata> &headers) const { return false; }
+    bool check_block_headers(uint64_t start_height, const std::vector<cryptonote::compact_block_header> &headers, const std::vector<crypto::hash> &ids, uint64_t &checked, cryptonote::difficulty_type &cumulative_difficulty) { checked = 0; return true; }
     bool handle_get_objects(cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote::cryptonote_connection_context& context){return true;}
     cryptonote::Blockchain &get_blockchain_storage() { throw std::runtime_error("Called invalid member function: please never call get_blockchain_storage on the TESTING class proxy_core."); }
     bool get_test_drop_download() {return true;}
@@ -110,6 +112,7 @@ namespace tests
     uint32_t get_blockchain_pruning_seed() const { return 0; }
     bool prune_blockchain(uint32_t pruning_seed) const { return true; }
     bool get_txpool_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes) { return false; }
+    void get_pool_short_id_index(const crypto::hash &salt, std::unordered_map<uint64_t, crypto::hash> &index) const { index.clear(); }
     bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes = true) const { return false; }
   };
 }
@@ -116,6 +116,16 @@ class BlockchainTest():
             assert block_header.long_term_weight > 0
             prev_block = block_header.hash
 
+        # the same headers again, in a single batch
+        res = daemon.rpc.send_json_rpc_batch([{'jsonrpc': '2.0', 'id': n, 'method': 'getblockheaderbyheight', 'params': {'height': height + n}} for n in range(blocks)] + [{'jsonrpc': '2.0', 'id': 'x', 'method': 'no_such_method'}])
+        assert len(res) == blocks + 1
+        for n in range(blocks):
+            assert res[n].id == n
+            assert 'error' not in res[n], res[n]
+            assert res[n].result.block_header.hash == res_getblock[n].block_header.hash
+        assert res[blocks].id == 'x'
+        assert res[blocks].error.code == -32601
+
         # we should not see a block after that
         ok = False
         try: daemon.getblock(height = height + blocks)
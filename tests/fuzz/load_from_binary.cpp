@@ -39,4 +39,6 @@ END_INIT_SIMPLE_FUZZER()
 BEGIN_SIMPLE_FUZZER()
   epee::serialization::portable_storage ps;
   ps.load_from_binary(std::string((const char*)buf, len));
+  epee::serialization::portable_storage_reader reader;
+  reader.load_from_binary(epee::span<const uint8_t>(buf, len));
 END_SIMPLE_FUZZER()
@@ -31,6 +31,7 @@
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage_template_helper.h"
 #include "storages/portable_storage_base.h"
+#include "storages/json_storage_reader.h"
 #include "fuzzer.h"
 
 BEGIN_INIT_SIMPLE_FUZZER()
@@ -39,4 +40,6 @@ END_INIT_SIMPLE_FUZZER()
 BEGIN_SIMPLE_FUZZER()
   epee::serialization::portable_storage ps;
   ps.load_from_json(std::string((const char*)buf, len));
+  epee::serialization::json_storage_reader reader;
+  reader.load_from_json(std::string((const char*)buf, len));
 END_SIMPLE_FUZZER()
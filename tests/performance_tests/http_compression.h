@@ -0,0 +1,248 @@
+// Copyright (c) 2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+#include "syncobj.h"
+#include "net/http_compression.h"
+#include "net/http_protocol_handler.h"
+
+#include "multi_tx_test_base.h"
+
+// Measures a typical wallet sync round trip through the epee HTTP server:
+// one pipelined batch of a streamed, pruned get_blocks.bin followed by a few
+// get_info calls, all on one keep-alive connection. Bytes on the wire per
+// batch are printed at init; requests/s is batch_requests / time per call.
+template<epee::net_utils::http::content_coding a_coding>
+class test_http_compression : private multi_tx_test_base<11>
+{
+  typedef epee::net_utils::connection_context_base context_t;
+
+  class handler : public epee::net_utils::http::i_http_server_handler<context_t>
+  {
+  public:
+    std::string blocks_body;
+    std::string info_body;
+
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, context_t&) override
+    {
+      if (query_info.m_URI == "/get_blocks.bin")
+      {
+        auto offset = std::make_shared<size_t>(0);
+        const std::string *body = &blocks_body;
+        response.m_body_generator = [offset, body](std::string& chunk) {
+          const size_t size = std::min<size_t>(64 * 1024, body->size() - *offset);
+          chunk.append(*body, *offset, size);
+          *offset += size;
+          return true;
+        };
+      }
+      else
+        response.m_body = info_body;
+      return true;
+    }
+  };
+
+  class connection : public epee::net_utils::i_service_endpoint
+  {
+  public:
+    explicit connection(epee::net_utils::http::custum_handler_config<context_t>& config)
+      : m_io_service(), m_context(), m_handler(this, config, m_context), m_callback_on_sent(false), sent(0)
+    {}
+
+    bool do_send(epee::byte_slice message) override { sent += message.size(); return true; }
+    bool close() override { return true; }
+    bool send_done() override { return true; }
+    bool call_run_once_service_io() override { return true; }
+    bool request_callback() override { return true; }
+    bool request_callback_on_sent() override { m_callback_on_sent = true; return true; }
+    boost::asio::io_service& get_io_service() override { return m_io_service; }
+    bool add_ref() override { return true; }
+    bool release() override { return true; }
+
+    bool recv(const std::string& data)
+    {
+      const bool res = m_handler.handle_recv(data.data(), data.size());
+      // every write completes at once
+      while (m_callback_on_sent)
+      {
+        m_callback_on_sent = false;
+        m_handler.handle_qued_callback();
+      }
+      return res;
+    }
+
+  private:
+    boost::asio::io_service m_io_service;
+    context_t m_context;
+    epee::net_utils::http::http_custom_handler<context_t> m_handler;
+    bool m_callback_on_sent;
+
+  public:
+    size_t sent;
+  };
+
+public:
+  static const size_t loop_count = 100;
+  static const size_t num_blocks = 32;
+  static const size_t txes_per_block = 4;
+  static const size_t info_calls = 4;
+  static const epee::net_utils::http::content_coding coding = a_coding;
+
+  typedef multi_tx_test_base<11> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!epee::net_utils::http::is_supported(coding))
+      return false;
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount - 1, m_alice.get_keys().m_account_address, false));
+    destinations.push_back(tx_destination_entry(1, m_alice.get_keys().m_account_address, false));
+
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+
+    // what a wallet asks for: pruned txes, with the prunable hash in their place
+    COMMAND_RPC_GET_BLOCKS_FAST::response blocks_res;
+    uint64_t global_index = 0;
+    crypto::hash top_hash = crypto::null_hash;
+    for (size_t b = 0; b < num_blocks; ++b)
+    {
+      block blk;
+      blk.major_version = HF_VERSION_MIN_2_OUTPUTS;
+      blk.minor_version = HF_VERSION_MIN_2_OUTPUTS;
+      blk.timestamp = 1600000000 + b * DIFFICULTY_TARGET;
+      blk.miner_tx = this->m_miner_txs[b % ring_size];
+
+      block_complete_entry entry;
+      entry.pruned = true;
+      COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices indices;
+      indices.indices.push_back({{global_index++}});
+      for (size_t n = 0; n < txes_per_block; ++n)
+      {
+        transaction tx;
+        if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, cryptonote::account_public_address{}, std::vector<uint8_t>(), tx, 0, tx_key, additional_tx_keys, true, {rct::RangeProofPaddedBulletproof, 2}))
+          return false;
+        const blobdata blob = tx_to_blob(tx);
+        transaction parsed_tx;
+        if (!parse_and_validate_tx_from_blob(blob, parsed_tx))
+          return false;
+        blk.tx_hashes.push_back(get_transaction_hash(parsed_tx));
+        entry.txs.push_back(tx_blob_entry(blob.substr(0, parsed_tx.unprunable_size), get_transaction_prunable_hash(parsed_tx)));
+        indices.indices.push_back({{global_index, global_index + 1}});
+        global_index += 2;
+      }
+      entry.block = block_to_blob(blk);
+      top_hash = get_block_hash(blk);
+      blocks_res.blocks.push_back(std::move(entry));
+      blocks_res.output_indices.push_back(std::move(indices));
+    }
+    blocks_res.start_height = 2000000;
+    blocks_res.current_height = blocks_res.start_height + num_blocks;
+    blocks_res.status = CORE_RPC_STATUS_OK;
+    if (!epee::serialization::store_t_to_binary(blocks_res, m_handler.blocks_body))
+      return false;
+
+    COMMAND_RPC_GET_INFO::response info_res;
+    info_res.status = CORE_RPC_STATUS_OK;
+    info_res.height = blocks_res.current_height;
+    info_res.target_height = info_res.height;
+    info_res.difficulty = 300000000000;
+    info_res.wide_difficulty = "0x45d964b800";
+    info_res.target = DIFFICULTY_TARGET;
+    info_res.tx_count = 10000000;
+    info_res.tx_pool_size = 25;
+    info_res.mainnet = true;
+    info_res.nettype = "mainnet";
+    info_res.top_block_hash = epee::string_tools::pod_to_hex(top_hash);
+    info_res.cumulative_difficulty = 300000000000000000;
+    info_res.wide_cumulative_difficulty = "0x429d069189e0000";
+    info_res.block_size_limit = info_res.block_weight_limit = 600000;
+    info_res.block_size_median = info_res.block_weight_median = 300000;
+    info_res.start_time = 1600000000;
+    info_res.free_space = 100000000000;
+    info_res.database_size = 100000000000;
+    info_res.version = "0.17.0.0";
+    std::string info_json;
+    if (!epee::serialization::store_t_to_json(info_res, info_json, 0, false))
+      return false;
+    m_handler.info_body = "{\"id\":\"0\",\"jsonrpc\":\"2.0\",\"result\":" + info_json + "}";
+
+    const std::string accept_encoding = coding == epee::net_utils::http::content_coding::identity ? std::string() :
+      std::string("Accept-Encoding: ") + epee::net_utils::http::get_name(coding) + "\r\n";
+    m_requests = "POST /get_blocks.bin HTTP/1.1\r\n" + accept_encoding + "Content-Length: 0\r\n\r\n";
+    for (size_t n = 0; n < info_calls; ++n)
+      m_requests += "POST /json_rpc HTTP/1.1\r\n" + accept_encoding + "Content-Length: 0\r\n\r\n";
+
+    m_config.m_phandler = &m_handler;
+    m_config.m_compress = true;
+    m_connection.reset(new connection(m_config));
+
+    if (!test())
+      return false;
+    const size_t bodies = m_handler.blocks_body.size() + info_calls * m_handler.info_body.size();
+    std::cout << (accept_encoding.empty() ? "identity" : epee::net_utils::http::get_name(coding)) << ": " << m_requests.size() << " request + " << m_connection->sent
+      << " response bytes per batch of " << (1 + info_calls) << " requests, for " << bodies << " bytes of bodies ("
+      << (100.0 * m_connection->sent / bodies) << "%)" << std::endl;
+    return true;
+  }
+
+  bool test()
+  {
+    m_connection->sent = 0;
+    return m_connection->recv(m_requests) && m_connection->sent != 0;
+  }
+
+private:
+  cryptonote::account_base m_alice;
+  handler m_handler;
+  epee::net_utils::http::custum_handler_config<context_t> m_config;
+  std::unique_ptr<connection> m_connection;
+  std::string m_requests;
+};
@@ -60,6 +60,8 @@
 #include "bulletproof.h"
 #include "crypto_ops.h"
 #include "multiexp.h"
+#include "tx_compression.h"
+#include "http_compression.h"
 
 namespace po = boost::program_options;
 
@@ -244,6 +246,25 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, false, 2, 1, 1, 0, 64);
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 64); // 64 proof, each with 2 amounts
 
+#ifdef HAVE_ZSTD
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_compression, false, false);
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_compression, false, true);
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_compression, true, false);
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_compression, true, true);
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_read, false, false);
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_read, false, true);
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_read, true, false);
+  TEST_PERFORMANCE2(filter, p, test_tx_blob_read, true, true);
+#endif
+
+  TEST_PERFORMANCE1(filter, p, test_http_compression, epee::net_utils::http::content_coding::identity);
+#ifdef HAVE_ZLIB
+  TEST_PERFORMANCE1(filter, p, test_http_compression, epee::net_utils::http::content_coding::gzip);
+#endif
+#ifdef HAVE_ZSTD
+  TEST_PERFORMANCE1(filter, p, test_http_compression, epee::net_utils::http::content_coding::zstd);
+#endif
+
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_sc_add);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_sc_sub);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_sc_mul);
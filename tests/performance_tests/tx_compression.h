@@ -0,0 +1,326 @@
+// Copyright (c) 2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "blockchain_db/tx_compression.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/hardfork.h"
+
+#include "multi_tx_test_base.h"
+
+// Measures the cost of dictionary compressed tx storage on the db read path
+// (decompress) and write path (compress). The dictionary is trained on one
+// half of the txes and used on the other half. The compression ratio printed
+// at init is the ratio by which the tx tables' page cache footprint shrinks.
+template<bool a_prunable, bool a_compress>
+class test_tx_blob_compression : private multi_tx_test_base<11>
+{
+public:
+  static const size_t loop_count = 100;
+  static const size_t num_txes = 256;
+  static const bool prunable = a_prunable;
+  static const bool compress = a_compress;
+
+  typedef multi_tx_test_base<11> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!tx_blob_compressor::is_supported())
+      return false;
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount - 1, m_alice.get_keys().m_account_address, false));
+    destinations.push_back(tx_destination_entry(1, m_alice.get_keys().m_account_address, false));
+
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+
+    std::vector<std::string> samples;
+    for (size_t n = 0; n < num_txes; ++n)
+    {
+      transaction tx;
+      if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, cryptonote::account_public_address{}, std::vector<uint8_t>(), tx, 0, tx_key, additional_tx_keys, true, {rct::RangeProofPaddedBulletproof, 2}))
+        return false;
+      const blobdata blob = tx_to_blob(tx);
+      transaction parsed_tx;
+      if (!parse_and_validate_tx_from_blob(blob, parsed_tx))
+        return false;
+      const size_t unprunable_size = parsed_tx.unprunable_size;
+      std::string part = prunable ? blob.substr(unprunable_size) : blob.substr(0, unprunable_size);
+      if (n % 2)
+        m_blobs.push_back(std::move(part));
+      else
+        samples.push_back(std::move(part));
+    }
+
+    std::string dictionary;
+    if (!tx_blob_compressor::train(samples, 16384, dictionary))
+      return false;
+    if (!m_compressor.set_dictionary(dictionary))
+      return false;
+
+    size_t raw_size = 0, compressed_size = 0;
+    for (const std::string &blob: m_blobs)
+    {
+      std::string compressed;
+      if (!m_compressor.compress(epee::strspan<uint8_t>(blob), compressed))
+        return false;
+      raw_size += blob.size();
+      compressed_size += compressed.size();
+      m_compressed.push_back(std::move(compressed));
+    }
+    std::cout << (prunable ? "prunable" : "pruned") << " data: " << raw_size << " -> " << compressed_size
+      << " bytes (" << (100.0 * compressed_size / raw_size) << "%)" << std::endl;
+    return true;
+  }
+
+  bool test()
+  {
+    if (compress)
+    {
+      std::string compressed;
+      for (const std::string &blob: m_blobs)
+        if (!m_compressor.compress(epee::strspan<uint8_t>(blob), compressed))
+          return false;
+    }
+    else
+    {
+      std::string blob;
+      for (const std::string &compressed: m_compressed)
+      {
+        blob.clear();
+        if (!m_compressor.decompress_append(epee::strspan<uint8_t>(compressed), blob))
+          return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  cryptonote::account_base m_alice;
+  cryptonote::tx_blob_compressor m_compressor;
+  std::vector<std::string> m_blobs;
+  std::vector<std::string> m_compressed;
+};
+
+// Distinct txes for test_tx_blob_read, each spending from a ring of its own
+// so that their key images differ. Built once, as this takes a while.
+class tx_blob_read_txes : private multi_tx_test_base<11>
+{
+public:
+  typedef multi_tx_test_base<11> base_class;
+  typedef std::vector<std::pair<cryptonote::transaction, cryptonote::blobdata>> txes_t;
+
+  static const txes_t *get(size_t count)
+  {
+    static txes_t txes;
+    if (txes.size() < count)
+    {
+      tx_blob_read_txes generator;
+      if (!generator.generate(count, txes))
+        return NULL;
+    }
+    return &txes;
+  }
+
+private:
+  bool generate(size_t count, txes_t &txes)
+  {
+    using namespace cryptonote;
+
+    account_base alice;
+    alice.generate();
+
+    while (txes.size() < count)
+    {
+      this->m_sources.clear();
+      if (!base_class::init())
+        return false;
+
+      std::vector<tx_destination_entry> destinations;
+      destinations.push_back(tx_destination_entry(this->m_source_amount - 1, alice.get_keys().m_account_address, false));
+      destinations.push_back(tx_destination_entry(1, alice.get_keys().m_account_address, false));
+
+      crypto::secret_key tx_key;
+      std::vector<crypto::secret_key> additional_tx_keys;
+      std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+      subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+
+      transaction tx;
+      if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, cryptonote::account_public_address{}, std::vector<uint8_t>(), tx, 0, tx_key, additional_tx_keys, true, {rct::RangeProofPaddedBulletproof, 2}))
+        return false;
+      blobdata blob = tx_to_blob(tx);
+      txes.push_back(std::make_pair(std::move(tx), std::move(blob)));
+    }
+    return true;
+  }
+};
+
+// Measures the db read path the RPC serves blocks from, get_blocks_from for
+// get_blocks.bin and for_blocks_from for the streamed variant, on a chain
+// stored with and without tx compression. The bytes printed at init are
+// what one call hands out, to turn the timings into a throughput.
+template<bool a_compress, bool a_stream>
+class test_tx_blob_read
+{
+public:
+  static const size_t loop_count = 20;
+  static const size_t num_blocks = 128;
+  static const size_t txes_per_block = 8; // enough txes for the db to train its dictionaries
+  static const bool compress = a_compress;
+  static const bool stream = a_stream;
+
+  ~test_tx_blob_read()
+  {
+    m_hardfork.reset();
+    if (m_db)
+    {
+      if (m_db->is_open())
+        m_db->close();
+      m_db.reset();
+    }
+    if (!m_dir.empty())
+      boost::filesystem::remove_all(m_dir);
+  }
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (compress && !tx_blob_compressor::is_supported())
+      return false;
+    const tx_blob_read_txes::txes_t *txes = tx_blob_read_txes::get(num_blocks * txes_per_block);
+    if (!txes)
+      return false;
+
+    try
+    {
+      m_dir = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+      m_db.reset(new BlockchainLMDB());
+      m_hardfork.reset(new HardFork(*m_db, 1, 0));
+      m_db->open(m_dir);
+      m_db->set_hard_fork(m_hardfork.get());
+      m_hardfork->init();
+
+      account_base miner;
+      miner.generate();
+      {
+        db_wtxn_guard guard(m_db.get());
+        crypto::hash prev_id = crypto::null_hash;
+        for (size_t h = 0; h < num_blocks; ++h)
+        {
+          std::pair<block, blobdata> b;
+          b.first.major_version = 1;
+          b.first.minor_version = 0;
+          b.first.timestamp = h;
+          b.first.prev_id = prev_id;
+          bool pad_tx = false;
+          if (!construct_miner_tx(h, 0, 0, 0, 0, miner.get_keys().m_account_address, b.first.miner_tx, blobdata(), 1, pad_tx))
+            return false;
+          const std::vector<std::pair<transaction, blobdata>> block_txes(txes->begin() + h * txes_per_block, txes->begin() + (h + 1) * txes_per_block);
+          for (const auto &tx: block_txes)
+            b.first.tx_hashes.push_back(get_transaction_hash(tx.first));
+          b.second = block_to_blob(b.first);
+          m_db->add_block(b, b.second.size(), b.second.size(), h + 1, 0, block_txes);
+          prev_id = get_block_hash(b.first);
+        }
+      }
+
+      // reopening with compression asked for converts the tx tables
+      m_db->close();
+      m_hardfork.reset();
+      m_db.reset(new BlockchainLMDB());
+      m_db->open(m_dir, compress ? DBF_COMPRESS_TXS : 0);
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "Failed to create the db: " << e.what() << std::endl;
+      return false;
+    }
+
+    std::vector<std::pair<std::pair<blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, blobdata>>>> blocks;
+    if (!m_db->get_blocks_from(0, num_blocks, num_blocks, std::numeric_limits<size_t>::max(), blocks, false, true, false))
+      return false;
+    size_t bytes = 0;
+    for (const auto &b: blocks)
+    {
+      bytes += b.first.first.size();
+      for (const auto &tx: b.second)
+        bytes += tx.second.size();
+    }
+    std::cout << blocks.size() << " blocks, " << bytes << " bytes per call" << std::endl;
+    return true;
+  }
+
+  bool test()
+  {
+    if (stream)
+    {
+      size_t count = 0;
+      if (!m_db->for_blocks_from(0, num_blocks, num_blocks, std::numeric_limits<size_t>::max(), false,
+          [&count](uint64_t, const epee::span<const uint8_t>, const cryptonote::block&, std::vector<cryptonote::blobdata> &txes) {
+            count += txes.size();
+            return true;
+          }))
+        return false;
+      return count == num_blocks * txes_per_block;
+    }
+    else
+    {
+      std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>> blocks;
+      if (!m_db->get_blocks_from(0, num_blocks, num_blocks, std::numeric_limits<size_t>::max(), blocks, false, true, false))
+        return false;
+      return blocks.size() == num_blocks;
+    }
+  }
+
+private:
+  std::string m_dir;
+  std::unique_ptr<cryptonote::BlockchainLMDB> m_db;
+  std::unique_ptr<cryptonote::HardFork> m_hardfork;
+};
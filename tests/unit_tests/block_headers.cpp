@@ -0,0 +1,228 @@
+// Copyright (c) 2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#define IN_UNIT_TESTS
+
+#include <ctime>
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/difficulty.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "blockchain_db/testdb.h"
+
+#define TEST_FIXED_DIFFICULTY 2
+
+namespace
+{
+
+class TestDB: public cryptonote::BaseTestDB
+{
+private:
+  struct block_t
+  {
+    cryptonote::block block;
+    crypto::hash id;
+    cryptonote::difficulty_type cumulative_difficulty;
+  };
+
+public:
+  TestDB() { m_open = true; }
+
+  virtual void add_block( const cryptonote::block& blk
+                        , size_t block_weight
+                        , uint64_t long_term_block_weight
+                        , const cryptonote::difficulty_type& cumulative_difficulty
+                        , const uint64_t& coins_generated
+                        , uint64_t num_rct_outs
+                        , const crypto::hash& blk_hash
+                        ) override {
+    blocks.push_back({blk, blk_hash, cumulative_difficulty});
+  }
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &height) const override { return blocks[height].block; }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override { return blocks[height].id; }
+  virtual uint64_t get_block_timestamp(const uint64_t &height) const override { return blocks[height].block.timestamp; }
+  virtual cryptonote::difficulty_type get_block_cumulative_difficulty(const uint64_t &height) const override { return blocks[height].cumulative_difficulty; }
+  virtual uint64_t get_top_block_timestamp() const override { return blocks.empty() ? 0 : blocks.back().block.timestamp; }
+  virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+    if (block_height)
+      *block_height = blocks.size() - 1;
+    return blocks.empty() ? crypto::null_hash : blocks.back().id;
+  }
+  virtual cryptonote::block get_top_block() const override { return blocks.empty() ? cryptonote::block() : blocks.back().block; }
+  virtual void set_hard_fork_version(uint64_t height, uint8_t version) override { versions[height] = version; }
+  virtual uint8_t get_hard_fork_version(uint64_t height) const override { auto i = versions.find(height); return i == versions.end() ? 0 : i->second; }
+  virtual void pop_block(cryptonote::block &blk, std::vector<cryptonote::transaction> &txs) override { blocks.pop_back(); }
+
+private:
+  std::vector<block_t> blocks;
+  std::map<uint64_t, uint8_t> versions;
+};
+
+// a header whose proof of work meets the fixed difficulty or not, as asked
+cryptonote::compact_block_header make_header(const crypto::hash &prev_id, uint64_t timestamp, bool good_pow)
+{
+  cryptonote::compact_block_header header;
+  header.major_version = 1;
+  header.minor_version = 1;
+  header.timestamp = timestamp;
+  header.prev_id = prev_id;
+  header.nonce8 = 0;
+  header.nonce = 0;
+  memset(&header.cycle, 0, sizeof(header.cycle));
+  header.tx_tree_root = crypto::rand<crypto::hash>();
+  header.tx_count = 1;
+  cn_pow_hash_v3 ctx;
+  while (cryptonote::check_hash(cryptonote::get_block_longhash(header, ctx), TEST_FIXED_DIFFICULTY) != good_pow)
+    ++header.nonce;
+  return header;
+}
+
+// the block a peer would send for the given header, as far as its header goes
+cryptonote::block make_block(const cryptonote::compact_block_header &header)
+{
+  cryptonote::block b;
+  static_cast<cryptonote::block_header&>(b) = header;
+  return b;
+}
+
+}
+
+#define PREFIX \
+  std::unique_ptr<cryptonote::Blockchain> bc; \
+  cryptonote::tx_memory_pool txpool(*bc); \
+  bc.reset(new cryptonote::Blockchain(txpool)); \
+  struct get_test_options { \
+    const std::pair<uint8_t, uint64_t> hard_forks[2]; \
+    const cryptonote::test_options test_options = { \
+      hard_forks, \
+      5000, \
+    }; \
+    get_test_options(): hard_forks{std::make_pair(1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)} {} \
+  } opts; \
+  ASSERT_TRUE(bc->init(new TestDB(), cryptonote::FAKECHAIN, true, &opts.test_options, TEST_FIXED_DIFFICULTY, NULL)); \
+  std::vector<cryptonote::blobdata> genesis_blob; \
+  ASSERT_TRUE(bc->get_compact_block_headers(0, 1, genesis_blob)); \
+  ASSERT_EQ(genesis_blob.size(), 1); \
+  cryptonote::compact_block_header genesis; \
+  ASSERT_TRUE(cryptonote::t_serializable_object_from_blob(genesis, genesis_blob[0])); \
+  ASSERT_EQ(cryptonote::get_compact_block_header_hash(genesis), bc->get_db().get_block_hash_from_height(0)); \
+  std::vector<cryptonote::compact_block_header> headers{genesis}; \
+  std::vector<crypto::hash> ids{cryptonote::get_compact_block_header_hash(genesis)}; \
+  const auto add_header = [&](const cryptonote::compact_block_header &header) { \
+    headers.push_back(header); \
+    ids.push_back(cryptonote::get_compact_block_header_hash(header)); \
+  }; \
+  uint64_t checked; \
+  cryptonote::difficulty_type cumulative_difficulty
+
+TEST(block_headers, good)
+{
+  PREFIX;
+
+  for (size_t n = 0; n < 3; ++n)
+    add_header(make_header(ids.back(), genesis.timestamp + n + 1, true));
+  ASSERT_TRUE(bc->check_block_headers(0, headers, ids, checked, cumulative_difficulty));
+  ASSERT_EQ(checked, headers.size());
+  ASSERT_EQ(cumulative_difficulty, bc->get_db().get_block_cumulative_difficulty(0) + 3 * TEST_FIXED_DIFFICULTY);
+
+  // checking them again finds them known
+  ASSERT_TRUE(bc->check_block_headers(0, headers, ids, checked, cumulative_difficulty));
+  ASSERT_EQ(checked, headers.size());
+}
+
+TEST(block_headers, bad_pow)
+{
+  PREFIX;
+
+  add_header(make_header(ids.back(), genesis.timestamp + 1, true));
+  add_header(make_header(ids.back(), genesis.timestamp + 2, false));
+  ASSERT_FALSE(bc->check_block_headers(0, headers, ids, checked, cumulative_difficulty));
+  ASSERT_EQ(checked, 1);
+
+  crypto::hash pow;
+  ASSERT_FALSE(bc->get_checked_header_pow(make_block(headers[1]), ids[1], pow));
+}
+
+TEST(block_headers, broken_link)
+{
+  PREFIX;
+
+  add_header(make_header(ids.back(), genesis.timestamp + 1, true));
+  add_header(make_header(crypto::rand<crypto::hash>(), genesis.timestamp + 2, true));
+  ASSERT_FALSE(bc->check_block_headers(0, headers, ids, checked, cumulative_difficulty));
+  ASSERT_EQ(checked, 0);
+
+  // nor do headers which do not hash to the announced ids
+  headers.pop_back();
+  ids.pop_back();
+  ids.back() = crypto::rand<crypto::hash>();
+  ASSERT_FALSE(bc->check_block_headers(0, headers, ids, checked, cumulative_difficulty));
+}
+
+TEST(block_headers, future_timestamp)
+{
+  PREFIX;
+
+  add_header(make_header(ids.back(), time(NULL) + CRYPTONOTE_BLOCK_FUTURE_TIME_LIMIT + 3600, true));
+  ASSERT_FALSE(bc->check_block_headers(0, headers, ids, checked, cumulative_difficulty));
+  ASSERT_EQ(checked, 1);
+}
+
+TEST(block_headers, pow_reuse)
+{
+  PREFIX;
+
+  add_header(make_header(ids.back(), genesis.timestamp + 1, true));
+  ASSERT_TRUE(bc->check_block_headers(0, headers, ids, checked, cumulative_difficulty));
+  ASSERT_EQ(checked, 2);
+
+  cn_pow_hash_v3 ctx;
+  const crypto::hash expected = cryptonote::get_block_longhash(headers[1], ctx);
+  cryptonote::block b = make_block(headers[1]);
+  crypto::hash pow;
+  ASSERT_TRUE(bc->get_checked_header_pow(b, ids[1], pow));
+  ASSERT_EQ(pow, expected);
+
+  // the id does not cover the nonce and cycle, which must match too
+  b.nonce = headers[1].nonce + 1;
+  ASSERT_FALSE(bc->get_checked_header_pow(b, ids[1], pow));
+  b = make_block(headers[1]);
+  b.nonce8 = headers[1].nonce8 + 1;
+  ASSERT_FALSE(bc->get_checked_header_pow(b, ids[1], pow));
+  b = make_block(headers[1]);
+  b.cycle.data[0] ^= 1;
+  ASSERT_FALSE(bc->get_checked_header_pow(b, ids[1], pow));
+
+  // unknown ids are never reused
+  ASSERT_FALSE(bc->get_checked_header_pow(make_block(headers[1]), crypto::rand<crypto::hash>(), pow));
+}
@@ -85,3 +85,38 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1());
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, span_size)
+{
+  cryptonote::block_queue bq;
+
+  // unknown peers get the default size
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20), 20);
+  ASSERT_LT(bq.get_expected_span_time(uuid1(), 20), 0.0f);
+
+  // 1 kB blocks at 10 kB/s, so 40 blocks in 4 seconds
+  bq.update_peer_stats(uuid1(), 20, 20000, 2.0f);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20), 40);
+  ASSERT_FLOAT_EQ(bq.get_expected_span_time(uuid1(), 20), 2.0f);
+
+  // a slow peer gets smaller spans, down to a quarter of the default
+  bq.update_peer_stats(uuid2(), 20, 20000, 20.0f);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20), 5);
+
+  // round trip time eats into the target time
+  bq.update_peer_rtt(uuid1(), 0, 2.0f);
+  ASSERT_FLOAT_EQ(bq.get_expected_span_time(uuid1(), 20), 4.0f);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20), 20);
+
+  cryptonote::block_queue::peer_stats stats;
+  bq.add_peer_stall(uuid2());
+  ASSERT_TRUE(bq.get_peer_stats(uuid2(), stats));
+  ASSERT_EQ(stats.nspans, 1);
+  ASSERT_EQ(stats.nblocks, 20);
+  ASSERT_EQ(stats.nstalls, 1);
+
+  // stats go away with the connection
+  bq.flush_stale_spans({uuid1()});
+  ASSERT_TRUE(bq.get_peer_stats(uuid1(), stats));
+  ASSERT_FALSE(bq.get_peer_stats(uuid2(), stats));
+}
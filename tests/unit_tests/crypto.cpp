@@ -31,6 +31,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 
@@ -99,3 +100,30 @@ TEST(Crypto, verify_32)
     }
   }
 }
+
+TEST(Crypto, generate_key_derivations)
+{
+  crypto::public_key tx_key;
+  crypto::secret_key tx_secret_key;
+  crypto::generate_keys(tx_key, tx_secret_key);
+
+  std::vector<crypto::secret_key> view_keys(5);
+  for (crypto::secret_key &view_key: view_keys)
+  {
+    crypto::public_key view_public_key;
+    crypto::generate_keys(view_public_key, view_key);
+  }
+
+  std::vector<crypto::key_derivation> derivations(view_keys.size());
+  ASSERT_TRUE(crypto::generate_key_derivations(tx_key, view_keys.data(), view_keys.size(), derivations.data()));
+  for (size_t i = 0; i < view_keys.size(); ++i)
+  {
+    crypto::key_derivation derivation;
+    ASSERT_TRUE(crypto::generate_key_derivation(tx_key, view_keys[i], derivation));
+    EXPECT_EQ(0, memcmp(&derivation, &derivations[i], sizeof(derivation)));
+  }
+
+  crypto::public_key bad_key;
+  memset(&bad_key, 0xff, sizeof(bad_key));
+  EXPECT_FALSE(crypto::generate_key_derivations(bad_key, view_keys.data(), view_keys.size(), derivations.data()));
+}
@@ -80,6 +80,33 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  // sends a burst of small frames as soon as the connection is up
+  struct burst_protocol_handler : test_protocol_handler
+  {
+    typedef test_connection_context connection_context;
+    typedef test_protocol_handler_config config_type;
+
+    static constexpr const size_t frame_count = 2000;
+
+    burst_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context)
+      : test_protocol_handler(psnd_hndlr, config, conn_context), m_psnd_hndlr(psnd_hndlr)
+    {
+    }
+
+    static std::string frame(size_t i)
+    {
+      return std::string(1 + (i * 37) % 300, char('a' + i % 26));
+    }
+
+    void after_init_connection()
+    {
+      for (size_t i = 0; i < frame_count; ++i)
+        m_psnd_hndlr->do_send(epee::byte_slice{frame(i)});
+    }
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+  };
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -132,3 +159,26 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, gathered_writes_keep_order)
+{
+  epee::net_utils::boosted_tcp_server<burst_protocol_handler> srv(epee::net_utils::e_connection_type_RPC);
+  ASSERT_TRUE(srv.init_server(test_server_port, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  std::string expected;
+  for (size_t i = 0; i < burst_protocol_handler::frame_count; ++i)
+    expected += burst_protocol_handler::frame(i);
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket socket(io_service);
+  socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port));
+  std::string received(expected.size(), 0);
+  boost::system::error_code ec;
+  boost::asio::read(socket, boost::asio::buffer(&received[0], received.size()), ec);
+  ASSERT_FALSE(ec);
+  ASSERT_EQ(expected, received);
+
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+}
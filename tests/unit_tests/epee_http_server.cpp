@@ -0,0 +1,621 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "syncobj.h"
+#include "net/http_client.h"
+#include "net/http_compression.h"
+#include "net/http_protocol_handler.h"
+
+namespace http = epee::net_utils::http;
+
+namespace
+{
+  /*! Serves fixed bodies: /small, /big, /stream (chunked) and /echo (the request
+    body). /deferred is parked until the test answers it through `parked`. */
+  class test_handler : public http::i_http_server_handler<epee::net_utils::connection_context_base>
+  {
+  public:
+    static std::string big_body()
+    {
+      std::string body;
+      for (unsigned i = 0; body.size() < 64 * 1024; ++i)
+        body += "{\"height\":" + std::to_string(i) + ",\"status\":\"OK\",\"untrusted\":false},";
+      return body;
+    }
+
+    bool handle_http_request(const http::http_request_info& query_info, http::http_response_info& response, epee::net_utils::connection_context_base&) override
+    {
+      const std::string& uri = query_info.m_URI;
+      if (uri == "/small")
+        response.m_body = "ok";
+      else if (uri == "/big")
+        response.m_body = big_body();
+      else if (uri == "/echo")
+        response.m_body = query_info.m_body;
+      else if (uri == "/deferred")
+        response.m_deferred = [this](const http::response_sink& done) { parked.push_back(done); };
+      else if (uri == "/stream")
+      {
+        auto pieces = std::make_shared<unsigned>(0);
+        response.m_body_generator = [pieces](std::string& chunk) {
+          if (*pieces < 3)
+            chunk += big_body();
+          ++*pieces;
+          return true;
+        };
+      }
+      else
+      {
+        response.m_response_code = 404;
+        response.m_response_comment = "Not found";
+      }
+      return true;
+    }
+
+    std::vector<http::response_sink> parked;
+  };
+
+  class test_connection : public epee::net_utils::i_service_endpoint
+  {
+  public:
+    explicit test_connection(http::custum_handler_config<epee::net_utils::connection_context_base>& config)
+      : m_io_service(), m_context(), m_handler(this, config, m_context), m_sent(), m_callback_on_sent(false), m_callback(false), m_refs(0)
+    {}
+
+    bool do_send(epee::byte_slice message) override
+    {
+      m_sent.append(reinterpret_cast<const char*>(message.data()), message.size());
+      return true;
+    }
+    bool close() override { return true; }
+    bool send_done() override { return true; }
+    bool call_run_once_service_io() override { return true; }
+    bool request_callback() override
+    {
+      m_callback = true;
+      return true;
+    }
+    bool request_callback_on_sent() override
+    {
+      m_callback_on_sent = true;
+      return true;
+    }
+    boost::asio::io_service& get_io_service() override { return m_io_service; }
+    bool add_ref() override
+    {
+      ++m_refs;
+      return true;
+    }
+    bool release() override
+    {
+      --m_refs;
+      return true;
+    }
+
+    //! \return False when the connection should be closed
+    bool recv(const std::string& data) { return m_handler.handle_recv(data.data(), data.size()); }
+
+    //! Completes the queued writes. \return False if the handler was not waiting on them
+    bool written()
+    {
+      if (!m_callback_on_sent)
+        return false;
+      m_callback_on_sent = false;
+      m_handler.handle_qued_callback();
+      return true;
+    }
+
+    void drain()
+    {
+      while (written());
+    }
+
+    //! Runs a requested callback. \return False if none was requested
+    bool called_back()
+    {
+      if (!m_callback)
+        return false;
+      m_callback = false;
+      m_handler.handle_qued_callback();
+      return true;
+    }
+
+    std::string& sent() noexcept { return m_sent; }
+    int refs() const noexcept { return m_refs; }
+
+  private:
+    boost::asio::io_service m_io_service;
+    epee::net_utils::connection_context_base m_context;
+    http::http_custom_handler<epee::net_utils::connection_context_base> m_handler;
+    std::string m_sent;
+    bool m_callback_on_sent;
+    bool m_callback;
+    int m_refs;
+  };
+
+  struct response
+  {
+    int code;
+    std::map<std::string, std::string> fields; //!< Names in lower case
+    std::string body;                           //!< Dechunked
+  };
+
+  std::string field(const response& r, const std::string& name)
+  {
+    const auto it = r.fields.find(name);
+    return it == r.fields.end() ? std::string{} : it->second;
+  }
+
+  bool parse_responses(std::string wire, std::vector<response>& out)
+  {
+    while (!wire.empty())
+    {
+      const std::size_t end = wire.find("\r\n\r\n");
+      if (end == std::string::npos || wire.compare(0, 9, "HTTP/1.1 ") != 0)
+        return false;
+      response r{std::stoi(wire.substr(9, 3)), {}, {}};
+      std::size_t line = wire.find("\r\n") + 2;
+      while (line < end + 2)
+      {
+        const std::size_t eol = wire.find("\r\n", line);
+        const std::size_t colon = wire.find(": ", line);
+        if (colon == std::string::npos || colon > eol)
+          return false;
+        r.fields[boost::algorithm::to_lower_copy(wire.substr(line, colon - line))] = wire.substr(colon + 2, eol - colon - 2);
+        line = eol + 2;
+      }
+      wire.erase(0, end + 4);
+
+      if (field(r, "transfer-encoding") == "chunked")
+      {
+        for (;;)
+        {
+          const std::size_t eol = wire.find("\r\n");
+          if (eol == std::string::npos)
+            return false;
+          const std::size_t size = std::stoul(wire.substr(0, eol), nullptr, 16);
+          if (wire.size() < eol + 2 + size + 2)
+            return false;
+          r.body.append(wire, eol + 2, size);
+          wire.erase(0, eol + 2 + size + 2);
+          if (size == 0)
+            break;
+        }
+      }
+      else
+      {
+        const std::size_t size = std::stoul(field(r, "content-length"));
+        if (wire.size() < size)
+          return false;
+        r.body = wire.substr(0, size);
+        wire.erase(0, size);
+      }
+      out.push_back(std::move(r));
+    }
+    return true;
+  }
+
+  bool decompress(const http::content_coding coding, const std::string& in, std::string& out)
+  {
+    switch (coding)
+    {
+#ifdef HAVE_ZLIB
+      case http::content_coding::gzip:
+      {
+        z_stream stream{};
+        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+          return false;
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        stream.avail_in = in.size();
+        int status = Z_OK;
+        while (status == Z_OK)
+        {
+          char buffer[4096];
+          stream.next_out = reinterpret_cast<Bytef*>(buffer);
+          stream.avail_out = sizeof(buffer);
+          status = inflate(&stream, Z_NO_FLUSH);
+          out.append(buffer, sizeof(buffer) - stream.avail_out);
+        }
+        inflateEnd(&stream);
+        return status == Z_STREAM_END && stream.avail_in == 0;
+      }
+#endif
+#ifdef HAVE_ZSTD
+      case http::content_coding::zstd:
+      {
+        ZSTD_DCtx* const ctx = ZSTD_createDCtx();
+        ZSTD_inBuffer input{in.data(), in.size(), 0};
+        std::size_t status = 1;
+        for (bool full = true; (full || input.pos < input.size) && !ZSTD_isError(status);)
+        {
+          char buffer[4096];
+          ZSTD_outBuffer output{buffer, sizeof(buffer), 0};
+          status = ZSTD_decompressStream(ctx, &output, &input);
+          out.append(buffer, output.pos);
+          full = output.pos == output.size;
+        }
+        ZSTD_freeDCtx(ctx);
+        return status == 0;
+      }
+#endif
+      default:
+        return false;
+    }
+  }
+
+  class http_server : public ::testing::Test
+  {
+  public:
+    http_server()
+      : m_handler(), m_config()
+    {
+      m_config.m_phandler = &m_handler;
+      m_config.m_compress = true;
+    }
+
+  protected:
+    test_handler m_handler;
+    http::custum_handler_config<epee::net_utils::connection_context_base> m_config;
+  };
+
+  std::vector<http::content_coding> supported_codings()
+  {
+    std::vector<http::content_coding> codings;
+    for (const http::content_coding coding : {http::content_coding::gzip, http::content_coding::zstd})
+      if (http::is_supported(coding))
+        codings.push_back(coding);
+    return codings;
+  }
+}
+
+TEST(http_compression, negotiate)
+{
+  const bool gzip = http::is_supported(http::content_coding::gzip);
+  const bool zstd = http::is_supported(http::content_coding::zstd);
+  const http::content_coding identity = http::content_coding::identity;
+  const http::content_coding gzip_or_identity = gzip ? http::content_coding::gzip : identity;
+  const http::content_coding zstd_or_identity = zstd ? http::content_coding::zstd : identity;
+
+  EXPECT_EQ(identity, http::negotiate_content_coding(""));
+  EXPECT_EQ(identity, http::negotiate_content_coding("identity"));
+  EXPECT_EQ(identity, http::negotiate_content_coding("br, deflate"));
+  EXPECT_EQ(gzip_or_identity, http::negotiate_content_coding("gzip"));
+  EXPECT_EQ(gzip_or_identity, http::negotiate_content_coding(" GZIP ; q=1.0 "));
+  EXPECT_EQ(gzip_or_identity, http::negotiate_content_coding("x-gzip"));
+  EXPECT_EQ(identity, http::negotiate_content_coding("gzip;q=0"));
+  EXPECT_EQ(identity, http::negotiate_content_coding("gzip;q=0.000, zstd;q=0"));
+  EXPECT_EQ(identity, http::negotiate_content_coding("gzip;q=2"));
+  EXPECT_EQ(zstd_or_identity, http::negotiate_content_coding("zstd"));
+  EXPECT_EQ(zstd ? http::content_coding::zstd : gzip_or_identity, http::negotiate_content_coding("gzip, zstd"));
+  EXPECT_EQ(zstd ? http::content_coding::zstd : gzip_or_identity, http::negotiate_content_coding("*"));
+  EXPECT_EQ(gzip ? http::content_coding::gzip : zstd_or_identity, http::negotiate_content_coding("gzip;q=0.5, zstd;q=0.25"));
+  EXPECT_EQ(gzip ? http::content_coding::gzip : zstd_or_identity, http::negotiate_content_coding("zstd;q=0.1;foo=bar, *;q=0.2"));
+  EXPECT_EQ(zstd_or_identity, http::negotiate_content_coding("gzip;q=0, *"));
+}
+
+TEST(http_compression, streamed_round_trip)
+{
+  const std::string piece = test_handler::big_body();
+  for (const http::content_coding coding : supported_codings())
+  {
+    http::body_compressor compressor{coding};
+    std::string compressed;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+      const std::size_t before = compressed.size();
+      ASSERT_TRUE(compressor.compress(piece, compressed, false));
+      EXPECT_LT(before, compressed.size()); // flushed, so each piece can be sent on its own
+
+      // everything so far decodes, short of the end of the stream
+      std::string partial;
+      decompress(coding, compressed, partial);
+      EXPECT_EQ(piece.size() * (i + 1), partial.size());
+    }
+    ASSERT_TRUE(compressor.compress({}, compressed, true));
+    EXPECT_LT(compressed.size(), piece.size());
+
+    std::string plain;
+    ASSERT_TRUE(decompress(coding, compressed, plain));
+    EXPECT_EQ(piece + piece + piece, plain);
+  }
+}
+
+TEST_F(http_server, pipelined_requests)
+{
+  test_connection connection{m_config};
+  const std::string requests =
+    "POST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nfirst"
+    "GET /small HTTP/1.1\r\n\r\n"
+    "POST /echo HTTP/1.1\r\nContent-Length: 6\r\n\r\nsecond"
+    "POST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nthird";
+
+  // all at once, then split at every byte
+  for (std::size_t split = 0; split <= requests.size(); ++split)
+  {
+    connection.sent().clear();
+    if (split)
+      ASSERT_TRUE(connection.recv(requests.substr(0, split)));
+    if (split < requests.size())
+      ASSERT_TRUE(connection.recv(requests.substr(split)));
+
+    std::vector<response> responses;
+    ASSERT_TRUE(parse_responses(connection.sent(), responses));
+    ASSERT_EQ(4, responses.size()) << "split at " << split;
+    EXPECT_EQ("first", responses[0].body);
+    EXPECT_EQ("ok", responses[1].body);
+    EXPECT_EQ("second", responses[2].body);
+    EXPECT_EQ("third", responses[3].body);
+  }
+}
+
+TEST_F(http_server, close_stops_pipeline)
+{
+  test_connection connection{m_config};
+  EXPECT_FALSE(connection.recv(
+    "GET /small HTTP/1.1\r\nConnection: close\r\n\r\n"
+    "GET /small HTTP/1.1\r\n\r\n"
+  ));
+  std::vector<response> responses;
+  ASSERT_TRUE(parse_responses(connection.sent(), responses));
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ("close", field(responses[0], "connection"));
+}
+
+TEST_F(http_server, stream_per_write)
+{
+  test_connection connection{m_config};
+  ASSERT_TRUE(connection.recv("GET /stream HTTP/1.1\r\n\r\nGET /small HTTP/1.1\r\n\r\n"));
+
+  // one chunk per completed write, and the pipelined request waits for the last one
+  const std::string piece = test_handler::big_body();
+  for (unsigned i = 0; i < 3; ++i)
+  {
+    EXPECT_EQ(std::string::npos, connection.sent().find("\r\nok"));
+    const std::size_t before = connection.sent().size();
+    ASSERT_TRUE(connection.written());
+    EXPECT_LT(before, connection.sent().size());
+  }
+  EXPECT_FALSE(connection.written());
+
+  std::vector<response> responses;
+  ASSERT_TRUE(parse_responses(connection.sent(), responses));
+  ASSERT_EQ(2, responses.size());
+  EXPECT_EQ("chunked", field(responses[0], "transfer-encoding"));
+  EXPECT_EQ(piece + piece + piece, responses[0].body);
+  EXPECT_EQ("ok", responses[1].body);
+}
+
+TEST_F(http_server, deferred_response)
+{
+  test_connection connection{m_config};
+  ASSERT_TRUE(connection.recv("GET /deferred HTTP/1.1\r\n\r\nGET /small HTTP/1.1\r\n\r\n"));
+
+  // nothing is sent, not even for the pipelined request, and the connection is kept
+  ASSERT_EQ(1, m_handler.parked.size());
+  EXPECT_TRUE(connection.sent().empty());
+  EXPECT_EQ(1, connection.refs());
+  EXPECT_FALSE(connection.called_back());
+
+  http::http_response_info later{};
+  later.m_response_code = 200;
+  later.m_response_comment = "OK";
+  later.m_body = "later";
+  m_handler.parked[0](std::move(later));
+  m_handler.parked[0](http::http_response_info{}); // only the first counts
+  EXPECT_EQ(0, connection.refs());
+  EXPECT_TRUE(connection.sent().empty()); // sent from the connection's callback only
+
+  ASSERT_TRUE(connection.called_back());
+  EXPECT_FALSE(connection.called_back());
+  std::vector<response> responses;
+  ASSERT_TRUE(parse_responses(connection.sent(), responses));
+  ASSERT_EQ(2, responses.size());
+  EXPECT_EQ(200, responses[0].code);
+  EXPECT_EQ("later", responses[0].body);
+  EXPECT_EQ("ok", responses[1].body);
+}
+
+TEST_F(http_server, http10_keep_alive)
+{
+  {
+    test_connection connection{m_config};
+    EXPECT_FALSE(connection.recv("GET /small HTTP/1.0\r\n\r\n"));
+    std::vector<response> responses;
+    ASSERT_TRUE(parse_responses(connection.sent(), responses));
+    ASSERT_EQ(1, responses.size());
+    EXPECT_EQ("close", field(responses[0], "connection"));
+  }
+  {
+    test_connection connection{m_config};
+    EXPECT_TRUE(connection.recv("GET /small HTTP/1.0\r\nConnection: keep-alive\r\n\r\nGET /small HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"));
+    std::vector<response> responses;
+    ASSERT_TRUE(parse_responses(connection.sent(), responses));
+    ASSERT_EQ(2, responses.size());
+    EXPECT_EQ("keep-alive", field(responses[1], "connection"));
+  }
+}
+
+TEST_F(http_server, compressed_body)
+{
+  for (const http::content_coding coding : supported_codings())
+  {
+    test_connection connection{m_config};
+    const std::string accept = std::string{"Accept-Encoding: "} + http::get_name(coding) + "\r\n";
+    ASSERT_TRUE(connection.recv("GET /big HTTP/1.1\r\n" + accept + "\r\nGET /small HTTP/1.1\r\n" + accept + "\r\nGET /big HTTP/1.1\r\n\r\n"));
+
+    std::vector<response> responses;
+    ASSERT_TRUE(parse_responses(connection.sent(), responses));
+    ASSERT_EQ(3, responses.size());
+
+    EXPECT_EQ(http::get_name(coding), field(responses[0], "content-encoding"));
+    EXPECT_EQ("Accept-Encoding", field(responses[0], "vary"));
+    EXPECT_LT(responses[0].body.size(), test_handler::big_body().size() / 4);
+    std::string plain;
+    ASSERT_TRUE(decompress(coding, responses[0].body, plain));
+    EXPECT_EQ(test_handler::big_body(), plain);
+
+    // too small to bother
+    EXPECT_EQ("", field(responses[1], "content-encoding"));
+    EXPECT_EQ("ok", responses[1].body);
+
+    // not asked for
+    EXPECT_EQ("", field(responses[2], "content-encoding"));
+    EXPECT_EQ(test_handler::big_body(), responses[2].body);
+  }
+}
+
+TEST_F(http_server, compressed_stream)
+{
+  for (const http::content_coding coding : supported_codings())
+  {
+    test_connection connection{m_config};
+    const std::string accept = std::string{"Accept-Encoding: "} + http::get_name(coding) + "\r\n";
+    ASSERT_TRUE(connection.recv("GET /stream HTTP/1.1\r\n" + accept + "\r\nGET /small HTTP/1.1\r\n\r\n"));
+    connection.drain();
+
+    std::vector<response> responses;
+    ASSERT_TRUE(parse_responses(connection.sent(), responses));
+    ASSERT_EQ(2, responses.size());
+    EXPECT_EQ("chunked", field(responses[0], "transfer-encoding"));
+    EXPECT_EQ(http::get_name(coding), field(responses[0], "content-encoding"));
+    std::string plain;
+    ASSERT_TRUE(decompress(coding, responses[0].body, plain));
+    const std::string piece = test_handler::big_body();
+    EXPECT_EQ(piece + piece + piece, plain);
+    EXPECT_EQ("ok", responses[1].body);
+  }
+}
+
+TEST_F(http_server, compression_disabled)
+{
+  m_config.m_compress = false;
+  test_connection connection{m_config};
+  ASSERT_TRUE(connection.recv("GET /big HTTP/1.1\r\nAccept-Encoding: gzip, zstd\r\n\r\n"));
+  std::vector<response> responses;
+  ASSERT_TRUE(parse_responses(connection.sent(), responses));
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ("", field(responses[0], "content-encoding"));
+  EXPECT_EQ("", field(responses[0], "vary"));
+  EXPECT_EQ(test_handler::big_body(), responses[0].body);
+}
+
+#ifdef HAVE_ZLIB
+namespace
+{
+  //! What the client sent, and what it gets back
+  struct canned_exchange
+  {
+    std::string sent;
+    std::string reply;
+  } canned;
+
+  //! Stands for the connection of an http client, answering with `canned.reply`
+  class canned_client
+  {
+  public:
+    bool connect(const std::string&, const std::string&, std::chrono::milliseconds) { return true; }
+    bool disconnect() { return true; }
+    bool send(const std::string& buff, std::chrono::milliseconds) { canned.sent += buff; return true; }
+    bool is_connected(bool* ssl = nullptr) { return true; }
+    bool recv(std::string& buff, std::chrono::milliseconds)
+    {
+      buff = std::move(canned.reply);
+      canned.reply.clear();
+      return true;
+    }
+    void set_ssl(epee::net_utils::ssl_options_t) {}
+    uint64_t get_bytes_sent() const { return canned.sent.size(); }
+    uint64_t get_bytes_received() const { return 0; }
+  };
+}
+
+TEST(http_client, gzip_response)
+{
+  const std::string body = test_handler::big_body();
+
+  // whole body, as buffered responses are sent
+  {
+    canned = canned_exchange{};
+    epee::net_utils::http::http_simple_client_template<canned_client> client;
+    std::string compressed;
+    ASSERT_TRUE(http::body_compressor::compress(http::content_coding::gzip, body, compressed));
+    canned.reply = "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\nContent-Length: " + std::to_string(compressed.size()) + "\r\n\r\n" + compressed;
+    const http::http_response_info* info = nullptr;
+    ASSERT_TRUE(client.invoke_post("/json_rpc", "{}", std::chrono::seconds(1), &info));
+    ASSERT_NE(nullptr, info);
+    EXPECT_TRUE(boost::algorithm::icontains(canned.sent, "\r\nAccept-Encoding: gzip\r\n"));
+    EXPECT_EQ(body, info->m_body);
+  }
+
+  // flushed chunk by chunk, as streamed responses are sent
+  {
+    canned = canned_exchange{};
+    epee::net_utils::http::http_simple_client_template<canned_client> client;
+    http::body_compressor compressor{http::content_coding::gzip};
+    std::string reply = "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n";
+    for (unsigned i = 0; i < 3; ++i)
+    {
+      std::string chunk;
+      ASSERT_TRUE(compressor.compress(body, chunk, i == 2));
+      std::stringstream size;
+      size << std::hex << chunk.size();
+      reply += size.str() + "\r\n" + chunk + "\r\n";
+    }
+    canned.reply = reply + "0\r\n\r\n";
+    const http::http_response_info* info = nullptr;
+    ASSERT_TRUE(client.invoke_get("/get_blocks.bin", std::chrono::seconds(1), std::string(), &info));
+    ASSERT_NE(nullptr, info);
+    EXPECT_EQ(body + body + body, info->m_body);
+  }
+
+  // a caller's own Accept-Encoding is sent instead
+  {
+    canned = canned_exchange{};
+    epee::net_utils::http::http_simple_client_template<canned_client> client;
+    canned.reply = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    ASSERT_TRUE(client.invoke_get("/", std::chrono::seconds(1), std::string(), nullptr, {{"Accept-Encoding", "identity"}}));
+    EXPECT_FALSE(boost::algorithm::icontains(canned.sent, "gzip"));
+    EXPECT_TRUE(boost::algorithm::icontains(canned.sent, "\r\nAccept-Encoding: identity\r\n"));
+  }
+}
+#endif
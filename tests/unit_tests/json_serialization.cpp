@@ -2,6 +2,8 @@
 #include <boost/optional/optional.hpp>
 #include <boost/range/adaptor/indexed.hpp>
 #include <gtest/gtest.h>
+#include <limits>
+#include <list>
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 #include <vector>
@@ -12,7 +14,12 @@
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
+#include "net/jsonrpc_structs.h"
 #include "serialization/json_object.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/json_storage_reader.h"
+#include "storages/json_storage_writer.h"
+#include "storages/portable_storage_template_helper.h"
 
 
 namespace test
@@ -240,3 +247,125 @@ TEST(JsonSerialization, BulletproofTransaction)
     EXPECT_EQ(tx_bytes, tx_copy_bytes);
 }
 
+
+namespace
+{
+    struct kv_inner
+    {
+        std::uint64_t a;
+        std::string s;
+        std::vector<std::uint32_t> v;
+
+        BEGIN_KV_SERIALIZE_MAP()
+            KV_SERIALIZE(a)
+            KV_SERIALIZE(s)
+            KV_SERIALIZE(v)
+        END_KV_SERIALIZE_MAP()
+    };
+
+    struct kv_outer
+    {
+        std::int64_t n;
+        double d;
+        bool b;
+        kv_inner in;
+        std::list<kv_inner> ins;
+        std::vector<std::string> strs;
+        std::uint8_t small;
+
+        BEGIN_KV_SERIALIZE_MAP()
+            KV_SERIALIZE(n)
+            KV_SERIALIZE(d)
+            KV_SERIALIZE(b)
+            KV_SERIALIZE(in)
+            KV_SERIALIZE(ins)
+            KV_SERIALIZE(strs)
+            KV_SERIALIZE_OPT(small, (std::uint8_t)7)
+        END_KV_SERIALIZE_MAP()
+    };
+
+    kv_outer make_kv_outer()
+    {
+        kv_outer o{};
+        o.n = -5;
+        o.d = 1.5;
+        o.b = true;
+        o.in.a = std::numeric_limits<std::uint64_t>::max();
+        o.in.s = std::string("q\"\\\n\x01\xff/", 7);
+        o.in.v = {1, 2, 3};
+        o.ins.resize(2);
+        o.ins.front().a = 2;
+        o.ins.back().a = 3;
+        o.ins.back().v = {9};
+        o.strs = {"x", "y"};
+        o.small = 7;
+        return o;
+    }
+
+    void expect_kv_equal(const kv_outer& a, const kv_outer& b)
+    {
+        EXPECT_EQ(a.n, b.n);
+        EXPECT_EQ(a.d, b.d);
+        EXPECT_EQ(a.b, b.b);
+        EXPECT_EQ(a.in.a, b.in.a);
+        EXPECT_EQ(a.in.s, b.in.s);
+        EXPECT_EQ(a.in.v, b.in.v);
+        ASSERT_EQ(a.ins.size(), b.ins.size());
+        EXPECT_EQ(a.ins.front().a, b.ins.front().a);
+        EXPECT_EQ(a.ins.back().a, b.ins.back().a);
+        EXPECT_EQ(a.ins.back().v, b.ins.back().v);
+        EXPECT_EQ(a.strs, b.strs);
+        EXPECT_EQ(a.small, b.small);
+    }
+} // anonymous
+
+TEST(JsonSerialization, KvStorageMatchesPortableStorage)
+{
+    const kv_outer o = make_kv_outer();
+    std::string direct;
+    ASSERT_TRUE(epee::serialization::store_t_to_json_direct(o, direct));
+    const std::string dom = epee::serialization::store_t_to_json(o);
+
+    kv_outer a{}, b{}, c{};
+    ASSERT_TRUE(epee::serialization::load_t_from_json_direct(a, direct));
+    expect_kv_equal(o, a);
+    ASSERT_TRUE(epee::serialization::load_t_from_json(b, direct));
+    expect_kv_equal(o, b);
+    ASSERT_TRUE(epee::serialization::load_t_from_json_direct(c, dom));
+    expect_kv_equal(o, c);
+}
+
+TEST(JsonSerialization, KvStorageJsonRpc)
+{
+    const std::string body =
+        "{\"jsonrpc\":\"2.0\",\"id\":{\"x\":[1,2]},\"method\":\"get\","
+        "\"params\":{\"n\":-12,\"in\":{\"a\":\"4\",\"v\":[]},\"d\":null}}";
+    epee::serialization::json_storage_reader reader;
+    ASSERT_TRUE(reader.load_from_json(body));
+    epee::json_rpc::request<kv_outer> req{};
+    ASSERT_TRUE(req.load(reader));
+    EXPECT_EQ("get", req.method);
+    EXPECT_EQ(-12, req.params.n);
+    EXPECT_EQ(4u, req.params.in.a);
+    EXPECT_EQ(7u, req.params.small);
+
+    epee::json_rpc::response<kv_inner, epee::json_rpc::dummy_error> resp{};
+    resp.jsonrpc = "2.0";
+    resp.id = req.id;
+    resp.result.a = 1;
+    std::string out;
+    ASSERT_TRUE(epee::serialization::store_t_to_json_direct(resp, out));
+    EXPECT_EQ("{\"jsonrpc\":\"2.0\",\"id\":{\"x\":[1,2]},\"result\":{\"a\":1,\"s\":\"\"}}", out);
+}
+
+TEST(JsonSerialization, KvStorageInvalid)
+{
+    epee::serialization::json_storage_reader reader;
+    EXPECT_FALSE(reader.load_from_json("[1]"));
+    EXPECT_FALSE(reader.load_from_json("{\"a\":"));
+
+    kv_outer o{};
+    EXPECT_FALSE(epee::serialization::load_t_from_json_direct(o, "{\"n\":\"x\"}"));
+    EXPECT_FALSE(epee::serialization::load_t_from_json_direct(o, "{\"strs\":[\"a\",1]}"));
+    EXPECT_FALSE(epee::serialization::load_t_from_json_direct(o, "{\"small\":300}"));
+}
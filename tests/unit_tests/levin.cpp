@@ -146,6 +146,11 @@ namespace
         {
             return context_.m_connection_id;
         }
+
+        cryptonote::levin::detail::p2p_context& get_context() noexcept
+        {
+            return context_;
+        }
     };
 
     struct received_message
@@ -271,12 +276,12 @@ namespace
             EXPECT_EQ(connection_ids_.size(), connections_->get_connections_count());
         }
 
-        cryptonote::levin::notify make_notifier(const std::size_t noise_size, bool is_public, bool pad_txs)
+        cryptonote::levin::notify make_notifier(const std::size_t noise_size, bool is_public, bool pad_txs, bool reconcile_txs = false)
         {
             epee::byte_slice noise = nullptr;
             if (noise_size)
                 noise = epee::levin::make_noise_notify(noise_size);
-            return cryptonote::levin::notify{io_service_, connections_, std::move(noise), is_public, pad_txs};
+            return cryptonote::levin::notify{io_service_, connections_, std::move(noise), is_public, pad_txs, reconcile_txs};
         }
 
         boost::uuids::random_generator random_generator_;
@@ -729,3 +734,104 @@ TEST_F(levin_notify, noise)
         }
     }
 }
+
+TEST_F(levin_notify, reconcile)
+{
+    cryptonote::levin::notify notifier = make_notifier(0, true, false, true);
+
+    for (unsigned count = 0; count < 6; ++count)
+    {
+        add_connection(count % 2 == 0);
+        cryptonote::levin::detail::p2p_context& context = contexts_.back().get_context();
+        context.m_state = cryptonote::cryptonote_connection_context::state_normal;
+        context.support_flags = P2P_SUPPORT_FLAG_TX_RECONCILIATION;
+    }
+
+    std::vector<cryptonote::blobdata> txs(2);
+    txs[0].resize(100, 'f');
+    txs[1].resize(200, 'e');
+    std::sort(txs.begin(), txs.end());
+
+    // a few outgoing peers are flooded, the others get the txs queued for the next round
+    ASSERT_EQ(6u, contexts_.size());
+    EXPECT_TRUE(notifier.send_txs(txs, contexts_.front().get_id()));
+    io_service_.reset();
+    ASSERT_LT(0u, io_service_.poll());
+    notifier.run_fluff();
+    ASSERT_LT(0u, io_service_.poll());
+
+    std::set<boost::uuids::uuid> queued_out{};
+    std::size_t flooded = 0;
+    std::size_t queued = 0;
+    for (auto context = contexts_.begin(); context != contexts_.end(); ++context)
+    {
+        const std::size_t sent = context->process_send_queue();
+        const std::size_t pending = context->get_context().m_tx_reconciliation->size();
+        if (context == contexts_.begin())
+        {
+            EXPECT_EQ(0u, sent);
+            EXPECT_EQ(0u, pending);
+        }
+        else if (sent)
+        {
+            EXPECT_EQ(1u, sent);
+            EXPECT_EQ(0u, pending);
+            EXPECT_FALSE(context->get_context().m_is_income);
+            ++flooded;
+        }
+        else
+        {
+            EXPECT_EQ(2u, pending);
+            if (!context->get_context().m_is_income)
+                queued_out.insert(context->get_id());
+            ++queued;
+        }
+    }
+    EXPECT_EQ(CRYPTONOTE_TX_RECONCILIATION_FLOOD_PEERS, flooded);
+    EXPECT_EQ(5u - CRYPTONOTE_TX_RECONCILIATION_FLOOD_PEERS, queued);
+    ASSERT_EQ(1u, queued_out.size());
+
+    ASSERT_EQ(flooded, receiver_.notified_size());
+    for (std::size_t count = 0; count < flooded; ++count)
+    {
+        auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>().second;
+        EXPECT_EQ(txs, notification.txs);
+    }
+
+    // every outgoing peer is asked for a sketch, then the queue goes to the peer lacking it
+    notifier.run_reconciliation();
+    io_service_.reset();
+    ASSERT_LT(0u, io_service_.poll());
+
+    for (auto& context : contexts_)
+        EXPECT_EQ(context.get_context().m_is_income ? 0u : 1u, context.process_send_queue());
+
+    ASSERT_EQ(3u, receiver_.notified_size());
+    for (unsigned count = 0; count < 3; ++count)
+    {
+        const auto request = receiver_.get_notification<cryptonote::NOTIFY_REQUEST_TX_SKETCH>();
+        auto context = std::find_if(contexts_.begin(), contexts_.end(), [&request] (test_connection& c) { return c.get_id() == request.first; });
+        ASSERT_TRUE(context != contexts_.end());
+        EXPECT_FALSE(context->get_context().m_is_income);
+        if (!queued_out.count(request.first))
+        {
+            EXPECT_EQ(0u, request.second.set_size);
+            continue;
+        }
+        EXPECT_EQ(2u, request.second.set_size);
+        EXPECT_EQ(0u, context->get_context().m_tx_reconciliation->size());
+
+        cryptonote::tx_reconciliation peer{};
+        ASSERT_TRUE(peer.add({txs[0]}));
+        std::string sketch;
+        ASSERT_TRUE(peer.make_sketch(request.second.salt, request.second.set_size, sketch));
+
+        std::vector<cryptonote::blobdata> send;
+        std::vector<std::uint32_t> missing;
+        bool success = false;
+        ASSERT_TRUE(context->get_context().m_tx_reconciliation->finish_round(sketch, send, missing, success));
+        EXPECT_TRUE(success);
+        EXPECT_EQ(std::vector<cryptonote::blobdata>{txs[1]}, send);
+        EXPECT_TRUE(missing.empty());
+    }
+}
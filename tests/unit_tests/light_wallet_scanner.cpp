@@ -0,0 +1,360 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_config.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+#include "ringct/rctOps.h"
+#include "rpc/light_wallet_scanner.h"
+
+using cryptonote::light_wallet_scanner;
+
+namespace
+{
+  constexpr uint64_t start_height = 100;
+
+  std::string address(const cryptonote::account_public_address &addr, bool subaddress = false)
+  {
+    return cryptonote::get_account_address_as_str(cryptonote::MAINNET, subaddress, addr);
+  }
+
+  //! RingCT payment to `to`, without the proofs the scanner does not look at
+  cryptonote::transaction make_payment(const cryptonote::account_public_address &to, bool subaddress, uint64_t amount)
+  {
+    cryptonote::transaction tx;
+    tx.version = 2;
+
+    crypto::public_key tx_pub_key;
+    crypto::secret_key tx_key;
+    crypto::generate_keys(tx_pub_key, tx_key);
+    if (subaddress)
+      tx_pub_key = rct::rct2pk(rct::scalarmultKey(rct::pk2rct(to.m_spend_public_key), rct::sk2rct(tx_key)));
+    cryptonote::add_tx_pub_key_to_extra(tx, tx_pub_key);
+
+    crypto::key_derivation derivation;
+    crypto::public_key key;
+    EXPECT_TRUE(crypto::generate_key_derivation(to.m_view_public_key, tx_key, derivation));
+    EXPECT_TRUE(crypto::derive_public_key(derivation, 0, to.m_spend_public_key, key));
+    tx.vout.push_back({0, cryptonote::txout_to_key(key)});
+
+    crypto::secret_key scalar;
+    crypto::derivation_to_scalar(derivation, 0, scalar);
+    rct::ecdhTuple ecdh{rct::genCommitmentMask(rct::sk2rct(scalar)), rct::d2h(amount)};
+    tx.rct_signatures.type = rct::RCTTypeBulletproof2;
+    tx.rct_signatures.outPk.push_back({rct::pk2rct(key), rct::commit(amount, ecdh.mask)});
+    rct::ecdhEncode(ecdh, rct::sk2rct(scalar), true);
+    tx.rct_signatures.ecdhInfo.push_back(ecdh);
+    return tx;
+  }
+
+  //! Transaction whose only input has `global_index` in its ring
+  cryptonote::transaction make_spend(uint64_t global_index, crypto::key_image &key_image)
+  {
+    cryptonote::transaction tx;
+    tx.version = 2;
+    key_image = crypto::rand<crypto::key_image>();
+    cryptonote::txin_to_key in;
+    in.amount = 0;
+    in.key_offsets = {global_index - 1, 1};
+    in.k_image = key_image;
+    tx.vin.push_back(in);
+    return tx;
+  }
+
+  //! Block with `txes`, the first standing for the miner transaction
+  light_wallet_scanner::block_data make_block(uint64_t height, std::vector<cryptonote::transaction> txes, uint64_t &next_global_index)
+  {
+    light_wallet_scanner::block_data block;
+    block.height = height;
+    block.id = crypto::rand<crypto::hash>();
+    block.timestamp = 1600000000 + height;
+    for (const cryptonote::transaction &tx: txes)
+    {
+      block.tx_hashes.push_back(crypto::rand<crypto::hash>());
+      block.output_indices.emplace_back();
+      for (size_t i = 0; i < tx.vout.size(); ++i)
+        block.output_indices.back().push_back(next_global_index++);
+    }
+    block.txes = std::move(txes);
+    return block;
+  }
+
+  struct light_wallet : public testing::Test
+  {
+    light_wallet()
+      : scanner(cryptonote::MAINNET), next_global_index(1000)
+    {
+      alice.generate();
+      bob.generate();
+      alice_sub = hw::get_device("default").get_subaddress(alice.get_keys(), {0, 1});
+    }
+
+    std::vector<light_wallet_scanner::output> outputs(const std::string &addr, const cryptonote::account_base &owner)
+    {
+      std::vector<light_wallet_scanner::output> out;
+      EXPECT_EQ(light_wallet_scanner::status::ok, scanner.with_account(addr, owner.get_keys().m_view_secret_key, [&](const light_wallet_scanner::account &account) {
+        out = account.outputs;
+      }));
+      return out;
+    }
+
+    light_wallet_scanner scanner;
+    cryptonote::account_base alice;
+    cryptonote::account_base bob;
+    cryptonote::account_public_address alice_sub;
+    uint64_t next_global_index;
+  };
+}
+
+TEST_F(light_wallet, login)
+{
+  const std::string addr = address(alice.get_keys().m_account_address);
+  const crypto::secret_key &view_key = alice.get_keys().m_view_secret_key;
+
+  EXPECT_EQ(light_wallet_scanner::status::bad_address, scanner.login("foo", view_key, true, start_height));
+  EXPECT_EQ(light_wallet_scanner::status::bad_view_key, scanner.login(addr, bob.get_keys().m_view_secret_key, true, start_height));
+  EXPECT_EQ(light_wallet_scanner::status::unknown_account, scanner.login(addr, view_key, false, start_height));
+  EXPECT_EQ(light_wallet_scanner::status::created, scanner.login(addr, view_key, true, start_height));
+  EXPECT_EQ(light_wallet_scanner::status::ok, scanner.login(addr, view_key, true, start_height + 10));
+  EXPECT_EQ(light_wallet_scanner::status::created, scanner.login(address(alice_sub, true), view_key, true, start_height));
+  EXPECT_EQ(light_wallet_scanner::status::bad_view_key, scanner.login(address(alice_sub, true), bob.get_keys().m_view_secret_key, true, start_height));
+
+  EXPECT_EQ(2u, scanner.get_account_count());
+  EXPECT_EQ(start_height, scanner.get_scan_height());
+}
+
+TEST_F(light_wallet, finds_outputs)
+{
+  const crypto::secret_key &view_key = alice.get_keys().m_view_secret_key;
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(address(alice.get_keys().m_account_address), view_key, true, start_height));
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(address(alice_sub, true), view_key, true, start_height));
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(address(bob.get_keys().m_account_address), bob.get_keys().m_view_secret_key, true, start_height + 1));
+
+  cryptonote::account_base carol;
+  carol.generate();
+  scanner.scan_block(make_block(start_height, {
+    make_payment(carol.get_keys().m_account_address, false, 1),
+    make_payment(alice.get_keys().m_account_address, false, 20),
+    make_payment(alice_sub, true, 300),
+    make_payment(bob.get_keys().m_account_address, false, 4000)
+  }, next_global_index));
+
+  const auto main_outputs = outputs(address(alice.get_keys().m_account_address), alice);
+  ASSERT_EQ(1u, main_outputs.size());
+  EXPECT_EQ(20u, main_outputs[0].amount);
+  EXPECT_EQ(1001u, main_outputs[0].global_index);
+  EXPECT_EQ(start_height, main_outputs[0].height);
+  EXPECT_EQ(192u, main_outputs[0].rct.size());
+  EXPECT_FALSE(main_outputs[0].coinbase);
+
+  const auto sub_outputs = outputs(address(alice_sub, true), alice);
+  ASSERT_EQ(1u, sub_outputs.size());
+  EXPECT_EQ(300u, sub_outputs[0].amount);
+  EXPECT_EQ(1002u, sub_outputs[0].global_index);
+
+  // bob starts at the next block
+  EXPECT_TRUE(outputs(address(bob.get_keys().m_account_address), bob).empty());
+  EXPECT_EQ(start_height + 1, scanner.get_scan_height());
+}
+
+TEST_F(light_wallet, rejects_bad_commitment)
+{
+  const crypto::secret_key &view_key = alice.get_keys().m_view_secret_key;
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(address(alice.get_keys().m_account_address), view_key, true, start_height));
+
+  cryptonote::transaction tx = make_payment(alice.get_keys().m_account_address, false, 20);
+  tx.rct_signatures.outPk[0].mask = rct::commit(21, rct::skGen());
+  scanner.scan_block(make_block(start_height, {tx}, next_global_index));
+
+  EXPECT_TRUE(outputs(address(alice.get_keys().m_account_address), alice).empty());
+  EXPECT_EQ(start_height + 1, scanner.get_scan_height());
+}
+
+TEST_F(light_wallet, spends_and_rollback)
+{
+  const std::string addr = address(alice.get_keys().m_account_address);
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(addr, alice.get_keys().m_view_secret_key, true, start_height));
+
+  scanner.scan_block(make_block(start_height, {make_payment(alice.get_keys().m_account_address, false, 20)}, next_global_index));
+  const auto found = outputs(addr, alice);
+  ASSERT_EQ(1u, found.size());
+
+  crypto::key_image key_image;
+  cryptonote::account_base carol;
+  carol.generate();
+  scanner.scan_block(make_block(start_height + 1, {
+    make_payment(carol.get_keys().m_account_address, false, 1),
+    make_spend(found[0].global_index, key_image)
+  }, next_global_index));
+
+  EXPECT_EQ(light_wallet_scanner::status::ok, scanner.with_account(addr, alice.get_keys().m_view_secret_key, [&](const light_wallet_scanner::account &account) {
+    ASSERT_EQ(1u, account.spends.size());
+    EXPECT_EQ(key_image, account.spends[0].key_image);
+    EXPECT_EQ(20u, account.spends[0].amount);
+    EXPECT_EQ(1u, account.spends[0].mixin);
+    ASSERT_EQ(1u, account.outputs[0].spend_key_images.size());
+    EXPECT_EQ(key_image, account.outputs[0].spend_key_images[0]);
+  }));
+
+  scanner.rollback(start_height + 1);
+  EXPECT_EQ(light_wallet_scanner::status::ok, scanner.with_account(addr, alice.get_keys().m_view_secret_key, [&](const light_wallet_scanner::account &account) {
+    EXPECT_TRUE(account.spends.empty());
+    ASSERT_EQ(1u, account.outputs.size());
+    EXPECT_TRUE(account.outputs[0].spend_key_images.empty());
+    EXPECT_EQ(start_height + 1, account.scan_height);
+  }));
+
+  scanner.rollback(start_height);
+  EXPECT_TRUE(outputs(addr, alice).empty());
+  EXPECT_EQ(start_height, scanner.get_scan_height());
+}
+
+TEST_F(light_wallet, reorg)
+{
+  const std::string addr = address(alice.get_keys().m_account_address);
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(addr, alice.get_keys().m_view_secret_key, true, start_height));
+
+  std::vector<crypto::hash> chain;
+  for (uint64_t height = start_height; height < start_height + 150; ++height)
+  {
+    light_wallet_scanner::block_data block = make_block(height, {make_payment(alice.get_keys().m_account_address, false, 20)}, next_global_index);
+    chain.push_back(block.id);
+    scanner.scan_block(block);
+  }
+  ASSERT_EQ(150u, outputs(addr, alice).size());
+  const auto get_block_id = [&chain](uint64_t height) { return chain[height - start_height]; };
+
+  // nothing changed
+  scanner.rollback_reorg(start_height + 150, get_block_id);
+  EXPECT_EQ(start_height + 150, scanner.get_scan_height());
+
+  // the fork is among the kept block ids
+  chain.resize(140);
+  chain.push_back(crypto::rand<crypto::hash>());
+  scanner.rollback_reorg(start_height + 141, get_block_id);
+  EXPECT_EQ(start_height + 140, scanner.get_scan_height());
+  EXPECT_EQ(140u, outputs(addr, alice).size());
+
+  // the fork is below the kept block ids
+  for (uint64_t height = start_height + 140; height < start_height + 150; ++height)
+  {
+    light_wallet_scanner::block_data block = make_block(height, {}, next_global_index);
+    chain.resize(height - start_height);
+    chain.push_back(block.id);
+    scanner.scan_block(block);
+  }
+  for (size_t i = 20; i < chain.size(); ++i)
+    chain[i] = crypto::rand<crypto::hash>();
+  scanner.rollback_reorg(start_height + 150, get_block_id);
+  EXPECT_EQ(start_height, scanner.get_scan_height());
+  EXPECT_TRUE(outputs(addr, alice).empty());
+}
+
+TEST_F(light_wallet, accounts_at_different_heights)
+{
+  const std::string alice_addr = address(alice.get_keys().m_account_address);
+  const std::string bob_addr = address(bob.get_keys().m_account_address);
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(alice_addr, alice.get_keys().m_view_secret_key, true, start_height));
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(bob_addr, bob.get_keys().m_view_secret_key, true, start_height + 300));
+
+  std::vector<light_wallet_scanner::block_data> chain;
+  const auto add_block = [&]() {
+    const uint64_t height = start_height + chain.size();
+    chain.push_back(make_block(height, {make_payment(alice.get_keys().m_account_address, false, 20), make_payment(bob.get_keys().m_account_address, false, 30)}, next_global_index));
+  };
+  const auto scan = [&](size_t max_blocks) {
+    return scanner.scan(start_height + chain.size(),
+      [&chain](uint64_t height) { return chain[height - start_height].id; },
+      [&chain](uint64_t height, light_wallet_scanner::block_data &block) { block = chain[height - start_height]; return true; },
+      max_blocks);
+  };
+  const auto scan_height = [&](const std::string &addr, const cryptonote::account_base &owner) {
+    uint64_t height = 0;
+    EXPECT_EQ(light_wallet_scanner::status::ok, scanner.with_account(addr, owner.get_keys().m_view_secret_key, [&](const light_wallet_scanner::account &account) {
+      height = account.scan_height;
+    }));
+    return height;
+  };
+  for (int i = 0; i <= 300; ++i)
+    add_block();
+
+  // bob gets the new block first, alice catches up with what is left
+  EXPECT_EQ(10u, scan(10));
+  EXPECT_EQ(start_height + 301, scan_height(bob_addr, bob));
+  EXPECT_EQ(1u, outputs(bob_addr, bob).size());
+  EXPECT_EQ(start_height + 9, scan_height(alice_addr, alice));
+  EXPECT_EQ(9u, outputs(alice_addr, alice).size());
+
+  // alice being behind does not delay the next block for bob
+  add_block();
+  EXPECT_EQ(1u, scan(1));
+  EXPECT_EQ(start_height + 302, scan_height(bob_addr, bob));
+  EXPECT_EQ(2u, outputs(bob_addr, bob).size());
+  EXPECT_EQ(start_height + 9, scan_height(alice_addr, alice));
+
+  // once alice reaches bob, both are scanned together
+  while (scan(50))
+    ;
+  EXPECT_EQ(start_height + 302, scanner.get_scan_height());
+  EXPECT_EQ(start_height + 302, scan_height(alice_addr, alice));
+  EXPECT_EQ(302u, outputs(alice_addr, alice).size());
+  add_block();
+  EXPECT_EQ(1u, scan(1));
+  EXPECT_EQ(303u, outputs(alice_addr, alice).size());
+  EXPECT_EQ(3u, outputs(bob_addr, bob).size());
+}
+
+TEST_F(light_wallet, store_and_load)
+{
+  const std::string addr = address(alice.get_keys().m_account_address);
+  ASSERT_EQ(light_wallet_scanner::status::created, scanner.login(addr, alice.get_keys().m_view_secret_key, true, start_height));
+  scanner.scan_block(make_block(start_height, {make_payment(alice.get_keys().m_account_address, false, 20)}, next_global_index));
+
+  const boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(scanner.store(directory.string()));
+#ifndef WIN32
+  const boost::filesystem::perms perms = boost::filesystem::status(directory / LIGHT_WALLET_DATA_FILENAME).permissions();
+  EXPECT_EQ(boost::filesystem::owner_read | boost::filesystem::owner_write, perms);
+#endif
+
+  light_wallet_scanner loaded(cryptonote::MAINNET);
+  ASSERT_TRUE(loaded.load(directory.string()));
+  boost::filesystem::remove_all(directory);
+
+  EXPECT_EQ(start_height + 1, loaded.get_scan_height());
+  EXPECT_EQ(light_wallet_scanner::status::ok, loaded.with_account(addr, alice.get_keys().m_view_secret_key, [&](const light_wallet_scanner::account &account) {
+    ASSERT_EQ(1u, account.outputs.size());
+    EXPECT_EQ(20u, account.outputs[0].amount);
+  }));
+}
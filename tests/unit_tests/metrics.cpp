@@ -0,0 +1,122 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include "common/metrics.h"
+#include "net/levin_command_stats.h"
+
+TEST(metrics, counter)
+{
+  tools::metrics::counter counter{};
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < 4; ++i)
+    threads.emplace_back([&counter] {
+      for (unsigned j = 0; j < 1000; ++j)
+        counter.inc();
+    });
+  for (std::thread& t : threads)
+    t.join();
+  counter.inc(5);
+  EXPECT_EQ(4005u, counter.value());
+}
+
+TEST(metrics, histogram)
+{
+  tools::metrics::histogram histogram{};
+  histogram.observe_ns(50000);
+  histogram.observe_ns(100000);
+  histogram.observe_ns(100001);
+  histogram.observe_ns(20000000000);
+
+  const auto buckets = histogram.buckets();
+  EXPECT_EQ(2u, buckets[0]);
+  EXPECT_EQ(1u, buckets[1]);
+  EXPECT_EQ(1u, buckets.back());
+  EXPECT_EQ(4u, histogram.count());
+  EXPECT_EQ(20000250001u, histogram.sum_ns());
+}
+
+TEST(metrics, exposition)
+{
+  auto& registry = tools::metrics::registry::getInstance();
+  registry.get_counter("test_metrics_calls_total", "Calls", "method", "get_\"info\"").inc(3);
+  registry.get_histogram("test_metrics_seconds", "Latency").observe_ns(1500000000);
+  EXPECT_EQ(std::addressof(registry.get_counter("test_metrics_calls_total", "Calls", "method", "get_\"info\"")),
+    std::addressof(registry.get_counter("test_metrics_calls_total", "Calls", "method", "get_\"info\"")));
+  EXPECT_THROW(registry.get_histogram("test_metrics_calls_total", "Calls", "method", "x"), std::logic_error);
+
+  std::string out;
+  registry.write(out);
+  EXPECT_NE(std::string::npos, out.find("# TYPE test_metrics_calls_total counter\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_calls_total{method=\"get_\\\"info\\\"\"} 3\n"));
+  EXPECT_NE(std::string::npos, out.find("# TYPE test_metrics_seconds histogram\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_seconds_bucket{le=\"1.000000000\"} 0\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_seconds_bucket{le=\"10.000000000\"} 1\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_seconds_bucket{le=\"+Inf\"} 1\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_seconds_sum 1.500000000\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_seconds_count 1\n"));
+
+  out.clear();
+  tools::metrics::registry::write_sampled(out, "test_metrics_queue", "gauge", "Queue", {}, {{{}, 7}});
+  EXPECT_EQ("# HELP test_metrics_queue Queue\n# TYPE test_metrics_queue gauge\ntest_metrics_queue 7\n", out);
+}
+
+TEST(metrics, levin_command_stats)
+{
+  epee::levin::command_stats stats{};
+  stats.received(1001, 100);
+  stats.received(1001, 50);
+  stats.sent(2002, 10);
+  for (std::uint32_t command = 3000; command < 3100; ++command)
+    stats.received(command, 1);
+
+  std::uint64_t other = 0;
+  bool found_handshake = false;
+  for (const auto& e : stats.get())
+  {
+    if (e.command == 1001)
+    {
+      found_handshake = true;
+      EXPECT_EQ(2u, e.messages_in);
+      EXPECT_EQ(150u, e.bytes_in);
+    }
+    if (e.command == 2002)
+    {
+      EXPECT_EQ(1u, e.messages_out);
+      EXPECT_EQ(10u, e.bytes_out);
+    }
+    if (e.command == epee::levin::command_stats::other_commands)
+      other = e.messages_in;
+  }
+  EXPECT_TRUE(found_handshake);
+  EXPECT_EQ(100u - (64u - 2u), other);
+}
@@ -63,6 +63,8 @@ public:
   void resume_mine(){}
   bool on_idle(){return true;}
   bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, bool clip_pruned, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp){return true;}
+  bool get_compact_block_headers(uint64_t start_height, size_t count, std::vector<cryptonote::blobdata> &headers) const { return false; }
+  bool check_block_headers(uint64_t start_height, const std::vector<cryptonote::compact_block_header> &headers, const std::vector<crypto::hash> &ids, uint64_t &checked, cryptonote::difficulty_type &cumulative_difficulty) { checked = 0; return true; }
   bool handle_get_objects(cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote::cryptonote_connection_context& context){return true;}
   cryptonote::blockchain_storage &get_blockchain_storage() { throw std::runtime_error("Called invalid member function: please never call get_blockchain_storage on the TESTING class test_core."); }
   bool get_test_drop_download() const {return true;}
@@ -91,6 +93,7 @@ public:
   bool is_within_compiled_block_hash_area(uint64_t height) const { return false; }
   bool has_block_weights(uint64_t height, uint64_t nblocks) const { return false; }
   bool get_txpool_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes) { return false; }
+  void get_pool_short_id_index(const crypto::hash &salt, std::unordered_map<uint64_t, crypto::hash> &index) const { index.clear(); }
   bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes = true) const { return false; }
   void stop() {}
 };
@@ -0,0 +1,241 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "rpc/rpc_admission.h"
+
+using lane = cryptonote::rpc_admission::lane;
+
+namespace
+{
+  //! Keeps a call admitted on its own thread until released
+  class held_call
+  {
+  public:
+    held_call(cryptonote::rpc_admission& admission, const char* rpc)
+      : m_release(), m_thread()
+    {
+      std::promise<bool> admitted;
+      std::future<bool> result = admitted.get_future();
+      std::shared_future<void> release = m_release.get_future().share();
+      m_thread = std::thread([&admission, rpc, release, &admitted] {
+        const auto ticket = admission.admit(rpc, lane::normal);
+        admitted.set_value(bool(ticket));
+        release.wait();
+      });
+      m_admitted = result.get();
+    }
+
+    ~held_call()
+    {
+      release();
+    }
+
+    bool admitted() const noexcept { return m_admitted; }
+
+    void release()
+    {
+      if (m_thread.joinable())
+      {
+        m_release.set_value();
+        m_thread.join();
+      }
+    }
+
+  private:
+    std::promise<void> m_release;
+    std::thread m_thread;
+    bool m_admitted;
+  };
+}
+
+TEST(rpc_admission, thread_budget)
+{
+  cryptonote::rpc_admission admission{3};
+
+  held_call first{admission, "get_info"};
+  held_call second{admission, "get_block_count"};
+  ASSERT_TRUE(first.admitted());
+  ASSERT_TRUE(second.admitted());
+
+  // the last server thread is kept for priority calls
+  EXPECT_FALSE(bool(admission.admit("get_info", lane::normal)));
+  EXPECT_TRUE(bool(admission.admit("getblocktemplate", lane::priority)));
+
+  second.release();
+  EXPECT_TRUE(bool(admission.admit("get_info", lane::normal)));
+
+  const auto counters = admission.get_counters();
+  ASSERT_EQ(1u, counters.size());
+  EXPECT_EQ(1u, counters.at("get_info").busy);
+  EXPECT_EQ(0u, counters.at("get_info").queued);
+
+  admission.clear_counters();
+  EXPECT_TRUE(admission.get_counters().empty());
+}
+
+TEST(rpc_admission, method_cap)
+{
+  cryptonote::rpc_admission admission{16};
+  admission.set_limits("get_output_histogram", {1, 0});
+
+  held_call first{admission, "get_output_histogram"};
+  ASSERT_TRUE(first.admitted());
+  EXPECT_FALSE(bool(admission.admit("get_output_histogram", lane::normal)));
+  EXPECT_TRUE(bool(admission.admit("get_info", lane::normal)));
+
+  first.release();
+  EXPECT_TRUE(bool(admission.admit("get_output_histogram", lane::normal)));
+  EXPECT_EQ(1u, admission.get_counters().at("get_output_histogram").busy);
+}
+
+TEST(rpc_admission, method_queue)
+{
+  cryptonote::rpc_admission admission{16};
+  admission.set_limits("get_output_histogram", {1, 1});
+
+  held_call first{admission, "get_output_histogram"};
+  ASSERT_TRUE(first.admitted());
+
+  std::thread releaser([&first] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    first.release();
+  });
+  EXPECT_TRUE(bool(admission.admit("get_output_histogram", lane::normal)));
+  releaser.join();
+
+  const auto counters = admission.get_counters().at("get_output_histogram");
+  EXPECT_EQ(1u, counters.queued);
+  EXPECT_LT(0u, counters.queue_time);
+  EXPECT_EQ(0u, counters.busy);
+}
+
+TEST(rpc_admission, nested)
+{
+  cryptonote::rpc_admission admission{1};
+
+  const auto outer = admission.admit("generateblocks", lane::normal);
+  ASSERT_TRUE(bool(outer));
+  held_call other{admission, "get_info"};
+  EXPECT_FALSE(other.admitted());
+
+  // calls made from within an admitted call are not counted again
+  EXPECT_TRUE(bool(admission.admit("getblocktemplate", lane::normal)));
+}
+
+TEST(rpc_admission, batch_elements)
+{
+  cryptonote::rpc_admission admission{2};
+  admission.set_limits("get_output_histogram", {1, 4});
+
+  // the batch itself takes the only normal server thread
+  held_call batch{admission, "json_rpc_batch"};
+  ASSERT_TRUE(batch.admitted());
+  EXPECT_FALSE(bool(admission.admit("get_info", lane::normal)));
+
+  const cryptonote::rpc_admission::batch_element_scope scope{};
+  EXPECT_TRUE(bool(admission.admit("get_info", lane::normal)));
+
+  // elements go through the method caps, but are deferred rather than queued
+  const auto first = admission.admit("get_output_histogram", lane::normal);
+  ASSERT_TRUE(bool(first));
+  EXPECT_FALSE(scope.deferred());
+  const auto start = std::chrono::steady_clock::now();
+  {
+    // a fresh element on the same thread, as when the caller helps run its own batch
+    const cryptonote::rpc_admission::batch_element_scope inner{};
+    EXPECT_FALSE(bool(admission.admit("get_output_histogram", lane::normal)));
+    EXPECT_TRUE(inner.deferred());
+  }
+  EXPECT_FALSE(scope.deferred());
+  EXPECT_GT(std::chrono::seconds(1), std::chrono::steady_clock::now() - start);
+
+  const auto counters = admission.get_counters();
+  EXPECT_EQ(0u, counters.count("get_output_histogram"));
+}
+
+TEST(rpc_admission, batch_over_method_cap)
+{
+  cryptonote::rpc_admission admission{4};
+  admission.set_limits("get_output_distribution", {2, 4});
+
+  held_call batch{admission, "json_rpc_batch"};
+  ASSERT_TRUE(batch.admitted());
+
+  // three elements of a method capped at two, on an idle server: the third is deferred
+  std::vector<uint8_t> deferred(3, 0);
+  {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::vector<std::promise<void>> ran(3);
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < 3; ++i)
+    {
+      pool.emplace_back([&, i] {
+        const cryptonote::rpc_admission::batch_element_scope scope{};
+        const auto ticket = admission.admit("get_output_distribution", lane::normal);
+        deferred[i] = scope.deferred();
+        ran[i].set_value();
+        if (ticket)
+          released.wait();
+      });
+      ran[i].get_future().wait();
+    }
+    release.set_value();
+    for (std::thread &t: pool)
+      t.join();
+  }
+  EXPECT_EQ((std::vector<uint8_t>{0, 0, 1}), deferred);
+
+  // then runs on the thread holding the batch, waiting for a slot if it has to
+  const cryptonote::rpc_admission::batch_element_scope scope{true};
+  held_call other{admission, "get_output_distribution"};
+  ASSERT_TRUE(other.admitted());
+  {
+    const auto held = admission.admit("get_output_distribution", lane::normal);
+    ASSERT_TRUE(bool(held));
+    std::thread releaser([&other] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      other.release();
+    });
+    const cryptonote::rpc_admission::batch_element_scope inner{true};
+    EXPECT_TRUE(bool(admission.admit("get_output_distribution", lane::normal)));
+    EXPECT_FALSE(inner.deferred());
+    releaser.join();
+  }
+
+  const auto counters = admission.get_counters().at("get_output_distribution");
+  EXPECT_EQ(1u, counters.queued);
+  EXPECT_EQ(0u, counters.busy);
+}
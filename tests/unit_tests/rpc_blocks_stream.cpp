@@ -0,0 +1,223 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/testdb.h"
+#include "rpc/rpc_blocks_stream.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  // blocks with a few txes each, tx ids running on from each block's miner tx
+  class TestDB: public cryptonote::BaseTestDB
+  {
+  public:
+    TestDB()
+    {
+      m_open = true;
+      uint64_t tx_id = 0;
+      for (uint64_t height = 0; height < 6; ++height)
+      {
+        cryptonote::block b{};
+        b.major_version = 1;
+        b.timestamp = height;
+        b.miner_tx.version = 1;
+        b.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+        b.miner_tx.vin.push_back(cryptonote::txin_gen{height});
+        std::vector<cryptonote::blobdata> txs;
+        for (uint64_t n = 0; n < height % 3; ++n)
+        {
+          crypto::hash tx_hash;
+          std::memset(&tx_hash, int(height * 8 + n), sizeof(tx_hash));
+          b.tx_hashes.push_back(tx_hash);
+          txs.push_back("tx " + std::to_string(height) + "/" + std::to_string(n) + " prunable data");
+        }
+        m_miner_tx_ids[cryptonote::get_transaction_hash(b.miner_tx)] = tx_id;
+        tx_id += 1 + txs.size();
+        m_blocks.push_back(cryptonote::block_to_blob(b));
+        m_txs.push_back(std::move(txs));
+        crypto::hash hash;
+        std::memset(&hash, int(height), sizeof(hash));
+        m_hashes.push_back(hash);
+      }
+    }
+
+    virtual uint64_t height() const override { return m_blocks.size(); }
+    virtual crypto::hash get_block_hash_from_height(const uint64_t& height) const override { return m_hashes.at(height); }
+
+    virtual bool get_blocks_from(uint64_t start_height, size_t min_count, size_t max_count, size_t max_size, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>>& blocks, bool pruned, bool skip_coinbase, bool get_miner_tx_hash) const override
+    {
+      size_t size = 0;
+      for (uint64_t h = start_height; h < m_blocks.size() && blocks.size() < max_count && (size < max_size || blocks.size() < min_count); ++h)
+      {
+        blocks.push_back({{m_blocks[h], crypto::null_hash}, {}});
+        size += m_blocks[h].size();
+        for (const auto& tx: m_txs[h])
+        {
+          blocks.back().second.push_back({crypto::null_hash, pruned ? tx.substr(0, tx.find(' ', 3)) : tx});
+          size += blocks.back().second.back().second.size();
+        }
+      }
+      return true;
+    }
+
+    virtual bool tx_exists(const crypto::hash& h, uint64_t& tx_index) const override
+    {
+      const auto i = m_miner_tx_ids.find(h);
+      if (i == m_miner_tx_ids.end())
+        return false;
+      tx_index = i->second;
+      return true;
+    }
+
+    virtual std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_index, size_t n_txes) const override
+    {
+      // every third tx has no outputs
+      std::vector<std::vector<uint64_t>> indices(n_txes);
+      for (size_t n = 0; n < n_txes; ++n)
+        for (uint64_t i = 0; i < (tx_index + n) % 3; ++i)
+          indices[n].push_back((tx_index + n) * 10 + i);
+      return indices;
+    }
+
+    std::vector<cryptonote::blobdata> m_blocks;
+    std::vector<std::vector<cryptonote::blobdata>> m_txs;
+    std::vector<crypto::hash> m_hashes;
+    std::unordered_map<crypto::hash, uint64_t> m_miner_tx_ids;
+  };
+
+  std::string drain(cryptonote::rpc_blocks_stream& stream)
+  {
+    std::string body;
+    for (size_t size = 0; ; size = body.size())
+    {
+      EXPECT_TRUE(stream(body));
+      if (body.size() == size)
+        return body;
+    }
+  }
+
+  void fill_base(cryptonote::rpc_access_response_base& res)
+  {
+    res.status = CORE_RPC_STATUS_OK;
+    res.untrusted = true;
+    res.credits = 42;
+    res.top_hash = "top";
+  }
+
+  void check_get_blocks(bool prune, bool no_miner_tx)
+  {
+    TestDB db;
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res{};
+    fill_base(res);
+    res.start_height = 1;
+    res.current_height = db.height();
+    const size_t count = 4;
+
+    // one block per chunk
+    cryptonote::rpc_blocks_stream stream(db, res, count, prune, no_miner_tx, 1);
+    const std::string streamed = drain(stream);
+
+    for (uint64_t h = res.start_height; h < res.start_height + count; ++h)
+    {
+      res.blocks.emplace_back();
+      res.blocks.back().pruned = prune;
+      res.blocks.back().block = db.m_blocks[h];
+      for (const auto& tx: db.m_txs[h])
+        res.blocks.back().txs.push_back({prune ? tx.substr(0, tx.find(' ', 3)) : tx, crypto::null_hash});
+
+      cryptonote::block b;
+      ASSERT_TRUE(cryptonote::parse_and_validate_block_from_blob(db.m_blocks[h], b));
+      const uint64_t tx_index = db.m_miner_tx_ids[cryptonote::get_transaction_hash(b.miner_tx)];
+      res.output_indices.emplace_back();
+      if (no_miner_tx)
+        res.output_indices.back().indices.emplace_back();
+      for (auto& indices: db.get_tx_amount_output_indices(tx_index + (no_miner_tx ? 1 : 0), db.m_txs[h].size() + (no_miner_tx ? 0 : 1)))
+        res.output_indices.back().indices.push_back({std::move(indices)});
+    }
+    std::string stored;
+    ASSERT_TRUE(epee::serialization::store_t_to_binary(res, stored));
+    EXPECT_EQ(stored, streamed);
+  }
+}
+
+TEST(rpc_blocks_stream, get_blocks)
+{
+  check_get_blocks(false, false);
+  check_get_blocks(false, true);
+  check_get_blocks(true, false);
+  check_get_blocks(true, true);
+}
+
+TEST(rpc_blocks_stream, get_blocks_by_height)
+{
+  TestDB db;
+  cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response res{};
+  fill_base(res);
+  const std::vector<uint64_t> heights{5, 0, 2, 2};
+
+  cryptonote::rpc_blocks_stream stream(db, res, heights, 1024 * 1024);
+  const std::string streamed = drain(stream);
+
+  for (const uint64_t h: heights)
+  {
+    res.blocks.emplace_back();
+    res.blocks.back().block = db.m_blocks[h];
+    for (const auto& tx: db.m_txs[h])
+      res.blocks.back().txs.push_back({tx, crypto::null_hash});
+  }
+  std::string stored;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(res, stored));
+  EXPECT_EQ(stored, streamed);
+}
+
+TEST(rpc_blocks_stream, reorg_aborts)
+{
+  TestDB db;
+  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res{};
+  fill_base(res);
+  res.start_height = 0;
+  res.current_height = db.height();
+
+  cryptonote::rpc_blocks_stream stream(db, res, db.height(), false, false, 1);
+  std::string body;
+  ASSERT_TRUE(stream(body));
+  ASSERT_FALSE(body.empty());
+
+  db.m_hashes.back() = crypto::null_hash;
+  EXPECT_FALSE(stream(body));
+
+  db.m_hashes.pop_back();
+  db.m_blocks.pop_back();
+  EXPECT_FALSE(stream(body));
+}
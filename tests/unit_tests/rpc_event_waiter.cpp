@@ -0,0 +1,209 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include "rpc/rpc_event_waiter.h"
+
+using result = cryptonote::rpc_event_waiter::result;
+
+namespace
+{
+  crypto::hash make_hash(const unsigned char c)
+  {
+    crypto::hash h;
+    memset(h.data, c, sizeof(h.data));
+    return h;
+  }
+
+  struct outcome
+  {
+    result r;
+    cryptonote::rpc_event_waiter::state state;
+  };
+
+  std::future<outcome> park(cryptonote::rpc_event_waiter& waiter, const crypto::hash& top, bool pool, uint64_t cookie, std::chrono::milliseconds timeout)
+  {
+    const auto done = std::make_shared<std::promise<outcome>>();
+    std::future<outcome> call = done->get_future();
+    waiter.wait(top, pool, cookie, timeout, [done](const result r, const cryptonote::rpc_event_waiter::state& state) {
+      done->set_value({r, state});
+    });
+    return call;
+  }
+
+  //! Calls expected to complete without waiting
+  outcome answer(cryptonote::rpc_event_waiter& waiter, const crypto::hash& top, bool pool, uint64_t cookie, std::chrono::milliseconds timeout)
+  {
+    std::future<outcome> call = park(waiter, top, pool, cookie, timeout);
+    EXPECT_EQ(std::future_status::ready, call.wait_for(std::chrono::seconds(0)));
+    return call.get();
+  }
+
+  bool parked(std::future<outcome>& call)
+  {
+    return call.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout;
+  }
+}
+
+TEST(rpc_event_waiter, returns_when_already_changed)
+{
+  cryptonote::rpc_event_waiter waiter{1};
+  waiter.init_chain(10, make_hash(1));
+  waiter.update_pool(5);
+
+  const outcome first = answer(waiter, crypto::null_hash, false, 0, std::chrono::seconds(10));
+  EXPECT_EQ(result::changed, first.r);
+  EXPECT_EQ(10, first.state.height);
+  EXPECT_EQ(make_hash(1), first.state.top_hash);
+  EXPECT_EQ(5, first.state.pool_cookie);
+
+  EXPECT_EQ(result::changed, answer(waiter, make_hash(1), true, 4, std::chrono::seconds(10)).r);
+  EXPECT_EQ(result::timeout, answer(waiter, make_hash(1), false, 4, std::chrono::milliseconds(0)).r);
+  EXPECT_EQ(0, waiter.get_parked());
+}
+
+TEST(rpc_event_waiter, init_chain_after_update)
+{
+  cryptonote::rpc_event_waiter waiter{1};
+  waiter.update_chain(11, make_hash(2));
+  waiter.init_chain(10, make_hash(1));
+  EXPECT_EQ(11, waiter.get_state().height);
+  EXPECT_EQ(make_hash(2), waiter.get_state().top_hash);
+}
+
+TEST(rpc_event_waiter, wakes_on_block)
+{
+  cryptonote::rpc_event_waiter waiter{2};
+  waiter.init_chain(10, make_hash(1));
+
+  std::future<outcome> call = park(waiter, make_hash(1), false, 0, std::chrono::seconds(30));
+  EXPECT_EQ(1, waiter.get_parked());
+  waiter.update_pool(1); // not asked for
+  waiter.update_chain(10, make_hash(1)); // same top
+  EXPECT_TRUE(parked(call));
+
+  waiter.update_chain(11, make_hash(2));
+  ASSERT_EQ(std::future_status::ready, call.wait_for(std::chrono::seconds(0)));
+  const outcome woken = call.get();
+  EXPECT_EQ(result::changed, woken.r);
+  EXPECT_EQ(11, woken.state.height);
+  EXPECT_EQ(make_hash(2), woken.state.top_hash);
+  EXPECT_EQ(1, woken.state.pool_cookie);
+  EXPECT_EQ(0, waiter.get_parked());
+}
+
+TEST(rpc_event_waiter, wakes_on_pool)
+{
+  cryptonote::rpc_event_waiter waiter{1};
+  waiter.init_chain(10, make_hash(1));
+  waiter.update_pool(3);
+
+  std::future<outcome> call = park(waiter, make_hash(1), true, 3, std::chrono::seconds(30));
+  waiter.update_pool(3);
+  EXPECT_TRUE(parked(call));
+
+  waiter.update_pool(4);
+  ASSERT_EQ(std::future_status::ready, call.wait_for(std::chrono::seconds(0)));
+  const outcome woken = call.get();
+  EXPECT_EQ(result::changed, woken.r);
+  EXPECT_EQ(4, woken.state.pool_cookie);
+}
+
+TEST(rpc_event_waiter, timeout)
+{
+  cryptonote::rpc_event_waiter waiter{2};
+  waiter.init_chain(10, make_hash(1));
+
+  const auto start = std::chrono::steady_clock::now();
+  std::future<outcome> later = park(waiter, make_hash(1), true, 0, std::chrono::seconds(30));
+  std::future<outcome> call = park(waiter, make_hash(1), true, 0, std::chrono::milliseconds(100));
+  ASSERT_EQ(std::future_status::ready, call.wait_for(std::chrono::seconds(5)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+  const outcome expired = call.get();
+  EXPECT_EQ(result::timeout, expired.r);
+  EXPECT_EQ(make_hash(1), expired.state.top_hash);
+  EXPECT_TRUE(parked(later));
+  EXPECT_EQ(1, waiter.get_parked());
+}
+
+TEST(rpc_event_waiter, parks_without_threads)
+{
+  cryptonote::rpc_event_waiter waiter{100};
+  waiter.init_chain(10, make_hash(1));
+
+  std::vector<std::future<outcome>> calls;
+  for (int i = 0; i < 100; ++i)
+    calls.push_back(park(waiter, make_hash(1), false, 0, std::chrono::seconds(30)));
+  EXPECT_EQ(100, waiter.get_parked());
+
+  waiter.update_chain(11, make_hash(2));
+  for (std::future<outcome>& call: calls)
+  {
+    ASSERT_EQ(std::future_status::ready, call.wait_for(std::chrono::seconds(0)));
+    EXPECT_EQ(result::changed, call.get().r);
+  }
+}
+
+TEST(rpc_event_waiter, bounded)
+{
+  cryptonote::rpc_event_waiter waiter{1};
+  waiter.init_chain(10, make_hash(1));
+
+  std::future<outcome> call = park(waiter, make_hash(1), false, 0, std::chrono::seconds(30));
+  EXPECT_EQ(result::busy, answer(waiter, make_hash(1), false, 0, std::chrono::seconds(30)).r);
+  // calls which need not wait are still answered
+  EXPECT_EQ(result::changed, answer(waiter, make_hash(9), false, 0, std::chrono::seconds(30)).r);
+
+  waiter.update_chain(11, make_hash(2));
+  EXPECT_EQ(result::changed, call.get().r);
+
+  cryptonote::rpc_event_waiter none{0};
+  none.init_chain(10, make_hash(1));
+  EXPECT_EQ(result::busy, answer(none, make_hash(1), false, 0, std::chrono::seconds(30)).r);
+}
+
+TEST(rpc_event_waiter, stopping)
+{
+  cryptonote::rpc_event_waiter waiter{1};
+  waiter.init_chain(10, make_hash(1));
+
+  std::future<outcome> call = park(waiter, make_hash(1), false, 0, std::chrono::seconds(30));
+  EXPECT_TRUE(parked(call));
+  waiter.stop();
+  ASSERT_EQ(std::future_status::ready, call.wait_for(std::chrono::seconds(0)));
+  EXPECT_EQ(result::stopped, call.get().r);
+  EXPECT_EQ(0, waiter.get_parked());
+
+  EXPECT_EQ(result::stopped, answer(waiter, make_hash(1), false, 0, std::chrono::seconds(30)).r);
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "rpc/rpc_response_cache.h"
+
+using depends = cryptonote::rpc_response_cache::depends;
+using chain_tip = cryptonote::rpc_response_cache::chain_tip;
+
+TEST(rpc_response_cache, hit_after_store)
+{
+  const chain_tip tip{10, crypto::null_hash};
+  cryptonote::rpc_response_cache cache{[&tip]() { return tip; }};
+  std::string body{};
+
+  auto handle = cache.bind("get_info", depends::chain, 0);
+  ASSERT_TRUE(bool(handle));
+  EXPECT_FALSE(handle.find("{}", body));
+  handle.store("{}", "response");
+
+  handle = cache.bind("get_info", depends::chain, 0);
+  EXPECT_TRUE(handle.find("{}", body));
+  EXPECT_EQ("response", body);
+  EXPECT_FALSE(handle.find("{\"a\": 1}", body));
+  EXPECT_FALSE(cache.bind("getinfo", depends::chain, 0).find("{}", body));
+
+  const auto counters = cache.get_counters();
+  ASSERT_EQ(2u, counters.size());
+  EXPECT_EQ(1u, counters.at("get_info").hits);
+  EXPECT_EQ(2u, counters.at("get_info").misses);
+  EXPECT_EQ(0u, counters.at("getinfo").hits);
+  EXPECT_EQ(1u, counters.at("getinfo").misses);
+
+  cache.clear_counters();
+  EXPECT_TRUE(cache.get_counters().empty());
+}
+
+TEST(rpc_response_cache, chain_change)
+{
+  chain_tip tip{10, crypto::null_hash};
+  cryptonote::rpc_response_cache cache{[&tip]() { return tip; }};
+  std::string body{};
+
+  cache.bind("get_block_count", depends::chain, 0).store("{}", "10");
+  tip.height = 11;
+  EXPECT_FALSE(cache.bind("get_block_count", depends::chain, 0).find("{}", body));
+
+  // a body computed before the chain moved is not kept
+  auto handle = cache.bind("get_block_count", depends::chain, 0);
+  tip.height = 12;
+  handle.store("{}", "11");
+  EXPECT_FALSE(cache.bind("get_block_count", depends::chain, 0).find("{}", body));
+
+  // a reorg to the same height is a change too
+  cache.bind("get_block_count", depends::chain, 0).store("{}", "12");
+  tip.id.data[0] = 1;
+  EXPECT_FALSE(cache.bind("get_block_count", depends::chain, 0).find("{}", body));
+
+  // popped blocks move the tip back, without any notification
+  tip = {11, crypto::null_hash};
+  cache.bind("get_block_count", depends::chain, 0).store("{}", "11");
+  tip.height = 10;
+  EXPECT_FALSE(cache.bind("get_block_count", depends::chain, 0).find("{}", body));
+}
+
+TEST(rpc_response_cache, pool_change)
+{
+  const chain_tip tip{10, crypto::null_hash};
+  cryptonote::rpc_response_cache cache{[&tip]() { return tip; }};
+  std::string body{};
+
+  cache.bind("get_info", depends::live, 7).store("{}", "response");
+  EXPECT_TRUE(cache.bind("get_info", depends::live, 7).find("{}", body));
+  EXPECT_FALSE(cache.bind("get_info", depends::live, 8).find("{}", body)); // drops the stale body
+  EXPECT_FALSE(cache.bind("get_info", depends::live, 7).find("{}", body));
+
+  cache.bind("get_fee_estimate", depends::chain, 7).store("{}", "response");
+  EXPECT_TRUE(cache.bind("get_fee_estimate", depends::chain, 8).find("{}", body));
+}
+
+TEST(rpc_response_cache, empty_handle)
+{
+  std::string body{};
+  const cryptonote::rpc_response_cache::handle handle{};
+  EXPECT_FALSE(bool(handle));
+  EXPECT_FALSE(handle.find("{}", body));
+  handle.store("{}", "response");
+}
@@ -1158,3 +1158,34 @@ TEST(Serialization, difficulty_type)
 
   ASSERT_EQ(v_original, v_unserialized);
 }
+
+TEST(Serialization, compact_block_header)
+{
+  for (uint8_t major_version: {(uint8_t)1, (uint8_t)HF_VERSION_CUCKOO})
+  {
+    cryptonote::block b;
+    b.major_version = major_version;
+    b.minor_version = major_version;
+    b.timestamp = 1577836800;
+    b.prev_id = crypto::rand<crypto::hash>();
+    b.nonce8 = 0x0102030405060708;
+    b.nonce = 42;
+    for (size_t i = 0; i < sizeof(b.cycle.data) / sizeof(b.cycle.data[0]); ++i)
+      b.cycle.data[i] = i * 7;
+    b.miner_tx.version = 1;
+    b.miner_tx.vin.push_back(cryptonote::txin_gen{10});
+    b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+    b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+
+    cryptonote::compact_block_header header = cryptonote::get_compact_block_header(b);
+    ASSERT_EQ(header.tx_count, 3);
+    ASSERT_EQ(cryptonote::get_block_hashing_blob(header), cryptonote::get_block_hashing_blob(b));
+    ASSERT_EQ(cryptonote::get_compact_block_header_hash(header), cryptonote::get_block_hash(b));
+
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(serialization::dump_binary(header, blob));
+    cryptonote::compact_block_header header2;
+    ASSERT_TRUE(serialization::parse_binary(blob, header2));
+    ASSERT_EQ(cryptonote::get_compact_block_header_hash(header2), cryptonote::get_block_hash(b));
+  }
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "crypto/siphash.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+
+// vectors from the SipHash reference implementation, key 00..0f, input 00..(n-1)
+static const uint64_t siphash_vectors[] = {
+  0x726fdb47dd0e0e31ull, 0x74f839c593dc67fdull, 0x0d6c8009d9a94f5aull, 0x85676696d7fb7e2dull,
+  0xcf2794e0277187b7ull, 0x18765564cd99a68dull, 0xcbc9466e58fee3ceull, 0xab0200f58b01d137ull,
+  0x93f5f5799a932462ull, 0x9e0082df0ba9e4b0ull, 0x7a5dbbc594ddb9f3ull, 0xf4b32f46226bada7ull,
+  0x751e8fbc860ee5fbull, 0x14ea5627c0843d90ull, 0xf723ca908e7af2eeull, 0xa129ca6149be45e5ull,
+};
+
+TEST(siphash, reference_vectors)
+{
+  uint8_t key[SIPHASH_KEY_SIZE];
+  for (size_t i = 0; i < sizeof(key); ++i)
+    key[i] = i;
+  uint8_t data[sizeof(siphash_vectors) / sizeof(siphash_vectors[0])];
+  for (size_t i = 0; i < sizeof(data); ++i)
+    data[i] = i;
+
+  for (size_t n = 0; n < sizeof(data); ++n)
+    ASSERT_EQ(siphash24(data, n, key), siphash_vectors[n]);
+}
+
+TEST(siphash, compact_block_short_id)
+{
+  crypto::hash block_hash = crypto::null_hash, txid = crypto::null_hash;
+  block_hash.data[0] = 1;
+  txid.data[0] = 2;
+
+  const crypto::hash salt0 = cryptonote::get_compact_block_salt(block_hash, 0);
+  const crypto::hash salt1 = cryptonote::get_compact_block_salt(block_hash, 1);
+  ASSERT_NE(salt0, salt1);
+
+  const uint64_t id0 = cryptonote::get_compact_block_short_id(salt0, txid);
+  const uint64_t id1 = cryptonote::get_compact_block_short_id(salt1, txid);
+  ASSERT_EQ(id0 >> 48, 0u);
+  ASSERT_EQ(id1 >> 48, 0u);
+  ASSERT_NE(id0, id1);
+  ASSERT_EQ(id0, cryptonote::get_compact_block_short_id(salt0, txid));
+}
@@ -254,3 +254,124 @@ TEST(peerlist_storage, store)
   EXPECT_EQ(24u, types.anchor[1].id);
   EXPECT_EQ(22u, types.anchor[1].first_seen);
 }
+
+TEST(peer_list, hashed_lookup)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(nodetool::peerlist_types{}, false);
+
+  const epee::net_utils::network_address v4{epee::net_utils::ipv4_network_address{MAKE_IP(123,43,12,1), 8080}};
+  const epee::net_utils::network_address v4_other_port{epee::net_utils::ipv4_network_address{MAKE_IP(123,43,12,1), 8081}};
+  const epee::net_utils::network_address v6{epee::net_utils::ipv6_network_address{boost::asio::ip::address_v6::from_string("2001:db8::1"), 8080}};
+  EXPECT_EQ(hash_value(v4), hash_value(epee::net_utils::network_address{epee::net_utils::ipv4_network_address{MAKE_IP(123,43,12,1), 8080}}));
+
+  for (const auto& adr : {v4, v4_other_port, v6})
+  {
+    nodetool::peerlist_entry ple{};
+    ple.adr = adr;
+    ple.id = 1;
+    ple.last_seen = 10;
+    plm.append_with_peer_gray(ple);
+  }
+  EXPECT_EQ(3u, plm.get_gray_peers_count());
+
+  nodetool::peerlist_entry ple{};
+  ple.adr = v6;
+  ple.id = 2;
+  plm.append_with_peer_white(ple);
+  EXPECT_EQ(2u, plm.get_gray_peers_count());
+  EXPECT_EQ(1u, plm.get_white_peers_count());
+
+  // a known peer showing up again in a remote peerlist changes nothing
+  std::vector<nodetool::peerlist_journal_entry> journal{};
+  EXPECT_TRUE(plm.take_journal(journal));
+  EXPECT_EQ(5u, journal.size());
+  ple.adr = v4;
+  ple.id = 1;
+  plm.merge_peerlist({ple});
+  journal.clear();
+  EXPECT_TRUE(plm.take_journal(journal));
+  EXPECT_TRUE(journal.empty());
+}
+
+TEST(peerlist_storage, journal)
+{
+  using zone = epee::net_utils::zone;
+
+  nodetool::peerlist_manager plm;
+  plm.init(nodetool::peerlist_types{}, false);
+
+  std::string snapshot{};
+  {
+    nodetool::peerlist_entry ple{};
+    ple.id = 1;
+    ple.last_seen = 10;
+    ple.adr = epee::net_utils::ipv4_network_address{1000, 10};
+    plm.append_with_peer_gray(ple);
+    ple.adr = epee::net_utils::ipv4_network_address{2000, 20};
+    plm.append_with_peer_gray(ple);
+
+    nodetool::peerlist_types types{};
+    plm.get_peerlist(types);
+    std::ostringstream stream{};
+    EXPECT_TRUE(nodetool::peerlist_storage{}.store(stream, types));
+    snapshot = stream.str();
+  }
+
+  std::vector<nodetool::peerlist_journal_entry> journal{};
+  EXPECT_TRUE(plm.take_journal(journal));
+  journal.clear();
+
+  std::ostringstream journal_stream{};
+  {
+    nodetool::peerlist_entry ple{};
+    ple.adr = epee::net_utils::ipv4_network_address{1000, 10};
+    ple.id = 5;
+    plm.append_with_peer_white(ple);
+    ple.adr = epee::net_utils::ipv4_network_address{3000, 30};
+    plm.append_with_peer_gray(ple);
+    plm.append_with_peer_anchor({epee::net_utils::ipv4_network_address{999, 654}, 444, 555});
+    EXPECT_TRUE(plm.take_journal(journal));
+    EXPECT_TRUE(nodetool::peerlist_storage::append_journal(journal_stream, journal));
+    journal.clear();
+
+    std::vector<nodetool::anchor_peerlist_entry> anchors{};
+    plm.get_and_empty_anchor_peerlist(anchors);
+    EXPECT_TRUE(plm.take_journal(journal));
+    EXPECT_TRUE(nodetool::peerlist_storage::append_journal(journal_stream, journal));
+  }
+
+  // a record torn by a crash is ignored along with anything after it
+  const std::string full_journal = journal_stream.str();
+  const std::string torn_journal = full_journal + full_journal.substr(0, full_journal.size() / 3);
+
+  std::istringstream snapshot_stream{snapshot};
+  boost::optional<nodetool::peerlist_storage> peers = nodetool::peerlist_storage::open(snapshot_stream, true);
+  ASSERT_TRUE(bool(peers));
+  std::istringstream replay_stream{torn_journal};
+  EXPECT_EQ(2u, peers->replay_journal(replay_stream));
+
+  nodetool::peerlist_types replayed = peers->take_zone(zone::public_);
+  nodetool::peerlist_types expected{};
+  plm.get_peerlist(expected);
+
+  const auto by_ip = [](const nodetool::peerlist_entry& left, const nodetool::peerlist_entry& right)
+  {
+    return left.adr.as<epee::net_utils::ipv4_network_address>().ip() < right.adr.as<epee::net_utils::ipv4_network_address>().ip();
+  };
+  std::sort(replayed.gray.begin(), replayed.gray.end(), by_ip);
+  std::sort(expected.gray.begin(), expected.gray.end(), by_ip);
+
+  ASSERT_EQ(expected.white.size(), replayed.white.size());
+  ASSERT_EQ(1u, replayed.white.size());
+  EXPECT_EQ(expected.white[0].adr, replayed.white[0].adr);
+  EXPECT_EQ(5u, replayed.white[0].id);
+
+  ASSERT_EQ(expected.gray.size(), replayed.gray.size());
+  for (std::size_t i = 0; i < expected.gray.size(); ++i)
+  {
+    EXPECT_EQ(expected.gray[i].adr, replayed.gray[i].adr);
+    EXPECT_EQ(expected.gray[i].id, replayed.gray[i].id);
+  }
+  EXPECT_TRUE(replayed.anchor.empty());
+}
@@ -54,3 +54,93 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+TEST(protocol_pack, reader_matches_portable_storage)
+{
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+  r.current_blockchain_height = 4321;
+  r.missed_ids.resize(3);
+  for (size_t i = 0; i < r.missed_ids.size(); ++i)
+    r.missed_ids[i].data[0] = i + 1;
+  for (size_t i = 0; i < 20; ++i)
+  {
+    cryptonote::block_complete_entry e;
+    e.pruned = i % 2;
+    e.block = std::string(100 + i, 'a' + i);
+    e.block_weight = e.pruned ? 1000 + i : 0;
+    for (size_t j = 0; j < i; ++j)
+    {
+      crypto::hash h = crypto::null_hash;
+      h.data[1] = j;
+      e.txs.push_back({std::string(50 + j, 'A' + j), e.pruned ? h : crypto::null_hash});
+    }
+    r.blocks.push_back(std::move(e));
+  }
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+
+  epee::serialization::portable_storage ps;
+  ASSERT_TRUE(ps.load_from_binary(buff));
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r_dom;
+  ASSERT_TRUE(r_dom.load(ps));
+
+  epee::serialization::portable_storage_reader reader;
+  ASSERT_TRUE(reader.load_from_binary(buff));
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r_stream;
+  ASSERT_TRUE(r_stream.load(reader));
+
+  ASSERT_EQ(r_stream.current_blockchain_height, 4321);
+  ASSERT_EQ(r_stream.missed_ids, r.missed_ids);
+  ASSERT_EQ(r_stream.blocks.size(), r.blocks.size());
+  for (size_t i = 0; i < r.blocks.size(); ++i)
+  {
+    const cryptonote::block_complete_entry &e = r_stream.blocks[i], &d = r_dom.blocks[i];
+    ASSERT_EQ(e.pruned, d.pruned);
+    ASSERT_EQ(e.block, r.blocks[i].block);
+    ASSERT_EQ(e.block, d.block);
+    ASSERT_EQ(e.block_weight, d.block_weight);
+    ASSERT_EQ(e.txs.size(), d.txs.size());
+    for (size_t j = 0; j < e.txs.size(); ++j)
+    {
+      ASSERT_EQ(e.txs[j].blob, d.txs[j].blob);
+      ASSERT_EQ(e.txs[j].prunable_hash, d.txs[j].prunable_hash);
+    }
+  }
+
+  // numeric conversions follow the DOM: a uint64 field can be loaded from a narrower stored type
+  cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request c;
+  epee::serialization::portable_storage cps;
+  ASSERT_TRUE(cps.set_value("start_height", uint32_t(7), nullptr));
+  ASSERT_TRUE(cps.set_value("total_height", uint8_t(9), nullptr));
+  ASSERT_TRUE(cps.set_value("cumulative_difficulty", uint64_t(11), nullptr));
+  ASSERT_TRUE(cps.store_to_binary(buff));
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(c, buff));
+  ASSERT_EQ(c.start_height, 7);
+  ASSERT_EQ(c.total_height, 9);
+  ASSERT_EQ(c.cumulative_difficulty, 11);
+  ASSERT_EQ(c.cumulative_difficulty_top64, 0);
+}
+
+TEST(protocol_pack, reader_rejects_truncated)
+{
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+  r.current_blockchain_height = 1;
+  r.blocks.resize(2);
+  r.blocks[0].block = "block";
+  r.blocks[1].txs.push_back({"tx", crypto::null_hash});
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+
+  epee::serialization::portable_storage_reader reader;
+  ASSERT_TRUE(reader.load_from_binary(buff));
+  for (size_t i = 0; i < buff.size(); ++i)
+    ASSERT_FALSE(reader.load_from_binary(epee::span<const uint8_t>((const uint8_t*)buff.data(), i)));
+
+  // a section claiming more entries than could fit in the blob
+  std::string bad = buff.substr(0, 9);
+  bad += char(0xfe);
+  bad += char(0xff);
+  bad += char(0xff);
+  bad += char(0x7f);
+  ASSERT_FALSE(reader.load_from_binary(bad));
+}
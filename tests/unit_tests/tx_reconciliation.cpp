@@ -0,0 +1,544 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <set>
+
+#include "cryptonote_basic/tx_reconciliation.h"
+#include "cryptonote_config.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "net/levin_base.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  std::vector<cryptonote::blobdata> make_txs(const char prefix, const std::size_t count)
+  {
+    std::vector<cryptonote::blobdata> txs;
+    for (std::size_t i = 0; i < count; ++i)
+      txs.push_back(std::string(1, prefix) + std::to_string(i));
+    return txs;
+  }
+
+  //! Discrete event simulation of tx relay over a random network, flooding or reconciling.
+  class relay_simulation
+  {
+  public:
+    struct result
+    {
+      std::uint64_t bytes;
+      std::uint64_t messages;
+      double average_delay;
+      double max_delay;
+      std::size_t missing;
+    };
+
+    static constexpr std::size_t nodes = 40;
+    static constexpr std::size_t out_peers = 8;
+    static constexpr std::size_t txs = 150;
+    static constexpr std::size_t tx_size = 1500;
+    static constexpr double latency = 0.1;    // seconds
+    static constexpr double tx_window = 60.0; // seconds over which txs are created
+    static constexpr double run_time = 180.0; // seconds
+
+    explicit relay_simulation(const bool reconcile)
+      : reconcile_(reconcile), rng_(42), nodes_(nodes), received_(nodes, std::vector<double>(txs, -1)), injected_(txs), bytes_(0), messages_(0), sequence_(0), now_(0)
+    {
+      for (std::size_t node = 0; node < nodes; ++node)
+      {
+        std::set<std::size_t> peers;
+        while (peers.size() < out_peers)
+        {
+          const std::size_t peer = rng_() % nodes;
+          if (peer != node && !nodes_[node].index.count(peer))
+            peers.insert(peer);
+        }
+        for (const std::size_t peer : peers)
+        {
+          if (nodes_[peer].index.count(node))
+            continue;
+          connect(node, peer, true);
+          connect(peer, node, false);
+        }
+        if (reconcile_)
+          schedule(std::uniform_real_distribution<double>(0, CRYPTONOTE_TX_RECONCILIATION_INTERVAL)(rng_), event::tick, node, 0, 0, {});
+      }
+
+      for (std::size_t tx = 0; tx < txs; ++tx)
+      {
+        injected_[tx] = std::uniform_real_distribution<double>(0, tx_window)(rng_);
+        schedule(injected_[tx], event::inject, rng_() % nodes, tx, 0, {});
+      }
+    }
+
+    result run()
+    {
+      while (!events_.empty() && events_.top().time < run_time)
+      {
+        const event e = events_.top();
+        events_.pop();
+        now_ = e.time;
+        switch (e.type)
+        {
+          case event::inject:
+            receive(e.node, e.value, nodes_[e.node].connections.size());
+            break;
+          case event::flush:
+            flush(e.node, e.value);
+            break;
+          case event::tick:
+            tick(e.node);
+            break;
+          case event::message:
+            handle(e.node, e.value, e.command, e.payload);
+            break;
+        }
+      }
+
+      result r{bytes_, messages_, 0, 0, 0};
+      std::size_t count = 0;
+      for (std::size_t node = 0; node < nodes; ++node)
+      {
+        for (std::size_t tx = 0; tx < txs; ++tx)
+        {
+          if (received_[node][tx] < 0)
+          {
+            ++r.missing;
+            continue;
+          }
+          const double delay = received_[node][tx] - injected_[tx];
+          r.average_delay += delay;
+          r.max_delay = std::max(r.max_delay, delay);
+          ++count;
+        }
+      }
+      if (count)
+        r.average_delay /= count;
+      return r;
+    }
+
+  private:
+    struct event
+    {
+      enum kind { inject, flush, tick, message };
+
+      double time;
+      std::uint64_t sequence;
+      kind type;
+      std::size_t node;
+      std::size_t value; //!< tx for inject, connection otherwise
+      int command;
+      std::string payload;
+
+      bool operator<(const event& other) const
+      {
+        return time != other.time ? time > other.time : sequence > other.sequence;
+      }
+    };
+
+    struct connection
+    {
+      std::size_t peer;
+      bool outbound;
+      std::vector<cryptonote::blobdata> fluff;
+      double flush_time;
+      cryptonote::tx_reconciliation reconciliation{std::chrono::seconds{0}}; //!< simulated time runs faster than the rate limit
+    };
+
+    struct node
+    {
+      std::vector<std::unique_ptr<connection>> connections;
+      std::map<std::size_t, std::size_t> index; //!< peer to connection
+    };
+
+    void connect(const std::size_t from, const std::size_t to, const bool outbound)
+    {
+      nodes_[from].index[to] = nodes_[from].connections.size();
+      nodes_[from].connections.emplace_back(new connection{to, outbound, {}, -1});
+    }
+
+    void schedule(const double time, const event::kind type, const std::size_t node, const std::size_t value, const int command, std::string payload)
+    {
+      events_.push(event{time, sequence_++, type, node, value, command, std::move(payload)});
+    }
+
+    template<typename T>
+    void send(const std::size_t from, const std::size_t conn, const typename T::request& message)
+    {
+      std::string payload;
+      ASSERT_TRUE(epee::serialization::store_t_to_binary(message, payload));
+      bytes_ += payload.size() + sizeof(epee::levin::bucket_head2);
+      ++messages_;
+      const std::size_t to = nodes_[from].connections[conn]->peer;
+      schedule(now_ + latency, event::message, to, nodes_[to].index.at(from), T::ID, std::move(payload));
+    }
+
+    void send_txs(const std::size_t from, const std::size_t conn, std::vector<cryptonote::blobdata> blobs)
+    {
+      if (blobs.empty())
+        return;
+      cryptonote::NOTIFY_NEW_TRANSACTIONS::request request{};
+      request.txs = std::move(blobs);
+      send<cryptonote::NOTIFY_NEW_TRANSACTIONS>(from, conn, request);
+    }
+
+    static std::size_t get_tx(const cryptonote::blobdata& blob)
+    {
+      return std::stoul(blob.substr(0, blob.find(' ')));
+    }
+
+    //! Same poisson delays as the fluff timers in levin_notify.cpp
+    void queue_fluff(const std::size_t from, const std::size_t conn, const cryptonote::blobdata& blob)
+    {
+      connection& c = *nodes_[from].connections[conn];
+      if (c.fluff.empty())
+      {
+        const unsigned quarters = CRYPTONOTE_DANDELIONPP_FLUSH_AVERAGE * (c.outbound ? 2 : 4);
+        c.flush_time = now_ + std::poisson_distribution<unsigned>(quarters)(rng_) / 4.0;
+        schedule(c.flush_time, event::flush, from, conn, 0, {});
+      }
+      c.fluff.push_back(blob);
+    }
+
+    void flush(const std::size_t from, const std::size_t conn)
+    {
+      connection& c = *nodes_[from].connections[conn];
+      std::sort(c.fluff.begin(), c.fluff.end());
+      send_txs(from, conn, std::move(c.fluff));
+      c.fluff.clear();
+    }
+
+    //! `source` is the connection the tx came in on, or past the end if created here
+    void receive(const std::size_t at, const std::size_t tx, const std::size_t source)
+    {
+      if (received_[at][tx] >= 0)
+        return;
+      received_[at][tx] = now_;
+
+      cryptonote::blobdata blob = std::to_string(tx) + ' ';
+      blob.resize(tx_size, char('a' + tx % 26));
+
+      // same choice as fluff_notify: a few random outgoing peers are still flooded
+      std::vector<std::size_t> flood;
+      node& n = nodes_[at];
+      for (std::size_t conn = 0; conn < n.connections.size(); ++conn)
+      {
+        if (conn != source && n.connections[conn]->outbound)
+          flood.push_back(conn);
+      }
+      std::shuffle(flood.begin(), flood.end(), rng_);
+      flood.resize(std::min<std::size_t>(flood.size(), CRYPTONOTE_TX_RECONCILIATION_FLOOD_PEERS));
+
+      for (std::size_t conn = 0; conn < n.connections.size(); ++conn)
+      {
+        if (conn == source)
+          continue;
+        if (reconcile_ && std::find(flood.begin(), flood.end(), conn) == flood.end())
+        {
+          if (n.connections[conn]->reconciliation.add({blob}))
+            continue;
+          for (const cryptonote::blobdata& queued : n.connections[conn]->reconciliation.flush())
+            queue_fluff(at, conn, queued);
+        }
+        queue_fluff(at, conn, blob);
+      }
+    }
+
+    void tick(const std::size_t at)
+    {
+      node& n = nodes_[at];
+      for (std::size_t conn = 0; conn < n.connections.size(); ++conn)
+      {
+        if (!n.connections[conn]->outbound)
+          continue;
+        cryptonote::NOTIFY_REQUEST_TX_SKETCH::request request{};
+        if (n.connections[conn]->reconciliation.start_round(request.salt, request.set_size))
+          send<cryptonote::NOTIFY_REQUEST_TX_SKETCH>(at, conn, request);
+      }
+      schedule(now_ + CRYPTONOTE_TX_RECONCILIATION_INTERVAL, event::tick, at, 0, 0, {});
+    }
+
+    void handle(const std::size_t at, const std::size_t conn, const int command, const std::string& payload)
+    {
+      connection& c = *nodes_[at].connections[conn];
+      switch (command)
+      {
+        case cryptonote::NOTIFY_NEW_TRANSACTIONS::ID:
+        {
+          cryptonote::NOTIFY_NEW_TRANSACTIONS::request request{};
+          ASSERT_TRUE(epee::serialization::load_t_from_binary(request, payload));
+          c.reconciliation.remove(request.txs);
+          for (const auto& blob : request.txs)
+            receive(at, get_tx(blob), conn);
+          break;
+        }
+        case cryptonote::NOTIFY_REQUEST_TX_SKETCH::ID:
+        {
+          cryptonote::NOTIFY_REQUEST_TX_SKETCH::request request{};
+          ASSERT_TRUE(epee::serialization::load_t_from_binary(request, payload));
+          cryptonote::NOTIFY_RESPONSE_TX_SKETCH::request response{};
+          ASSERT_TRUE(c.reconciliation.make_sketch(request.salt, request.set_size, response.sketch));
+          send<cryptonote::NOTIFY_RESPONSE_TX_SKETCH>(at, conn, response);
+          break;
+        }
+        case cryptonote::NOTIFY_RESPONSE_TX_SKETCH::ID:
+        {
+          cryptonote::NOTIFY_RESPONSE_TX_SKETCH::request response{};
+          ASSERT_TRUE(epee::serialization::load_t_from_binary(response, payload));
+          std::vector<cryptonote::blobdata> blobs;
+          cryptonote::NOTIFY_TX_RECONCILIATION_RESULT::request result{};
+          ASSERT_TRUE(c.reconciliation.finish_round(response.sketch, blobs, result.short_ids, result.success));
+          send<cryptonote::NOTIFY_TX_RECONCILIATION_RESULT>(at, conn, result);
+          send_txs(at, conn, std::move(blobs));
+          break;
+        }
+        case cryptonote::NOTIFY_TX_RECONCILIATION_RESULT::ID:
+        {
+          cryptonote::NOTIFY_TX_RECONCILIATION_RESULT::request result{};
+          ASSERT_TRUE(epee::serialization::load_t_from_binary(result, payload));
+          std::vector<cryptonote::blobdata> blobs;
+          c.reconciliation.get_requested(result.success, result.short_ids, blobs);
+          send_txs(at, conn, std::move(blobs));
+          break;
+        }
+        default:
+          FAIL() << "unexpected command " << command;
+      }
+    }
+
+    const bool reconcile_;
+    std::mt19937 rng_;
+    std::vector<node> nodes_;
+    std::vector<std::vector<double>> received_; //!< per node and tx, -1 until received
+    std::vector<double> injected_;
+    std::priority_queue<event> events_;
+    std::uint64_t bytes_;
+    std::uint64_t messages_;
+    std::uint64_t sequence_;
+    double now_;
+  };
+
+  constexpr std::size_t relay_simulation::nodes;
+  constexpr std::size_t relay_simulation::out_peers;
+  constexpr std::size_t relay_simulation::txs;
+  constexpr std::size_t relay_simulation::tx_size;
+  constexpr double relay_simulation::latency;
+  constexpr double relay_simulation::tx_window;
+  constexpr double relay_simulation::run_time;
+}
+
+TEST(tx_sketch, decode_difference)
+{
+  std::mt19937 rng(1);
+  for (std::size_t capacity = 1; capacity <= 32; ++capacity)
+  {
+    cryptonote::tx_sketch a{capacity}, b{capacity};
+    for (unsigned i = 0; i < 50; ++i)
+    {
+      const std::uint32_t common = rng() | 1;
+      a.add(common);
+      b.add(common);
+    }
+
+    std::set<std::uint32_t> difference;
+    while (difference.size() < capacity)
+      difference.insert(rng() | 1);
+    bool to_a = false;
+    for (const std::uint32_t element : difference)
+      ((to_a = !to_a) ? a : b).add(element);
+
+    cryptonote::tx_sketch received{};
+    ASSERT_TRUE(received.deserialize(b.serialize()));
+    a.merge(received);
+    std::vector<std::uint32_t> decoded;
+    ASSERT_TRUE(a.decode(decoded));
+    EXPECT_EQ(difference, std::set<std::uint32_t>(decoded.begin(), decoded.end()));
+    EXPECT_EQ(difference.size(), decoded.size());
+  }
+}
+
+TEST(tx_sketch, over_capacity)
+{
+  std::mt19937 rng(2);
+  cryptonote::tx_sketch sketch{8};
+  for (unsigned i = 0; i < 12; ++i)
+    sketch.add(rng() | 1);
+  std::vector<std::uint32_t> decoded;
+  EXPECT_FALSE(sketch.decode(decoded));
+  EXPECT_TRUE(decoded.empty());
+
+  EXPECT_FALSE(sketch.deserialize("abc"));
+}
+
+TEST(tx_reconciliation, round)
+{
+  cryptonote::tx_reconciliation initiator, responder;
+  const auto common = make_txs('c', 40);
+  const auto only_initiator = make_txs('i', 4);
+  const auto only_responder = make_txs('r', 6);
+  ASSERT_TRUE(initiator.add(common));
+  ASSERT_TRUE(initiator.add(only_initiator));
+  ASSERT_TRUE(responder.add(common));
+  ASSERT_TRUE(responder.add(only_responder));
+
+  crypto::hash salt;
+  std::uint64_t set_size = 0;
+  ASSERT_TRUE(initiator.start_round(salt, set_size));
+  EXPECT_EQ(44u, set_size);
+  EXPECT_EQ(0u, initiator.size());
+  EXPECT_FALSE(initiator.start_round(salt, set_size));
+
+  std::string sketch;
+  ASSERT_TRUE(responder.make_sketch(salt, set_size, sketch));
+  EXPECT_FALSE(sketch.empty());
+  EXPECT_LT(sketch.size(), 100u);
+
+  std::vector<cryptonote::blobdata> sent;
+  std::vector<std::uint32_t> requested;
+  bool success = false;
+  ASSERT_TRUE(initiator.finish_round(sketch, sent, requested, success));
+  ASSERT_TRUE(success);
+  EXPECT_EQ(std::set<cryptonote::blobdata>(only_initiator.begin(), only_initiator.end()), std::set<cryptonote::blobdata>(sent.begin(), sent.end()));
+  EXPECT_EQ(only_responder.size(), requested.size());
+
+  std::vector<cryptonote::blobdata> answered;
+  responder.get_requested(true, requested, answered);
+  EXPECT_EQ(std::set<cryptonote::blobdata>(only_responder.begin(), only_responder.end()), std::set<cryptonote::blobdata>(answered.begin(), answered.end()));
+  EXPECT_EQ(0u, responder.size());
+
+  EXPECT_FALSE(initiator.finish_round(sketch, sent, requested, success));
+}
+
+TEST(tx_reconciliation, fallback)
+{
+  cryptonote::tx_reconciliation initiator, responder;
+  ASSERT_TRUE(initiator.add(make_txs('i', 300)));
+  ASSERT_TRUE(responder.add(make_txs('r', 10)));
+
+  crypto::hash salt;
+  std::uint64_t set_size = 0;
+  ASSERT_TRUE(initiator.start_round(salt, set_size));
+  std::string sketch;
+  ASSERT_TRUE(responder.make_sketch(salt, set_size, sketch));
+  EXPECT_TRUE(sketch.empty());
+
+  std::vector<cryptonote::blobdata> sent;
+  std::vector<std::uint32_t> requested;
+  bool success = true;
+  ASSERT_TRUE(initiator.finish_round({}, sent, requested, success));
+  EXPECT_FALSE(success);
+  EXPECT_EQ(300u, sent.size());
+
+  std::vector<cryptonote::blobdata> answered;
+  responder.get_requested(false, requested, answered);
+  EXPECT_EQ(10u, answered.size());
+}
+
+TEST(tx_reconciliation, sketch_rate_limit)
+{
+  cryptonote::tx_reconciliation initiator, responder;
+  const auto common = make_txs('c', 20);
+  ASSERT_TRUE(initiator.add(common));
+  ASSERT_TRUE(initiator.add(make_txs('i', 2)));
+  ASSERT_TRUE(responder.add(common));
+  ASSERT_TRUE(responder.add(make_txs('r', 3)));
+
+  crypto::hash salt;
+  std::uint64_t set_size = 0;
+  ASSERT_TRUE(initiator.start_round(salt, set_size));
+  std::string sketch;
+  ASSERT_TRUE(responder.make_sketch(salt, set_size, sketch));
+  EXPECT_FALSE(sketch.empty());
+
+  // a peer asking again within the same round gets nothing, and the snapshot is kept
+  std::string again = "x";
+  EXPECT_FALSE(responder.make_sketch(crypto::rand<crypto::hash>(), CRYPTONOTE_TX_RECONCILIATION_MAX_CAPACITY, again));
+  EXPECT_TRUE(again.empty());
+
+  std::vector<cryptonote::blobdata> sent;
+  std::vector<std::uint32_t> requested;
+  bool success = false;
+  ASSERT_TRUE(initiator.finish_round(sketch, sent, requested, success));
+  ASSERT_TRUE(success);
+  std::vector<cryptonote::blobdata> answered;
+  responder.get_requested(true, requested, answered);
+  EXPECT_EQ(3u, answered.size());
+
+  // without a limit, every request is answered
+  cryptonote::tx_reconciliation unlimited{std::chrono::seconds{0}};
+  EXPECT_TRUE(unlimited.make_sketch(salt, 0, sketch));
+  EXPECT_TRUE(unlimited.make_sketch(salt, 0, sketch));
+}
+
+TEST(tx_reconciliation, queue_limits)
+{
+  cryptonote::tx_reconciliation reconciliation;
+  const auto txs = make_txs('t', 10);
+  ASSERT_TRUE(reconciliation.add(txs));
+  EXPECT_FALSE(reconciliation.add(make_txs('u', CRYPTONOTE_TX_RECONCILIATION_MAX_PENDING)));
+  EXPECT_EQ(10u, reconciliation.size());
+
+  reconciliation.remove({txs.front()});
+  EXPECT_EQ(9u, reconciliation.size());
+  EXPECT_EQ(9u, reconciliation.flush().size());
+  EXPECT_EQ(0u, reconciliation.size());
+}
+
+TEST(tx_reconciliation, stalled)
+{
+  cryptonote::tx_reconciliation reconciliation;
+  ASSERT_TRUE(reconciliation.add(make_txs('s', 5)));
+  EXPECT_TRUE(reconciliation.flush_stalled(std::chrono::hours{1}).empty());
+  EXPECT_EQ(5u, reconciliation.size());
+
+  // the peer never answers this round
+  crypto::hash salt;
+  std::uint64_t set_size = 0;
+  ASSERT_TRUE(reconciliation.start_round(salt, set_size));
+  EXPECT_EQ(5u, set_size);
+  EXPECT_EQ(0u, reconciliation.size());
+  EXPECT_EQ(5u, reconciliation.flush_stalled(std::chrono::seconds{0}).size());
+  EXPECT_EQ(0u, reconciliation.size());
+  EXPECT_TRUE(reconciliation.flush_stalled(std::chrono::hours{1}).empty());
+}
+
+TEST(tx_reconciliation, simulation)
+{
+  const relay_simulation::result flood = relay_simulation{false}.run();
+  const relay_simulation::result reconcile = relay_simulation{true}.run();
+
+  EXPECT_EQ(0u, flood.missing);
+  EXPECT_EQ(0u, reconcile.missing);
+  EXPECT_LT(reconcile.bytes, flood.bytes);
+  EXPECT_LT(reconcile.average_delay, 2 * flood.average_delay);
+}
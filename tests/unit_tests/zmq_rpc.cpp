@@ -26,7 +26,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <boost/optional/optional.hpp>
 #include <boost/preprocessor/stringize.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstring>
 #include <gtest/gtest.h>
 #include <rapidjson/document.h>
 
@@ -34,6 +37,8 @@
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/events.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "common/metrics.h"
+#include "int-util.h"
 #include "json_serialization.h"
 #include "net/zmq.h"
 #include "rpc/message.h"
@@ -223,6 +228,119 @@ namespace
     return testing::AssertionSuccess();
   }
 
+  //! Reads `buf` entries in the format of the binary topics
+  struct binary_reader
+  {
+    boost::string_ref buf;
+
+    template<typename T>
+    bool read(T& out)
+    {
+      if (buf.size() < sizeof(out))
+        return false;
+      std::memcpy(std::addressof(out), buf.data(), sizeof(out));
+      buf.remove_prefix(sizeof(out));
+      return true;
+    }
+
+    bool read_u32(std::uint32_t& out)
+    {
+      if (!read(out))
+        return false;
+      out = SWAP32LE(out);
+      return true;
+    }
+
+    bool read_u64(std::uint64_t& out)
+    {
+      if (!read(out))
+        return false;
+      out = SWAP64LE(out);
+      return true;
+    }
+
+    bool read_entry(crypto::hash& id, std::string& blob)
+    {
+      std::uint32_t size = 0;
+      if (!read(id) || !read_u32(size) || buf.size() < size)
+        return false;
+      blob.assign(buf.data(), size);
+      buf.remove_prefix(size);
+      return true;
+    }
+  };
+
+  //! \return Payload following `topic:` in `message`, or `boost::none`.
+  boost::optional<boost::string_ref> get_binary_payload(const std::string& message, const boost::string_ref topic)
+  {
+    if (!boost::string_ref{message}.starts_with(topic) || message.size() <= topic.size() || message[topic.size()] != ':')
+      return boost::none;
+    return boost::string_ref{message}.substr(topic.size() + 1);
+  }
+
+  testing::AssertionResult compare_binary_txpool(const std::uint64_t sequence, epee::span<const cryptonote::txpool_event> events, const std::string& message)
+  {
+    const auto payload = get_binary_payload(message, "binary-full-txpool_add");
+    MASSERT(bool(payload));
+
+    binary_reader reader{*payload};
+    std::uint64_t actual_sequence = 0;
+    std::uint32_t count = 0;
+    MASSERT(reader.read_u64(actual_sequence));
+    MASSERT(reader.read_u32(count));
+    MASSERT(sequence == actual_sequence);
+    MASSERT(count <= events.size());
+
+    for (const cryptonote::txpool_event& event : events)
+    {
+      if (!event.res)
+        continue;
+
+      crypto::hash id{};
+      std::string blob;
+      MASSERT(count--);
+      MASSERT(reader.read_entry(id, blob));
+      MASSERT(id == cryptonote::get_transaction_hash(event.tx));
+      MASSERT(blob == cryptonote::tx_to_blob(event.tx));
+    }
+    MASSERT(count == 0);
+    MASSERT(reader.buf.empty());
+    return testing::AssertionSuccess();
+  }
+
+  testing::AssertionResult compare_binary_chain(const std::uint64_t sequence, const std::uint64_t height, epee::span<const cryptonote::block> blocks, const std::string& message)
+  {
+    const auto payload = get_binary_payload(message, "binary-full-chain_main");
+    MASSERT(bool(payload));
+
+    binary_reader reader{*payload};
+    std::uint64_t actual_sequence = 0;
+    std::uint64_t actual_height = 0;
+    std::uint32_t count = 0;
+    MASSERT(reader.read_u64(actual_sequence));
+    MASSERT(sequence == actual_sequence);
+    MASSERT(reader.read_u64(actual_height));
+    MASSERT(reader.read_u32(count));
+    MASSERT(height == actual_height);
+    MASSERT(blocks.size() == count);
+
+    for (const cryptonote::block& bl : blocks)
+    {
+      crypto::hash id{};
+      std::string blob;
+      MASSERT(reader.read_entry(id, blob));
+      MASSERT(id == cryptonote::get_block_hash(bl));
+      MASSERT(blob == cryptonote::block_to_blob(bl));
+    }
+    MASSERT(reader.buf.empty());
+    return testing::AssertionSuccess();
+  }
+
+  std::uint64_t zmq_pub_sent(const std::string& topic)
+  {
+    return tools::metrics::registry::getInstance().get_counter("monero_zmq_pub_sent_total", "", "topic", topic).value();
+  }
+
   struct zmq_base : public testing::Test
   {
     cryptonote::account_base acct;
@@ -329,7 +447,7 @@ namespace
         throw std::runtime_error{"init_rpc failure"};
 
       const std::string endpoint = inproc_pub;
-      pub = server.init_pub({std::addressof(endpoint), 1});
+      pub = server.init_pub({std::addressof(endpoint), 1}, cryptonote::listener::zmq_pub::default_high_water_mark());
       if (!pub)
         throw std::runtime_error{"failed to initiaze zmq/pub"};
 
@@ -755,6 +873,95 @@ TEST_F(zmq_pub, JsonTxpoolWeakPtrSkip)
   EXPECT_NO_THROW(cryptonote::listener::zmq_pub::txpool_add{pub}(std::move(events)));
 }
 
+TEST_F(zmq_pub, BinaryFullTxpool)
+{
+  static constexpr const char topic[] = "\1binary-full-txpool_add";
+
+  ASSERT_TRUE(sub_request(topic));
+
+  std::vector<cryptonote::txpool_event> events
+  {
+   {make_transaction(), {}, true}, {make_transaction(), {}, true}
+  };
+  events.at(1).blob = cryptonote::tx_to_blob(events.at(1).tx);
+  events.at(1).hash = cryptonote::get_transaction_hash(events.at(1).tx);
+
+  const std::uint64_t sent = zmq_pub_sent("binary-full-txpool_add");
+  EXPECT_EQ(1u, pub->send_txpool_add(events));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+  EXPECT_EQ(sent + 1, zmq_pub_sent("binary-full-txpool_add"));
+
+  auto messages = get_messages(dummy_client.get());
+  EXPECT_EQ(1u, messages.size());
+  ASSERT_LE(1u, messages.size());
+  EXPECT_TRUE(compare_binary_txpool(1, epee::to_span(events), messages.front()));
+
+  events.at(0).res = false;
+  EXPECT_EQ(1u, pub->send_txpool_add(events));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  messages = get_messages(dummy_client.get());
+  EXPECT_EQ(1u, messages.size());
+  ASSERT_LE(1u, messages.size());
+  EXPECT_TRUE(compare_binary_txpool(2, epee::to_span(events), messages.front()));
+}
+
+TEST_F(zmq_pub, BinaryFullChain)
+{
+  static constexpr const char topic[] = "\1binary-full-chain_main";
+
+  ASSERT_TRUE(sub_request(topic));
+
+  const std::array<cryptonote::block, 2> blocks{{make_block(), make_block()}};
+
+  const std::uint64_t sent = zmq_pub_sent("binary-full-chain_main");
+  EXPECT_EQ(1u, pub->send_chain_main(100, epee::to_span(blocks)));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+  EXPECT_EQ(sent + 1, zmq_pub_sent("binary-full-chain_main"));
+
+  auto messages = get_messages(dummy_client.get());
+  EXPECT_EQ(1u, messages.size());
+  ASSERT_LE(1u, messages.size());
+  EXPECT_TRUE(compare_binary_chain(1, 100, epee::to_span(blocks), messages.front()));
+}
+
+TEST_F(zmq_pub, BinaryAndJson)
+{
+  ASSERT_TRUE(sub_request("\1binary"));
+  ASSERT_TRUE(sub_request("\1json-minimal"));
+
+  const std::array<cryptonote::block, 1> blocks{{make_block()}};
+
+  EXPECT_EQ(2u, pub->send_chain_main(533, epee::to_span(blocks)));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  auto messages = get_messages(dummy_client.get());
+  EXPECT_EQ(2u, messages.size());
+  ASSERT_LE(2u, messages.size());
+  EXPECT_TRUE(compare_binary_chain(1, 533, epee::to_span(blocks), messages.front()));
+  EXPECT_TRUE(boost::string_ref{messages.back()}.starts_with("json-minimal-chain_main:"));
+}
+
+TEST_F(zmq_pub, CatchAllSkipsBinary)
+{
+  ASSERT_TRUE(sub_request("\1"));
+
+  const std::array<cryptonote::block, 1> blocks{{make_block()}};
+
+  EXPECT_EQ(2u, pub->send_chain_main(533, epee::to_span(blocks)));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  auto messages = get_messages(dummy_client.get());
+  EXPECT_EQ(2u, messages.size());
+  for (const std::string& message : messages)
+    EXPECT_TRUE(boost::string_ref{message}.starts_with("json-"));
+
+  ASSERT_TRUE(sub_request("\0"));
+  EXPECT_EQ(0u, pub->send_chain_main(534, epee::to_span(blocks)));
+}
+
 TEST_F(zmq_server, pub)
 {
   subscribe("json-minimal");
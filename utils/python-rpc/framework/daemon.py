@@ -445,6 +445,11 @@ class Daemon(object):
         }
         return self.rpc.send_request('/get_net_stats', get_net_stats)
 
+    def get_db_stats(self):
+        get_db_stats = {
+        }
+        return self.rpc.send_request('/get_db_stats', get_db_stats)
+
     def get_limit(self):
         get_limit = {
         }
@@ -79,5 +79,16 @@ class JSONRPC(object):
     def send_json_rpc_request(self, inputs):
         return self.send_request("/json_rpc", inputs, 'result')
 
+    def send_json_rpc_batch(self, inputs):
+        res = requests.post(
+            self.url + "/json_rpc",
+            data=json.dumps(inputs),
+            headers={'content-type': 'application/json'})
+        res = res.json()
+
+        assert type(res) == list, res
+
+        return [Response(r) for r in res]
+
 
 